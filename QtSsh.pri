@@ -20,7 +20,47 @@ HEADERS += \
     $$PWD/qtssh/sshkey.h \
     $$PWD/qtssh/sshtunnelinconnection.h \
     $$PWD/qtssh/sshtunneloutconnection.h \
-    $$PWD/qtssh/sshtunneldataconnector.h
+    $$PWD/qtssh/sshtunneldataconnector.h \
+    $$PWD/qtssh/sshringbuffer.h \
+    $$PWD/qtssh/sshbufferpool.h \
+    $$PWD/qtssh/sshclientpool.h \
+    $$PWD/qtssh/sshsftptransferqueue.h \
+    $$PWD/qtssh/sshsftptreesync.h \
+    $$PWD/qtssh/sshsftpattrcache.h \
+    $$PWD/qtssh/sshprogressthrottle.h \
+    $$PWD/qtssh/sshprocessbatch.h \
+    $$PWD/qtssh/sshchannelregistry.h \
+    $$PWD/qtssh/sshdirectsocket.h \
+    $$PWD/qtssh/sshkeepalivescheduler.h \
+    $$PWD/qtssh/sshsessionmanager.h \
+    $$PWD/qtssh/sshtunneldynamic.h \
+    $$PWD/qtssh/sshtunneldynamicconnection.h \
+    $$PWD/qtssh/sshdirectchannel.h \
+    $$PWD/qtssh/sshchanneldevice.h \
+    $$PWD/qtssh/sshwritescheduler.h \
+    $$PWD/qtssh/sshratelimiter.h \
+    $$PWD/qtssh/sshsocketoptions.h \
+    $$PWD/qtssh/sshfleet.h \
+    $$PWD/qtssh/sshdnscache.h \
+    $$PWD/qtssh/sshhappyeyeballs.h \
+    $$PWD/qtssh/sshknownhosts.h \
+    $$PWD/qtssh/sshsftpcommandrename.h \
+    $$PWD/qtssh/sshsftpcommandsymlink.h \
+    $$PWD/qtssh/sshsftpcommandfsync.h \
+    $$PWD/qtssh/sshsftpcommandstatvfs.h \
+    $$PWD/qtssh/sshsftpcommandfile.h \
+    $$PWD/qtssh/sshsftpfile.h \
+    $$PWD/qtssh/sshshell.h \
+    $$PWD/qtssh/sshchannelio.h \
+    $$PWD/qtssh/sshtracer.h \
+    $$PWD/qtssh/sshchrometracer.h \
+    $$PWD/qtssh/sshoutputcapture.h \
+    $$PWD/qtssh/sshtararchive.h \
+    $$PWD/qtssh/sshbulktransfer.h \
+    $$PWD/qtssh/sshfilestream.h \
+    $$PWD/qtssh/sshscpbatch.h \
+    $$PWD/qtssh/sshsftppool.h \
+    $$PWD/qtssh/sshwritewindow.h
 
 
 SOURCES += \
@@ -42,6 +82,64 @@ SOURCES += \
     $$PWD/qtssh/sshkey.cpp \
     $$PWD/qtssh/sshtunnelinconnection.cpp \
     $$PWD/qtssh/sshtunneloutconnection.cpp \
-    $$PWD/qtssh/sshtunneldataconnector.cpp
+    $$PWD/qtssh/sshtunneldataconnector.cpp \
+    $$PWD/qtssh/sshringbuffer.cpp \
+    $$PWD/qtssh/sshbufferpool.cpp \
+    $$PWD/qtssh/sshclientpool.cpp \
+    $$PWD/qtssh/sshsftptransferqueue.cpp \
+    $$PWD/qtssh/sshsftptreesync.cpp \
+    $$PWD/qtssh/sshsftpattrcache.cpp \
+    $$PWD/qtssh/sshprogressthrottle.cpp \
+    $$PWD/qtssh/sshprocessbatch.cpp \
+    $$PWD/qtssh/sshchannelregistry.cpp \
+    $$PWD/qtssh/sshdirectsocket.cpp \
+    $$PWD/qtssh/sshkeepalivescheduler.cpp \
+    $$PWD/qtssh/sshsessionmanager.cpp \
+    $$PWD/qtssh/sshtunneldynamic.cpp \
+    $$PWD/qtssh/sshtunneldynamicconnection.cpp \
+    $$PWD/qtssh/sshdirectchannel.cpp \
+    $$PWD/qtssh/sshchanneldevice.cpp \
+    $$PWD/qtssh/sshwritescheduler.cpp \
+    $$PWD/qtssh/sshratelimiter.cpp \
+    $$PWD/qtssh/sshsocketoptions.cpp \
+    $$PWD/qtssh/sshfleet.cpp \
+    $$PWD/qtssh/sshdnscache.cpp \
+    $$PWD/qtssh/sshhappyeyeballs.cpp \
+    $$PWD/qtssh/sshknownhosts.cpp \
+    $$PWD/qtssh/sshsftpcommandrename.cpp \
+    $$PWD/qtssh/sshsftpcommandsymlink.cpp \
+    $$PWD/qtssh/sshsftpcommandfsync.cpp \
+    $$PWD/qtssh/sshsftpcommandstatvfs.cpp \
+    $$PWD/qtssh/sshsftpcommandfile.cpp \
+    $$PWD/qtssh/sshsftpfile.cpp \
+    $$PWD/qtssh/sshshell.cpp \
+    $$PWD/qtssh/sshchannelio.cpp \
+    $$PWD/qtssh/sshtracer.cpp \
+    $$PWD/qtssh/sshchrometracer.cpp \
+    $$PWD/qtssh/sshoutputcapture.cpp \
+    $$PWD/qtssh/sshtararchive.cpp \
+    $$PWD/qtssh/sshbulktransfer.cpp \
+    $$PWD/qtssh/sshfilestream.cpp \
+    $$PWD/qtssh/sshscpbatch.cpp \
+    $$PWD/qtssh/sshsftppool.cpp \
+    $$PWD/qtssh/sshwritewindow.cpp
 
 INCLUDEPATH += $$PWD/qtssh
+
+# C++20 coroutine API: CONFIG += qtssh_coroutines
+qtssh_coroutines {
+    CONFIG += c++2a
+    DEFINES += QTSSH_COROUTINES
+    HEADERS += $$PWD/qtssh/sshcoroutine.h
+}
+
+# zstd compression of SshBulkTransfer: CONFIG += qtssh_zstd
+qtssh_zstd {
+    DEFINES += QTSSH_ZSTD
+    LIBS += -lzstd
+}
+
+# Per packet tunnel transfer tracing: CONFIG += qtssh_trace_transfer
+qtssh_trace_transfer {
+    DEFINES += QTSSH_TRACE_TRANSFER
+}
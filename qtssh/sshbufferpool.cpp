@@ -0,0 +1,141 @@
+#include "sshbufferpool.h"
+
+Q_LOGGING_CATEGORY(logbufferpool, "ssh.bufferpool", QtWarningMsg)
+
+#define POOL_MIN_CLASS_SIZE (4*1024)
+#define POOL_CLASS_COUNT    9           /* 4 KiB to 1 MiB */
+
+SshBufferPool::SshBufferPool()
+    : m_free(POOL_CLASS_COUNT)
+{
+}
+
+SshBufferPool::~SshBufferPool()
+{
+    trim();
+}
+
+SshBufferPool &SshBufferPool::instance()
+{
+    static SshBufferPool pool;
+    return pool;
+}
+
+int SshBufferPool::sizeClass(size_t size)
+{
+    int c = 0;
+    size_t s = POOL_MIN_CLASS_SIZE;
+    while(s < size)
+    {
+        s <<= 1;
+        ++c;
+    }
+    return (c < POOL_CLASS_COUNT) ? c : -1;
+}
+
+size_t SshBufferPool::classSize(int sizeClass)
+{
+    return static_cast<size_t>(POOL_MIN_CLASS_SIZE) << sizeClass;
+}
+
+char *SshBufferPool::acquire(size_t size)
+{
+    QMutexLocker locker(&m_mutex);
+    int c = sizeClass(size);
+    size_t real = (c < 0) ? size : classSize(c);
+    char *data = nullptr;
+
+    if(c >= 0 && !m_free[c].isEmpty())
+    {
+        data = m_free[c].takeLast();
+        m_bytesCached -= real;
+    }
+    else
+    {
+        data = new char[real];
+    }
+
+    m_bytesInUse += real;
+    if(m_bytesInUse > m_highWaterMark)
+    {
+        m_highWaterMark = m_bytesInUse;
+        qCDebug(logbufferpool) << "New high water mark:" << m_highWaterMark;
+    }
+    return data;
+}
+
+void SshBufferPool::release(char *data, size_t size)
+{
+    if(data == nullptr)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    int c = sizeClass(size);
+    size_t real = (c < 0) ? size : classSize(c);
+    m_bytesInUse -= real;
+
+    if(c >= 0 && m_bytesCached + real <= m_maxCachedBytes)
+    {
+        m_free[c].append(data);
+        m_bytesCached += real;
+    }
+    else
+    {
+        delete[] data;
+    }
+}
+
+size_t SshBufferPool::bytesInUse() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesInUse;
+}
+
+size_t SshBufferPool::bytesCached() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesCached;
+}
+
+size_t SshBufferPool::highWaterMark() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_highWaterMark;
+}
+
+void SshBufferPool::resetHighWaterMark()
+{
+    QMutexLocker locker(&m_mutex);
+    m_highWaterMark = m_bytesInUse;
+}
+
+size_t SshBufferPool::maxCachedBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxCachedBytes;
+}
+
+void SshBufferPool::setMaxCachedBytes(size_t maxCachedBytes)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_maxCachedBytes = maxCachedBytes;
+        if(m_bytesCached <= m_maxCachedBytes)
+            return;
+    }
+    trim();
+}
+
+void SshBufferPool::trim()
+{
+    QMutexLocker locker(&m_mutex);
+    for(int c = 0; c < m_free.size(); ++c)
+    {
+        for(char *data: m_free[c])
+        {
+            delete[] data;
+        }
+        m_free[c].clear();
+    }
+    m_bytesCached = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QMutex>
+#include <QVector>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(logbufferpool)
+
+/**
+ * \brief Process wide pool of transfer buffers
+ * \details Buffers are grouped in size classes (power of two from 4 KiB
+ * to 1 MiB). Tunnels borrow a buffer only while data is in flight and
+ * give it back when it drains, so idle connections don't hold memory.
+ * Released buffers are kept for reuse up to maxCachedBytes().
+ */
+class SshBufferPool
+{
+    mutable QMutex m_mutex;
+    QVector<QVector<char*>> m_free;
+    size_t m_bytesInUse {0};
+    size_t m_bytesCached {0};
+    size_t m_highWaterMark {0};
+    size_t m_maxCachedBytes {8*1024*1024};
+
+    SshBufferPool();
+    static int sizeClass(size_t size);
+    static size_t classSize(int sizeClass);
+
+public:
+    ~SshBufferPool();
+    SshBufferPool(const SshBufferPool &) = delete;
+    SshBufferPool &operator=(const SshBufferPool &) = delete;
+    static SshBufferPool &instance();
+
+    char *acquire(size_t size);
+    void release(char *data, size_t size);
+
+    size_t bytesInUse() const;
+    size_t bytesCached() const;
+    size_t highWaterMark() const;
+    void resetHighWaterMark();
+
+    size_t maxCachedBytes() const;
+    void setMaxCachedBytes(size_t maxCachedBytes);
+    void trim();
+};
@@ -0,0 +1,390 @@
+#include "sshbulktransfer.h"
+#include "sshclient.h"
+#include <QEventLoop>
+#include <QDir>
+#ifdef QTSSH_ZSTD
+#include <zstd.h>
+#endif
+
+Q_LOGGING_CATEGORY(logsshbulk, "ssh.bulk", QtWarningMsg)
+
+#define BULK_CHUNK (64*1024)
+#define BULK_MAX_STDERR (64*1024)
+
+/* Stream (de)compression state of one transfer */
+struct SshBulkTransfer::Zstd
+{
+#ifdef QTSSH_ZSTD
+    ZSTD_CCtx *cctx {nullptr};
+    ZSTD_DCtx *dctx {nullptr};
+    QByteArray output;
+
+    Zstd()
+        : output(static_cast<int>(ZSTD_CStreamOutSize()), Qt::Uninitialized)
+    {
+    }
+
+    ~Zstd()
+    {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+
+    bool compress(const QByteArray &data, bool end, QByteArray &res)
+    {
+        if(!cctx)
+            cctx = ZSTD_createCCtx();
+        ZSTD_inBuffer in = {data.constData(), static_cast<size_t>(data.size()), 0};
+        forever
+        {
+            ZSTD_outBuffer out = {output.data(), static_cast<size_t>(output.size()), 0};
+            size_t remaining = ZSTD_compressStream2(cctx, &out, &in, (end) ? ZSTD_e_end : ZSTD_e_continue);
+            if(ZSTD_isError(remaining))
+                return false;
+            res.append(output.constData(), static_cast<int>(out.pos));
+            if((end) ? (remaining == 0) : (in.pos == in.size))
+                return true;
+        }
+    }
+
+    bool decompress(const QByteArray &data, QByteArray &res)
+    {
+        if(!dctx)
+            dctx = ZSTD_createDCtx();
+        ZSTD_inBuffer in = {data.constData(), static_cast<size_t>(data.size()), 0};
+        while(in.pos < in.size)
+        {
+            ZSTD_outBuffer out = {output.data(), static_cast<size_t>(output.size()), 0};
+            size_t ret = ZSTD_decompressStream(dctx, &out, &in);
+            if(ZSTD_isError(ret))
+                return false;
+            res.append(output.constData(), static_cast<int>(out.pos));
+        }
+        return true;
+    }
+#else
+    bool compress(const QByteArray &, bool, QByteArray &) { return false; }
+    bool decompress(const QByteArray &, QByteArray &) { return false; }
+#endif
+};
+
+static QString shellQuote(const QString &path)
+{
+    QString quoted(path);
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+
+SshBulkTransfer::SshBulkTransfer(SshClient *client, const QString &name, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_name(name)
+{
+}
+
+SshBulkTransfer::~SshBulkTransfer()
+{
+    if(m_proc)
+    {
+        QObject::disconnect(m_proc, nullptr, this, nullptr);
+        m_proc->close();
+    }
+    _reset();
+}
+
+bool SshBulkTransfer::isCompressionSupported(Compression compression)
+{
+#ifdef QTSSH_ZSTD
+    Q_UNUSED(compression)
+    return true;
+#else
+    return compression == NoCompression;
+#endif
+}
+
+void SshBulkTransfer::setCompression(Compression compression)
+{
+    m_compression = compression;
+}
+
+SshBulkTransfer::Compression SshBulkTransfer::compression() const
+{
+    return m_compression;
+}
+
+void SshBulkTransfer::setWindowSize(qint64 size)
+{
+    m_windowSize = qMax<qint64>(size, BULK_CHUNK);
+}
+
+qint64 SshBulkTransfer::windowSize() const
+{
+    return m_windowSize;
+}
+
+bool SshBulkTransfer::isFinished() const
+{
+    return m_finished;
+}
+
+bool SshBulkTransfer::isError() const
+{
+    return m_error;
+}
+
+QStringList SshBulkTransfer::errMsg() const
+{
+    return m_errMsg;
+}
+
+int SshBulkTransfer::exitStatus() const
+{
+    return m_exitStatus;
+}
+
+int SshBulkTransfer::fileCount() const
+{
+    return m_fileCount;
+}
+
+int SshBulkTransfer::totalFileCount() const
+{
+    return m_totalFileCount;
+}
+
+void SshBulkTransfer::_reset()
+{
+    delete m_writer;
+    m_writer = nullptr;
+    delete m_reader;
+    m_reader = nullptr;
+    delete m_zstd;
+    m_zstd = nullptr;
+}
+
+bool SshBulkTransfer::put(const QString &localDir, const QString &remoteDir)
+{
+    if(m_running)
+        return false;
+    _reset();
+    m_errMsg.clear();
+    m_writer = new SshTarWriter();
+    if(!m_writer->addTree(localDir))
+    {
+        m_errMsg << m_writer->errors();
+        m_error = true;
+        return false;
+    }
+    m_totalFileCount = 0;
+    for(int i = 0; i < m_writer->entryCount(); i++)
+    {
+        if(!m_writer->entry(i).directory)
+            m_totalFileCount++;
+    }
+
+    QString extract = (m_compression == Zstd) ? "zstd -dcq | tar -xf -" : "tar -xf -";
+    if(!_start(QString("mkdir -p %1 && cd %1 && %2").arg(shellQuote(remoteDir), extract)))
+        return false;
+
+    QObject::connect(m_proc, &SshProcess::bytesWritten, this, &SshBulkTransfer::_feed, Qt::QueuedConnection);
+    _feed();
+    return true;
+}
+
+bool SshBulkTransfer::get(const QString &remoteDir, const QString &localDir)
+{
+    if(m_running)
+        return false;
+    _reset();
+    m_errMsg.clear();
+    if(!QDir().mkpath(localDir))
+    {
+        m_errMsg << QString("Can't create %1").arg(localDir);
+        m_error = true;
+        return false;
+    }
+    m_reader = new SshTarReader(QDir(localDir).absolutePath());
+    m_totalFileCount = -1;
+
+    QString create = (m_compression == Zstd) ? "tar -cf - . | zstd -cq" : "tar -cf - .";
+    if(!_start(QString("cd %1 && %2").arg(shellQuote(remoteDir), create)))
+        return false;
+
+    QObject::connect(m_proc, &SshProcess::readyReadStandardOutput, this, &SshBulkTransfer::_readOutput);
+    return true;
+}
+
+bool SshBulkTransfer::_start(const QString &command)
+{
+    if(!isCompressionSupported(m_compression))
+    {
+        m_errMsg << "zstd compression not built in (QTSSH_ZSTD)";
+        m_error = true;
+        return false;
+    }
+    if(m_compression == Zstd)
+        m_zstd = new Zstd();
+
+    m_running = true;
+    m_finished = false;
+    m_error = false;
+    m_stderr.clear();
+    m_exitStatus = -1;
+    m_fileCount = 0;
+    m_done = 0;
+
+    qCDebug(logsshbulk) << m_name << "run" << command;
+    m_proc = m_client->getChannel<SshProcess>(QString("%1_%2").arg(m_name).arg(m_id++));
+    m_proc->setStreaming(true);
+    QObject::connect(m_proc, &SshProcess::readyReadStandardError, this, &SshBulkTransfer::_readError);
+    QObject::connect(m_proc, &SshProcess::finished, this, [this](){ _finish(true); });
+    QObject::connect(m_proc, &SshProcess::failed, this, [this](){ _finish(false); });
+    m_proc->runCommand(command);
+    return true;
+}
+
+void SshBulkTransfer::_feed()
+{
+    if(!m_proc || !m_writer || !m_running)
+        return;
+
+    while(m_proc->bytesToWrite() < m_windowSize && !m_writer->atEnd())
+    {
+        QByteArray chunk = m_writer->read(BULK_CHUNK);
+        if(m_zstd)
+        {
+            QByteArray compressed;
+            if(!m_zstd->compress(chunk, m_writer->atEnd(), compressed))
+            {
+                m_errMsg << "zstd compression failed";
+                m_error = true;
+                m_proc->close();
+                return;
+            }
+            chunk.swap(compressed);
+        }
+        if(!chunk.isEmpty())
+            m_proc->write(chunk);
+        _filesDone(m_writer->takeCompleted());
+        emit progress(m_writer->position(), m_writer->archiveSize());
+    }
+    if(m_writer->atEnd())
+    {
+        /* EOF sent by the channel once the queued data is written */
+        m_proc->closeWriteChannel();
+    }
+}
+
+void SshBulkTransfer::_readOutput()
+{
+    if(!m_proc || !m_reader)
+        return;
+
+    QByteArray data = m_proc->readAllStandardOutput();
+    m_done += data.size();
+    if(m_zstd)
+    {
+        QByteArray plain;
+        if(!m_zstd->decompress(data, plain))
+        {
+            m_errMsg << "zstd decompression failed";
+            m_error = true;
+            m_proc->close();
+            return;
+        }
+        data.swap(plain);
+    }
+    if(!m_reader->feed(data.constData(), data.size()))
+    {
+        m_error = true;
+        m_proc->close();
+    }
+    _filesDone(m_reader->takeCompleted());
+    emit progress(m_done, -1);
+}
+
+void SshBulkTransfer::_readError()
+{
+    if(!m_proc)
+        return;
+    QByteArray data = m_proc->readAllStandardError();
+    m_stderr.append(data.left(BULK_MAX_STDERR - m_stderr.size()));
+}
+
+void SshBulkTransfer::_filesDone(const QList<SshTarEntry> &entries)
+{
+    for(const SshTarEntry &entry: entries)
+    {
+        if(entry.directory)
+            continue;
+        m_fileCount++;
+        emit fileTransferred(entry.path, entry.size);
+    }
+}
+
+void SshBulkTransfer::_finish(bool processOk)
+{
+    if(!m_running)
+        return;
+    m_running = false;
+
+    if(m_proc)
+    {
+        m_exitStatus = m_proc->exitStatus();
+        if(!processOk)
+            m_errMsg << m_proc->errMsg();
+    }
+    if(!processOk)
+    {
+        m_error = true;
+    }
+    else if(m_exitStatus != 0)
+    {
+        m_error = true;
+        m_errMsg << QString("Remote tar exited with %1: %2").arg(m_exitStatus).arg(QString::fromUtf8(m_stderr).trimmed());
+    }
+    if(m_writer)
+    {
+        if(!m_writer->errors().isEmpty())
+        {
+            m_error = true;
+            m_errMsg << m_writer->errors();
+        }
+        if(!m_writer->atEnd())
+        {
+            m_error = true;
+            m_errMsg << "Upload interrupted";
+        }
+    }
+    if(m_reader)
+    {
+        if(!m_reader->errors().isEmpty())
+        {
+            m_error = true;
+            m_errMsg << m_reader->errors();
+        }
+        if(!m_reader->atEnd())
+        {
+            m_error = true;
+            m_errMsg << "Archive truncated";
+        }
+    }
+
+    qCDebug(logsshbulk) << m_name << "done" << m_fileCount << "files, exit" << m_exitStatus << m_errMsg;
+    m_finished = true;
+    _reset();
+    if(m_error)
+        emit failed();
+    emit finished();
+}
+
+bool SshBulkTransfer::waitForFinished()
+{
+    QEventLoop wait(this);
+    QObject::connect(this, &SshBulkTransfer::finished, &wait, &QEventLoop::quit);
+    while(m_running)
+    {
+        wait.exec();
+    }
+    return m_finished && !m_error;
+}
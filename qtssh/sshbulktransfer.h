@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include "sshprocess.h"
+#include "sshtararchive.h"
+
+class SshClient;
+
+/**
+ * \brief Directory upload and download as one tar stream
+ * \details put() archives a local directory on the fly into the standard
+ * input of a remote "tar -x", get() extracts the output of a remote
+ * "tar -c": a whole tree costs one channel and no round trip per file.
+ * With zstd compression (library built with QTSSH_ZSTD, zstd installed
+ * on the server), the stream is compressed on both ends. The transfer
+ * succeeds when tar exits with 0 and, for get(), the archive is complete.
+ */
+class SshBulkTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Compression {
+        NoCompression,
+        Zstd
+    };
+
+    explicit SshBulkTransfer(SshClient *client, const QString &name = "bulk", QObject *parent = nullptr);
+    virtual ~SshBulkTransfer() override;
+
+    static bool isCompressionSupported(Compression compression);
+    void setCompression(Compression compression);
+    Compression compression() const;
+
+    /* Upload data queued on the channel before waiting for it to drain */
+    void setWindowSize(qint64 size);
+    qint64 windowSize() const;
+
+    bool put(const QString &localDir, const QString &remoteDir);
+    bool get(const QString &remoteDir, const QString &localDir);
+    bool waitForFinished();
+
+    bool isFinished() const;
+    bool isError() const;
+    QStringList errMsg() const;
+    int exitStatus() const;
+
+    /* Files transferred, total known for put() only (-1 otherwise) */
+    int fileCount() const;
+    int totalFileCount() const;
+
+signals:
+    /* A file is complete in the stream (put) or on disk (get) */
+    void fileTransferred(const QString &path, qint64 size);
+    /* Archive bytes, total is -1 for get() */
+    void progress(qint64 done, qint64 total);
+    void finished();
+    void failed();
+
+private:
+    struct Zstd;
+
+    SshClient *m_client;
+    QString m_name;
+    int m_id {0};
+    Compression m_compression {NoCompression};
+    qint64 m_windowSize {1024*1024};
+
+    QPointer<SshProcess> m_proc;
+    SshTarWriter *m_writer {nullptr};
+    SshTarReader *m_reader {nullptr};
+    Zstd *m_zstd {nullptr};
+    bool m_running {false};
+    bool m_finished {false};
+    bool m_error {false};
+    QStringList m_errMsg;
+    QByteArray m_stderr;
+    int m_exitStatus {-1};
+    int m_fileCount {0};
+    int m_totalFileCount {-1};
+    qint64 m_done {0};
+
+    bool _start(const QString &command);
+    void _reset();
+    void _feed();
+    void _readOutput();
+    void _readError();
+    void _filesDone(const QList<SshTarEntry> &entries);
+    void _finish(bool processOk);
+};
@@ -1,6 +1,10 @@
 #include "sshchannel.h"
 #include "sshclient.h"
+#include "sshtracer.h"
 #include <QCoreApplication>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
 
 Q_LOGGING_CATEGORY(sshchannel, "ssh.channel", QtWarningMsg)
 
@@ -10,13 +14,17 @@ SshChannel::SshChannel(QString name, SshClient *client)
     , m_name(name)
 {
     qCDebug(sshchannel) << "createChannel:" << m_name;
-    QObject::connect(m_sshClient, &SshClient::sshDataReceived, this, &SshChannel::sshDataReceived, Qt::QueuedConnection);
+    m_stateClock.start();
 }
 
 SshChannel::~SshChannel()
 {
     qCDebug(sshchannel) << "destroyChannel:" << this;
     setChannelState(ChannelState::Free);
+    if(m_registry)
+    {
+        m_registry->remove(this);
+    }
 }
 
 SshClient *SshChannel::sshClient() const
@@ -24,6 +32,11 @@ SshClient *SshChannel::sshClient() const
     return m_sshClient;
 }
 
+bool SshChannel::skipWaitClosed() const
+{
+    return m_sshClient && m_sshClient->isClosingFast();
+}
+
 SshChannel::ChannelState SshChannel::channelState() const
 {
     return m_channelState;
@@ -34,11 +47,36 @@ void SshChannel::setChannelState(const ChannelState &channelState)
     if(m_channelState != channelState)
     {
         qCDebug(sshchannel)  << m_name << "Change State:" << m_channelState << "->" << channelState;
+        qint64 elapsed = m_stateClock.nsecsElapsed();
+        m_stateTime[m_channelState] += m_stateClock.restart();
+        if(SshTracer *tracer = SshTracer::installed())
+        {
+            tracer->channelStateChanged(this, m_channelState, channelState, SshTracer::now(), elapsed);
+        }
+        if(m_openLatency < 0 && m_channelState == ChannelState::Openning && (channelState == ChannelState::Exec || channelState == ChannelState::Ready))
+        {
+            m_openLatency = m_stateTime[ChannelState::Openning];
+        }
         m_channelState = channelState;
         emit stateChanged(m_channelState);
     }
 }
 
+SshChannel::Stats SshChannel::stats() const
+{
+    Stats stats {};
+    stats.name = m_name;
+    stats.state = m_channelState;
+    stats.openLatency = m_openLatency;
+    for(int i = 0; i <= ChannelState::Error; i++)
+    {
+        stats.stateTime[i] = m_stateTime[i];
+    }
+    stats.stateTime[m_channelState] += m_stateClock.elapsed();
+    transferStats(stats);
+    return stats;
+}
+
 bool SshChannel::waitForState(SshChannel::ChannelState state)
 {
     QEventLoop wait(this);
@@ -51,6 +89,189 @@ bool SshChannel::waitForState(SshChannel::ChannelState state)
 }
 
 
+LIBSSH2_CHANNEL *SshChannel::dispatchChannel() const
+{
+    return nullptr;
+}
+
+bool SshChannel::sshEventPending()
+{
+    /* Opening and closing steps wait for session replies we can't see */
+    if(m_channelState != ChannelState::Ready)
+        return true;
+
+    LIBSSH2_CHANNEL *channel = dispatchChannel();
+    if(channel == nullptr)
+        return true;
+
+    if(libssh2_poll_channel_read(channel, 0) || libssh2_poll_channel_read(channel, 1))
+        return true;
+
+    if(libssh2_channel_eof(channel))
+        return true;
+
+    /* Remote side adjust our window: a blocked write can continue */
+    return m_writeWindow.adjusted(libssh2_channel_window_write_ex(channel, nullptr));
+}
+
+void SshChannel::writeWindowUsed(LIBSSH2_CHANNEL *channel)
+{
+    if(channel)
+        m_writeWindow.written(libssh2_channel_window_write_ex(channel, nullptr));
+}
+
+void SshChannel::_resetForReuse(const QString &name)
+{
+    qCDebug(sshchannel) << "reuseChannel:" << m_name << "as" << name;
+    m_name = name;
+    m_channelState = ChannelState::Openning;
+    m_writeWindow.reset();
+    m_priority = Priority::Normal;
+    m_rateLimiter.setRate(0);
+    m_windowSize = 0;
+    m_packetSize = 0;
+    m_windowTarget = 0;
+    m_windowGranted = 0;
+    std::fill(std::begin(m_stateTime), std::end(m_stateTime), 0);
+    m_openLatency = -1;
+    m_stateClock.start();
+}
+
+void SshChannel::_queueSshEvent()
+{
+    if(!m_sshEventQueued)
+    {
+        m_sshEventQueued = true;
+        QMetaObject::invokeMethod(this, "_dispatchSshEvent", Qt::QueuedConnection);
+    }
+}
+
+void SshChannel::_dispatchSshEvent()
+{
+    m_sshEventQueued = false;
+    sshDataReceived();
+}
+
+void SshChannel::setPriority(Priority priority)
+{
+    m_priority = priority;
+}
+
+SshChannel::Priority SshChannel::priority() const
+{
+    return m_priority;
+}
+
+void SshChannel::setRateLimit(quint64 bytesPerSecond, quint64 burst)
+{
+    m_rateLimiter.setRate(bytesPerSecond, burst);
+    if(bytesPerSecond == 0)
+    {
+        /* A throttled write may wait for tokens which are not needed anymore */
+        _queueSshEvent();
+    }
+}
+
+quint64 SshChannel::rateLimit() const
+{
+    return m_rateLimiter.rate();
+}
+
+void SshChannel::setWindowSize(quint32 size)
+{
+    m_windowSize = size;
+}
+
+void SshChannel::setPacketSize(quint32 size)
+{
+    m_packetSize = size;
+}
+
+quint32 SshChannel::windowSize() const
+{
+    return (m_windowSize) ? m_windowSize : m_sshClient->channelWindowSize();
+}
+
+quint32 SshChannel::packetSize() const
+{
+    return (m_packetSize) ? m_packetSize : m_sshClient->channelPacketSize();
+}
+
+LIBSSH2_CHANNEL *SshChannel::openChannel(const char *type, const QByteArray &message)
+{
+    LIBSSH2_CHANNEL *channel = libssh2_channel_open_ex(m_sshClient->session(), type, static_cast<unsigned int>(strlen(type)),
+                                                       windowSize(), packetSize(),
+                                                       message.isEmpty() ? nullptr : message.constData(),
+                                                       static_cast<unsigned int>(message.size()));
+    if(channel)
+    {
+        m_windowTarget = windowSize();
+        m_windowGranted = m_windowTarget;
+    }
+    return channel;
+}
+
+LIBSSH2_CHANNEL *SshChannel::openDirectTcpip(const QString &host, quint16 port)
+{
+    /* Same request as libssh2_channel_direct_tcpip(), RFC 4254 7.2 */
+    auto putString = [](QByteArray &msg, const QByteArray &str) {
+        quint32 len = static_cast<quint32>(str.size());
+        msg.append(static_cast<char>(len >> 24)).append(static_cast<char>(len >> 16));
+        msg.append(static_cast<char>(len >> 8)).append(static_cast<char>(len));
+        msg.append(str);
+    };
+    auto putPort = [](QByteArray &msg, quint32 value) {
+        msg.append(static_cast<char>(value >> 24)).append(static_cast<char>(value >> 16));
+        msg.append(static_cast<char>(value >> 8)).append(static_cast<char>(value));
+    };
+
+    QByteArray message;
+    putString(message, host.toUtf8());
+    putPort(message, port);
+    putString(message, QByteArray("127.0.0.1"));
+    putPort(message, 22);
+    return openChannel("direct-tcpip", message);
+}
+
+void SshChannel::tuneWindow(LIBSSH2_CHANNEL *channel)
+{
+    if(channel == nullptr)
+        return;
+
+    if(m_windowTarget == 0)
+    {
+        /* Accepted channel: opened by libssh2 with its default window */
+        unsigned long initial = 0;
+        libssh2_channel_window_read_ex(channel, nullptr, &initial);
+        m_windowGranted = initial;
+        m_windowTarget = qMax<quint64>(initial, windowSize());
+    }
+
+    if(m_sshClient->windowAutoTune() && m_windowTarget < m_sshClient->windowAutoTuneMax())
+    {
+        /* The peer used most of the window before we read: it is the limit */
+        unsigned long window = libssh2_channel_window_read_ex(channel, nullptr, nullptr);
+        if(m_windowGranted == m_windowTarget && window < m_windowGranted / 4)
+        {
+            m_windowTarget = qMin<quint64>(m_windowTarget * 2, m_sshClient->windowAutoTuneMax());
+            qCDebug(sshchannel) << m_name << "Grow receive window to" << m_windowTarget;
+        }
+    }
+
+    if(m_windowGranted < m_windowTarget)
+    {
+        unsigned int window = 0;
+        int ret = libssh2_channel_receive_window_adjust2(channel, static_cast<unsigned long>(m_windowTarget - m_windowGranted), 1, &window);
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            _queueSshEvent();
+            return;
+        }
+        /* On error keep the window we have */
+        m_windowGranted = m_windowTarget;
+    }
+}
+
 QString SshChannel::name() const
 {
     return m_name;
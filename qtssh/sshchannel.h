@@ -12,9 +12,16 @@
 #include <QObject>
 #include <QLoggingCategory>
 #include <QMutex>
+#include <QElapsedTimer>
+#include "sshratelimiter.h"
+#include "sshwritewindow.h"
 #include <libssh2.h>
 
 class SshClient;
+class SshChannelRegistry;
+
+/* Channel writes by size: < 64, < 128 ... < 16K, >= 16K bytes */
+#define SSH_WRITE_HISTOGRAM_BUCKETS 10
 
 Q_DECLARE_LOGGING_CATEGORY(sshchannel)
 
@@ -22,6 +29,8 @@ class SshChannel : public QObject
 {
     Q_OBJECT
     friend class SshClient;
+    friend class SshChannelRegistry;
+    friend class SshWriteScheduler;
 
 public:
     QString name() const;
@@ -39,23 +48,123 @@ public:
     };
     Q_ENUM(ChannelState)
 
+    /* Write share of the channel on a busy session (SshWriteScheduler) */
+    enum Priority {
+        Interactive,
+        Normal,
+        Bulk
+    };
+    Q_ENUM(Priority)
+
     ChannelState channelState() const;
     void setChannelState(const ChannelState &channelState);
     bool waitForState(SshChannel::ChannelState state);
 
     SshClient *sshClient() const;
 
+    /*
+     * Receive window and max packet size of this channel, 0 to use the
+     * SshClient ones. Applied when the channel is opened (or accepted).
+     */
+    void setWindowSize(quint32 size);
+    void setPacketSize(quint32 size);
+    quint32 windowSize() const;
+    quint32 packetSize() const;
+
+    void setPriority(Priority priority);
+    Priority priority() const;
+
+    /* Write rate limit of this channel, 0 for unlimited, can be changed at any time */
+    void setRateLimit(quint64 bytesPerSecond, quint64 burst = 0);
+    quint64 rateLimit() const;
+
+    struct Stats {
+        QString name;
+        ChannelState state;
+        quint64 bytesIn;                /* read from the channel */
+        quint64 bytesOut;               /* written on the channel */
+        quint64 stalls;                 /* EAGAIN on write and full buffer */
+        quint64 buffered;               /* held in the channel buffers */
+        qint64 openLatency;             /* ms from creation to open, -1 until opened */
+        qint64 stateTime[Error + 1];    /* ms spent in each state */
+        quint64 writeSizes[SSH_WRITE_HISTOGRAM_BUCKETS];
+    };
+    Stats stats() const;
+
+    /* Called after each write on the channel: the window it left wakes the next adjust */
+    void writeWindowUsed(LIBSSH2_CHANNEL *channel);
+
 protected:
     explicit SshChannel(QString name, SshClient *client);
     virtual ~SshChannel();
     SshClient *m_sshClient  {nullptr};
     QString m_name;
 
+    /* libssh2 channel used by SshClient to know if this channel has pending events */
+    virtual LIBSSH2_CHANNEL *dispatchChannel() const;
+    virtual bool sshEventPending();
+
+    /*
+     * Session lost with auto reconnect enabled: return true to be kept,
+     * after dropping every libssh2 resource, and be given sessionRestored()
+     * once the new session is Ready. Other channels are closed.
+     */
+    virtual bool sessionLost() { return false; }
+    virtual void sessionRestored() {}
+
+    /*
+     * Free channel kept by SshClient for a later getChannel() of the same
+     * type: return true after dropping the state of the finished
+     * connection, false to be deleted. reuse() follows when the channel is
+     * given out again, renamed and back in Openning state.
+     */
+    virtual bool recycle() { return false; }
+    virtual void reuse() {}
+
+    /* Channel opening with the configured window and packet size */
+    LIBSSH2_CHANNEL *openChannel(const char *type, const QByteArray &message = QByteArray());
+    LIBSSH2_CHANNEL *openDirectTcpip(const QString &host, quint16 port);
+
+    /*
+     * Grow the receive window of an opened channel up to windowSize(), and
+     * with auto tuning, double it while the peer exhausts it. Called after
+     * each read, retries by itself when libssh2 returns EAGAIN.
+     */
+    void tuneWindow(LIBSSH2_CHANNEL *channel);
+
+    /* Client disconnecting with fast close: don't wait for the peer close */
+    bool skipWaitClosed() const;
+
+    /* Transfer counters of stats(), left to 0 by channels without data */
+    virtual void transferStats(Stats &stats) const { Q_UNUSED(stats) }
+
 protected slots:
     virtual void sshDataReceived() {}
 
 private:
     ChannelState m_channelState {ChannelState::Openning};
+    bool m_sshEventQueued {false};
+    SshWriteWindow m_writeWindow;
+    Priority m_priority {Priority::Normal};
+    SshRateLimiter m_rateLimiter;
+    quint32 m_windowSize {0};
+    quint32 m_packetSize {0};
+    quint64 m_windowTarget {0};
+    quint64 m_windowGranted {0};
+    QElapsedTimer m_stateClock;
+    qint64 m_stateTime[Error + 1] {};
+    qint64 m_openLatency {-1};
+    void _queueSshEvent();
+    void _resetForReuse(const QString &name);
+
+    /* Intrusive hooks of the SshClient channel registry */
+    SshChannelRegistry *m_registry {nullptr};
+    SshChannel *m_registryPrev {nullptr};
+    SshChannel *m_registryNext {nullptr};
+    QString m_registryName;
+
+private slots:
+    void _dispatchSshEvent();
 
 signals:
     void stateChanged(ChannelState state);
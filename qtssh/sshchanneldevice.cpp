@@ -0,0 +1,204 @@
+#include "sshchanneldevice.h"
+#include "sshdirectchannel.h"
+#include <QEventLoop>
+#include <QTimer>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(logsshchanneldevice, "ssh.channeldevice", QtWarningMsg)
+
+SshChannelDevice::SshChannelDevice(SshDirectChannel *channel, QObject *parent)
+    : QIODevice(parent)
+    , m_channel(channel)
+{
+    QObject::connect(channel, &SshDirectChannel::opened, this, &SshChannelDevice::_channelOpened);
+    QObject::connect(channel, &SshDirectChannel::dataReceived, this, &SshChannelDevice::readyRead);
+    QObject::connect(channel, &SshDirectChannel::dataWritten, this, &SshChannelDevice::bytesWritten);
+    QObject::connect(channel, &SshDirectChannel::finished, this, &SshChannelDevice::_channelFinished);
+    QObject::connect(channel, &SshDirectChannel::failed, this, &SshChannelDevice::_channelFailed);
+    QObject::connect(channel, &SshChannel::stateChanged, this, &SshChannelDevice::_channelStateChanged);
+    /* The channel buffers are the device buffers */
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+SshChannelDevice::~SshChannelDevice()
+{
+    if(m_channel)
+    {
+        QObject::disconnect(m_channel, nullptr, this, nullptr);
+        m_channel->close();
+    }
+}
+
+bool SshChannelDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 SshChannelDevice::bytesAvailable() const
+{
+    qint64 available = m_channel ? static_cast<qint64>(m_channel->m_rx.size()) : 0;
+    return available + QIODevice::bytesAvailable();
+}
+
+qint64 SshChannelDevice::bytesToWrite() const
+{
+    qint64 pending = m_channel ? static_cast<qint64>(m_channel->m_tx.size()) : 0;
+    return pending + QIODevice::bytesToWrite();
+}
+
+bool SshChannelDevice::atEnd() const
+{
+    return bytesAvailable() == 0 && (!m_channel || m_channel->atEof());
+}
+
+void SshChannelDevice::close()
+{
+    QIODevice::close();
+    if(m_channel)
+    {
+        m_channel->close();
+    }
+}
+
+bool SshChannelDevice::isConnected() const
+{
+    return m_connected && m_channel;
+}
+
+void SshChannelDevice::setBufferSize(size_t size)
+{
+    if(m_channel)
+    {
+        m_channel->setBufferSize(size);
+    }
+}
+
+qint64 SshChannelDevice::readData(char *data, qint64 maxlen)
+{
+    if(!m_channel)
+    {
+        return -1;
+    }
+
+    SshRingBuffer &rx = m_channel->m_rx;
+    qint64 len = 0;
+    while(len < maxlen && !rx.isEmpty())
+    {
+        size_t chunk = qMin(rx.readSize(), static_cast<size_t>(maxlen - len));
+        memcpy(data + len, rx.readPointer(), chunk);
+        rx.consume(chunk);
+        len += static_cast<qint64>(chunk);
+    }
+
+    if(len > 0)
+    {
+        /* Room again in the buffer: the channel can be read (window adjusted) */
+        emit m_channel->sendEvent();
+    }
+    else if(m_channel->atEof())
+    {
+        return -1;
+    }
+    return len;
+}
+
+qint64 SshChannelDevice::writeData(const char *data, qint64 len)
+{
+    if(!m_channel || m_channel->m_closing)
+    {
+        setErrorString("Channel closed");
+        return -1;
+    }
+
+    SshRingBuffer &tx = m_channel->m_tx;
+    qint64 done = 0;
+    while(done < len && !tx.isFull())
+    {
+        size_t chunk = qMin(tx.writeSize(), static_cast<size_t>(len - done));
+        memcpy(tx.writePointer(), data + done, chunk);
+        tx.commit(chunk);
+        done += static_cast<qint64>(chunk);
+    }
+
+    if(done > 0)
+    {
+        emit m_channel->sendEvent();
+    }
+    return done;
+}
+
+bool SshChannelDevice::_waitFor(int msecs, const std::function<bool()> &done)
+{
+    QEventLoop wait;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &wait, &QEventLoop::quit);
+    QObject::connect(this, &SshChannelDevice::connected, &wait, &QEventLoop::quit);
+    QObject::connect(this, &SshChannelDevice::readyRead, &wait, &QEventLoop::quit);
+    QObject::connect(this, &SshChannelDevice::bytesWritten, &wait, &QEventLoop::quit);
+    QObject::connect(this, &SshChannelDevice::disconnected, &wait, &QEventLoop::quit);
+    QObject::connect(this, &SshChannelDevice::errorOccurred, &wait, &QEventLoop::quit);
+    if(msecs >= 0)
+    {
+        timeout.start(msecs);
+    }
+
+    while(!done())
+    {
+        if(!m_channel || (msecs >= 0 && !timeout.isActive()))
+        {
+            return done();
+        }
+        wait.exec();
+    }
+    return true;
+}
+
+bool SshChannelDevice::waitForConnected(int msecs)
+{
+    return _waitFor(msecs, [this](){ return m_connected; });
+}
+
+bool SshChannelDevice::waitForReadyRead(int msecs)
+{
+    qint64 available = bytesAvailable();
+    return _waitFor(msecs, [this, available](){ return bytesAvailable() > available; });
+}
+
+bool SshChannelDevice::waitForBytesWritten(int msecs)
+{
+    if(bytesToWrite() == 0)
+    {
+        return false;
+    }
+    qint64 pending = bytesToWrite();
+    return _waitFor(msecs, [this, pending](){ return bytesToWrite() < pending; });
+}
+
+void SshChannelDevice::_channelOpened()
+{
+    m_connected = true;
+    emit connected();
+}
+
+void SshChannelDevice::_channelFinished()
+{
+    emit readChannelFinished();
+}
+
+void SshChannelDevice::_channelFailed(const QString &message)
+{
+    setErrorString(message);
+    emit errorOccurred(message);
+}
+
+void SshChannelDevice::_channelStateChanged()
+{
+    if(m_channel && m_channel->channelState() == SshChannel::Free)
+    {
+        qCDebug(logsshchanneldevice) << "Channel" << m_channel->name() << "freed";
+        m_connected = false;
+        /* Unread data stays in the channel until it is deleted */
+        emit disconnected();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QIODevice>
+#include <QPointer>
+#include <QLoggingCategory>
+#include <functional>
+
+class SshDirectChannel;
+
+Q_DECLARE_LOGGING_CATEGORY(logsshchanneldevice)
+
+/**
+ * \brief Sequential QIODevice backed by a direct-tcpip channel
+ * \details Given by SshClient::openDirectChannel(), no local listener nor
+ * socket is involved. readyRead() is emitted when data is received and
+ * bytesWritten() when written data is given to the channel. Reads and
+ * writes are bounded by the buffer size: write() may accept only a part
+ * of the data, the rest has to be written again after bytesWritten().
+ */
+class SshChannelDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit SshChannelDevice(SshDirectChannel *channel, QObject *parent = nullptr);
+    virtual ~SshChannelDevice() override;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool atEnd() const override;
+    void close() override;
+    bool waitForReadyRead(int msecs) override;
+    bool waitForBytesWritten(int msecs) override;
+
+    /* Channel opened, the device is readable and writable */
+    bool isConnected() const;
+    bool waitForConnected(int msecs = 30000);
+
+    /* Applied before the first transfer only */
+    void setBufferSize(size_t size);
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    QPointer<SshDirectChannel> m_channel;
+    bool m_connected {false};
+    bool _waitFor(int msecs, const std::function<bool()> &done);
+
+private slots:
+    void _channelOpened();
+    void _channelFinished();
+    void _channelFailed(const QString &message);
+    void _channelStateChanged();
+
+signals:
+    void connected();
+    void disconnected();
+    void errorOccurred(const QString &message);
+};
@@ -0,0 +1,35 @@
+#include "sshchannelio.h"
+
+namespace {
+
+class SshChannelIoLibssh2 : public SshChannelIo
+{
+public:
+    ssize_t write(LIBSSH2_CHANNEL *channel, const char *buffer, size_t length) override
+    {
+        return libssh2_channel_write(channel, buffer, length);
+    }
+
+    ssize_t read(LIBSSH2_CHANNEL *channel, char *buffer, size_t length) override
+    {
+        return libssh2_channel_read(channel, buffer, length);
+    }
+
+    int eof(LIBSSH2_CHANNEL *channel) override
+    {
+        return libssh2_channel_eof(channel);
+    }
+
+    int sendEof(LIBSSH2_CHANNEL *channel) override
+    {
+        return libssh2_channel_send_eof(channel);
+    }
+};
+
+}
+
+SshChannelIo &SshChannelIo::direct()
+{
+    static SshChannelIoLibssh2 io;
+    return io;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QtGlobal>
+#include <libssh2.h>
+
+/*
+ * Data calls of an opened channel, as used by SshTunnelDataConnector.
+ * direct() forwards to libssh2; a fake backend replays EAGAIN patterns
+ * and window sizes without session, so the data pumps can be measured
+ * offline. Same conventions as libssh2: LIBSSH2_ERROR_EAGAIN when the
+ * call would block, other negative values on error.
+ */
+class SshChannelIo
+{
+public:
+    virtual ~SshChannelIo() = default;
+
+    virtual ssize_t write(LIBSSH2_CHANNEL *channel, const char *buffer, size_t length) = 0;
+    virtual ssize_t read(LIBSSH2_CHANNEL *channel, char *buffer, size_t length) = 0;
+    virtual int eof(LIBSSH2_CHANNEL *channel) = 0;
+    virtual int sendEof(LIBSSH2_CHANNEL *channel) = 0;
+
+    /* libssh2 backend, shared and stateless */
+    static SshChannelIo &direct();
+};
@@ -0,0 +1,93 @@
+#include "sshchannelregistry.h"
+#include "sshchannel.h"
+
+SshChannelRegistry::const_iterator &SshChannelRegistry::const_iterator::operator++()
+{
+    m_channel = m_channel->m_registryNext;
+    return *this;
+}
+
+void SshChannelRegistry::insert(SshChannel *channel)
+{
+    if(channel->m_registry)
+    {
+        return;
+    }
+    channel->m_registry = this;
+    channel->m_registryName = channel->name();
+    channel->m_registryPrev = m_tail;
+    channel->m_registryNext = nullptr;
+    if(m_tail)
+    {
+        m_tail->m_registryNext = channel;
+    }
+    else
+    {
+        m_head = channel;
+    }
+    m_tail = channel;
+    m_byName.insert(channel->m_registryName, channel);
+    ++m_count;
+}
+
+bool SshChannelRegistry::remove(SshChannel *channel)
+{
+    if(channel->m_registry != this)
+    {
+        return false;
+    }
+
+    /* Keep the next pointer: an iteration on this channel can go on */
+    if(channel->m_registryPrev)
+    {
+        channel->m_registryPrev->m_registryNext = channel->m_registryNext;
+    }
+    else
+    {
+        m_head = channel->m_registryNext;
+    }
+    if(channel->m_registryNext)
+    {
+        channel->m_registryNext->m_registryPrev = channel->m_registryPrev;
+    }
+    else
+    {
+        m_tail = channel->m_registryPrev;
+    }
+    channel->m_registryPrev = nullptr;
+    channel->m_registry = nullptr;
+    m_byName.remove(channel->m_registryName, channel);
+    --m_count;
+    return true;
+}
+
+bool SshChannelRegistry::contains(SshChannel *channel) const
+{
+    return channel->m_registry == this;
+}
+
+QList<SshChannel *> SshChannelRegistry::find(const QString &name) const
+{
+    return m_byName.values(name);
+}
+
+int SshChannelRegistry::count() const
+{
+    return m_count;
+}
+
+bool SshChannelRegistry::isEmpty() const
+{
+    return m_count == 0;
+}
+
+QList<SshChannel *> SshChannelRegistry::toList() const
+{
+    QList<SshChannel *> list;
+    list.reserve(m_count);
+    for(SshChannel *channel = m_head; channel; channel = channel->m_registryNext)
+    {
+        list.append(channel);
+    }
+    return list;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QMultiHash>
+#include <QString>
+
+class SshChannel;
+
+/*
+ * Channels of a SshClient, hashed by name for the lookups and chained
+ * through the channels themselves (intrusive list) so removal and
+ * iteration in creation order cost nothing more than the hash.
+ */
+class SshChannelRegistry
+{
+public:
+    class const_iterator
+    {
+    public:
+        explicit const_iterator(SshChannel *channel = nullptr): m_channel(channel) {}
+        SshChannel *operator*() const { return m_channel; }
+        const_iterator &operator++();
+        bool operator==(const const_iterator &other) const { return m_channel == other.m_channel; }
+        bool operator!=(const const_iterator &other) const { return m_channel != other.m_channel; }
+
+    private:
+        SshChannel *m_channel;
+    };
+
+    SshChannelRegistry() = default;
+    SshChannelRegistry(const SshChannelRegistry &) = delete;
+    SshChannelRegistry &operator=(const SshChannelRegistry &) = delete;
+
+    void insert(SshChannel *channel);
+    bool remove(SshChannel *channel);
+    bool contains(SshChannel *channel) const;
+
+    /* Channels registered with this name, usually only one */
+    QList<SshChannel *> find(const QString &name) const;
+
+    template<typename T>
+    T *find(const QString &name) const
+    {
+        for(auto it = m_byName.constFind(name); it != m_byName.constEnd() && it.key() == name; ++it)
+        {
+            T *channel = qobject_cast<T*>(it.value());
+            if(channel)
+            {
+                return channel;
+            }
+        }
+        return nullptr;
+    }
+
+    int count() const;
+    int size() const { return count(); }
+    bool isEmpty() const;
+
+    /* Copy for loops which may close (and unregister) channels */
+    QList<SshChannel *> toList() const;
+
+    const_iterator begin() const { return const_iterator(m_head); }
+    const_iterator end() const { return const_iterator(); }
+
+private:
+    QMultiHash<QString, SshChannel *> m_byName;
+    SshChannel *m_head {nullptr};
+    SshChannel *m_tail {nullptr};
+    int m_count {0};
+};
@@ -0,0 +1,116 @@
+#include "sshchrometracer.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMetaEnum>
+
+SshChromeTracer::SshChromeTracer(int maxEvents)
+    : m_maxEvents(maxEvents)
+{
+}
+
+void SshChromeTracer::clientStateChanged(const SshClient *client, SshClient::SshState from, SshClient::SshState to, qint64 timestamp, qint64 duration)
+{
+    QMetaEnum states = QMetaEnum::fromType<SshClient::SshState>();
+    _record(client, client->getName(), "SshClient", states.valueToKey(from), states.valueToKey(to), timestamp, duration);
+}
+
+void SshChromeTracer::channelStateChanged(const SshChannel *channel, SshChannel::ChannelState from, SshChannel::ChannelState to, qint64 timestamp, qint64 duration)
+{
+    QMetaEnum states = QMetaEnum::fromType<SshChannel::ChannelState>();
+    _record(channel, channel->name(), "SshChannel", states.valueToKey(from), states.valueToKey(to), timestamp, duration);
+}
+
+void SshChromeTracer::_record(const void *object, const QString &name, const QString &category, const char *state, const char *next, qint64 timestamp, qint64 duration)
+{
+    QMutexLocker lock(&m_mutex);
+    m_totals[category + "::" + state] += duration;
+    if(m_events.size() >= m_maxEvents)
+    {
+        m_dropped++;
+        return;
+    }
+
+    /* Addresses are reused once objects are gone: the name is in the key */
+    QString key = QString::number(reinterpret_cast<quintptr>(object), 16) + '/' + name;
+    auto it = m_trackIds.find(key);
+    if(it == m_trackIds.end())
+    {
+        it = m_trackIds.insert(key, m_trackNames.size());
+        m_trackNames.append(category + " " + name);
+    }
+    m_events.append({it.value(), category, state, next, timestamp - duration, duration});
+}
+
+void SshChromeTracer::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_events.clear();
+    m_totals.clear();
+    m_trackIds.clear();
+    m_trackNames.clear();
+    m_dropped = 0;
+}
+
+int SshChromeTracer::eventCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_events.size();
+}
+
+int SshChromeTracer::droppedCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_dropped;
+}
+
+QHash<QString, qint64> SshChromeTracer::phaseTotals() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_totals;
+}
+
+QJsonDocument SshChromeTracer::toJson() const
+{
+    QMutexLocker lock(&m_mutex);
+    QJsonArray events;
+    for(int track = 0; track < m_trackNames.size(); track++)
+    {
+        events.append(QJsonObject {
+            {"name", "thread_name"},
+            {"ph", "M"},
+            {"pid", 1},
+            {"tid", track},
+            {"args", QJsonObject {{"name", m_trackNames.at(track)}}}
+        });
+    }
+    for(const Event &event: m_events)
+    {
+        /* Trace event times are in us */
+        events.append(QJsonObject {
+            {"name", event.state},
+            {"cat", event.category},
+            {"ph", "X"},
+            {"pid", 1},
+            {"tid", event.track},
+            {"ts", static_cast<double>(event.begin) / 1000.0},
+            {"dur", static_cast<double>(event.duration) / 1000.0},
+            {"args", QJsonObject {{"next", event.next}}}
+        });
+    }
+    return QJsonDocument(QJsonObject {
+        {"traceEvents", events},
+        {"displayTimeUnit", "ms"}
+    });
+}
+
+bool SshChromeTracer::save(const QString &path) const
+{
+    QByteArray json = toJson().toJson(QJsonDocument::Compact);
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    return file.write(json) == json.size();
+}
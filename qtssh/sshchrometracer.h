@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QJsonDocument>
+#include "sshtracer.h"
+
+/*
+ * Records the state spans and exports them in the Chrome trace event
+ * format (chrome://tracing, ui.perfetto.dev): one track per client and
+ * channel, one complete event per state left. Keeps the maxEvents first
+ * spans, phaseTotals() has the time spent in each state over all of them.
+ */
+class SshChromeTracer : public SshTracer
+{
+public:
+    explicit SshChromeTracer(int maxEvents = 100000);
+
+    void clientStateChanged(const SshClient *client, SshClient::SshState from, SshClient::SshState to, qint64 timestamp, qint64 duration) override;
+    void channelStateChanged(const SshChannel *channel, SshChannel::ChannelState from, SshChannel::ChannelState to, qint64 timestamp, qint64 duration) override;
+
+    void clear();
+    int eventCount() const;
+    int droppedCount() const;
+
+    /* "SshClient::HandShake", "SshChannel::WaitClose"... total ns */
+    QHash<QString, qint64> phaseTotals() const;
+
+    QJsonDocument toJson() const;
+    bool save(const QString &path) const;
+
+private:
+    struct Event {
+        int track;
+        QString category;
+        QString state;
+        QString next;
+        qint64 begin;
+        qint64 duration;
+    };
+    void _record(const void *object, const QString &name, const QString &category, const char *state, const char *next, qint64 timestamp, qint64 duration);
+
+    mutable QMutex m_mutex;
+    int m_maxEvents;
+    int m_dropped {0};
+    QList<Event> m_events;
+    QHash<QString, qint64> m_totals;
+    QHash<QString, int> m_trackIds;
+    QList<QString> m_trackNames;
+};
@@ -10,7 +10,11 @@
 #include "sshprocess.h"
 #include "sshscpsend.h"
 #include "sshscpget.h"
+#include "sshsftppool.h"
 #include "sshsftp.h"
+#include "sshdirectchannel.h"
+#include "sshchanneldevice.h"
+#include "sshtracer.h"
 #include "cerrno"
 
 Q_LOGGING_CATEGORY(sshclient, "ssh.client", QtWarningMsg)
@@ -25,7 +29,18 @@ Q_LOGGING_CATEGORY(sshclient, "ssh.client", QtWarningMsg)
 #define MAX_LOST_KEEP_ALIVE 6
 #endif
 
+#if !defined(KEEP_ALIVE_INTERVAL)
+/* Default keepalive interval (seconds) */
+#define KEEP_ALIVE_INTERVAL 5
+#endif
+
 int SshClient::s_nbInstance = 0;
+static QMutex s_nbInstanceLock;
+
+/* Reconnections skip the method negotiation */
+static QMutex s_reconnectCacheLock;
+static QHash<QString, QByteArray> s_authMethods;
+static QHash<QString, QByteArray> s_agentIdentities;
 
 static ssize_t qt_callback_libssh_recv(int socket,void *buffer, size_t length,int flags, void **abstract)
 {
@@ -33,6 +48,11 @@ static ssize_t qt_callback_libssh_recv(int socket,void *buffer, size_t length,in
     Q_UNUSED(flags)
 
     QTcpSocket * c = reinterpret_cast<QTcpSocket *>(* abstract);
+    if(c == nullptr)
+    {
+        /* Session left behind by a reconnection */
+        return -ENOTCONN;
+    }
     qint64 r = c->read(reinterpret_cast<char *>(buffer), static_cast<qint64>(length));
     if (r == 0)
     {
@@ -47,6 +67,11 @@ static ssize_t qt_callback_libssh_send(int socket,const void * buffer, size_t le
     Q_UNUSED(flags)
 
     QTcpSocket * c = reinterpret_cast<QTcpSocket *>(* abstract);
+    if(c == nullptr)
+    {
+        /* Session left behind by a reconnection */
+        return -ENOTCONN;
+    }
     qint64 r = c->write(reinterpret_cast<const char *>(buffer), static_cast<qint64>(length));
     if (r == 0)
     {
@@ -55,21 +80,103 @@ static ssize_t qt_callback_libssh_send(int socket,const void * buffer, size_t le
     return static_cast<ssize_t>(r);
 }
 
+static ssize_t direct_callback_libssh_recv(int socket, void *buffer, size_t length, int flags, void **abstract)
+{
+    Q_UNUSED(socket)
+    Q_UNUSED(flags)
+
+    SshDirectSocket *c = reinterpret_cast<SshDirectSocket *>(* abstract);
+    if(c == nullptr)
+    {
+        /* Session left behind by a reconnection */
+        return -ENOTCONN;
+    }
+    return c->recv(buffer, length);
+}
+
+static ssize_t direct_callback_libssh_send(int socket, const void *buffer, size_t length, int flags, void **abstract)
+{
+    Q_UNUSED(socket)
+    Q_UNUSED(flags)
+
+    SshDirectSocket *c = reinterpret_cast<SshDirectSocket *>(* abstract);
+    if(c == nullptr)
+    {
+        /* Session left behind by a reconnection */
+        return -ENOTCONN;
+    }
+    return c->send(buffer, length);
+}
+
 void SshClient::setProxy(QNetworkProxy *proxy)
 {
     m_proxy = proxy;
 }
 
+void SshClient::setDirectTransport(bool enable)
+{
+    m_directTransport = enable;
+}
+
+bool SshClient::directTransport() const
+{
+    return m_directTransport;
+}
+
 void SshClient::setConnectTimeout(int timeoutMsec)
 {
     m_connTimeoutCnt = timeoutMsec;
 }
 
+void SshClient::setConnectAttemptDelay(int msec)
+{
+    m_connector.setAttemptDelay(msec);
+    m_directSocket.setAttemptDelay(msec);
+}
+
+int SshClient::connectAttemptDelay() const
+{
+    return m_connector.attemptDelay();
+}
+
+void SshClient::setFastClose(bool enable)
+{
+    m_fastClose = enable;
+}
+
+bool SshClient::fastClose() const
+{
+    return m_fastClose;
+}
+
+void SshClient::setCloseTimeout(int msec)
+{
+    m_closeTimeout = qMax(0, msec);
+}
+
+int SshClient::closeTimeout() const
+{
+    return m_closeTimeout;
+}
+
+bool SshClient::isClosingFast() const
+{
+    return (m_fastClose || m_fastCloseOnce) && m_sshState == SshState::DisconnectingChannel;
+}
+
 SshClient::SshClient(const QString &name, QObject * parent):
     QObject(parent),
     m_name(name),
-    m_socket(this)
+    m_socket(this),
+    m_directSocket(this),
+    m_connector(this),
+    m_connectionTimeout(this)
 {
+    m_openClock.start();
+    m_stateClock.start();
+    m_keepAliveInterval = KEEP_ALIVE_INTERVAL;
+    m_keepAliveMissed = MAX_LOST_KEEP_ALIVE;
+
     /* New implementation */
     QObject::connect(this, &SshClient::sshEvent, this, &SshClient::_ssh_processEvent, Qt::QueuedConnection);
     QObject::connect(&m_socket, &QTcpSocket::connected,      this, &SshClient::_connection_socketConnected);
@@ -82,15 +189,36 @@ SshClient::SshClient(const QString &name, QObject * parent):
                                                              this, &SshClient::_connection_socketError);
 #endif
     QObject::connect(&m_socket, &QTcpSocket::readyRead,      this, &SshClient::_ssh_processEvent, Qt::QueuedConnection);
+    QObject::connect(&m_directSocket, &SshDirectSocket::connected,     this, &SshClient::_connection_socketConnected);
+    QObject::connect(&m_directSocket, &SshDirectSocket::disconnected,  this, &SshClient::_connection_socketDisconnected);
+    QObject::connect(&m_directSocket, &SshDirectSocket::errorOccurred, this, &SshClient::_connection_socketError);
+    QObject::connect(&m_directSocket, &SshDirectSocket::readyRead,     this, [this](){
+        _ssh_processEvent();
+        /* Whatever the pass did, the next data must wake us up */
+        m_directSocket.rearm();
+    }, Qt::QueuedConnection);
+    QObject::connect(&m_directSocket, &SshDirectSocket::readyWrite,    this, &SshClient::_transportWritable);
+    QObject::connect(&m_connector, &SshHappyEyeballs::connected, this, [this](qintptr fd){
+        /* Raced outside of Qt, the socket adopts the winner */
+        m_socket.setSocketDescriptor(fd);
+        _connection_socketConnected();
+    });
+    QObject::connect(&m_connector, &SshHappyEyeballs::failed,  this, &SshClient::_connection_socketError);
     QObject::connect(&m_connectionTimeout, &QTimer::timeout, this, &SshClient::_connection_socketTimeout);
-    QObject::connect(&m_keepalive,&QTimer::timeout,          this, &SshClient::_sendKeepAlive);
+    m_reconnectTimer.setSingleShot(true);
+    QObject::connect(&m_reconnectTimer, &QTimer::timeout,    this, &SshClient::_reconnect);
+    m_closeDeadline.setSingleShot(true);
+    QObject::connect(&m_closeDeadline, &QTimer::timeout,     this, &SshClient::_closeDeadlineReached);
+    QObject::connect(&m_statsTimer, &QTimer::timeout,        this, [this](){ emit statsUpdated(stats()); });
 
+    s_nbInstanceLock.lock();
     if(s_nbInstance == 0)
     {
         qCDebug(sshclient) << m_name << ": libssh2_init()";
         Q_ASSERT(libssh2_init(0) == 0);
     }
     ++s_nbInstance;
+    s_nbInstanceLock.unlock();
 
     qCDebug(sshclient) << m_name << ": created " << this;
 }
@@ -100,12 +228,20 @@ SshClient::~SshClient()
     qCDebug(sshclient) << m_name << ": SshClient::~SshClient() " << this;
     disconnectFromHost();
     waitForState(SshClient::SshState::Unconnected);
+    _stopKeepAlive();
+    for(const DeadSession &dead: m_deadSessions)
+    {
+        libssh2_session_free(dead.session);
+    }
+    m_deadSessions.clear();
+    s_nbInstanceLock.lock();
     --s_nbInstance;
     if(s_nbInstance == 0)
     {
         qCDebug(sshclient) << m_name << ": libssh2_exit()";
         libssh2_exit();
     }
+    s_nbInstanceLock.unlock();
     qCDebug(sshclient) << m_name << ": destroyed";
 }
 
@@ -114,30 +250,236 @@ QString SshClient::getName() const
     return m_name;
 }
 
-bool SshClient::takeChannelCreationMutex(void *identifier)
+bool SshClient::acquireChannelOpen(SshChannel *channel)
 {
-    if ( ! channelCreationInProgress.tryLock() && currentLockerForChannelCreation != identifier )
+    if(!m_openRequests.contains(channel))
     {
-        qCDebug(sshclient) << "takeChannelCreationMutex another channel is already been created, have to wait";
+        OpenRequest request;
+        request.enqueued = m_openClock.elapsed();
+        request.granted = -1;
+        request.destroyed = QObject::connect(channel, &QObject::destroyed, this, [this, channel](){
+            _removeOpenRequest(channel);
+        });
+        request.stateChanged = QObject::connect(channel, &SshChannel::stateChanged, this, [this, channel](SshChannel::ChannelState state){
+            /* Closed before its open completed */
+            if(state >= SshChannel::ChannelState::Close)
+                _removeOpenRequest(channel);
+        });
+        m_openRequests.insert(channel, request);
+        m_openQueue.append(channel);
+        m_openStats.queueDepth = m_openQueue.size();
+        m_openStats.maxQueueDepth = qMax(m_openStats.maxQueueDepth, m_openStats.queueDepth);
+    }
+
+    if(m_openQueue.first() != channel)
+    {
+        qCDebug(sshclient) << m_name << ": channel" << channel->name() << "waits to open, queue depth" << m_openQueue.size();
         return false;
     }
-    currentLockerForChannelCreation = identifier;
+
+    OpenRequest &request = m_openRequests[channel];
+    if(request.granted < 0)
+    {
+        request.granted = m_openClock.elapsed();
+        m_openStats.totalWait += request.granted - request.enqueued;
+    }
     return true;
 }
 
-void SshClient::releaseChannelCreationMutex(void *identifier)
+void SshClient::releaseChannelOpen(SshChannel *channel, const void *result)
+{
+    if(m_openQueue.isEmpty() || m_openQueue.first() != channel)
+    {
+        qCCritical(sshclient) << "Trying to release channel open but it isn't its turn";
+        return;
+    }
+    if(result == nullptr && libssh2_session_last_errno(m_session) == LIBSSH2_ERROR_EAGAIN)
+    {
+        /* libssh2 open in progress, keep the turn */
+        return;
+    }
+
+    qint64 latency = m_openClock.elapsed() - m_openRequests[channel].enqueued;
+    m_openStats.opened++;
+    m_openStats.lastLatency = latency;
+    m_openStats.maxLatency = qMax(m_openStats.maxLatency, latency);
+    m_openStats.totalLatency += latency;
+    _removeOpenRequest(channel);
+}
+
+void SshClient::_removeOpenRequest(SshChannel *channel)
+{
+    auto it = m_openRequests.find(channel);
+    if(it == m_openRequests.end())
+        return;
+
+    QObject::disconnect(it->destroyed);
+    QObject::disconnect(it->stateChanged);
+    m_openRequests.erase(it);
+    bool wasFirst = (!m_openQueue.isEmpty() && m_openQueue.first() == channel);
+    m_openQueue.removeOne(channel);
+    m_openStats.queueDepth = m_openQueue.size();
+
+    /* Wake up the next channel instead of waiting for the next packet */
+    if(wasFirst && !m_openQueue.isEmpty())
+    {
+        m_openQueue.first()->_queueSshEvent();
+    }
+}
+
+SshClient::ChannelOpenStats SshClient::channelOpenStats() const
+{
+    return m_openStats;
+}
+
+void SshClient::resetChannelOpenStats()
+{
+    int depth = m_openStats.queueDepth;
+    m_openStats = ChannelOpenStats {};
+    m_openStats.queueDepth = depth;
+    m_openStats.maxQueueDepth = depth;
+}
+
+SshWriteScheduler &SshClient::writeScheduler()
+{
+    return m_writeScheduler;
+}
+
+SshSftpPool *SshClient::sftpPool()
+{
+    if(m_sftpPool == nullptr)
+    {
+        m_sftpPool = new SshSftpPool(this);
+    }
+    return m_sftpPool;
+}
+
+void SshClient::setSocketOptions(const SshSocketOptions &options)
+{
+    m_socketOptions = options;
+    m_directSocket.setOptions(options);
+}
+
+SshSocketOptions SshClient::socketOptions() const
+{
+    return m_socketOptions;
+}
+
+void SshClient::setSessionOptions(const SessionOptions &options)
+{
+    m_sessionOptions = options;
+}
+
+SshClient::SessionOptions SshClient::sessionOptions() const
+{
+    return m_sessionOptions;
+}
+
+SshClient::NegotiatedMethods SshClient::negotiatedMethods() const
+{
+    return m_negotiated;
+}
+
+void SshClient::_applySessionOptions()
+{
+    if(m_sessionOptions.compression)
+    {
+        libssh2_session_flag(m_session, LIBSSH2_FLAG_COMPRESS, 1);
+    }
+
+    const struct {
+        int method;
+        const QByteArray &prefs;
+    } prefs[] = {
+        { LIBSSH2_METHOD_KEX,      m_sessionOptions.kex },
+        { LIBSSH2_METHOD_HOSTKEY,  m_sessionOptions.hostKey },
+        { LIBSSH2_METHOD_CRYPT_CS, m_sessionOptions.ciphers },
+        { LIBSSH2_METHOD_CRYPT_SC, m_sessionOptions.ciphers },
+        { LIBSSH2_METHOD_MAC_CS,   m_sessionOptions.macs },
+        { LIBSSH2_METHOD_MAC_SC,   m_sessionOptions.macs },
+    };
+    for(const auto &pref: prefs)
+    {
+        if(pref.prefs.isEmpty())
+            continue;
+        int ret = libssh2_session_method_pref(m_session, pref.method, pref.prefs.constData());
+        if(ret < 0)
+        {
+            /* None of the methods is supported by this libssh2: keep defaults */
+            qCWarning(sshclient) << m_name << "Method preference" << pref.prefs << "refused:" << sshErrorToString(ret);
+        }
+    }
+}
+
+void SshClient::_readNegotiatedMethods()
+{
+    auto method = [this](int type) { return QByteArray(libssh2_session_methods(m_session, type)); };
+    m_negotiated.kex = method(LIBSSH2_METHOD_KEX);
+    m_negotiated.hostKey = method(LIBSSH2_METHOD_HOSTKEY);
+    m_negotiated.cipherClientToServer = method(LIBSSH2_METHOD_CRYPT_CS);
+    m_negotiated.cipherServerToClient = method(LIBSSH2_METHOD_CRYPT_SC);
+    m_negotiated.macClientToServer = method(LIBSSH2_METHOD_MAC_CS);
+    m_negotiated.macServerToClient = method(LIBSSH2_METHOD_MAC_SC);
+    m_negotiated.compressionClientToServer = method(LIBSSH2_METHOD_COMP_CS);
+    m_negotiated.compressionServerToClient = method(LIBSSH2_METHOD_COMP_SC);
+    qCInfo(sshclient) << m_name << "Negotiated kex:" << m_negotiated.kex << "hostkey:" << m_negotiated.hostKey
+                      << "cipher:" << m_negotiated.cipherClientToServer << "/" << m_negotiated.cipherServerToClient
+                      << "mac:" << m_negotiated.macClientToServer << "/" << m_negotiated.macServerToClient
+                      << "compression:" << m_negotiated.compressionClientToServer << "/" << m_negotiated.compressionServerToClient;
+}
+
+void SshClient::setRateLimit(quint64 bytesPerSecond, quint64 burst)
 {
-    if ( currentLockerForChannelCreation == identifier )
+    m_writeScheduler.setSessionRateLimit(bytesPerSecond, burst);
+}
+
+quint64 SshClient::rateLimit() const
+{
+    return m_writeScheduler.sessionRateLimit();
+}
+
+SshClient::Stats SshClient::stats() const
+{
+    Stats stats {};
+    stats.open = m_openStats;
+    for(int i = 0; i <= SshState::Error; i++)
+    {
+        stats.stateTime[i] = m_stateTime[i];
+    }
+    stats.stateTime[m_sshState] += m_stateClock.elapsed();
+    stats.bytesIn = m_freedBytesIn;
+    stats.bytesOut = m_freedBytesOut;
+    stats.stalls = m_freedStalls;
+    for(SshChannel *channel: m_channels)
     {
-        channelCreationInProgress.unlock();
-        currentLockerForChannelCreation = nullptr;
+        SshChannel::Stats channelStats = channel->stats();
+        stats.bytesIn += channelStats.bytesIn;
+        stats.bytesOut += channelStats.bytesOut;
+        stats.stalls += channelStats.stalls;
+        stats.buffered += channelStats.buffered;
+        stats.channelStats.append(channelStats);
+    }
+    stats.channels = stats.channelStats.size();
+    return stats;
+}
+
+void SshClient::setStatsInterval(int msec)
+{
+    if(msec > 0)
+    {
+        m_statsTimer.start(msec);
     }
     else
     {
-        qCCritical(sshclient) << "Trying to release channel mutex but it doesn't host it";
+        m_statsTimer.stop();
     }
 }
 
+int SshClient::statsInterval() const
+{
+    return m_statsTimer.isActive() ? m_statsTimer.interval() : 0;
+}
+
 LIBSSH2_SESSION *SshClient::session()
 {
     return m_session;
@@ -153,7 +495,11 @@ int SshClient::connectToHost(const QString &user, const QString &host, quint16 p
     qCDebug(sshclient) << m_name << "connectToHost:" << user << "@" << host << ":" << port;
 
     m_connTimeoutCnt = connTimeoutMsec;
+    m_connectMethodes = methodes;
     m_authenticationMethodes = methodes;
+    m_authMethod.clear();
+    m_authFromCache = false;
+    m_authCacheTried = false;
     m_hostname = host;
     m_port = port;
     m_username = user;
@@ -180,6 +526,20 @@ bool SshClient::waitForState(SshState state)
 void SshClient::disconnectFromHost()
 {
     qCDebug(sshclient) << m_name << ": disconnectFromHost(): state is " << m_sshState << " and channel size is " << m_channels.size();
+    m_reconnectArmed = false;
+    m_reconnectTimer.stop();
+    if(m_recovering)
+    {
+        /* Tunnels waiting for the new session */
+        m_recovering = false;
+        if(m_sshState == SshState::Unconnected)
+        {
+            for(SshChannel *ch: m_channels.toList())
+            {
+                ch->close();
+            }
+        }
+    }
     if(m_sshState == SshState::Unconnected)
         return;
 
@@ -193,12 +553,39 @@ void SshClient::disconnectFromHost()
     else
     {
         setSshState(DisconnectingChannel);
+        if(m_closeTimeout > 0 && !m_closeDeadline.isActive())
+        {
+            m_closeDeadline.start(m_closeTimeout);
+        }
     }
 
     emit sshEvent();
     return;
 }
 
+void SshClient::disconnectFromHostAsync(bool deleteWhenDone)
+{
+    m_fastCloseOnce = true;
+    m_deleteWhenDone = deleteWhenDone;
+    disconnectFromHost();
+    if(deleteWhenDone && (m_sshState == SshState::Unconnected || m_sshState == SshState::Error))
+    {
+        /* Nothing to wait for */
+        deleteLater();
+    }
+}
+
+void SshClient::_closeDeadlineReached()
+{
+    if(m_sshState != SshState::DisconnectingChannel)
+    {
+        return;
+    }
+    qCWarning(sshclient) << m_name << ": close timeout," << m_channels.size() << "channels abandoned";
+    setSshState(DisconnectingSession);
+    emit sshEvent();
+}
+
 void SshClient::resetError()
 {
     waitForState(Unconnected);
@@ -210,18 +597,115 @@ void SshClient::resetError()
 void SshClient::setPassphrase(const QString & pass)
 {
     m_passphrase = pass;
+    m_passphraseData = pass.toUtf8();
 }
 
 void SshClient::setKeys(const QString &publicKey, const QString &privateKey)
 {
     m_publicKey  = publicKey;
     m_privateKey = privateKey;
+    m_publicKeyData = publicKey.toUtf8();
+    m_privateKeyData = privateKey.toUtf8();
+}
+
+QString SshClient::_authCacheKey() const
+{
+    return QString("%1@%2:%3").arg(m_username, m_hostname).arg(m_port);
+}
+
+void SshClient::setUseAgent(bool enable, const QString &path)
+{
+    m_useAgent = enable;
+    m_agentPath = path;
+}
+
+bool SshClient::useAgent() const
+{
+    return m_useAgent;
+}
+
+int SshClient::_agentAuthenticate()
+{
+    if(!m_agent)
+    {
+        m_agent = libssh2_agent_init(m_session);
+        if(!m_agent)
+        {
+            return LIBSSH2_ERROR_AGENT_PROTOCOL;
+        }
+#if LIBSSH2_VERSION_NUM >= 0x010900
+        if(!m_agentPath.isEmpty())
+        {
+            libssh2_agent_set_identity_path(m_agent, qPrintable(m_agentPath));
+        }
+#endif
+        if(libssh2_agent_connect(m_agent) != 0 || libssh2_agent_list_identities(m_agent) != 0)
+        {
+            qCDebug(sshclient) << m_name << ": no usable ssh-agent";
+            return LIBSSH2_ERROR_AGENT_PROTOCOL;
+        }
+
+        QByteArray preferred;
+        {
+            QMutexLocker locker(&s_reconnectCacheLock);
+            preferred = s_agentIdentities.value(_authCacheKey());
+        }
+        struct libssh2_agent_publickey *identity = nullptr;
+        struct libssh2_agent_publickey *prev = nullptr;
+        while(libssh2_agent_get_identity(m_agent, &identity, prev) == 0)
+        {
+            QByteArray blob(reinterpret_cast<const char *>(identity->blob), static_cast<int>(identity->blob_len));
+            if(blob == preferred)
+                m_agentIdentities.prepend(identity);
+            else
+                m_agentIdentities.append(identity);
+            prev = identity;
+        }
+        m_agentIndex = 0;
+    }
+
+    QByteArray username = m_username.toUtf8();
+    while(m_agentIndex < m_agentIdentities.size())
+    {
+        struct libssh2_agent_publickey *identity = m_agentIdentities[m_agentIndex];
+        int ret = libssh2_agent_userauth(m_agent, username.constData(), identity);
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            return ret;
+        }
+        if(ret == 0)
+        {
+            qCDebug(sshclient) << m_name << ": Authenticated with agent identity" << identity->comment;
+            QMutexLocker locker(&s_reconnectCacheLock);
+            s_agentIdentities.insert(_authCacheKey(), QByteArray(reinterpret_cast<const char *>(identity->blob), static_cast<int>(identity->blob_len)));
+            return 0;
+        }
+        m_agentIndex++;
+    }
+    return LIBSSH2_ERROR_PUBLICKEY_UNVERIFIED;
+}
+
+void SshClient::_freeAgent()
+{
+    if(m_agent)
+    {
+        libssh2_agent_disconnect(m_agent);
+        libssh2_agent_free(m_agent);
+        m_agent = nullptr;
+    }
+    m_agentIdentities.clear();
+    m_agentIndex = 0;
+    m_agentDone = false;
 }
 
 bool SshClient::saveKnownHosts(const QString & file)
 {
-    bool res = (libssh2_knownhost_writefile(m_knownHosts, qPrintable(file), LIBSSH2_KNOWNHOST_FILE_OPENSSH) == 0);
-    return res;
+    if(file == m_knowhostFiles)
+    {
+        /* Entries are appended to it as they are added */
+        return true;
+    }
+    return SshKnownHosts::instance().save(file, m_knowhostFiles);
 }
 
 void SshClient::setKownHostFile(const QString &file)
@@ -229,23 +713,19 @@ void SshClient::setKownHostFile(const QString &file)
     m_knowhostFiles = file;
 }
 
-bool SshClient::addKnownHost(const QString & hostname,const SshKey & key)
+bool SshClient::addKnownHost(const QString & hostname,const SshKey & key, quint16 port)
 {
-    bool ret;
-    int typemask = LIBSSH2_KNOWNHOST_TYPE_PLAIN | LIBSSH2_KNOWNHOST_KEYENC_RAW;
-    switch (key.type)
+    if(key.type == SshKey::UnknownType && SshKnownHosts::keyType(key.key).isEmpty())
     {
-        case SshKey::Dss:
-            typemask |= LIBSSH2_KNOWNHOST_KEY_SSHDSS;
-            break;
-        case SshKey::Rsa:
-            typemask |= LIBSSH2_KNOWNHOST_KEY_SSHRSA;
-            break;
-        case SshKey::UnknownType:
-            return false;
+        return false;
     }
-    ret = (libssh2_knownhost_add(m_knownHosts, qPrintable(hostname), nullptr, key.key.data(), static_cast<size_t>(key.key.size()), typemask, nullptr));
-    return ret;
+    /* Same host key as the handshake check, "[host]:port" off port 22 */
+    return SshKnownHosts::instance().add(m_knowhostFiles, hostname, (port == 0) ? m_port : port, key.key);
+}
+
+SshKnownHosts::Status SshClient::hostKeyStatus() const
+{
+    return m_hostKeyStatus;
 }
 
 QString SshClient::banner()
@@ -253,30 +733,151 @@ QString SshClient::banner()
     return QString(libssh2_session_banner_get(m_session));
 }
 
+void SshClient::setKeepAliveInterval(int seconds)
+{
+    m_keepAliveInterval = qMax(1, seconds);
+}
+
+void SshClient::setKeepAliveMaxInterval(int seconds)
+{
+    m_keepAliveMaxInterval = qMax(1, seconds);
+}
+
+void SshClient::setKeepAliveMissed(int count)
+{
+    m_keepAliveMissed = qMax(1, count);
+}
+
+int SshClient::keepAliveInterval() const
+{
+    return m_keepAliveInterval;
+}
+
+int SshClient::keepAliveMaxInterval() const
+{
+    return m_keepAliveMaxInterval;
+}
+
+int SshClient::keepAliveMissed() const
+{
+    return m_keepAliveMissed;
+}
+
+void SshClient::setChannelWindowSize(quint32 size)
+{
+    m_channelWindowSize = (size) ? size : LIBSSH2_CHANNEL_WINDOW_DEFAULT;
+}
+
+void SshClient::setChannelPacketSize(quint32 size)
+{
+    /* Larger packets are refused by libssh2 on receive */
+    m_channelPacketSize = (size) ? qMin<quint32>(size, LIBSSH2_CHANNEL_PACKET_DEFAULT) : LIBSSH2_CHANNEL_PACKET_DEFAULT;
+}
+
+void SshClient::setWindowAutoTune(bool enable, quint32 maxWindow)
+{
+    m_windowAutoTune = enable;
+    m_windowAutoTuneMax = qMax(maxWindow, m_channelWindowSize);
+}
+
+quint32 SshClient::channelWindowSize() const
+{
+    return m_channelWindowSize;
+}
+
+quint32 SshClient::channelPacketSize() const
+{
+    return m_channelPacketSize;
+}
+
+bool SshClient::windowAutoTune() const
+{
+    return m_windowAutoTune;
+}
+
+quint32 SshClient::windowAutoTuneMax() const
+{
+    return m_windowAutoTuneMax;
+}
+
+void SshClient::_scheduleKeepAlive(qint64 msec)
+{
+    if(!m_keepAliveScheduler)
+    {
+        m_keepAliveScheduler = SshKeepAliveScheduler::instance();
+    }
+    m_keepAliveScheduler->schedule(this, static_cast<int>(msec));
+}
+
+void SshClient::_stopKeepAlive()
+{
+    if(m_keepAliveScheduler)
+    {
+        m_keepAliveScheduler->cancel(this);
+    }
+    m_keepAliveProbe = 0;
+}
+
 void SshClient::_sendKeepAlive()
 {
-    int keepalive = 0;
-    if(m_session)
+    if(!m_session)
     {
-        int ret = libssh2_keepalive_send(m_session, &keepalive);
-        if(ret == LIBSSH2_ERROR_SOCKET_SEND)
+        return;
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 interval = m_keepAliveInterval * 1000;
+    if(m_keepAliveProbe)
+    {
+        if(m_lastProofOfLive >= m_keepAliveProbe)
         {
-            qCWarning(sshclient) << m_name << ": Connection I/O error !!!";
-            m_socket.disconnectFromHost();
+            /* Answered on an idle session: probe less often */
+            m_keepAliveProbe = 0;
+            m_keepAliveSeen = m_lastProofOfLive;
+            m_keepAliveCurrent = qMin(m_keepAliveCurrent * 2, m_keepAliveMaxInterval);
         }
-        else if(((QDateTime::currentMSecsSinceEpoch() - m_lastProofOfLive) / 1000) > (MAX_LOST_KEEP_ALIVE * keepalive))
+        else if(now - m_keepAliveProbe > m_keepAliveMissed * interval)
         {
             qCWarning(sshclient) << m_name << ": Connection lost !!!";
+            m_keepAliveProbe = 0;
             setSshState(SshState::Error);
-            m_socket.disconnectFromHost();
-        }
-        else
-        {
-            keepalive -= 1;
-            if(keepalive < 2) keepalive = 2;
-            m_keepalive.start(keepalive * 1000);
+            _socketDisconnect();
+            return;
         }
     }
+
+    if(m_lastProofOfLive > m_keepAliveSeen)
+    {
+        /* Real traffic, back to the base interval */
+        m_keepAliveSeen = m_lastProofOfLive;
+        m_keepAliveCurrent = m_keepAliveInterval;
+    }
+
+    qint64 idle = now - m_lastProofOfLive;
+    if(m_keepAliveProbe == 0 && idle < m_keepAliveCurrent * 1000)
+    {
+        _scheduleKeepAlive(m_keepAliveCurrent * 1000 - idle);
+        return;
+    }
+
+    int next = 0;
+    int ret = libssh2_keepalive_send(m_session, &next);
+    if(m_direct)
+    {
+        /* Data nobody read yet still wakes the session once in a while */
+        m_directSocket.rearm();
+    }
+    if(ret == LIBSSH2_ERROR_SOCKET_SEND)
+    {
+        qCWarning(sshclient) << m_name << ": Connection I/O error !!!";
+        _socketDisconnect();
+        return;
+    }
+    if(m_keepAliveProbe == 0)
+    {
+        m_keepAliveProbe = now;
+    }
+    _scheduleKeepAlive(interval);
 }
 
 
@@ -290,7 +891,21 @@ void SshClient::setSshState(const SshState &sshState)
     if(m_sshState != sshState)
     {
         qCDebug(sshclient) << m_name << ": Change state " <<  m_sshState << " to " << sshState;
+        qint64 elapsed = m_stateClock.nsecsElapsed();
+        m_stateTime[m_sshState] += m_stateClock.restart();
+        if(SshTracer *tracer = SshTracer::installed())
+        {
+            tracer->clientStateChanged(this, m_sshState, sshState, SshTracer::now(), elapsed);
+        }
         m_sshState = sshState;
+        if(m_sshState == SshState::Unconnected)
+        {
+            _clearRecycled();
+        }
+        if(m_sshState == SshState::Ready && m_session)
+        {
+            _readNegotiatedMethods();
+        }
         emit sshStateChanged(m_sshState);
     }
 }
@@ -305,7 +920,7 @@ void SshClient::setName(const QString &name)
 void SshClient::_connection_socketTimeout()
 {
     m_connectionTimeout.stop();
-    m_socket.disconnectFromHost();
+    _socketDisconnect();
     qCWarning(sshclient) << m_name << ": ssh socket connection timeout";
     setSshState(SshState::Error);
     emit sshEvent();
@@ -324,6 +939,11 @@ void SshClient::_connection_socketConnected()
 
     if(m_sshState == SshState::WaitingSocketConnection)
     {
+        if(!m_direct)
+        {
+            /* The direct socket got them before connecting */
+            m_socketOptions.apply(&m_socket);
+        }
         /* Normal process; socket is connected */
         setSshState(SshState::Initialize);
         emit sshEvent();
@@ -339,7 +959,12 @@ void SshClient::_connection_socketConnected()
 void SshClient::_connection_socketDisconnected()
 {
     qCDebug(sshclient) << m_name << ": ssh socket disconnected";
-    if(sshState() != Error)
+    if(m_autoReconnect && m_reconnectArmed && sshState() != DisconnectingChannel && sshState() != DisconnectingSession && sshState() != FreeSession && sshState() != Unconnected)
+    {
+        /* Lost: recover from the Error state */
+        setSshState(Error);
+    }
+    else if(sshState() != Error)
     {
         setSshState(FreeSession);
     }
@@ -358,44 +983,63 @@ void SshClient::_ssh_processEvent()
         case SshState::SocketConnection:
         {
             m_connectionTimeout.start(m_connTimeoutCnt);
+            m_direct = (m_directTransport && m_proxy == nullptr);
+            /* Before connecting: the connection may be reported at once */
+            setSshState(SshState::WaitingSocketConnection);
+            if(m_direct)
+            {
+                m_directSocket.connectToHost(m_hostname, m_port);
+                return;
+            }
             if(m_proxy)
             {
+                /* The proxy resolves and connects */
                 m_socket.setProxy(*m_proxy);
+                m_socket.connectToHost(m_hostname, m_port);
             }
             else
             {
                 m_socket.setProxy(QNetworkProxy::NoProxy);
+                m_connector.setOptions(m_socketOptions);
+                m_connector.connectToHost(m_hostname, m_port);
             }
-            m_socket.connectToHost(m_hostname, m_port);
-            setSshState(SshState::WaitingSocketConnection);
+            return;
         }
 
-        FALLTHROUGH; case SshState::WaitingSocketConnection:
+        case SshState::WaitingSocketConnection:
         {
             return;
         }
 
         case SshState::Initialize:
         {
-            m_session = libssh2_session_init_ex(nullptr, nullptr, nullptr, reinterpret_cast<void *>(&m_socket));
+            void *transport = m_direct ? reinterpret_cast<void *>(&m_directSocket) : reinterpret_cast<void *>(&m_socket);
+            m_session = libssh2_session_init_ex(nullptr, nullptr, nullptr, transport);
             if(m_session == nullptr)
             {
                 qCCritical(sshclient) << m_name << ": libssh error during session init";
                 setSshState(SshState::Error);
-                m_socket.disconnectFromHost();
+                _socketDisconnect();
                 return;
             }
 
-            libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_RECV,reinterpret_cast<void*>(& qt_callback_libssh_recv));
-            libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_SEND,reinterpret_cast<void*>(& qt_callback_libssh_send));
+            if(m_direct)
+            {
+                libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_RECV,reinterpret_cast<void*>(& direct_callback_libssh_recv));
+                libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_SEND,reinterpret_cast<void*>(& direct_callback_libssh_send));
+            }
+            else
+            {
+                libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_RECV,reinterpret_cast<void*>(& qt_callback_libssh_recv));
+                libssh2_session_callback_set(m_session, LIBSSH2_CALLBACK_SEND,reinterpret_cast<void*>(& qt_callback_libssh_send));
+            }
             libssh2_session_set_blocking(m_session, 0);
-
-            m_knownHosts = libssh2_knownhost_init(m_session);
-            Q_ASSERT(m_knownHosts);
+            _applySessionOptions();
 
             if(m_knowhostFiles.size())
             {
-                libssh2_knownhost_readfile(m_knownHosts, qPrintable(m_knowhostFiles), LIBSSH2_KNOWNHOST_FILE_OPENSSH);
+                /* Shared by all the clients: only read when the file changed */
+                SshKnownHosts::instance().load(m_knowhostFiles);
             }
 
             setSshState(SshState::HandShake);
@@ -403,7 +1047,7 @@ void SshClient::_ssh_processEvent()
 
         FALLTHROUGH; case SshState::HandShake:
         {
-            int ret = libssh2_session_handshake(m_session, static_cast<int>(m_socket.socketDescriptor()));
+            int ret = libssh2_session_handshake(m_session, static_cast<int>(m_direct ? m_directSocket.socketDescriptor() : m_socket.socketDescriptor()));
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
                 return;
@@ -412,7 +1056,7 @@ void SshClient::_ssh_processEvent()
             {
                 qCCritical(sshclient) << m_name << "Handshake error" << sshErrorToString(ret);
                 setSshState(SshState::Error);
-                m_socket.disconnectFromHost();
+                _socketDisconnect();
                 return;
             }
 
@@ -424,7 +1068,7 @@ void SshClient::_ssh_processEvent()
             {
                 qCCritical(sshclient) << m_name << "Fingerprint error";
                 setSshState(SshState::Error);
-                m_socket.disconnectFromHost();
+                _socketDisconnect();
                 return;
             }
 
@@ -442,13 +1086,28 @@ void SshClient::_ssh_processEvent()
             }
 
             m_hostKey.key = QByteArray(fingerprint, static_cast<int>(len));
-            struct libssh2_knownhost *khost;
-            libssh2_knownhost_check(m_knownHosts, m_hostname.toStdString().c_str(), fingerprint, len, LIBSSH2_KNOWNHOST_TYPE_PLAIN | LIBSSH2_KNOWNHOST_KEYENC_RAW, &khost);
+            m_hostKeyStatus = SshKnownHosts::instance().check(m_knowhostFiles, m_hostname, m_port, m_hostKey.key);
+            if(m_hostKeyStatus == SshKnownHosts::Mismatch)
+            {
+                qCWarning(sshclient) << m_name << ": host key of" << m_hostname << "does not match the known hosts";
+            }
             setSshState(SshState::GetAuthenticationMethodes);
         }
 
         FALLTHROUGH; case SshState::GetAuthenticationMethodes:
         {
+            if(m_authenticationMethodes.length() == 0 && !m_authCacheTried)
+            {
+                m_authCacheTried = true;
+                QMutexLocker locker(&s_reconnectCacheLock);
+                QByteArray method = s_authMethods.value(_authCacheKey());
+                if(!method.isEmpty())
+                {
+                    qCDebug(sshclient) << m_name << ": try last accepted method first:" << method;
+                    m_authenticationMethodes.append(method);
+                    m_authFromCache = true;
+                }
+            }
             if(m_authenticationMethodes.length() == 0)
             {
                 QByteArray username = m_username.toLocal8Bit();
@@ -463,7 +1122,7 @@ void SshClient::_ssh_processEvent()
                         return;
                     }
                     setSshState(SshState::Error);
-                    m_socket.disconnectFromHost();
+                    _socketDisconnect();
                     qCDebug(sshclient) << m_name << ": Failed to authenticate:" << sshErrorToString(ret);
                     return;
                 }
@@ -478,17 +1137,39 @@ void SshClient::_ssh_processEvent()
         {
             while(m_authenticationMethodes.length() != 0)
             {
+                if(m_authenticationMethodes.first() == "publickey" && m_useAgent && !m_agentDone)
+                {
+                    int ret = _agentAuthenticate();
+                    if(ret == LIBSSH2_ERROR_EAGAIN)
+                    {
+                        return;
+                    }
+                    m_agentDone = true;
+                    if(ret == 0)
+                    {
+                        m_authMethod = "publickey";
+                        setSshState(SshState::Ready);
+                        break;
+                    }
+                    if(m_privateKeyData.isEmpty())
+                    {
+                        m_authenticationMethodes.removeFirst();
+                        continue;
+                    }
+                }
+
                 if(m_authenticationMethodes.first() == "publickey")
                 {
+                    QByteArray username = m_username.toUtf8();
                     int ret = libssh2_userauth_publickey_frommemory(
                                     m_session,
-                                    m_username.toStdString().c_str(),
-                                    static_cast<size_t>(m_username.length()),
-                                    m_publicKey.toStdString().c_str(),
-                                    static_cast<size_t>(m_publicKey.length()),
-                                    m_privateKey.toStdString().c_str(),
-                                    static_cast<size_t>(m_privateKey.length()),
-                                    m_passphrase.toStdString().c_str()
+                                    username.constData(),
+                                    static_cast<size_t>(username.size()),
+                                    m_publicKeyData.constData(),
+                                    static_cast<size_t>(m_publicKeyData.size()),
+                                    m_privateKeyData.constData(),
+                                    static_cast<size_t>(m_privateKeyData.size()),
+                                    m_passphraseData.constData()
                             );
                     if(ret == LIBSSH2_ERROR_EAGAIN)
                     {
@@ -498,10 +1179,12 @@ void SshClient::_ssh_processEvent()
                     {
                         qCWarning(sshclient) << m_name << ": Authentication with publickey failed:" << sshErrorToString(ret);
                         m_authenticationMethodes.removeFirst();
+                        continue;
                     }
                     if(ret == 0)
                     {
                         qCDebug(sshclient) << m_name << ": Authenticated with publickey";
+                        m_authMethod = "publickey";
                         setSshState(SshState::Ready);
                         break;
                     }
@@ -530,6 +1213,7 @@ void SshClient::_ssh_processEvent()
                     if(ret == 0)
                     {
                         qCDebug(sshclient) << m_name << ": Authenticated with password";
+                        m_authMethod = "password";
                         emit channelsChanged(m_channels.count());
                         setSshState(SshState::Ready);
                         break;
@@ -538,20 +1222,53 @@ void SshClient::_ssh_processEvent()
 
                 m_authenticationMethodes.pop_front();
             }
+            if(!libssh2_userauth_authenticated(m_session) && m_authFromCache)
+            {
+                /* The method which worked last time is refused, negotiate */
+                qCDebug(sshclient) << m_name << ": last accepted method refused, ask the server";
+                m_authFromCache = false;
+                m_authenticationMethodes.clear();
+                setSshState(SshState::GetAuthenticationMethodes);
+                emit sshEvent();
+                return;
+            }
+            _freeAgent();
             if(libssh2_userauth_authenticated(m_session))
             {
                 qCDebug(sshclient) << m_name << ": Connected and authenticated";
+                if(!m_authMethod.isEmpty())
+                {
+                    QMutexLocker locker(&s_reconnectCacheLock);
+                    s_authMethods.insert(_authCacheKey(), m_authMethod);
+                }
                 m_connectionTimeout.stop();
-                m_keepalive.setSingleShot(true);
-                m_keepalive.start(1000);
-                libssh2_keepalive_config(m_session, 1, 5);
+                /* Probes are paced by _sendKeepAlive(), not by libssh2 */
+                libssh2_keepalive_config(m_session, 1, 1);
+                m_lastProofOfLive = QDateTime::currentMSecsSinceEpoch();
+                m_keepAliveSeen = m_lastProofOfLive;
+                m_keepAliveCurrent = m_keepAliveInterval;
+                m_keepAliveProbe = 0;
+                _scheduleKeepAlive(m_keepAliveInterval * 1000);
+                m_reconnectArmed = true;
+                m_reconnectAttempt = 0;
+                if(m_recovering)
+                {
+                    m_recovering = false;
+                    setSshState(SshState::Ready);
+                    qCWarning(sshclient) << m_name << ": session recovered";
+                    for(SshChannel *ch: m_channels.toList())
+                    {
+                        ch->sessionRestored();
+                    }
+                    emit reconnected();
+                }
                 setSshState(SshState::Ready);
                 emit sshReady();
             }
             else
             {
                 qCWarning(sshclient) << m_name << ": Authentication failed";
-                m_socket.disconnectFromHost();
+                _socketDisconnect();
                 setSshState(SshState::Error);
                 return;
             }
@@ -561,6 +1278,7 @@ void SshClient::_ssh_processEvent()
         case SshState::Ready:
         {
             m_lastProofOfLive = QDateTime::currentMSecsSinceEpoch();
+            _dispatchSshEvent();
             emit sshDataReceived();
             return;
         }
@@ -571,7 +1289,7 @@ void SshClient::_ssh_processEvent()
             if(m_channels.size() > 0)
             {
                 qCDebug(sshclient) << m_name << ": DisconnectingChannel, there is still " << m_channels.size() << "connections:";
-                for(SshChannel* ch: m_channels)
+                for(SshChannel* ch: m_channels.toList())
                 {
                     qCDebug(sshclient) << m_name << "\t" << ch->name();
                     ch->close();
@@ -591,18 +1309,18 @@ void SshClient::_ssh_processEvent()
             {
                 return;
             }
-            if(m_socket.state() == QAbstractSocket::ConnectedState)
+            if(_socketState() == QAbstractSocket::ConnectedState)
             {
                 qCDebug(sshclient) << m_name << ": Ask for main socket disconnection";
-                m_socket.disconnectFromHost();
+                _socketDisconnect();
                 return;
             }
             else
             {
-                qCDebug(sshclient) << m_name << ": Socket state is " << m_socket.state();
-                if(m_socket.state() == QAbstractSocket::UnconnectedState)
+                qCDebug(sshclient) << m_name << ": Socket state is " << _socketState();
+                if(_socketState() == QAbstractSocket::UnconnectedState)
                 {
-                    qCDebug(sshclient) << m_name << ": Socket state is " << m_socket.state();
+                    qCDebug(sshclient) << m_name << ": Socket state is " << _socketState();
                     setSshState(FreeSession);
                 }
                 else
@@ -614,13 +1332,22 @@ void SshClient::_ssh_processEvent()
 
         FALLTHROUGH; case SshState::FreeSession:
         {
-            m_keepalive.stop();
-            if (m_knownHosts)
+            _stopKeepAlive();
+            _freeAgent();
+
+            if(m_session && m_channels.size() > 0)
             {
-                libssh2_knownhost_free(m_knownHosts);
-                m_knownHosts = nullptr;
+                /*
+                 * Abandoned on close timeout: freed once the channels are
+                 * gone, their libssh2 calls now fail without waiting.
+                 */
+                const QList<SshChannel *> abandoned = m_channels.toList();
+                _detachSession(abandoned);
+                for(SshChannel *ch: abandoned)
+                {
+                    QMetaObject::invokeMethod(ch, "sshDataReceived", Qt::QueuedConnection);
+                }
             }
-
             if(m_session)
             {
                 int ret = libssh2_session_free(m_session);
@@ -632,24 +1359,279 @@ void SshClient::_ssh_processEvent()
             }
 
             m_session = nullptr;
+            m_closeDeadline.stop();
+            m_fastCloseOnce = false;
             setSshState(Unconnected);
             emit sshDisconnected();
+            if(m_deleteWhenDone)
+            {
+                deleteLater();
+            }
             break;
         }
 
         case SshState::Error:
         {
-            m_keepalive.stop();
-            if(m_socket.state() != QAbstractSocket::UnconnectedState)
+            _stopKeepAlive();
+            if(_socketState() != QAbstractSocket::UnconnectedState)
             {
-                m_socket.disconnectFromHost();
-                m_socket.waitForDisconnected(3000);
+                _socketDisconnect(true);
             }
             qCWarning(sshclient) << m_name << ": ssh socket connection error";
             emit sshError();
+            if(m_autoReconnect && m_reconnectArmed && !m_reconnectTimer.isActive())
+            {
+                _beginRecovery();
+            }
+            return;
+        }
+    }
+}
+
+void SshClient::setAutoReconnect(bool enable, int initialDelayMsec, int maxDelayMsec)
+{
+    m_autoReconnect = enable;
+    m_reconnectDelay = qMax(1, initialDelayMsec);
+    m_reconnectMaxDelay = qMax(m_reconnectDelay, maxDelayMsec);
+    if(!enable)
+    {
+        m_reconnectTimer.stop();
+    }
+}
+
+bool SshClient::autoReconnect() const
+{
+    return m_autoReconnect;
+}
+
+void SshClient::_beginRecovery()
+{
+    QList<SshChannel *> lost;
+    for(SshChannel *ch: m_channels.toList())
+    {
+        if(!ch->sessionLost())
+        {
+            lost.append(ch);
+        }
+    }
+
+    _freeAgent();
+    if(m_session)
+    {
+        if(lost.isEmpty())
+        {
+            *libssh2_session_abstract(m_session) = nullptr;
+            libssh2_session_free(m_session);
+            m_session = nullptr;
+        }
+        else
+        {
+            _detachSession(lost);
+        }
+    }
+    for(SshChannel *ch: lost)
+    {
+        ch->close();
+    }
+
+    int delay = m_reconnectDelay;
+    for(int i = 0; i < m_reconnectAttempt && delay < m_reconnectMaxDelay; ++i)
+    {
+        delay *= 2;
+    }
+    delay = qMin(delay, m_reconnectMaxDelay);
+    ++m_reconnectAttempt;
+    m_recovering = true;
+
+    qCWarning(sshclient) << m_name << ": reconnect in" << delay << "ms (attempt" << m_reconnectAttempt << ")";
+    setSshState(SshState::Unconnected);
+    emit reconnecting(m_reconnectAttempt, delay);
+    m_reconnectTimer.start(delay);
+}
+
+void SshClient::_detachSession(const QList<SshChannel *> &channels)
+{
+    /*
+     * The channels may still call libssh2 with their handles: keep the
+     * session, detached from the socket, until they are gone.
+     */
+    *libssh2_session_abstract(m_session) = nullptr;
+    m_deadSessions.append(DeadSession{m_session, channels});
+    for(SshChannel *ch: channels)
+    {
+        QObject::connect(ch, &QObject::destroyed, this, &SshClient::_deadSessionChannelGone);
+    }
+    m_session = nullptr;
+}
+
+void SshClient::_deadSessionChannelGone(QObject *channel)
+{
+    for(int i = 0; i < m_deadSessions.size(); ++i)
+    {
+        DeadSession &dead = m_deadSessions[i];
+        dead.channels.removeAll(static_cast<SshChannel *>(channel));
+        if(dead.channels.isEmpty())
+        {
+            libssh2_session_free(dead.session);
+            m_deadSessions.removeAt(i);
+            --i;
+        }
+    }
+}
+
+void SshClient::_reconnect()
+{
+    if(sshState() != SshState::Unconnected || !m_recovering)
+    {
+        return;
+    }
+    qCDebug(sshclient) << m_name << ": reconnect to" << m_hostname << ":" << m_port;
+    connectToHost(m_username, m_hostname, m_port, m_connectMethodes, m_connTimeoutCnt);
+}
+
+QAbstractSocket::SocketState SshClient::_socketState() const
+{
+    return m_direct ? m_directSocket.state() : m_socket.state();
+}
+
+void SshClient::_socketDisconnect(bool wait)
+{
+    if(m_direct)
+    {
+        m_directSocket.disconnectFromHost();
+        return;
+    }
+    m_connector.abort();
+    m_socket.disconnectFromHost();
+    if(wait)
+    {
+        m_socket.waitForDisconnected(3000);
+    }
+}
+
+void SshClient::_transportWritable()
+{
+    /* A send blocked on the socket, every channel may have been stuck */
+    for(SshChannel *ch: m_channels)
+    {
+        ch->_queueSshEvent();
+    }
+    emit sshEvent();
+}
+
+void SshClient::_dispatchSshEvent()
+{
+    /*
+     * Read all incoming packets in the libssh2 queue (a zero length read
+     * on any open channel spin the transport), then only wake channels
+     * which have data, EOF or a window update waiting for them.
+     */
+    for(SshChannel *ch: m_channels)
+    {
+        LIBSSH2_CHANNEL *channel = ch->dispatchChannel();
+        if(channel && ch->channelState() == SshChannel::ChannelState::Ready)
+        {
+            char dummy;
+            libssh2_channel_read_ex(channel, 0, &dummy, 0);
+            break;
+        }
+    }
+
+    for(SshChannel *ch: m_channels)
+    {
+        if(ch->sshEventPending())
+        {
+            ch->_queueSshEvent();
+        }
+    }
+}
+
+const SshChannelRegistry &SshClient::channels() const
+{
+    return m_channels;
+}
+
+SshChannelDevice *SshClient::openDirectChannel(const QString &host, quint16 port, QObject *parent)
+{
+    QString name = QString("direct_%1:%2_%3").arg(host).arg(port).arg(m_directChannelCounter++);
+    SshDirectChannel *channel = getChannel<SshDirectChannel>(name);
+    SshChannelDevice *device = new SshChannelDevice(channel, parent);
+    channel->open(host, port);
+    return device;
+}
+
+void SshClient::setChannelRecycling(int max)
+{
+    m_recycleMax = qMax(0, max);
+    while(m_recycled.size() > m_recycleMax)
+    {
+        m_recycled.takeLast()->deleteLater();
+    }
+}
+
+int SshClient::channelRecycling() const
+{
+    return m_recycleMax;
+}
+
+int SshClient::nextChannelId()
+{
+    return m_channelId++;
+}
+
+SshChannel *SshClient::_takeRecycled(const QMetaObject *type, const QString &name)
+{
+    /* Last parked first, its buffers are the most likely in cache */
+    for(int i = m_recycled.size() - 1; i >= 0; --i)
+    {
+        SshChannel *channel = m_recycled.at(i);
+        if(channel->metaObject() == type)
+        {
+            m_recycled.removeAt(i);
+            channel->_resetForReuse(name);
+            channel->reuse();
+            return channel;
+        }
+    }
+    return nullptr;
+}
+
+void SshClient::_releaseChannel(SshChannel *channel)
+{
+    if(m_recycled.size() >= m_recycleMax)
+    {
+        channel->deleteLater();
+        return;
+    }
+
+    /* Parked once the other receivers of stateChanged() are done with it */
+    QPointer<SshChannel> pending(channel);
+    QMetaObject::invokeMethod(this, [this, pending](){
+        if(!pending)
+        {
             return;
         }
+        SshChannel *channel = pending.data();
+        if(m_recycled.size() < m_recycleMax && m_sshState != SshState::Unconnected && channel->recycle())
+        {
+            QObject::disconnect(channel, &SshChannel::stateChanged, nullptr, nullptr);
+            m_writeScheduler.forget(channel);
+            m_recycled.append(channel);
+        }
+        else
+        {
+            channel->deleteLater();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void SshClient::_clearRecycled()
+{
+    for(SshChannel *channel: m_recycled)
+    {
+        channel->deleteLater();
     }
+    m_recycled.clear();
 }
 
 void SshClient::_channel_free()
@@ -661,8 +1643,12 @@ void SshClient::_channel_free()
         if(connection->channelState() == SshChannel::ChannelState::Free)
         {
             qCDebug(sshclient) << "Channel " << connection->name() << " is FREE";
-            m_channels.removeAll(connection);
-            connection->deleteLater();
+            SshChannel::Stats channelStats = connection->stats();
+            m_freedBytesIn += channelStats.bytesIn;
+            m_freedBytesOut += channelStats.bytesOut;
+            m_freedStalls += channelStats.stalls;
+            m_channels.remove(connection);
+            _releaseChannel(connection);
             emit channelsChanged(m_channels.count());
 
             if(sshState() == SshState::DisconnectingChannel && m_channels.size() == 0)
@@ -671,7 +1657,7 @@ void SshClient::_channel_free()
                 qCDebug(sshclient) << m_name << ": no more channel registered";
 
                 /* Stop keepalive */
-                m_keepalive.stop();
+                _stopKeepAlive();
 
                 setSshState(SshState::DisconnectingSession);
             }
@@ -5,9 +5,19 @@
 #include <QTcpSocket>
 #include <QTimer>
 #include <QMutex>
+#include <QHash>
+#include <QElapsedTimer>
 #include "sshchannel.h"
+#include "sshchannelregistry.h"
+#include "sshdirectsocket.h"
+#include "sshhappyeyeballs.h"
+#include "sshkeepalivescheduler.h"
+#include "sshwritescheduler.h"
 #include "sshkey.h"
+#include "sshknownhosts.h"
+#include "sshsocketoptions.h"
 #include <QSharedPointer>
+#include <QPointer>
 
 #ifndef FALLTHROUGH
 #if __has_cpp_attribute(fallthrough)
@@ -23,12 +33,15 @@ Q_DECLARE_LOGGING_CATEGORY(sshclient)
 class SshScpGet;
 class SshScpSend;
 class SshSFtp;
+class SshSftpPool;
 class SshTunnelIn;
 class SshTunnelOut;
+class SshChannelDevice;
 class QNetworkProxy;
 
 class  SshClient : public QObject {
     Q_OBJECT
+    friend class SshKeepAliveScheduler;
 
 public:
     enum SshState {
@@ -47,14 +60,38 @@ public:
     };
     Q_ENUM(SshState)
 
+    /* Preferred methods of the session, see setSessionOptions() */
+    struct SessionOptions {
+        QByteArray kex;
+        QByteArray hostKey;
+        QByteArray ciphers;
+        QByteArray macs;
+        bool compression;
+    };
+
+    /* Methods agreed with the server, filled when the session is Ready */
+    struct NegotiatedMethods {
+        QByteArray kex;
+        QByteArray hostKey;
+        QByteArray cipherClientToServer;
+        QByteArray cipherServerToClient;
+        QByteArray macClientToServer;
+        QByteArray macServerToClient;
+        QByteArray compressionClientToServer;
+        QByteArray compressionServerToClient;
+    };
+
 private:
     static int s_nbInstance;
     LIBSSH2_SESSION    * m_session {nullptr};
-    LIBSSH2_KNOWNHOSTS * m_knownHosts {nullptr};
-    QList<SshChannel*> m_channels;
+    SshChannelRegistry m_channels;
 
     QString m_name;
     QTcpSocket m_socket;
+    SshDirectSocket m_directSocket;
+    SshHappyEyeballs m_connector;
+    bool m_directTransport {true};
+    bool m_direct {false};
     QNetworkProxy *m_proxy {nullptr};
     qint64 m_lastProofOfLive {0};
 
@@ -70,19 +107,164 @@ private:
     QString m_publicKey;
     QString m_errorMessage;
     QString m_knowhostFiles;
+
+    /* Key material converted once, not on each authentication */
+    QByteArray m_publicKeyData;
+    QByteArray m_privateKeyData;
+    QByteArray m_passphraseData;
+
+    /* Last method accepted by this user@host:port (process wide cache) */
+    QByteArray m_authMethod;
+    bool m_authFromCache {false};
+    bool m_authCacheTried {false};
+    QString _authCacheKey() const;
+
+    /* ssh-agent identities, the last one accepted by the host first */
+    bool m_useAgent {false};
+    QString m_agentPath;
+    LIBSSH2_AGENT *m_agent {nullptr};
+    QList<struct libssh2_agent_publickey *> m_agentIdentities;
+    int m_agentIndex {0};
+    bool m_agentDone {false};
+    int _agentAuthenticate();
+    void _freeAgent();
     SshKey  m_hostKey;
-    QTimer m_keepalive;
+    SshKnownHosts::Status m_hostKeyStatus {SshKnownHosts::NotFound};
+    QPointer<SshKeepAliveScheduler> m_keepAliveScheduler;
+    int m_keepAliveInterval;
+    int m_keepAliveMaxInterval {60};
+    int m_keepAliveMissed;
+    int m_keepAliveCurrent {0};
+    qint64 m_keepAliveProbe {0};
+    qint64 m_keepAliveSeen {0};
     QTimer m_connectionTimeout;
-    QMutex channelCreationInProgress;
-    void *currentLockerForChannelCreation {nullptr};
+    int m_directChannelCounter {0};
+    SshSftpPool *m_sftpPool {nullptr};
+    QList<SshChannel *> m_recycled;
+    int m_recycleMax {16};
+    int m_channelId {0};
+    SshChannel *_takeRecycled(const QMetaObject *type, const QString &name);
+    void _releaseChannel(SshChannel *channel);
+    void _clearRecycled();
+    SshWriteScheduler m_writeScheduler;
+    SessionOptions m_sessionOptions {};
+    SshSocketOptions m_socketOptions;
+    NegotiatedMethods m_negotiated {};
+    void _applySessionOptions();
+    void _readNegotiatedMethods();
+    QTimer m_statsTimer;
+    quint32 m_channelWindowSize {LIBSSH2_CHANNEL_WINDOW_DEFAULT};
+    quint32 m_channelPacketSize {LIBSSH2_CHANNEL_PACKET_DEFAULT};
+    bool m_windowAutoTune {false};
+    quint32 m_windowAutoTuneMax {16 * 1024 * 1024};
+
+    /* Auto reconnection */
+    bool m_autoReconnect {false};
+    bool m_reconnectArmed {false};
+    bool m_recovering {false};
+    int m_reconnectDelay {1000};
+    int m_reconnectMaxDelay {60000};
+    int m_reconnectAttempt {0};
+    QTimer m_reconnectTimer;
+    QByteArrayList m_connectMethodes;
+
+    /* Disconnection */
+    bool m_fastClose {false};
+    bool m_fastCloseOnce {false};
+    bool m_deleteWhenDone {false};
+    int m_closeTimeout {0};
+    QTimer m_closeDeadline;
+    void _closeDeadlineReached();
+
+    /* Sessions lost, freed once their channels are gone */
+    struct DeadSession {
+        LIBSSH2_SESSION *session;
+        QList<SshChannel *> channels;
+    };
+    QList<DeadSession> m_deadSessions;
+    void _detachSession(const QList<SshChannel *> &channels);
+    void _beginRecovery();
+    void _deadSessionChannelGone(QObject *channel);
+
+public:
+    struct ChannelOpenStats {
+        int queueDepth;
+        int maxQueueDepth;
+        quint64 opened;
+        qint64 lastLatency;     /* ms from request to end of open */
+        qint64 maxLatency;
+        qint64 totalLatency;
+        qint64 totalWait;       /* ms spent waiting in the queue */
+    };
+
+private:
+    /* libssh2 keeps one channel open state per session: opens are queued */
+    struct OpenRequest {
+        qint64 enqueued;
+        qint64 granted;
+        QMetaObject::Connection destroyed;
+        QMetaObject::Connection stateChanged;
+    };
+    QList<SshChannel *> m_openQueue;
+    QHash<SshChannel *, OpenRequest> m_openRequests;
+    QElapsedTimer m_openClock;
+    ChannelOpenStats m_openStats {};
+    void _removeOpenRequest(SshChannel *channel);
 
 public:
     SshClient(const QString &name = "noname", QObject * parent = nullptr);
     virtual ~SshClient();
 
     QString getName() const;
-    bool takeChannelCreationMutex(void *identifier);
-    void releaseChannelCreationMutex(void *identifier);
+
+    /*
+     * Channel opening (session, direct-tcpip, forward listen, sftp, scp):
+     * acquire returns false while other channels are before in the queue,
+     * the channel is woken up when its turn comes. Release with the result
+     * of the libssh2 call: a nullptr with EAGAIN keeps the turn.
+     */
+    bool acquireChannelOpen(SshChannel *channel);
+    void releaseChannelOpen(SshChannel *channel, const void *result);
+    ChannelOpenStats channelOpenStats() const;
+    void resetChannelOpenStats();
+
+    /* Fair share of the session writes between channels */
+    SshWriteScheduler &writeScheduler();
+
+    /* SFTP subsystems shared by the users of this client, created on first use */
+    SshSftpPool *sftpPool();
+
+    /* Write rate limit shared by all the channels, 0 for unlimited */
+    void setRateLimit(quint64 bytesPerSecond, quint64 burst = 0);
+    quint64 rateLimit() const;
+
+    /*
+     * Preferred methods, comma separated lists in preference order (see
+     * libssh2_session_method_pref), empty for libssh2 defaults. Ciphers
+     * and MACs apply to both directions. Applied on next connection.
+     */
+    void setSessionOptions(const SessionOptions &options);
+    SessionOptions sessionOptions() const;
+
+    /* Filled when the session is Ready */
+    NegotiatedMethods negotiatedMethods() const;
+
+    /* Traffic snapshot of the session, totals include the freed channels */
+    struct Stats {
+        int channels;
+        quint64 bytesIn;
+        quint64 bytesOut;
+        quint64 stalls;
+        quint64 buffered;
+        ChannelOpenStats open;
+        qint64 stateTime[SshState::Error + 1];  /* ms spent in each state: TCP, handshake, auth... */
+        QList<SshChannel::Stats> channelStats;
+    };
+    Stats stats() const;
+
+    /* Emit statsUpdated() every msec, 0 to stop */
+    void setStatsInterval(int msec);
+    int statsInterval() const;
 
 
 
@@ -90,36 +272,66 @@ public slots:
     int connectToHost(const QString &username, const QString &hostname, quint16 port = 22, QByteArrayList methodes = QByteArrayList(), int connTimeoutMsec = 60000);
     bool waitForState(SshClient::SshState state);
     void disconnectFromHost();
+    /*
+     * Fast close disconnection without waiting, sshDisconnected() is emitted
+     * once done. deleteWhenDone: the client deletes itself then, its
+     * destructor does not block.
+     */
+    void disconnectFromHostAsync(bool deleteWhenDone = false);
     void resetError();
 
 public:
     template<typename T>
     T *getChannel(const QString &name)
     {
-        for(SshChannel *ch: m_channels)
+        T *proc = m_channels.find<T>(name);
+        if(proc)
         {
-            if(ch->name() == name)
-            {
-                T *proc = qobject_cast<T*>(ch);
-                if(proc)
-                {
-                    return proc;
-                }
-            }
+            return proc;
         }
 
-        T *res = new T(name, this);
-        m_channels.append(res);
+        T *res = static_cast<T*>(_takeRecycled(&T::staticMetaObject, name));
+        if(res == nullptr)
+        {
+            res = new T(name, this);
+        }
+        m_channels.insert(res);
         QObject::connect(res, &SshChannel::stateChanged, this, &SshClient::_channel_free);
         emit channelsChanged(m_channels.count());
         return res;
     }
 
+    /* Lookup only, nullptr if no channel of this type has this name */
+    template<typename T>
+    T *findChannel(const QString &name) const
+    {
+        return m_channels.find<T>(name);
+    }
+
+    /* Registered channels, in creation order */
+    const SshChannelRegistry &channels() const;
+
+    /*
+     * direct-tcpip channel to host:port used as a QIODevice, without local
+     * listener. The device is owned by the caller (or parent).
+     */
+    SshChannelDevice *openDirectChannel(const QString &host, quint16 port, QObject *parent = nullptr);
+
     void setKeys(const QString &publicKey, const QString &privateKey);
     void setPassphrase(const QString & pass);
+    /*
+     * Try the ssh-agent identities before the keys: an agent holding
+     * decrypted or hardware keys spares the key decryption on each connect.
+     * path: agent socket, SSH_AUTH_SOCK if empty.
+     */
+    void setUseAgent(bool enable, const QString &path = QString());
+    bool useAgent() const;
     bool saveKnownHosts(const QString &file);
     void setKownHostFile(const QString &file);
-    bool addKnownHost  (const QString &hostname, const SshKey &key);
+    /* port 0: the port this client connects to */
+    bool addKnownHost  (const QString &hostname, const SshKey &key, quint16 port = 0);
+    /* Host key checked against the known hosts during the handshake */
+    SshKnownHosts::Status hostKeyStatus() const;
     QString banner();
 
 
@@ -138,12 +350,98 @@ public: /* New function implementation with state machine */
 
     void setProxy(QNetworkProxy *proxy);
 
+    /*
+     * Without proxy, libssh2 reads and writes the socket descriptor directly
+     * (no QTcpSocket buffers). Enabled by default, applied on next connection.
+     */
+    void setDirectTransport(bool enable);
+    bool directTransport() const;
+
     void setConnectTimeout(int timeoutMsec);
+    /* Head start of each address before racing the next one (RFC 8305) */
+    void setConnectAttemptDelay(int msec);
+    int connectAttemptDelay() const;
+
+    /*
+     * Disconnection: all channels are closed at once, as usual, but with
+     * fast close they don't wait for the peer to acknowledge. The session
+     * is freed at most closeTimeout msec (0 for no limit) after the
+     * disconnection began, channels still open are then abandoned.
+     */
+    void setFastClose(bool enable);
+    bool fastClose() const;
+    void setCloseTimeout(int msec);
+    int closeTimeout() const;
+    /* Disconnecting with fast close, now */
+    bool isClosingFast() const;
+
+    /* Options of the session socket, applied on next connection */
+    void setSocketOptions(const SshSocketOptions &options);
+    SshSocketOptions socketOptions() const;
+
+    /*
+     * Reconnect by itself when the session is lost after being Ready,
+     * waiting initialDelay, doubled on each failed attempt up to maxDelay.
+     * Tunnels keep their configuration (and local listening port) and are
+     * bound again on the new session.
+     */
+    void setAutoReconnect(bool enable, int initialDelayMsec = 1000, int maxDelayMsec = 60000);
+    bool autoReconnect() const;
+
+    /*
+     * Default receive window and max packet size of opened channels
+     * (libssh2 defaults otherwise). The packet size is bounded to what
+     * libssh2 can receive. With auto tuning, channels double their window,
+     * up to maxWindow, while the peer exhausts it (bulk transfer on a
+     * long fat link).
+     */
+    void setChannelWindowSize(quint32 size);
+    void setChannelPacketSize(quint32 size);
+    void setWindowAutoTune(bool enable, quint32 maxWindow = 16 * 1024 * 1024);
+    quint32 channelWindowSize() const;
+    quint32 channelPacketSize() const;
+    bool windowAutoTune() const;
+    quint32 windowAutoTuneMax() const;
+
+    /*
+     * Free channels which support it (tunnel connections) are kept, up to
+     * max, and given out again by getChannel() instead of allocated. 0
+     * disables it, extra parked channels are deleted.
+     */
+    void setChannelRecycling(int max);
+    int channelRecycling() const;
+
+    /* Increasing number, for helpers naming channels on behalf of the user */
+    int nextChannelId();
+
+    /*
+     * Keepalive probes are only sent when nothing was received for
+     * interval seconds; while probes are answered on an idle session the
+     * interval doubles up to maxInterval. The connection is lost when a
+     * probe stays unanswered for missed * interval seconds.
+     */
+    void setKeepAliveInterval(int seconds);
+    void setKeepAliveMaxInterval(int seconds);
+    void setKeepAliveMissed(int count);
+    int keepAliveInterval() const;
+    int keepAliveMaxInterval() const;
+    int keepAliveMissed() const;
 
 private: /* New function implementation with state machine */
     SshState m_sshState {SshState::Unconnected};
+    QElapsedTimer m_stateClock;
+    qint64 m_stateTime[SshState::Error + 1] {};
+    /* Traffic of the channels already freed */
+    quint64 m_freedBytesIn {0};
+    quint64 m_freedBytesOut {0};
+    quint64 m_freedStalls {0};
     QByteArrayList m_authenticationMethodes;
     void setSshState(const SshState &sshState);
+    void _dispatchSshEvent();
+    QAbstractSocket::SocketState _socketState() const;
+    void _socketDisconnect(bool wait = false);
+    void _scheduleKeepAlive(qint64 msec);
+    void _stopKeepAlive();
 
 
 private slots: /* New function implementation with state machine */
@@ -151,6 +449,8 @@ private slots: /* New function implementation with state machine */
     void _connection_socketError();
     void _connection_socketConnected();
     void _connection_socketDisconnected();
+    void _transportWritable();
+    void _reconnect();
     void _ssh_processEvent();
     void _channel_free();
 
@@ -159,12 +459,17 @@ signals:
     void sshReady();
     void sshDisconnected();
     void sshError();
+    void reconnecting(int attempt, int delayMsec);
+    void reconnected();
 
     void sshDataReceived();
     void sshEvent();
     void channelsChanged(int);
+    void statsUpdated(const SshClient::Stats &stats);
 };
 
+Q_DECLARE_METATYPE(SshClient::Stats)
+
 inline const char* sshErrorToString(int err)
 {
     switch(err)
@@ -0,0 +1,129 @@
+#include "sshclientpool.h"
+
+Q_LOGGING_CATEGORY(logsshclientpool, "ssh.clientpool", QtWarningMsg)
+
+SshClientPool::SshClientPool(int threads, QObject *parent)
+    : QObject(parent)
+{
+    if(threads < 1)
+        threads = 1;
+
+    for(int i = 0; i < threads; ++i)
+    {
+        Worker worker;
+        worker.thread = new QThread();
+        worker.thread->setObjectName(QString("SshClientPool-%1").arg(i));
+        worker.clients = 0;
+        worker.thread->start();
+        m_workers.append(worker);
+    }
+    qCDebug(logsshclientpool) << "Pool started with" << threads << "threads";
+}
+
+SshClientPool::~SshClientPool()
+{
+    QList<SshClient*> clients;
+    {
+        QMutexLocker locker(&m_mutex);
+        clients = m_clients;
+    }
+
+    /* Clients must be destroyed in their own thread */
+    for(SshClient *client: clients)
+    {
+        runInClientThread(client, [client](){ delete client; });
+    }
+
+    for(Worker &worker: m_workers)
+    {
+        worker.thread->quit();
+        worker.thread->wait();
+        delete worker.thread;
+    }
+    qCDebug(logsshclientpool) << "Pool stopped";
+}
+
+int SshClientPool::threadCount() const
+{
+    return m_workers.size();
+}
+
+int SshClientPool::clientCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_clients.size();
+}
+
+SshClient *SshClientPool::createClient(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    int best = 0;
+    for(int i = 1; i < m_workers.size(); ++i)
+    {
+        if(m_workers[i].clients < m_workers[best].clients)
+            best = i;
+    }
+
+    SshClient *client = new SshClient(name);
+    client->moveToThread(m_workers[best].thread);
+    client->setProperty("_sshClientPoolWorker", best);
+    m_workers[best].clients++;
+    m_clients.append(client);
+    QObject::connect(client, &QObject::destroyed, this, [this](QObject *obj){ _clientDestroyed(obj); }, Qt::DirectConnection);
+
+    qCDebug(logsshclientpool) << "Create client" << name << "in" << m_workers[best].thread->objectName();
+    return client;
+}
+
+void SshClientPool::releaseClient(SshClient *client)
+{
+    client->deleteLater();
+}
+
+void SshClientPool::_clientDestroyed(QObject *client)
+{
+    QMutexLocker locker(&m_mutex);
+    int index = m_clients.indexOf(static_cast<SshClient*>(client));
+    if(index < 0)
+        return;
+
+    m_clients.removeAt(index);
+    int worker = client->property("_sshClientPoolWorker").toInt();
+    if(worker >= 0 && worker < m_workers.size())
+    {
+        m_workers[worker].clients--;
+    }
+}
+
+void SshClientPool::runInClientThread(SshClient *client, const std::function<void()> &function)
+{
+    if(client->thread() == QThread::currentThread())
+    {
+        function();
+        return;
+    }
+    QMetaObject::invokeMethod(client, function, Qt::BlockingQueuedConnection);
+}
+
+void SshClientPool::connectToHost(SshClient *client, const QString &username, const QString &hostname, quint16 port, QByteArrayList methodes, int connTimeoutMsec)
+{
+    QMetaObject::invokeMethod(client, [=](){
+        client->connectToHost(username, hostname, port, methodes, connTimeoutMsec);
+    }, Qt::QueuedConnection);
+}
+
+void SshClientPool::disconnectFromHost(SshClient *client)
+{
+    QMetaObject::invokeMethod(client, [client](){
+        client->disconnectFromHost();
+    }, Qt::QueuedConnection);
+}
+
+SshClient::SshState SshClientPool::sshState(SshClient *client)
+{
+    SshClient::SshState state = SshClient::SshState::Unconnected;
+    runInClientThread(client, [&state, client](){
+        state = client->sshState();
+    });
+    return state;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QLoggingCategory>
+#include <functional>
+#include "sshclient.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshclientpool)
+
+/**
+ * \brief Run SshClient sessions on a pool of worker threads
+ * \details Each SshClient created by the pool, with all its channels,
+ * lives in one worker thread. New clients are given to the thread which
+ * hosts the fewest clients. Use the pool methods to drive a client from
+ * another thread: they are executed in the client thread.
+ */
+class SshClientPool : public QObject
+{
+    Q_OBJECT
+
+    struct Worker {
+        QThread *thread;
+        int clients;
+    };
+
+    mutable QMutex m_mutex;
+    QList<Worker> m_workers;
+    QList<SshClient*> m_clients;
+
+    void _clientDestroyed(QObject *client);
+
+public:
+    explicit SshClientPool(int threads = QThread::idealThreadCount(), QObject *parent = nullptr);
+    virtual ~SshClientPool() override;
+
+    int threadCount() const;
+    int clientCount() const;
+
+    SshClient *createClient(const QString &name = "noname");
+    void releaseClient(SshClient *client);
+
+    /* Execute function in the thread of the client, and wait for the end of execution */
+    static void runInClientThread(SshClient *client, const std::function<void()> &function);
+
+    static void connectToHost(SshClient *client, const QString &username, const QString &hostname, quint16 port = 22, QByteArrayList methodes = QByteArrayList(), int connTimeoutMsec = 60000);
+    static void disconnectFromHost(SshClient *client);
+    static SshClient::SshState sshState(SshClient *client);
+
+    template<typename T>
+    static T *getChannel(SshClient *client, const QString &name)
+    {
+        T *res = nullptr;
+        runInClientThread(client, [&res, client, &name](){
+            res = client->getChannel<T>(name);
+        });
+        return res;
+    }
+};
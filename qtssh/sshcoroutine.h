@@ -0,0 +1,346 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error "sshcoroutine.h needs C++20 coroutines, configure with -DQTSSH_COROUTINES=ON"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <QObject>
+#include <QPointer>
+#include "sshclient.h"
+#include "sshprocess.h"
+#include "sshsftp.h"
+#include "sshsftpcommand.h"
+#include "sshsftpcommandget.h"
+#include "sshsftpcommandsend.h"
+
+/*
+ * Coroutine layer over the signals of the state machines, for callers
+ * which would use the waitFor*() helpers: an awaiting coroutine is a
+ * suspended frame, no event loop is nested. The coroutine is resumed from
+ * the event loop, never from inside the emission of the signal, so it can
+ * delete the channel or the command it awaited.
+ *
+ *     SshCoro::Task<void> fetch(SshClient &client)
+ *     {
+ *         if(!co_await SshCoro::connect(client, "user", "host"))
+ *             co_return;
+ *         SshProcess *proc = client.getChannel<SshProcess>("uname");
+ *         QByteArray out = co_await SshCoro::run(proc, "uname -a");
+ *         ...
+ *     }
+ *
+ * Task is eager: calling fetch() runs it up to the first suspension. A
+ * Task which is not awaited goes on alone and frees itself once done.
+ */
+namespace SshCoro {
+
+namespace Detail {
+
+/* Resumes a coroutine once, from the next event loop pass */
+class Resumer : public QObject
+{
+public:
+    explicit Resumer(std::coroutine_handle<> handle)
+        : m_handle(handle)
+    {
+    }
+
+    void fire()
+    {
+        if(m_fired)
+            return;
+        m_fired = true;
+        QMetaObject::invokeMethod(this, [this]() {
+            deleteLater();
+            m_handle.resume();
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    std::coroutine_handle<> m_handle;
+    bool m_fired {false};
+};
+
+template<typename T>
+struct PromiseResult
+{
+    std::optional<T> value;
+    void return_value(T v) { value = std::move(v); }
+    T take() { return std::move(*value); }
+};
+
+template<>
+struct PromiseResult<void>
+{
+    void return_void() {}
+    void take() {}
+};
+
+} // namespace Detail
+
+template<typename T = void>
+class Task
+{
+public:
+    struct promise_type : Detail::PromiseResult<T>
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+        bool detached {false};
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                promise_type &p = h.promise();
+                if(p.continuation)
+                    return p.continuation;
+                if(p.detached)
+                    h.destroy();
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+    };
+
+    Task(Task &&other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if(!m_handle)
+            return;
+        if(m_handle.done())
+            m_handle.destroy();
+        else
+            m_handle.promise().detached = true;
+    }
+
+    bool isDone() const { return !m_handle || m_handle.done(); }
+
+    bool await_ready() const noexcept { return m_handle.done(); }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept { m_handle.promise().continuation = awaiting; }
+    T await_resume()
+    {
+        promise_type &p = m_handle.promise();
+        if(p.exception)
+            std::rethrow_exception(p.exception);
+        return p.take();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : m_handle(handle)
+    {
+    }
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/* SshClient state reached, or Error. Result: state reached */
+class ClientStateAwaiter
+{
+public:
+    ClientStateAwaiter(SshClient &client, SshClient::SshState state, std::function<void()> start = nullptr)
+        : m_client(&client), m_state(state), m_start(std::move(start))
+    {
+    }
+
+    bool await_ready() const
+    {
+        return !m_start && (m_client->sshState() == m_state || m_client->sshState() == SshClient::Error);
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Detail::Resumer *resumer = new Detail::Resumer(handle);
+        SshClient *client = m_client;
+        SshClient::SshState state = m_state;
+        QObject::connect(client, &SshClient::sshStateChanged, resumer, [resumer, state](SshClient::SshState current) {
+            if(current == state || current == SshClient::Error)
+                resumer->fire();
+        });
+        QObject::connect(client, &QObject::destroyed, resumer, &Detail::Resumer::fire);
+        if(m_start)
+            m_start();
+        /* Nothing started, as when already connected */
+        if(client->sshState() == state || client->sshState() == SshClient::Error)
+            resumer->fire();
+    }
+
+    bool await_resume() const
+    {
+        return m_client && m_client->sshState() == m_state;
+    }
+
+private:
+    QPointer<SshClient> m_client;
+    SshClient::SshState m_state;
+    std::function<void()> m_start;
+};
+
+/* co_await connect(...): true once Ready, false on error */
+inline ClientStateAwaiter connect(SshClient &client, const QString &username, const QString &hostname, quint16 port = 22, QByteArrayList methodes = QByteArrayList(), int connTimeoutMsec = 60000)
+{
+    SshClient *c = &client;
+    return ClientStateAwaiter(client, SshClient::Ready, [c, username, hostname, port, methodes, connTimeoutMsec]() {
+        c->connectToHost(username, hostname, port, methodes, connTimeoutMsec);
+    });
+}
+
+/* co_await disconnect(client): true once Unconnected */
+inline ClientStateAwaiter disconnect(SshClient &client)
+{
+    SshClient *c = &client;
+    return ClientStateAwaiter(client, SshClient::Unconnected, [c]() { c->disconnectFromHost(); });
+}
+
+inline ClientStateAwaiter waitForState(SshClient &client, SshClient::SshState state)
+{
+    return ClientStateAwaiter(client, state);
+}
+
+/* SshChannel state reached, or Error. Result: state reached */
+class ChannelStateAwaiter
+{
+public:
+    ChannelStateAwaiter(SshChannel *channel, SshChannel::ChannelState state)
+        : m_channel(channel), m_state(state)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return !m_channel || m_channel->channelState() == m_state || m_channel->channelState() == SshChannel::Error;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Detail::Resumer *resumer = new Detail::Resumer(handle);
+        SshChannel *channel = m_channel;
+        SshChannel::ChannelState state = m_state;
+        QObject::connect(channel, &SshChannel::stateChanged, resumer, [resumer, channel, state]() {
+            if(channel->channelState() == state || channel->channelState() == SshChannel::Error)
+                resumer->fire();
+        });
+        QObject::connect(channel, &QObject::destroyed, resumer, &Detail::Resumer::fire);
+    }
+
+    bool await_resume() const
+    {
+        return m_channel && m_channel->channelState() == m_state;
+    }
+
+private:
+    QPointer<SshChannel> m_channel;
+    SshChannel::ChannelState m_state;
+};
+
+inline ChannelStateAwaiter waitForState(SshChannel *channel, SshChannel::ChannelState state)
+{
+    return ChannelStateAwaiter(channel, state);
+}
+
+/* co_await run(process, cmd): output of the command, see isError() */
+class ProcessAwaiter
+{
+public:
+    ProcessAwaiter(SshProcess *process, const QString &cmd)
+        : m_process(process), m_cmd(cmd)
+    {
+    }
+
+    bool await_ready() const { return !m_process; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Detail::Resumer *resumer = new Detail::Resumer(handle);
+        QObject::connect(m_process, &SshProcess::finished, resumer, &Detail::Resumer::fire);
+        QObject::connect(m_process, &SshProcess::failed, resumer, &Detail::Resumer::fire);
+        QObject::connect(m_process, &QObject::destroyed, resumer, &Detail::Resumer::fire);
+        m_process->runCommand(m_cmd);
+    }
+
+    QByteArray await_resume() const
+    {
+        return m_process ? m_process->result() : QByteArray();
+    }
+
+private:
+    QPointer<SshProcess> m_process;
+    QString m_cmd;
+};
+
+inline ProcessAwaiter run(SshProcess *process, const QString &cmd)
+{
+    return ProcessAwaiter(process, cmd);
+}
+
+/*
+ * co_await command(sftp.asyncXxx(...)): true on success. The command is
+ * deleted once resumed, its errMsg() is lost: read it in a finished()
+ * handler if needed.
+ */
+class SftpCommandAwaiter
+{
+public:
+    explicit SftpCommandAwaiter(SshSftpCommand *cmd)
+        : m_cmd(cmd)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return !m_cmd || m_cmd->state() == SshSftpCommand::Terminate || m_cmd->state() == SshSftpCommand::Error;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Detail::Resumer *resumer = new Detail::Resumer(handle);
+        QObject::connect(m_cmd, &SshSftpCommand::finished, resumer, &Detail::Resumer::fire);
+        QObject::connect(m_cmd, &QObject::destroyed, resumer, &Detail::Resumer::fire);
+    }
+
+    bool await_resume()
+    {
+        if(!m_cmd)
+            return false;
+        bool ok = (m_cmd->state() == SshSftpCommand::Terminate);
+        m_cmd->deleteLater();
+        return ok;
+    }
+
+private:
+    QPointer<SshSftpCommand> m_cmd;
+};
+
+inline SftpCommandAwaiter command(SshSftpCommand *cmd)
+{
+    return SftpCommandAwaiter(cmd);
+}
+
+inline SftpCommandAwaiter get(SshSFtp &sftp, const QString &source, const QString &dest)
+{
+    return SftpCommandAwaiter(sftp.asyncGet(source, dest));
+}
+
+inline SftpCommandAwaiter send(SshSFtp &sftp, const QString &source, const QString &dest)
+{
+    return SftpCommandAwaiter(sftp.asyncSend(source, dest));
+}
+
+} // namespace SshCoro
@@ -0,0 +1,282 @@
+#include "sshdirectchannel.h"
+#include "sshclient.h"
+
+Q_LOGGING_CATEGORY(logsshdirectchannel, "ssh.directchannel", QtWarningMsg)
+
+#define DEBUGCH qCDebug(logsshdirectchannel) << m_name
+
+SshDirectChannel::SshDirectChannel(const QString &name, SshClient *client)
+    : SshChannel(name, client)
+{
+    QObject::connect(this, &SshDirectChannel::sendEvent, this, &SshDirectChannel::_eventLoop, Qt::QueuedConnection);
+}
+
+SshDirectChannel::~SshDirectChannel()
+{
+    DEBUGCH << "Free SshDirectChannel (destructor)";
+}
+
+LIBSSH2_CHANNEL *SshDirectChannel::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
+void SshDirectChannel::transferStats(Stats &stats) const
+{
+    stats.bytesIn = m_bytesIn;
+    stats.bytesOut = m_bytesOut;
+    stats.stalls = m_stalls;
+    stats.buffered = m_rx.size() + m_tx.size();
+}
+
+void SshDirectChannel::open(const QString &host, quint16 port)
+{
+    m_host = host;
+    m_port = port;
+    emit sendEvent();
+}
+
+void SshDirectChannel::setBufferSize(size_t size)
+{
+    m_rx.setCapacity(size);
+    m_tx.setCapacity(size);
+}
+
+bool SshDirectChannel::atEof() const
+{
+    return m_eof;
+}
+
+void SshDirectChannel::close()
+{
+    DEBUGCH << "Close asked";
+    /* Pending writes are sent before the channel is closed */
+    m_closing = true;
+    if(channelState() == ChannelState::Openning)
+    {
+        setChannelState(ChannelState::Close);
+    }
+    emit sendEvent();
+}
+
+void SshDirectChannel::sshDataReceived()
+{
+    _eventLoop();
+}
+
+void SshDirectChannel::_fail(const QString &message)
+{
+    if(!m_error)
+    {
+        m_error = true;
+        qCWarning(logsshdirectchannel) << m_name << message;
+        emit failed(message);
+    }
+}
+
+bool SshDirectChannel::_readChannel()
+{
+    bool received = false;
+    bool ended = false;
+    while(!m_eof && m_rx.freeSpace() > 0)
+    {
+        ssize_t ret = libssh2_channel_read_ex(m_sshChannel, 0, m_rx.writePointer(), m_rx.writeSize());
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            break;
+        }
+        if(ret < 0)
+        {
+            _fail(QString("Can't read channel (%1)").arg(sshErrorToString(static_cast<int>(ret))));
+            return false;
+        }
+        if(ret == 0)
+        {
+            m_eof = (libssh2_channel_eof(m_sshChannel) == 1);
+            ended = m_eof;
+            break;
+        }
+        m_rx.commit(static_cast<size_t>(ret));
+        m_bytesIn += static_cast<quint64>(ret);
+        received = true;
+    }
+    if(m_rx.isFull())
+    {
+        m_stalls++;
+    }
+    tuneWindow(m_sshChannel);
+    if(received)
+    {
+        emit dataReceived();
+    }
+    if(ended)
+    {
+        DEBUGCH << "Remote end of stream";
+        emit finished();
+    }
+    return true;
+}
+
+bool SshDirectChannel::_writeChannel()
+{
+    qint64 written = 0;
+    SshWriteScheduler &scheduler = m_sshClient->writeScheduler();
+    while(!m_tx.isEmpty())
+    {
+        size_t quota = scheduler.grant(this, m_tx.readSize());
+        if(quota == 0)
+        {
+            break;
+        }
+        ssize_t ret = libssh2_channel_write_ex(m_sshChannel, 0, m_tx.readPointer(), quota);
+        writeWindowUsed(m_sshChannel);
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            m_stalls++;
+            break;
+        }
+        if(ret < 0)
+        {
+            _fail(QString("Can't write channel (%1)").arg(sshErrorToString(static_cast<int>(ret))));
+            return false;
+        }
+        m_tx.consume(static_cast<size_t>(ret));
+        scheduler.consumed(this, static_cast<size_t>(ret));
+        m_bytesOut += static_cast<quint64>(ret);
+        written += ret;
+    }
+    if(m_tx.isEmpty())
+    {
+        scheduler.done(this);
+    }
+    if(written > 0)
+    {
+        emit dataWritten(written);
+    }
+    return true;
+}
+
+void SshDirectChannel::_eventLoop()
+{
+    switch(channelState())
+    {
+        case Openning:
+        {
+            if(m_host.isEmpty())
+            {
+                /* open() not called yet */
+                return;
+            }
+            if ( ! m_sshClient->acquireChannelOpen(this) )
+            {
+                return;
+            }
+            m_sshChannel = openDirectTcpip(m_host, m_port);
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
+            if (m_sshChannel == nullptr)
+            {
+                char *emsg;
+                int size;
+                int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
+                if(ret == LIBSSH2_ERROR_EAGAIN)
+                {
+                    return;
+                }
+                _fail(QString("Channel open failed: %1").arg(emsg));
+                setChannelState(ChannelState::Error);
+                emit sendEvent();
+                return;
+            }
+            DEBUGCH << "Channel opened to" << m_host << ":" << m_port;
+            setChannelState(ChannelState::Exec);
+        }
+
+        FALLTHROUGH; case Exec:
+        {
+            setChannelState(ChannelState::Ready);
+            emit opened();
+        }
+
+        FALLTHROUGH; case Ready:
+        {
+            if(!_writeChannel() || !_readChannel())
+            {
+                setChannelState(ChannelState::Close);
+                emit sendEvent();
+                return;
+            }
+            /* Remote data is kept until read, pending writes until sent */
+            bool drained = m_eof && m_rx.isEmpty();
+            if((m_closing || drained) && m_tx.isEmpty())
+            {
+                setChannelState(ChannelState::Close);
+                emit sendEvent();
+            }
+            return;
+        }
+
+        case Close:
+        {
+            DEBUGCH << "closeChannel";
+            if(m_sshChannel == nullptr)
+            {
+                setChannelState(ChannelState::Free);
+                return;
+            }
+            int ret = libssh2_channel_close(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to channel_close: %1").arg(sshErrorToString(ret)));
+            }
+            setChannelState(ChannelState::WaitClose);
+        }
+
+        FALLTHROUGH; case WaitClose:
+        {
+            int ret = skipWaitClosed() ? 0 : libssh2_channel_wait_closed(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to channel_wait_closed: %1").arg(sshErrorToString(ret)));
+            }
+            setChannelState(ChannelState::Freeing);
+        }
+
+        FALLTHROUGH; case Freeing:
+        {
+            DEBUGCH << "free Channel";
+            int ret = libssh2_channel_free(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to free channel: %1").arg(sshErrorToString(ret)));
+            }
+            m_sshChannel = nullptr;
+            setChannelState(ChannelState::Free);
+            return;
+        }
+
+        case Free:
+        {
+            qCDebug(logsshdirectchannel) << "Channel" << m_name << "is free";
+            return;
+        }
+
+        case Error:
+        {
+            qCDebug(logsshdirectchannel) << "Channel" << m_name << "is in error state";
+            setChannelState(ChannelState::Free);
+            return;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QObject>
+#include <QLoggingCategory>
+#include "sshchannel.h"
+#include "sshringbuffer.h"
+
+#define DIRECT_CHANNEL_BUFFER_SIZE (128*1024)
+
+Q_DECLARE_LOGGING_CATEGORY(logsshdirectchannel)
+
+class SshChannelDevice;
+
+/**
+ * \brief direct-tcpip channel read and written by a SshChannelDevice
+ * \details Received data is kept in a bounded buffer: the channel is not
+ * read while it is full, so the SSH window is not adjusted and the server
+ * stops sending until the device is read.
+ */
+class SshDirectChannel : public SshChannel
+{
+    Q_OBJECT
+    friend class SshClient;
+    friend class SshChannelDevice;
+
+protected:
+    explicit SshDirectChannel(const QString &name, SshClient *client);
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+    void transferStats(Stats &stats) const override;
+
+public:
+    virtual ~SshDirectChannel() override;
+    void open(const QString &host, quint16 port);
+    void setBufferSize(size_t size);
+    bool atEof() const;
+    void close() override;
+
+private:
+    LIBSSH2_CHANNEL *m_sshChannel {nullptr};
+    QString m_host;
+    quint16 m_port {0};
+    SshRingBuffer m_rx {DIRECT_CHANNEL_BUFFER_SIZE};
+    SshRingBuffer m_tx {DIRECT_CHANNEL_BUFFER_SIZE};
+    bool m_eof {false};
+    bool m_closing {false};
+    bool m_error {false};
+    quint64 m_bytesIn {0};
+    quint64 m_bytesOut {0};
+    quint64 m_stalls {0};
+
+    bool _readChannel();
+    bool _writeChannel();
+    void _fail(const QString &message);
+
+private slots:
+    void _eventLoop();
+
+public slots:
+    void sshDataReceived() override;
+
+signals:
+    void sendEvent();
+    void opened();
+    void dataReceived();
+    void dataWritten(qint64 bytes);
+    void finished();
+    void failed(const QString &message);
+};
@@ -0,0 +1,197 @@
+#include "sshdirectsocket.h"
+#include <cerrno>
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define SOCK_WOULDBLOCK(e) ((e) == WSAEWOULDBLOCK)
+#define SOCK_ERRNO WSAGetLastError()
+#define SOCK_CLOSE closesocket
+#define SOCK_INVALID INVALID_SOCKET
+#define SOCK_NOSIGNAL 0
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define SOCK_WOULDBLOCK(e) ((e) == EAGAIN || (e) == EWOULDBLOCK)
+#define SOCK_ERRNO errno
+#define SOCK_CLOSE ::close
+#define SOCK_INVALID (-1)
+#ifdef MSG_NOSIGNAL
+#define SOCK_NOSIGNAL MSG_NOSIGNAL
+#else
+#define SOCK_NOSIGNAL 0
+#endif
+#endif
+
+Q_LOGGING_CATEGORY(logsshdirectsocket, "ssh.directsocket", QtWarningMsg)
+
+SshDirectSocket::SshDirectSocket(QObject *parent)
+    : QObject(parent)
+    , m_connector(this)
+{
+    QObject::connect(&m_connector, &SshHappyEyeballs::connected, this, [this](qintptr fd){ _attach(fd); });
+    QObject::connect(&m_connector, &SshHappyEyeballs::failed, this, [this](QAbstractSocket::SocketError error){
+        qCWarning(logsshdirectsocket) << "Connection failed:" << error;
+        _fail(error);
+    });
+}
+
+SshDirectSocket::~SshDirectSocket()
+{
+    m_connector.abort();
+    _close();
+}
+
+void SshDirectSocket::connectToHost(const QString &hostname, quint16 port)
+{
+    _close();
+    m_state = QAbstractSocket::ConnectingState;
+    m_connector.connectToHost(hostname, port);
+}
+
+void SshDirectSocket::_attach(qintptr fd)
+{
+    m_fd = fd;
+    m_state = QAbstractSocket::ConnectedState;
+    m_readNotifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    m_writeNotifier = new QSocketNotifier(m_fd, QSocketNotifier::Write, this);
+    m_writeNotifier->setEnabled(false);
+    QObject::connect(m_readNotifier, &QSocketNotifier::activated, this, [this](){ _readActivated(); });
+    QObject::connect(m_writeNotifier, &QSocketNotifier::activated, this, [this](){ _writeActivated(); });
+    emit connected();
+}
+
+void SshDirectSocket::disconnectFromHost()
+{
+    m_connector.abort();
+    bool wasConnected = (m_state == QAbstractSocket::ConnectedState);
+    _close();
+    if(wasConnected)
+    {
+        emit disconnected();
+    }
+}
+
+QAbstractSocket::SocketState SshDirectSocket::state() const
+{
+    return m_state;
+}
+
+QAbstractSocket::SocketError SshDirectSocket::error() const
+{
+    return m_error;
+}
+
+void SshDirectSocket::setOptions(const SshSocketOptions &options)
+{
+    m_connector.setOptions(options);
+}
+
+void SshDirectSocket::setAttemptDelay(int msec)
+{
+    m_connector.setAttemptDelay(msec);
+}
+
+qintptr SshDirectSocket::socketDescriptor() const
+{
+    return m_fd;
+}
+
+ssize_t SshDirectSocket::recv(void *buffer, size_t length)
+{
+    auto r = ::recv(static_cast<decltype(SOCK_INVALID)>(m_fd), reinterpret_cast<char *>(buffer), static_cast<int>(length), 0);
+    if(r < 0)
+    {
+        int err = SOCK_ERRNO;
+        if(SOCK_WOULDBLOCK(err))
+        {
+            /* Drained: the next data will wake us up */
+            rearm();
+            return -EAGAIN;
+        }
+        return -err;
+    }
+    return static_cast<ssize_t>(r);
+}
+
+ssize_t SshDirectSocket::send(const void *buffer, size_t length)
+{
+    auto r = ::send(static_cast<decltype(SOCK_INVALID)>(m_fd), reinterpret_cast<const char *>(buffer), static_cast<int>(length), SOCK_NOSIGNAL);
+    if(r < 0)
+    {
+        int err = SOCK_ERRNO;
+        if(SOCK_WOULDBLOCK(err))
+        {
+            if(m_writeNotifier)
+            {
+                m_writeNotifier->setEnabled(true);
+            }
+            return -EAGAIN;
+        }
+        return -err;
+    }
+    return static_cast<ssize_t>(r);
+}
+
+void SshDirectSocket::rearm()
+{
+    if(m_readNotifier && m_state == QAbstractSocket::ConnectedState)
+    {
+        m_readNotifier->setEnabled(true);
+    }
+}
+
+void SshDirectSocket::_readActivated()
+{
+    m_readNotifier->setEnabled(false);
+
+    char c;
+    auto r = ::recv(static_cast<decltype(SOCK_INVALID)>(m_fd), &c, 1, MSG_PEEK);
+    if(r == 0)
+    {
+        qCDebug(logsshdirectsocket) << "Connection closed by peer";
+        disconnectFromHost();
+        return;
+    }
+    if(r < 0 && !SOCK_WOULDBLOCK(SOCK_ERRNO))
+    {
+        _fail(QAbstractSocket::RemoteHostClosedError);
+        return;
+    }
+    emit readyRead();
+}
+
+void SshDirectSocket::_writeActivated()
+{
+    m_writeNotifier->setEnabled(false);
+    emit readyWrite();
+}
+
+void SshDirectSocket::_fail(QAbstractSocket::SocketError error)
+{
+    _close();
+    m_error = error;
+    emit errorOccurred(error);
+}
+
+void SshDirectSocket::_close()
+{
+    /* May be called from a notifier activation */
+    for(QSocketNotifier *notifier: {m_readNotifier, m_writeNotifier})
+    {
+        if(notifier)
+        {
+            notifier->setEnabled(false);
+            notifier->deleteLater();
+        }
+    }
+    m_readNotifier = nullptr;
+    m_writeNotifier = nullptr;
+    if(m_fd != -1)
+    {
+        SOCK_CLOSE(static_cast<decltype(SOCK_INVALID)>(m_fd));
+        m_fd = -1;
+    }
+    m_state = QAbstractSocket::UnconnectedState;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QObject>
+#include <QAbstractSocket>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+#include <libssh2.h>
+#include "sshsocketoptions.h"
+#include "sshhappyeyeballs.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshdirectsocket)
+
+/*
+ * Non blocking TCP socket without any user space buffer: libssh2 reads and
+ * writes the descriptor itself, QSocketNotifier only reports readiness.
+ *
+ * The read notifier is disabled once it fired and enabled again at the
+ * end of the processing pass it woke up, or as soon as a recv() would
+ * block.
+ * The write notifier is only enabled while a send() would block.
+ */
+class SshDirectSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshDirectSocket(QObject *parent = nullptr);
+    virtual ~SshDirectSocket() override;
+
+    void connectToHost(const QString &hostname, quint16 port);
+    void disconnectFromHost();
+    QAbstractSocket::SocketState state() const;
+    QAbstractSocket::SocketError error() const;
+    qintptr socketDescriptor() const;
+
+    /* Applied to each new descriptor, before connect (window scaling) */
+    void setOptions(const SshSocketOptions &options);
+    /* Delay before racing the next address of the host */
+    void setAttemptDelay(int msec);
+
+    /* libssh2 transport callbacks convention: negative errno on error */
+    ssize_t recv(void *buffer, size_t length);
+    ssize_t send(const void *buffer, size_t length);
+
+    /* Enable the read notifier again, even if no recv() blocked */
+    void rearm();
+
+signals:
+    void connected();
+    void disconnected();
+    void errorOccurred(QAbstractSocket::SocketError error);
+    void readyRead();
+    void readyWrite();
+
+private:
+    qintptr m_fd {-1};
+    QSocketNotifier *m_readNotifier {nullptr};
+    QSocketNotifier *m_writeNotifier {nullptr};
+    QAbstractSocket::SocketState m_state {QAbstractSocket::UnconnectedState};
+    QAbstractSocket::SocketError m_error {QAbstractSocket::UnknownSocketError};
+    SshHappyEyeballs m_connector;
+
+    void _attach(qintptr fd);
+    void _readActivated();
+    void _writeActivated();
+    void _fail(QAbstractSocket::SocketError error);
+    void _close();
+};
@@ -0,0 +1,111 @@
+#include "sshdnscache.h"
+
+SshDnsCache::SshDnsCache()
+{
+    m_clock.start();
+}
+
+SshDnsCache &SshDnsCache::instance()
+{
+    static SshDnsCache cache;
+    return cache;
+}
+
+bool SshDnsCache::lookup(const QString &hostname, QList<QHostAddress> &addresses) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.constFind(hostname.toLower());
+    if(it == m_entries.constEnd() || it->expire < m_clock.elapsed())
+    {
+        return false;
+    }
+    addresses = it->addresses;
+    return true;
+}
+
+void SshDnsCache::insert(const QString &hostname, const QList<QHostAddress> &addresses)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 now = m_clock.elapsed();
+    if(m_entries.size() >= m_maxEntries)
+    {
+        /* Drop the expired entries first, the one expiring first if none */
+        for(auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            if(it->expire < now)
+                it = m_entries.erase(it);
+            else
+                ++it;
+        }
+        if(m_entries.size() >= m_maxEntries)
+        {
+            auto oldest = m_entries.begin();
+            for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                if(it->expire < oldest->expire)
+                    oldest = it;
+            }
+            m_entries.erase(oldest);
+        }
+    }
+    m_entries.insert(hostname.toLower(), Entry {addresses, now + m_ttl});
+}
+
+void SshDnsCache::remove(const QString &hostname)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(hostname.toLower());
+}
+
+void SshDnsCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
+
+int SshDnsCache::ttl() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_ttl;
+}
+
+void SshDnsCache::setTtl(int msec)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ttl = qMax(0, msec);
+}
+
+int SshDnsCache::maxEntries() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxEntries;
+}
+
+void SshDnsCache::setMaxEntries(int entries)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxEntries = qMax(1, entries);
+}
+
+QList<QHostAddress> SshDnsCache::interleave(const QList<QHostAddress> &addresses)
+{
+    QList<QHostAddress> v6;
+    QList<QHostAddress> v4;
+    for(const QHostAddress &address: addresses)
+    {
+        if(address.protocol() == QAbstractSocket::IPv6Protocol)
+            v6.append(address);
+        else
+            v4.append(address);
+    }
+
+    QList<QHostAddress> res;
+    while(!v6.isEmpty() || !v4.isEmpty())
+    {
+        if(!v6.isEmpty())
+            res.append(v6.takeFirst());
+        if(!v4.isEmpty())
+            res.append(v4.takeFirst());
+    }
+    return res;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+/**
+ * \brief Process wide cache of host name resolutions
+ * \details Shared by all the SshClient, whatever their thread: reconnects
+ * and sessions to the same hosts do not wait for the resolver again.
+ * Entries expire after ttl(), the oldest ones are dropped beyond
+ * maxEntries().
+ */
+class SshDnsCache
+{
+    struct Entry {
+        QList<QHostAddress> addresses;
+        qint64 expire;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    QElapsedTimer m_clock;
+    int m_ttl {60000};
+    int m_maxEntries {1024};
+
+    SshDnsCache();
+
+public:
+    SshDnsCache(const SshDnsCache &) = delete;
+    SshDnsCache &operator=(const SshDnsCache &) = delete;
+    static SshDnsCache &instance();
+
+    /* False when the host is not cached or expired */
+    bool lookup(const QString &hostname, QList<QHostAddress> &addresses) const;
+    void insert(const QString &hostname, const QList<QHostAddress> &addresses);
+    void remove(const QString &hostname);
+    void clear();
+
+    int ttl() const;
+    void setTtl(int msec);
+    int maxEntries() const;
+    void setMaxEntries(int entries);
+
+    /* RFC 8305 order: families alternate, IPv6 first */
+    static QList<QHostAddress> interleave(const QList<QHostAddress> &addresses);
+};
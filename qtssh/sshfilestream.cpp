@@ -0,0 +1,393 @@
+#include "sshfilestream.h"
+#include <QThread>
+#include <QMutex>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+#define FILE_STREAM_DEPTH 2
+
+/* Shared by all the streams, stopped when the library is unloaded */
+class SshFileIoThread : public QThread
+{
+public:
+    SshFileIoThread()
+    {
+        setObjectName("qtssh-file-io");
+    }
+    ~SshFileIoThread() override
+    {
+        quit();
+        wait();
+    }
+};
+Q_GLOBAL_STATIC(SshFileIoThread, s_ioThread)
+
+static QThread *ioThread()
+{
+    static QMutex mutex;
+    QMutexLocker lock(&mutex);
+    QThread *thread = s_ioThread();
+    if(!thread->isRunning())
+    {
+        thread->start();
+    }
+    return thread;
+}
+
+void SshFileStreamWorker::open(const QString &fileName, QIODevice::OpenMode mode, qint64 preallocate)
+{
+    m_file.setFileName(fileName);
+    if(!m_file.open(mode))
+    {
+        emit opened(-1, m_file.errorString());
+        return;
+    }
+    qint64 size = m_file.size();
+#ifdef Q_OS_LINUX
+    int fd = m_file.handle();
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if((mode & QIODevice::WriteOnly) && preallocate > size)
+    {
+        /* Blocks reserved, the file size is left to the data written */
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, preallocate);
+    }
+#else
+    Q_UNUSED(preallocate)
+#endif
+    emit opened(size, QString());
+}
+
+void SshFileStreamWorker::read(quint64 generation, qint64 length)
+{
+    QByteArray data(static_cast<int>(length), Qt::Uninitialized);
+    qint64 len = m_file.read(data.data(), length);
+    if(len < 0)
+    {
+        emit blockRead(generation, QByteArray(), m_file.errorString());
+        return;
+    }
+    data.resize(static_cast<int>(len));
+    emit blockRead(generation, data, QString());
+}
+
+void SshFileStreamWorker::write(const QByteArray &block)
+{
+    qint64 len = m_file.write(block);
+    if(len != block.size())
+    {
+        emit blockWritten(-1, m_file.errorString());
+        return;
+    }
+    emit blockWritten(len, QString());
+}
+
+void SshFileStreamWorker::seek(qint64 offset)
+{
+    m_file.seek(offset);
+}
+
+void SshFileStreamWorker::resize(qint64 size)
+{
+    m_file.resize(size);
+}
+
+void SshFileStreamWorker::close()
+{
+    QString error;
+    if(m_file.isOpen())
+    {
+        if(!m_file.flush())
+            error = m_file.errorString();
+        m_file.close();
+    }
+    emit closed(error);
+}
+
+SshFileStream::SshFileStream(QObject *parent)
+    : QObject(parent)
+{
+    m_worker = new SshFileStreamWorker();
+    m_worker->moveToThread(ioThread());
+    QObject::connect(m_worker, &SshFileStreamWorker::opened, this, &SshFileStream::_opened);
+    QObject::connect(m_worker, &SshFileStreamWorker::blockRead, this, &SshFileStream::_blockRead);
+    QObject::connect(m_worker, &SshFileStreamWorker::blockWritten, this, &SshFileStream::_blockWritten);
+    QObject::connect(m_worker, &SshFileStreamWorker::closed, this, &SshFileStream::_closed);
+}
+
+SshFileStream::~SshFileStream()
+{
+    /* Queued data still written, in order, then the worker is freed */
+    close();
+    if(!m_closeSent)
+    {
+        /* Writes still in flight: the worker writes the tail itself */
+        QByteArray tail = isError() ? QByteArray() : m_pending;
+        SshFileStreamWorker *worker = m_worker;
+        QMetaObject::invokeMethod(worker, [worker, tail](){
+            if(!tail.isEmpty())
+                worker->write(tail);
+            worker->close();
+        });
+    }
+    m_worker->deleteLater();
+}
+
+void SshFileStream::setBlockSize(qint64 size)
+{
+    m_blockSize = qMax<qint64>(size, 4096);
+}
+
+qint64 SshFileStream::blockSize() const
+{
+    return m_blockSize;
+}
+
+void SshFileStream::open(const QString &fileName, QIODevice::OpenMode mode, qint64 preallocate)
+{
+    m_fileName = fileName;
+    SshFileStreamWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, fileName, mode, preallocate](){ worker->open(fileName, mode, preallocate); });
+    if(mode & QIODevice::ReadOnly && !(mode & QIODevice::WriteOnly))
+    {
+        m_readAhead = true;
+        _readAhead();
+    }
+}
+
+QString SshFileStream::fileName() const
+{
+    return m_fileName;
+}
+
+bool SshFileStream::isOpen() const
+{
+    return m_open;
+}
+
+bool SshFileStream::isClosed() const
+{
+    return m_closed;
+}
+
+bool SshFileStream::isError() const
+{
+    return !m_error.isEmpty();
+}
+
+QString SshFileStream::errorString() const
+{
+    return m_error;
+}
+
+qint64 SshFileStream::size() const
+{
+    return m_size;
+}
+
+void SshFileStream::seek(qint64 offset)
+{
+    /* Blocks already read ahead, or in flight, are dropped */
+    m_generation++;
+    m_blocks.clear();
+    m_blockOffset = 0;
+    m_available = 0;
+    m_readsInFlight = 0;
+    m_eof = false;
+    m_readAhead = false;
+    SshFileStreamWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, offset](){ worker->seek(offset); });
+}
+
+void SshFileStream::resize(qint64 size)
+{
+    SshFileStreamWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, size](){ worker->resize(size); });
+}
+
+void SshFileStream::_readAhead()
+{
+    if(!m_readAhead || m_closing || isError())
+        return;
+    while(!m_eof && m_blocks.size() + m_readsInFlight < FILE_STREAM_DEPTH)
+    {
+        m_readsInFlight++;
+        SshFileStreamWorker *worker = m_worker;
+        quint64 generation = m_generation;
+        qint64 length = m_blockSize;
+        QMetaObject::invokeMethod(worker, [worker, generation, length](){ worker->read(generation, length); });
+    }
+}
+
+qint64 SshFileStream::read(char *data, qint64 maxSize)
+{
+    m_readAhead = true;
+    qint64 total = 0;
+    while(total < maxSize && !m_blocks.isEmpty())
+    {
+        const QByteArray &block = m_blocks.first();
+        qint64 len = qMin(maxSize - total, static_cast<qint64>(block.size() - m_blockOffset));
+        std::memcpy(data + total, block.constData() + m_blockOffset, static_cast<size_t>(len));
+        total += len;
+        m_blockOffset += static_cast<int>(len);
+        if(m_blockOffset == block.size())
+        {
+            m_blocks.removeFirst();
+            m_blockOffset = 0;
+        }
+    }
+    m_available -= total;
+    _readAhead();
+    return total;
+}
+
+QByteArray SshFileStream::readBlock()
+{
+    m_readAhead = true;
+    QByteArray block;
+    if(!m_blocks.isEmpty())
+    {
+        block = m_blocks.takeFirst();
+        if(m_blockOffset > 0)
+        {
+            block.remove(0, m_blockOffset);
+            m_blockOffset = 0;
+        }
+        m_available -= block.size();
+    }
+    _readAhead();
+    return block;
+}
+
+qint64 SshFileStream::bytesAvailable() const
+{
+    return m_available;
+}
+
+bool SshFileStream::atEnd() const
+{
+    return m_eof && m_blocks.isEmpty();
+}
+
+qint64 SshFileStream::write(const char *data, qint64 length)
+{
+    if(m_closing || isError())
+        return -1;
+    m_pending.append(data, static_cast<int>(length));
+    m_bytesToWrite += length;
+    _flushWrites();
+    return length;
+}
+
+bool SshFileStream::canWrite() const
+{
+    return !isError() && m_bytesToWrite < FILE_STREAM_DEPTH * m_blockSize;
+}
+
+qint64 SshFileStream::bytesToWrite() const
+{
+    return m_bytesToWrite;
+}
+
+void SshFileStream::_flushWrites()
+{
+    while(m_writesInFlight < FILE_STREAM_DEPTH && (m_pending.size() >= m_blockSize || (m_closing && !m_pending.isEmpty())))
+    {
+        QByteArray block;
+        if(m_pending.size() <= m_blockSize)
+        {
+            block.swap(m_pending);
+        }
+        else
+        {
+            block = m_pending.left(static_cast<int>(m_blockSize));
+            m_pending.remove(0, static_cast<int>(m_blockSize));
+        }
+        m_writesInFlight++;
+        SshFileStreamWorker *worker = m_worker;
+        QMetaObject::invokeMethod(worker, [worker, block](){ worker->write(block); });
+    }
+    if(m_closing && !m_closeSent && (m_pending.isEmpty() || isError()) && m_writesInFlight == 0)
+    {
+        m_closeSent = true;
+        SshFileStreamWorker *worker = m_worker;
+        QMetaObject::invokeMethod(worker, [worker](){ worker->close(); });
+    }
+}
+
+void SshFileStream::close()
+{
+    if(m_closing)
+        return;
+    m_closing = true;
+    _flushWrites();
+}
+
+void SshFileStream::_setError(const QString &error)
+{
+    if(m_error.isEmpty())
+        m_error = (error.isEmpty()) ? QString("I/O error on %1").arg(m_fileName) : error;
+}
+
+void SshFileStream::_opened(qint64 size, const QString &error)
+{
+    if(!error.isEmpty())
+    {
+        _setError(error);
+    }
+    else
+    {
+        m_open = true;
+        m_size = size;
+    }
+    emit ready();
+}
+
+void SshFileStream::_blockRead(quint64 generation, const QByteArray &data, const QString &error)
+{
+    if(generation != m_generation)
+        return;
+    m_readsInFlight--;
+    if(!error.isEmpty())
+    {
+        _setError(error);
+    }
+    else if(data.isEmpty())
+    {
+        m_eof = true;
+    }
+    else
+    {
+        m_blocks.append(data);
+        m_available += data.size();
+    }
+    _readAhead();
+    emit ready();
+}
+
+void SshFileStream::_blockWritten(qint64 length, const QString &error)
+{
+    m_writesInFlight--;
+    if(length < 0)
+    {
+        _setError(error);
+        m_pending.clear();
+        m_bytesToWrite = 0;
+    }
+    else
+    {
+        m_bytesToWrite -= length;
+    }
+    _flushWrites();
+    emit ready();
+}
+
+void SshFileStream::_closed(const QString &error)
+{
+    if(!error.isEmpty())
+        _setError(error);
+    m_open = false;
+    m_closed = true;
+    emit ready();
+}
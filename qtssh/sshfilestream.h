@@ -0,0 +1,111 @@
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+
+/* File side of SshFileStream, lives in the shared I/O thread */
+class SshFileStreamWorker : public QObject
+{
+    Q_OBJECT
+
+    QFile m_file;
+
+public:
+    void open(const QString &fileName, QIODevice::OpenMode mode, qint64 preallocate);
+    void read(quint64 generation, qint64 length);
+    void write(const QByteArray &block);
+    void seek(qint64 offset);
+    void resize(qint64 size);
+    void close();
+
+signals:
+    void opened(qint64 size, const QString &error);
+    void blockRead(quint64 generation, const QByteArray &data, const QString &error);
+    void blockWritten(qint64 length, const QString &error);
+    void closed(const QString &error);
+};
+
+/**
+ * \brief Local file read or written in large blocks by a worker thread
+ * \details All the transfers share one I/O thread, so a slow disk never
+ * blocks the thread driving the sessions. Every call returns at once and
+ * operations run in order: reads are prefetched two blocks ahead, writes
+ * are copied and queued, two blocks at most in flight. ready() is emitted
+ * when an operation completed, for the caller to try again. On Linux a
+ * file opened for writing is preallocated and every file gets a
+ * sequential access hint.
+ */
+class SshFileStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshFileStream(QObject *parent = nullptr);
+    virtual ~SshFileStream() override;
+
+    void setBlockSize(qint64 size);
+    qint64 blockSize() const;
+
+    /* preallocate: expected size of the file written, 0 if unknown */
+    void open(const QString &fileName, QIODevice::OpenMode mode, qint64 preallocate = 0);
+    QString fileName() const;
+    bool isOpen() const;
+    bool isClosed() const;
+    bool isError() const;
+    QString errorString() const;
+    /* Size when opened, -1 before */
+    qint64 size() const;
+
+    void seek(qint64 offset);
+    void resize(qint64 size);
+
+    /* Data read ahead, 0 when not there yet (ready() follows) */
+    qint64 read(char *data, qint64 maxSize);
+    QByteArray readBlock();
+    qint64 bytesAvailable() const;
+    bool atEnd() const;
+
+    /* Queued write, -1 on error; wait for canWrite() to bound the memory */
+    qint64 write(const char *data, qint64 length);
+    bool canWrite() const;
+    qint64 bytesToWrite() const;
+
+    /* Writes what is queued then closes, isClosed() once done */
+    void close();
+
+signals:
+    void ready();
+
+private:
+    void _readAhead();
+    void _flushWrites();
+    void _opened(qint64 size, const QString &error);
+    void _blockRead(quint64 generation, const QByteArray &data, const QString &error);
+    void _blockWritten(qint64 length, const QString &error);
+    void _closed(const QString &error);
+    void _setError(const QString &error);
+
+    SshFileStreamWorker *m_worker {nullptr};
+    QString m_fileName;
+    qint64 m_blockSize {1024*1024};
+    bool m_open {false};
+    bool m_closing {false};
+    bool m_closeSent {false};
+    bool m_closed {false};
+    QString m_error;
+    qint64 m_size {-1};
+
+    bool m_readAhead {false};
+    quint64 m_generation {0};
+    int m_readsInFlight {0};
+    QList<QByteArray> m_blocks;
+    int m_blockOffset {0};
+    qint64 m_available {0};
+    bool m_eof {false};
+
+    QByteArray m_pending;
+    int m_writesInFlight {0};
+    qint64 m_bytesToWrite {0};
+};
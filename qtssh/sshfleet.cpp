@@ -0,0 +1,303 @@
+#include "sshfleet.h"
+#include "sshprocess.h"
+#include "sshsftp.h"
+#include "sshsftpcommandsend.h"
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <memory>
+
+Q_LOGGING_CATEGORY(logsshfleet, "ssh.fleet", QtWarningMsg)
+
+SshFleet::SshFleet(int threads, QObject *parent)
+    : QObject(parent)
+    , m_pool(threads)
+{
+}
+
+SshFleet::~SshFleet()
+{
+    /* Running clients are destroyed by the pool */
+    closeSessions();
+}
+
+void SshFleet::setKeys(const QString &publicKey, const QString &privateKey)
+{
+    m_publicKey = publicKey;
+    m_privateKey = privateKey;
+}
+
+void SshFleet::setPassphrase(const QString &pass)
+{
+    m_passphrase = pass;
+}
+
+void SshFleet::setConcurrency(int tasks)
+{
+    m_concurrency = qMax(1, tasks);
+    _startNext();
+}
+
+int SshFleet::concurrency() const
+{
+    return m_concurrency;
+}
+
+void SshFleet::setHostTimeout(int msec)
+{
+    m_hostTimeout = qMax(1, msec);
+}
+
+int SshFleet::hostTimeout() const
+{
+    return m_hostTimeout;
+}
+
+void SshFleet::setRetries(int retries)
+{
+    m_retries = qMax(0, retries);
+}
+
+int SshFleet::retries() const
+{
+    return m_retries;
+}
+
+void SshFleet::setRetryDelay(int msec)
+{
+    m_retryDelay = qMax(0, msec);
+}
+
+int SshFleet::retryDelay() const
+{
+    return m_retryDelay;
+}
+
+QString SshFleet::_key(const Host &host)
+{
+    return QString("%1@%2:%3").arg(host.username, host.hostname).arg(host.port);
+}
+
+int SshFleet::_addTask(const Task &task)
+{
+    m_tasks.append(task);
+    m_results.append(Result {task.host, (task.send) ? task.dest : task.command, false, -1, QByteArray(), QString(), 0, 0});
+    return m_tasks.size() - 1;
+}
+
+int SshFleet::addCommand(const Host &host, const QString &command)
+{
+    return _addTask(Task {host, false, command, QString(), QString(), 0});
+}
+
+int SshFleet::addSend(const Host &host, const QString &source, const QString &dest)
+{
+    return _addTask(Task {host, true, QString(), source, dest, 0});
+}
+
+void SshFleet::start()
+{
+    for(; m_queued < m_tasks.size(); ++m_queued)
+    {
+        m_pending.append(m_queued);
+    }
+    _startNext();
+}
+
+bool SshFleet::waitForFinished()
+{
+    start();
+    QEventLoop wait(this);
+    QObject::connect(this, &SshFleet::finished, &wait, &QEventLoop::quit);
+    while(!isFinished())
+    {
+        wait.exec();
+    }
+    for(const Result &result: m_results)
+    {
+        if(!result.success)
+            return false;
+    }
+    return true;
+}
+
+bool SshFleet::isFinished() const
+{
+    return m_finished == m_tasks.size();
+}
+
+void SshFleet::closeSessions()
+{
+    for(SshClient *client: m_idle)
+    {
+        _dropSession(client);
+    }
+    m_idle.clear();
+}
+
+int SshFleet::count() const
+{
+    return m_tasks.size();
+}
+
+int SshFleet::runningCount() const
+{
+    return m_running;
+}
+
+SshFleet::Result SshFleet::result(int index) const
+{
+    return m_results.value(index);
+}
+
+const QList<SshFleet::Result> &SshFleet::results() const
+{
+    return m_results;
+}
+
+void SshFleet::_startNext()
+{
+    while(m_running < m_concurrency && !m_pending.isEmpty())
+    {
+        int index = m_pending.takeFirst();
+        QString key = _key(m_tasks[index].host);
+        SshClient *client = m_idle.take(key);
+        if(!client)
+        {
+            client = m_pool.createClient(key);
+            qCDebug(logsshfleet) << "New session for" << key;
+        }
+        m_running++;
+        emit hostStarted(index);
+        _run(index, client);
+    }
+}
+
+void SshFleet::_run(int index, SshClient *client)
+{
+    const Task task = m_tasks[index];
+    const QString label = m_results[index].task;
+    const QString channelName = QString("fleet-%1").arg(++m_taskId);
+    const QString publicKey = m_publicKey;
+    const QString privateKey = m_privateKey;
+    const QString passphrase = m_passphrase;
+    const int timeout = m_hostTimeout;
+    QElapsedTimer clock;
+    clock.start();
+
+    QMetaObject::invokeMethod(client, [=]() {
+        /* From here, everything lives in the client thread */
+        QObject *ctx = new QObject(client);
+        auto over = std::make_shared<bool>(false);
+        auto done = std::make_shared<std::function<void(bool, int, const QByteArray &, const QString &)>>();
+        *done = [=](bool success, int exitCode, const QByteArray &output, const QString &error) {
+            if(*over)
+                return;
+            *over = true;
+            bool reusable = success && client->sshState() == SshClient::SshState::Ready;
+            Result result {task.host, label, success, exitCode, output, error, task.attempts + 1, clock.elapsed()};
+            ctx->deleteLater();
+            QMetaObject::invokeMethod(this, [=]() {
+                _taskDone(index, client, result, reusable);
+            }, Qt::QueuedConnection);
+        };
+
+        QTimer *timer = new QTimer(ctx);
+        timer->setSingleShot(true);
+        QObject::connect(timer, &QTimer::timeout, ctx, [=]() {
+            (*done)(false, -1, QByteArray(), "Timeout");
+        });
+
+        auto started = std::make_shared<bool>(false);
+        auto action = [=]() {
+            if(*started)
+                return;
+            *started = true;
+            if(task.send)
+            {
+                SshSFtp *sftp = client->getChannel<SshSFtp>("fleet-sftp");
+                SshSftpCommandSend *cmd = sftp->asyncSend(task.source, task.dest);
+                QObject::connect(cmd, &SshSftpCommand::finished, ctx, [=]() {
+                    bool success = cmd->state() == SshSftpCommand::CommandState::Terminate && cmd->errMsg().isEmpty();
+                    (*done)(success, (success) ? 0 : -1, QByteArray(), cmd->errMsg().join("; "));
+                    cmd->deleteLater();
+                });
+            }
+            else
+            {
+                SshProcess *proc = client->getChannel<SshProcess>(channelName);
+                QObject::connect(proc, &SshProcess::finished, ctx, [=]() {
+                    int status = proc->exitStatus();
+                    (*done)(status == 0, status, proc->result(), (status == 0) ? QString() : QString("Exit status %1").arg(status));
+                });
+                QObject::connect(proc, &SshProcess::failed, ctx, [=]() {
+                    (*done)(false, -1, proc->result(), proc->errMsg().join("; "));
+                });
+                proc->runCommand(task.command);
+            }
+        };
+
+        QObject::connect(client, &SshClient::sshError, ctx, [=]() {
+            (*done)(false, -1, QByteArray(), "SSH connection error");
+        });
+        QObject::connect(client, &SshClient::sshDisconnected, ctx, [=]() {
+            (*done)(false, -1, QByteArray(), "SSH disconnected");
+        });
+
+        timer->start(timeout);
+        if(client->sshState() == SshClient::SshState::Ready)
+        {
+            action();
+            return;
+        }
+        QObject::connect(client, &SshClient::sshReady, ctx, action);
+        if(!privateKey.isEmpty())
+            client->setKeys(publicKey, privateKey);
+        if(!passphrase.isEmpty())
+            client->setPassphrase(passphrase);
+        client->connectToHost(task.host.username, task.host.hostname, task.host.port, QByteArrayList(), timeout);
+    }, Qt::QueuedConnection);
+}
+
+void SshFleet::_taskDone(int index, SshClient *client, const Result &result, bool reusable)
+{
+    m_running--;
+    if(reusable)
+    {
+        m_idle.insert(_key(result.host), client);
+    }
+    else
+    {
+        _dropSession(client);
+    }
+
+    Task &task = m_tasks[index];
+    if(!result.success && task.attempts < m_retries)
+    {
+        task.attempts++;
+        qCDebug(logsshfleet) << "Retry" << _key(task.host) << "after" << result.error;
+        QTimer::singleShot(m_retryDelay * task.attempts, this, [this, index]() {
+            m_pending.prepend(index);
+            _startNext();
+        });
+        _startNext();
+        return;
+    }
+
+    m_results[index] = result;
+    m_finished++;
+    if(!result.success)
+        qCWarning(logsshfleet) << _key(result.host) << "failed:" << result.error;
+    emit hostFinished(index, result);
+    _startNext();
+    if(isFinished())
+    {
+        emit finished();
+    }
+}
+
+void SshFleet::_dropSession(SshClient *client)
+{
+    /* The client disconnects from its destructor, in its thread */
+    m_pool.releaseClient(client);
+}
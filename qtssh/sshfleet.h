@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QMultiHash>
+#include <QLoggingCategory>
+#include "sshclientpool.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshfleet)
+
+/**
+ * \brief Run commands and SFTP uploads on many hosts in parallel
+ * \details Sessions are spread over the threads of a SshClientPool, at
+ * most concurrency() tasks run at the same time. Results are reported by
+ * hostFinished() as soon as each task ends. A task which fails or runs
+ * longer than hostTimeout() is retried up to retries() times on a new
+ * session. The session of a successful task is kept and reused by the
+ * next task for the same host, until closeSessions().
+ */
+class SshFleet : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Host {
+        QString username;
+        QString hostname;
+        quint16 port {22};
+    };
+
+    struct Result {
+        Host host;
+        QString task;
+        bool success;
+        int exitCode;
+        QByteArray output;
+        QString error;
+        int attempts;
+        qint64 elapsed;
+    };
+
+private:
+    struct Task {
+        Host host;
+        bool send;
+        QString command;
+        QString source;
+        QString dest;
+        int attempts;
+    };
+
+    SshClientPool m_pool;
+    QString m_publicKey;
+    QString m_privateKey;
+    QString m_passphrase;
+    int m_concurrency {32};
+    int m_hostTimeout {60000};
+    int m_retries {1};
+    int m_retryDelay {1000};
+
+    QList<Task> m_tasks;
+    QList<Result> m_results;
+    QList<int> m_pending;
+    QMultiHash<QString, SshClient *> m_idle;
+    int m_running {0};
+    int m_queued {0};
+    int m_finished {0};
+    int m_taskId {0};
+
+    static QString _key(const Host &host);
+    int _addTask(const Task &task);
+    void _startNext();
+    void _run(int index, SshClient *client);
+    void _taskDone(int index, SshClient *client, const Result &result, bool reusable);
+    void _dropSession(SshClient *client);
+
+public:
+    explicit SshFleet(int threads = QThread::idealThreadCount(), QObject *parent = nullptr);
+    virtual ~SshFleet() override;
+
+    void setKeys(const QString &publicKey, const QString &privateKey);
+    void setPassphrase(const QString &pass);
+
+    void setConcurrency(int tasks);
+    int concurrency() const;
+    /* Connection plus task duration, per attempt */
+    void setHostTimeout(int msec);
+    int hostTimeout() const;
+    void setRetries(int retries);
+    int retries() const;
+    /* Multiplied by the attempt number */
+    void setRetryDelay(int msec);
+    int retryDelay() const;
+
+    int addCommand(const Host &host, const QString &command);
+    int addSend(const Host &host, const QString &source, const QString &dest);
+    void start();
+    bool waitForFinished();
+    bool isFinished() const;
+    void closeSessions();
+
+    int count() const;
+    int runningCount() const;
+    Result result(int index) const;
+    const QList<Result> &results() const;
+
+signals:
+    void hostStarted(int index);
+    void hostFinished(int index, const SshFleet::Result &result);
+    void finished();
+};
+
+Q_DECLARE_METATYPE(SshFleet::Result)
@@ -0,0 +1,258 @@
+#include "sshhappyeyeballs.h"
+#include "sshdnscache.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define SOCK_INPROGRESS(e) ((e) == WSAEWOULDBLOCK || (e) == WSAEINPROGRESS)
+#define SOCK_ERRNO WSAGetLastError()
+#define SOCK_CLOSE closesocket
+#define SOCK_INVALID INVALID_SOCKET
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SOCK_INPROGRESS(e) ((e) == EINPROGRESS || (e) == EINTR)
+#define SOCK_ERRNO errno
+#define SOCK_CLOSE ::close
+#define SOCK_INVALID (-1)
+#endif
+
+Q_LOGGING_CATEGORY(logsshhappyeyeballs, "ssh.happyeyeballs", QtWarningMsg)
+
+SshHappyEyeballs::SshHappyEyeballs(QObject *parent)
+    : QObject(parent)
+{
+    m_delayTimer.setSingleShot(true);
+    QObject::connect(&m_delayTimer, &QTimer::timeout, this, &SshHappyEyeballs::_startAttempt);
+}
+
+SshHappyEyeballs::~SshHappyEyeballs()
+{
+    abort();
+}
+
+void SshHappyEyeballs::setOptions(const SshSocketOptions &options)
+{
+    m_options = options;
+}
+
+void SshHappyEyeballs::setAttemptDelay(int msec)
+{
+    /* RFC 8305 recommends 250 ms, 10 ms minimum */
+    m_attemptDelay = qMax(10, msec);
+}
+
+int SshHappyEyeballs::attemptDelay() const
+{
+    return m_attemptDelay;
+}
+
+bool SshHappyEyeballs::isRunning() const
+{
+    return m_running;
+}
+
+void SshHappyEyeballs::connectToHost(const QString &hostname, quint16 port)
+{
+    abort();
+    m_hostname = hostname;
+    m_port = port;
+    m_running = true;
+
+    QHostAddress address;
+    if(address.setAddress(hostname))
+    {
+        _start({address});
+        return;
+    }
+
+    QList<QHostAddress> addresses;
+    if(SshDnsCache::instance().lookup(hostname, addresses))
+    {
+        qCDebug(logsshhappyeyeballs) << hostname << "found in cache";
+        _start(addresses);
+        return;
+    }
+    m_lookupId = QHostInfo::lookupHost(hostname, this, SLOT(_hostFound(QHostInfo)));
+}
+
+void SshHappyEyeballs::abort()
+{
+    if(m_lookupId >= 0)
+    {
+        QHostInfo::abortHostLookup(m_lookupId);
+        m_lookupId = -1;
+    }
+    m_delayTimer.stop();
+    m_addresses.clear();
+    _closeAttempts(-1);
+    m_running = false;
+}
+
+void SshHappyEyeballs::_hostFound(const QHostInfo &info)
+{
+    m_lookupId = -1;
+    if(info.error() != QHostInfo::NoError || info.addresses().isEmpty())
+    {
+        qCWarning(logsshhappyeyeballs) << "Host lookup failed:" << info.errorString();
+        m_running = false;
+        emit failed(QAbstractSocket::HostNotFoundError);
+        return;
+    }
+    SshDnsCache::instance().insert(m_hostname, info.addresses());
+    _start(info.addresses());
+}
+
+void SshHappyEyeballs::_start(const QList<QHostAddress> &addresses)
+{
+    m_addresses = SshDnsCache::interleave(addresses);
+    _startAttempt();
+}
+
+void SshHappyEyeballs::_startAttempt()
+{
+    while(!m_addresses.isEmpty())
+    {
+        QHostAddress address = m_addresses.takeFirst();
+
+        struct sockaddr_storage storage;
+        std::memset(&storage, 0, sizeof(storage));
+        socklen_t len = 0;
+        if(address.protocol() == QAbstractSocket::IPv6Protocol)
+        {
+            struct sockaddr_in6 *sa = reinterpret_cast<struct sockaddr_in6 *>(&storage);
+            Q_IPV6ADDR ip = address.toIPv6Address();
+            sa->sin6_family = AF_INET6;
+            sa->sin6_port = htons(m_port);
+            std::memcpy(&sa->sin6_addr, &ip, sizeof(ip));
+            len = sizeof(struct sockaddr_in6);
+        }
+        else
+        {
+            struct sockaddr_in *sa = reinterpret_cast<struct sockaddr_in *>(&storage);
+            sa->sin_family = AF_INET;
+            sa->sin_port = htons(m_port);
+            sa->sin_addr.s_addr = htonl(address.toIPv4Address());
+            len = sizeof(struct sockaddr_in);
+        }
+
+        auto fd = ::socket(storage.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        if(fd == SOCK_INVALID)
+        {
+            qCWarning(logsshhappyeyeballs) << "Can't create socket:" << SOCK_ERRNO;
+            continue;
+        }
+        m_options.apply(static_cast<qintptr>(fd));
+
+#ifdef Q_OS_WIN
+        u_long nonblock = 1;
+        ioctlsocket(fd, FIONBIO, &nonblock);
+#else
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+
+        qCDebug(logsshhappyeyeballs) << "Connect to" << address << m_port;
+        qintptr handle = static_cast<qintptr>(fd);
+        if(::connect(fd, reinterpret_cast<struct sockaddr *>(&storage), len) == 0)
+        {
+            m_attempts.append(Attempt {handle, address, nullptr});
+            _win(handle);
+            return;
+        }
+        int err = SOCK_ERRNO;
+        if(!SOCK_INPROGRESS(err))
+        {
+            qCDebug(logsshhappyeyeballs) << "Connect to" << address << "failed:" << err;
+            SOCK_CLOSE(fd);
+            continue;
+        }
+
+        QSocketNotifier *notifier = new QSocketNotifier(handle, QSocketNotifier::Write, this);
+        QObject::connect(notifier, &QSocketNotifier::activated, this, [this, handle](){ _attemptReady(handle); });
+        m_attempts.append(Attempt {handle, address, notifier});
+
+        /* Give this one a head start before racing the next address */
+        if(!m_addresses.isEmpty())
+        {
+            m_delayTimer.start(m_attemptDelay);
+        }
+        return;
+    }
+
+    if(m_attempts.isEmpty() && m_running)
+    {
+        m_running = false;
+        emit failed(QAbstractSocket::ConnectionRefusedError);
+    }
+}
+
+void SshHappyEyeballs::_attemptReady(qintptr fd)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    ::getsockopt(static_cast<decltype(SOCK_INVALID)>(fd), SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&err), &len);
+    if(err != 0)
+    {
+        qCDebug(logsshhappyeyeballs) << "Connection failed:" << err;
+        _attemptFailed(fd);
+        return;
+    }
+    _win(fd);
+}
+
+void SshHappyEyeballs::_attemptFailed(qintptr fd)
+{
+    for(int i = 0; i < m_attempts.size(); ++i)
+    {
+        if(m_attempts[i].fd != fd)
+            continue;
+        Attempt attempt = m_attempts.takeAt(i);
+        attempt.notifier->setEnabled(false);
+        attempt.notifier->deleteLater();
+        SOCK_CLOSE(static_cast<decltype(SOCK_INVALID)>(fd));
+        break;
+    }
+    /* Don't wait the delay: the next address goes now */
+    m_delayTimer.stop();
+    _startAttempt();
+}
+
+void SshHappyEyeballs::_win(qintptr fd)
+{
+    QHostAddress address;
+    for(const Attempt &attempt: m_attempts)
+    {
+        if(attempt.fd == fd)
+            address = attempt.address;
+    }
+    qCDebug(logsshhappyeyeballs) << "Connected to" << address << "with" << m_attempts.size() << "attempts pending";
+    m_delayTimer.stop();
+    m_addresses.clear();
+    _closeAttempts(fd);
+    m_running = false;
+    emit connected(fd, address);
+}
+
+void SshHappyEyeballs::_closeAttempts(qintptr keep)
+{
+    /* May be called from a notifier activation */
+    for(const Attempt &attempt: m_attempts)
+    {
+        if(attempt.notifier)
+        {
+            attempt.notifier->setEnabled(false);
+            attempt.notifier->deleteLater();
+        }
+        if(attempt.fd != keep)
+        {
+            SOCK_CLOSE(static_cast<decltype(SOCK_INVALID)>(attempt.fd));
+        }
+    }
+    m_attempts.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QObject>
+#include <QAbstractSocket>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QList>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QLoggingCategory>
+#include "sshsocketoptions.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshhappyeyeballs)
+
+/*
+ * RFC 8305 connection: addresses come from SshDnsCache or from an
+ * asynchronous lookup, families interleaved. A new attempt starts each
+ * attemptDelay() or as soon as the previous one fails, all pending
+ * attempts race and the first connected socket wins; the others are
+ * closed. A dead address family costs attemptDelay(), not a timeout.
+ *
+ * The connected descriptor is non blocking and belongs to the receiver
+ * of connected().
+ */
+class SshHappyEyeballs : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshHappyEyeballs(QObject *parent = nullptr);
+    virtual ~SshHappyEyeballs() override;
+
+    void connectToHost(const QString &hostname, quint16 port);
+    void abort();
+    bool isRunning() const;
+
+    /* Applied to each descriptor, before connect */
+    void setOptions(const SshSocketOptions &options);
+    void setAttemptDelay(int msec);
+    int attemptDelay() const;
+
+signals:
+    void connected(qintptr fd, const QHostAddress &address);
+    void failed(QAbstractSocket::SocketError error);
+
+private:
+    struct Attempt {
+        qintptr fd;
+        QHostAddress address;
+        QSocketNotifier *notifier;
+    };
+
+    QString m_hostname;
+    quint16 m_port {0};
+    QList<QHostAddress> m_addresses;
+    QList<Attempt> m_attempts;
+    QTimer m_delayTimer;
+    SshSocketOptions m_options;
+    int m_attemptDelay {250};
+    int m_lookupId {-1};
+    bool m_running {false};
+
+    void _start(const QList<QHostAddress> &addresses);
+    void _startAttempt();
+    void _attemptReady(qintptr fd);
+    void _attemptFailed(qintptr fd);
+    void _win(qintptr fd);
+    void _closeAttempts(qintptr keep);
+
+private slots:
+    void _hostFound(const QHostInfo &info);
+};
@@ -0,0 +1,79 @@
+#include "sshkeepalivescheduler.h"
+#include "sshclient.h"
+#include <QDateTime>
+#include <QThreadStorage>
+
+static QThreadStorage<SshKeepAliveScheduler *> s_schedulers;
+
+SshKeepAliveScheduler *SshKeepAliveScheduler::instance()
+{
+    if(!s_schedulers.hasLocalData())
+    {
+        s_schedulers.setLocalData(new SshKeepAliveScheduler());
+    }
+    return s_schedulers.localData();
+}
+
+SshKeepAliveScheduler::SshKeepAliveScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    QObject::connect(&m_timer, &QTimer::timeout, this, &SshKeepAliveScheduler::_timeout);
+}
+
+void SshKeepAliveScheduler::schedule(SshClient *client, int msec)
+{
+    cancel(client);
+    qint64 deadline = QDateTime::currentMSecsSinceEpoch() + msec;
+    m_clients.insert(client, deadline);
+    m_deadlines.insert(deadline, client);
+    _arm();
+}
+
+void SshKeepAliveScheduler::cancel(SshClient *client)
+{
+    auto it = m_clients.find(client);
+    if(it == m_clients.end())
+    {
+        return;
+    }
+    m_deadlines.remove(it.value(), client);
+    m_clients.erase(it);
+    _arm();
+}
+
+int SshKeepAliveScheduler::count() const
+{
+    return m_clients.size();
+}
+
+void SshKeepAliveScheduler::_arm()
+{
+    if(m_deadlines.isEmpty())
+    {
+        m_timer.stop();
+        return;
+    }
+    qint64 next = m_deadlines.firstKey() - QDateTime::currentMSecsSinceEpoch();
+    m_timer.start(static_cast<int>(qMax(qint64(0), next)));
+}
+
+void SshKeepAliveScheduler::_timeout()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<SshClient *> expired;
+    while(!m_deadlines.isEmpty() && m_deadlines.firstKey() <= now)
+    {
+        SshClient *client = m_deadlines.first();
+        m_deadlines.erase(m_deadlines.begin());
+        m_clients.remove(client);
+        expired.append(client);
+    }
+
+    /* Clients reschedule themselves from _sendKeepAlive() */
+    for(SshClient *client: expired)
+    {
+        client->_sendKeepAlive();
+    }
+    _arm();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QMultiMap>
+#include <QTimer>
+
+class SshClient;
+
+/*
+ * One timer per thread for the keepalive of all the SshClient living in
+ * it: deadlines are kept sorted and the timer is armed on the first one.
+ */
+class SshKeepAliveScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /* Scheduler of the calling thread, created on first use */
+    static SshKeepAliveScheduler *instance();
+
+    void schedule(SshClient *client, int msec);
+    void cancel(SshClient *client);
+    int count() const;
+
+private:
+    explicit SshKeepAliveScheduler(QObject *parent = nullptr);
+    QTimer m_timer;
+    QMultiMap<qint64, SshClient *> m_deadlines;
+    QHash<SshClient *, qint64> m_clients;
+
+    void _arm();
+
+private slots:
+    void _timeout();
+};
@@ -0,0 +1,276 @@
+#include "sshknownhosts.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(logsshknownhosts, "ssh.knownhosts", QtWarningMsg)
+
+#define HASHED_HOST_MAGIC "|1|"
+#define HASHED_SALT_SIZE  20
+
+SshKnownHosts &SshKnownHosts::instance()
+{
+    static SshKnownHosts store;
+    return store;
+}
+
+QByteArray SshKnownHosts::_hostKey(const QString &hostname, quint16 port)
+{
+    QByteArray host = hostname.toLower().toUtf8();
+    if(port == 22 || port == 0)
+    {
+        return host;
+    }
+    return "[" + host + "]:" + QByteArray::number(port);
+}
+
+QByteArray SshKnownHosts::keyType(const QByteArray &key)
+{
+    /* Blob starts with the type name: uint32 length, name */
+    if(key.size() < 4)
+        return QByteArray();
+    const uchar *p = reinterpret_cast<const uchar *>(key.constData());
+    quint32 len = (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+    if(len == 0 || len > static_cast<quint32>(key.size() - 4))
+        return QByteArray();
+    return key.mid(4, static_cast<int>(len));
+}
+
+bool SshKnownHosts::load(const QString &file)
+{
+    QFileInfo info(file);
+    QMutexLocker locker(&m_mutex);
+    KnownFile &known = m_files[file];
+    qint64 offset = 0;
+    if(known.modified.isValid() || known.size > 0)
+    {
+        if(known.modified == info.lastModified() && known.size == info.size())
+        {
+            return true;
+        }
+        if(info.size() < known.size)
+        {
+            /* Rewritten behind our back: read it all again */
+            qCDebug(logsshknownhosts) << file << "shrunk, read again";
+            known = KnownFile();
+        }
+        else
+        {
+            offset = known.size;
+        }
+    }
+
+    QFile f(file);
+    if(!f.open(QIODevice::ReadOnly))
+    {
+        known.modified = info.lastModified();
+        known.size = info.size();
+        return false;
+    }
+    qint64 size = f.size();
+    if(size > offset)
+    {
+        uchar *data = f.map(offset, size - offset);
+        if(data)
+        {
+            _parse(known, reinterpret_cast<const char *>(data), size - offset);
+            f.unmap(data);
+        }
+        else
+        {
+            f.seek(offset);
+            QByteArray content = f.readAll();
+            _parse(known, content.constData(), content.size());
+        }
+    }
+    known.modified = info.lastModified();
+    known.size = size;
+    qCDebug(logsshknownhosts) << "Loaded" << file << "from" << offset << ":" << known.count << "entries";
+    return true;
+}
+
+void SshKnownHosts::_parse(KnownFile &known, const char *data, qint64 size)
+{
+    const char *end = data + size;
+    while(data < end)
+    {
+        const char *eol = static_cast<const char *>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+        if(!eol)
+            eol = end;
+        /* Only the line is copied, not the whole file */
+        _parseLine(known, QByteArray::fromRawData(data, static_cast<int>(eol - data)).trimmed());
+        data = eol + 1;
+    }
+    /* New hashed entries: the remembered resolutions are stale */
+    known.resolved.clear();
+}
+
+void SshKnownHosts::_parseLine(KnownFile &known, const QByteArray &line)
+{
+    if(line.isEmpty() || line.startsWith('#') || line.startsWith('@'))
+    {
+        /* Markers (@cert-authority, @revoked) are not supported */
+        return;
+    }
+    QList<QByteArray> fields = line.simplified().split(' ');
+    if(fields.size() < 3)
+    {
+        return;
+    }
+    Entry entry {fields[1], QByteArray::fromBase64(fields[2])};
+    known.count++;
+
+    if(fields[0].startsWith(HASHED_HOST_MAGIC))
+    {
+        QList<QByteArray> parts = fields[0].mid(3).split('|');
+        if(parts.size() == 2)
+        {
+            known.hashed.append(HashedEntry {QByteArray::fromBase64(parts[0]), QByteArray::fromBase64(parts[1]), entry});
+        }
+        return;
+    }
+
+    for(const QByteArray &host: fields[0].split(','))
+    {
+        if(host.isEmpty() || host.startsWith('!'))
+            continue;
+        if(host.contains('*') || host.contains('?'))
+            known.patterns.append(qMakePair(host.toLower(), entry));
+        else
+            known.plain[host.toLower()].append(entry);
+    }
+}
+
+QList<SshKnownHosts::Entry> SshKnownHosts::_entries(const KnownFile &known, const QByteArray &host)
+{
+    QList<Entry> entries = known.plain.value(host);
+
+    auto it = known.resolved.constFind(host);
+    if(it == known.resolved.constEnd())
+    {
+        QList<Entry> hashed;
+        for(const HashedEntry &h: known.hashed)
+        {
+            if(QMessageAuthenticationCode::hash(host, h.salt, QCryptographicHash::Sha1) == h.hash)
+                hashed.append(h.entry);
+        }
+        it = known.resolved.insert(host, hashed);
+    }
+    entries.append(*it);
+
+    for(const auto &pattern: known.patterns)
+    {
+        QRegularExpression re(QRegularExpression::wildcardToRegularExpression(QString::fromUtf8(pattern.first)));
+        if(re.match(QString::fromUtf8(host)).hasMatch())
+            entries.append(pattern.second);
+    }
+    return entries;
+}
+
+SshKnownHosts::Status SshKnownHosts::check(const QString &file, const QString &hostname, quint16 port, const QByteArray &key) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto known = m_files.constFind(file);
+    if(known == m_files.constEnd())
+    {
+        return NotFound;
+    }
+    const QList<Entry> entries = _entries(*known, _hostKey(hostname, port));
+    if(entries.isEmpty())
+    {
+        return NotFound;
+    }
+    for(const Entry &entry: entries)
+    {
+        if(entry.key == key)
+            return Match;
+    }
+    return Mismatch;
+}
+
+bool SshKnownHosts::add(const QString &file, const QString &hostname, quint16 port, const QByteArray &key)
+{
+    QByteArray type = keyType(key);
+    if(type.isEmpty())
+    {
+        return false;
+    }
+    QByteArray host = _hostKey(hostname, port);
+
+    QMutexLocker locker(&m_mutex);
+    KnownFile &known = m_files[file];
+    known.plain[host].append(Entry {type, key});
+    known.count++;
+    if(file.isEmpty())
+    {
+        return true;
+    }
+
+    QByteArray salt(HASHED_SALT_SIZE, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(salt.data()), HASHED_SALT_SIZE / sizeof(quint32));
+    QByteArray hash = QMessageAuthenticationCode::hash(host, salt, QCryptographicHash::Sha1);
+    QByteArray line = HASHED_HOST_MAGIC + salt.toBase64() + "|" + hash.toBase64() + " " + type + " " + key.toBase64() + "\n";
+
+    QFile f(file);
+    if(!f.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        qCWarning(logsshknownhosts) << "Can't append to" << file;
+        return false;
+    }
+    bool res = (f.write(line) == line.size());
+    f.close();
+
+    /* Our own line is already known, don't read it again */
+    QFileInfo info(file);
+    if(known.size + line.size() == info.size())
+    {
+        known.modified = info.lastModified();
+        known.size = info.size();
+    }
+    return res;
+}
+
+bool SshKnownHosts::save(const QString &file, const QString &source) const
+{
+    QMutexLocker locker(&m_mutex);
+    const KnownFile known = m_files.value(source.isEmpty() ? file : source);
+    QFile f(file);
+    if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    for(auto it = known.plain.constBegin(); it != known.plain.constEnd(); ++it)
+    {
+        for(const Entry &entry: it.value())
+            f.write(it.key() + " " + entry.type + " " + entry.key.toBase64() + "\n");
+    }
+    for(const HashedEntry &h: known.hashed)
+    {
+        f.write(HASHED_HOST_MAGIC + h.salt.toBase64() + "|" + h.hash.toBase64() + " " + h.entry.type + " " + h.entry.key.toBase64() + "\n");
+    }
+    for(const auto &pattern: known.patterns)
+    {
+        f.write(pattern.first + " " + pattern.second.type + " " + pattern.second.key.toBase64() + "\n");
+    }
+    return f.error() == QFile::NoError;
+}
+
+int SshKnownHosts::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    int count = 0;
+    for(const KnownFile &known: m_files)
+    {
+        count += known.count;
+    }
+    return count;
+}
+
+void SshKnownHosts::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_files.clear();
+}
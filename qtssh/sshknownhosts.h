@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QDateTime>
+#include <QByteArray>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(logsshknownhosts)
+
+/**
+ * \brief Process wide OpenSSH known_hosts store
+ * \details Files are memory mapped and parsed once, then only the lines
+ * appended by other processes are read again. Entries are indexed by host
+ * name ("[host]:port" for ports other than 22). Hashed entries (|1|salt|hash)
+ * have one salt each: the first check() of a name computes them all, the
+ * matches are remembered and the next checks are a lookup.
+ * add() appends a hashed line to the file instead of rewriting it.
+ * Entries stay indexed by the file they come from: a client only trusts
+ * the hosts of its own file, an empty name is the in-memory store.
+ */
+class SshKnownHosts
+{
+public:
+    enum Status {
+        Match,
+        Mismatch,
+        NotFound
+    };
+
+    SshKnownHosts(const SshKnownHosts &) = delete;
+    SshKnownHosts &operator=(const SshKnownHosts &) = delete;
+    static SshKnownHosts &instance();
+
+    /* Load file, or the lines added to it since the last call */
+    bool load(const QString &file);
+    /* Against the entries of file; key: host key blob, as given by libssh2_session_hostkey() */
+    Status check(const QString &file, const QString &hostname, quint16 port, const QByteArray &key) const;
+    /* Append to file if not empty, keep in memory only otherwise */
+    bool add(const QString &file, const QString &hostname, quint16 port, const QByteArray &key);
+    /* Write the entries of source (file itself if empty) in a new file */
+    bool save(const QString &file, const QString &source = QString()) const;
+    int count() const;
+    void clear();
+
+    /* Key type name ("ssh-rsa", "ssh-ed25519"...) read from a key blob */
+    static QByteArray keyType(const QByteArray &key);
+
+private:
+    struct Entry {
+        QByteArray type;
+        QByteArray key;
+    };
+    struct HashedEntry {
+        QByteArray salt;
+        QByteArray hash;
+        Entry entry;
+    };
+    struct KnownFile {
+        QDateTime modified;
+        qint64 size {0};
+        QHash<QByteArray, QList<Entry>> plain;
+        QList<HashedEntry> hashed;
+        QList<QPair<QByteArray, Entry>> patterns;
+        mutable QHash<QByteArray, QList<Entry>> resolved;
+        int count {0};
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, KnownFile> m_files;
+
+    SshKnownHosts() = default;
+    static void _parse(KnownFile &known, const char *data, qint64 size);
+    static void _parseLine(KnownFile &known, const QByteArray &line);
+    static QList<Entry> _entries(const KnownFile &known, const QByteArray &host);
+    static QByteArray _hostKey(const QString &hostname, quint16 port);
+};
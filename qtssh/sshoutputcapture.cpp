@@ -0,0 +1,229 @@
+#include "sshoutputcapture.h"
+#include <QTemporaryFile>
+#include <QDir>
+#include <cstring>
+
+SshOutputCapture::SshOutputCapture()
+{
+}
+
+SshOutputCapture::~SshOutputCapture()
+{
+}
+
+void SshOutputCapture::setLimit(Mode mode, qint64 limit, qint64 spillLimit)
+{
+    m_mode = mode;
+    m_limit = qMax<qint64>(limit, 0);
+    m_spillLimit = qMax<qint64>(spillLimit, 0);
+    clear();
+}
+
+void SshOutputCapture::setSpillDirectory(const QString &directory)
+{
+    m_spillDirectory = directory;
+}
+
+SshOutputCapture::Mode SshOutputCapture::mode() const
+{
+    return m_mode;
+}
+
+qint64 SshOutputCapture::limit() const
+{
+    return m_limit;
+}
+
+void SshOutputCapture::append(const char *data, qint64 length)
+{
+    if(length <= 0)
+    {
+        return;
+    }
+    m_total += length;
+
+    switch(m_mode)
+    {
+        case Unlimited:
+        {
+            m_head.append(data, static_cast<int>(length));
+            return;
+        }
+
+        case HeadTail:
+        {
+            qint64 headSize = m_limit / 2;
+            qint64 toHead = qMin(length, headSize - m_head.size());
+            if(toHead > 0)
+            {
+                m_head.append(data, static_cast<int>(toHead));
+                data += toHead;
+                length -= toHead;
+            }
+            _appendTail(data, length);
+            return;
+        }
+
+        case Spill:
+        {
+            if(!m_spillFile && m_head.size() + length <= m_limit)
+            {
+                m_head.append(data, static_cast<int>(length));
+                return;
+            }
+            if(!m_spillFile && !_spill())
+            {
+                m_dropped += length;
+                return;
+            }
+            qint64 room = (m_spillLimit > 0) ? qMax<qint64>(m_spillLimit - m_spilled, 0) : length;
+            qint64 toFile = qMin(length, room);
+            if(toFile > 0)
+            {
+                qint64 written = m_spillFile->write(data, toFile);
+                if(written < 0)
+                {
+                    m_errorString = m_spillFile->errorString();
+                    written = 0;
+                }
+                m_spilled += written;
+                m_dropped += toFile - written;
+            }
+            m_dropped += length - toFile;
+            return;
+        }
+    }
+}
+
+void SshOutputCapture::_appendTail(const char *data, qint64 length)
+{
+    qint64 capacity = m_limit - m_limit / 2;
+    if(length <= 0)
+    {
+        return;
+    }
+    if(capacity <= 0)
+    {
+        m_dropped += length;
+        return;
+    }
+    if(m_tail.size() != capacity)
+    {
+        m_tail.resize(static_cast<int>(capacity));
+    }
+
+    /* Oldest bytes of the tail are overwritten */
+    qint64 kept = qMin(length, capacity);
+    qint64 overwritten = (m_tailWrapped) ? kept : qMax<qint64>(m_tailPos + kept - capacity, 0);
+    m_dropped += (length - kept) + overwritten;
+    data += length - kept;
+    while(kept > 0)
+    {
+        qint64 chunk = qMin(kept, capacity - m_tailPos);
+        std::memcpy(m_tail.data() + m_tailPos, data, static_cast<size_t>(chunk));
+        data += chunk;
+        kept -= chunk;
+        m_tailPos += chunk;
+        if(m_tailPos == capacity)
+        {
+            m_tailPos = 0;
+            m_tailWrapped = true;
+        }
+    }
+}
+
+bool SshOutputCapture::_spill()
+{
+    QString directory = (m_spillDirectory.isEmpty()) ? QDir::tempPath() : m_spillDirectory;
+    m_spillFile.reset(new QTemporaryFile(directory + "/qtssh-output-XXXXXX"));
+    if(!m_spillFile->open())
+    {
+        m_errorString = m_spillFile->errorString();
+        m_spillFile.reset();
+        return false;
+    }
+    qint64 written = m_spillFile->write(m_head);
+    if(written != m_head.size())
+    {
+        m_errorString = m_spillFile->errorString();
+        m_spillFile.reset();
+        return false;
+    }
+    m_spilled = written;
+    m_head.clear();
+    m_head.squeeze();
+    return true;
+}
+
+void SshOutputCapture::clear()
+{
+    m_head.clear();
+    m_tail.clear();
+    m_tailPos = 0;
+    m_tailWrapped = false;
+    m_spillFile.reset();
+    m_spilled = 0;
+    m_total = 0;
+    m_dropped = 0;
+    m_errorString.clear();
+}
+
+QByteArray SshOutputCapture::data() const
+{
+    if(m_spillFile)
+    {
+        m_spillFile->flush();
+        QFile file(m_spillFile->fileName());
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return QByteArray();
+        }
+        return file.readAll();
+    }
+    if(m_tail.isEmpty())
+    {
+        return m_head;
+    }
+    QByteArray res = m_head;
+    if(m_tailWrapped)
+    {
+        res.append(m_tail.constData() + m_tailPos, static_cast<int>(m_tail.size() - m_tailPos));
+    }
+    res.append(m_tail.constData(), static_cast<int>(m_tailPos));
+    return res;
+}
+
+bool SshOutputCapture::isEmpty() const
+{
+    return m_total == 0;
+}
+
+qint64 SshOutputCapture::totalSize() const
+{
+    return m_total;
+}
+
+qint64 SshOutputCapture::droppedSize() const
+{
+    return m_dropped;
+}
+
+bool SshOutputCapture::isTruncated() const
+{
+    return m_dropped > 0;
+}
+
+bool SshOutputCapture::isSpilled() const
+{
+    return !m_spillFile.isNull();
+}
+
+QString SshOutputCapture::spillFileName() const
+{
+    return (m_spillFile) ? m_spillFile->fileName() : QString();
+}
+
+QString SshOutputCapture::errorString() const
+{
+    return m_errorString;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QScopedPointer>
+
+class QTemporaryFile;
+
+/*
+ * Collected output of one stream, bounded:
+ *  - Unlimited: everything in memory (default)
+ *  - HeadTail: the first and last limit/2 bytes, the middle is dropped
+ *  - Spill: limit bytes in memory, then all of it in a temporary file,
+ *    up to spillLimit bytes (0 for no limit) after which it is dropped
+ * isTruncated() tells if data() misses some of the received bytes.
+ */
+class SshOutputCapture
+{
+public:
+    enum Mode {
+        Unlimited,
+        HeadTail,
+        Spill
+    };
+
+    SshOutputCapture();
+    ~SshOutputCapture();
+    SshOutputCapture(const SshOutputCapture &) = delete;
+    SshOutputCapture &operator=(const SshOutputCapture &) = delete;
+
+    /* Set before the first append(), directory "" for QDir::tempPath() */
+    void setLimit(Mode mode, qint64 limit, qint64 spillLimit = 0);
+    void setSpillDirectory(const QString &directory);
+    Mode mode() const;
+    qint64 limit() const;
+
+    void append(const char *data, qint64 length);
+    void clear();
+
+    /* Whole capture: reads the spill file back, see spillFileName() */
+    QByteArray data() const;
+    bool isEmpty() const;
+
+    qint64 totalSize() const;       /* received */
+    qint64 droppedSize() const;     /* received but not kept */
+    bool isTruncated() const;
+    bool isSpilled() const;
+    QString spillFileName() const;
+    QString errorString() const;
+
+private:
+    void _appendTail(const char *data, qint64 length);
+    bool _spill();
+
+    Mode m_mode {Unlimited};
+    qint64 m_limit {0};
+    qint64 m_spillLimit {0};
+    QString m_spillDirectory;
+
+    QByteArray m_head;
+    QByteArray m_tail;
+    qint64 m_tailPos {0};
+    bool m_tailWrapped {false};
+
+    QScopedPointer<QTemporaryFile> m_spillFile;
+    qint64 m_spilled {0};
+    qint64 m_total {0};
+    qint64 m_dropped {0};
+    QString m_errorString;
+};
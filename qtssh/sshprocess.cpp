@@ -15,6 +15,11 @@ SshProcess::~SshProcess()
     qCDebug(sshchannel) << "free Channel:" << m_name;
 }
 
+LIBSSH2_CHANNEL *SshProcess::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
 void SshProcess::close()
 {
     setChannelState(ChannelState::Close);
@@ -23,12 +28,38 @@ void SshProcess::close()
 
 QByteArray SshProcess::result()
 {
-    return m_result;
+    return m_result.data();
+}
+
+QByteArray SshProcess::standardError()
+{
+    return m_errorOutput.data();
 }
 
 QStringList SshProcess::errMsg()
 {
-    return m_errMsg;
+    QStringList res = m_errMsg;
+    if(!m_errorOutput.isEmpty())
+    {
+        /* Single entry for the whole stderr, as bounded as its capture */
+        res.prepend(QString("Run command error: (%1)").arg(QString::fromUtf8(m_errorOutput.data())));
+    }
+    return res;
+}
+
+SshOutputCapture &SshProcess::capture(Stream stream)
+{
+    return (stream == StandardOutput) ? m_result : m_errorOutput;
+}
+
+const SshOutputCapture &SshProcess::capture(Stream stream) const
+{
+    return (stream == StandardOutput) ? m_result : m_errorOutput;
+}
+
+bool SshProcess::isTruncated() const
+{
+    return m_result.isTruncated() || m_errorOutput.isTruncated();
 }
 
 bool SshProcess::isError()
@@ -36,6 +67,187 @@ bool SshProcess::isError()
     return m_error;
 }
 
+void SshProcess::setStreaming(bool streaming)
+{
+    m_streaming = streaming;
+}
+
+bool SshProcess::isStreaming() const
+{
+    return m_streaming;
+}
+
+void SshProcess::setReadBufferSize(qint64 size)
+{
+    m_readBufferSize = size;
+}
+
+qint64 SshProcess::readBufferSize() const
+{
+    return m_readBufferSize;
+}
+
+QByteArray SshProcess::readAllStandardOutput()
+{
+    bool throttled = _readThrottled();
+    QByteArray res;
+    res.swap(m_stdout);
+    if(throttled)
+    {
+        QMetaObject::invokeMethod(this, "sshDataReceived", Qt::QueuedConnection);
+    }
+    return res;
+}
+
+QByteArray SshProcess::readAllStandardError()
+{
+    bool throttled = _readThrottled();
+    QByteArray res;
+    res.swap(m_stderr);
+    if(throttled)
+    {
+        QMetaObject::invokeMethod(this, "sshDataReceived", Qt::QueuedConnection);
+    }
+    return res;
+}
+
+qint64 SshProcess::bytesAvailableStandardOutput() const
+{
+    return m_stdout.size();
+}
+
+qint64 SshProcess::bytesAvailableStandardError() const
+{
+    return m_stderr.size();
+}
+
+qint64 SshProcess::write(const QByteArray &data)
+{
+    if(m_stdinClosed)
+    {
+        return -1;
+    }
+    m_stdin.append(data);
+    if(channelState() == ChannelState::Ready)
+    {
+        sshDataReceived();
+    }
+    return data.size();
+}
+
+qint64 SshProcess::bytesToWrite() const
+{
+    return m_stdin.size();
+}
+
+void SshProcess::closeWriteChannel()
+{
+    m_stdinClosed = true;
+    if(channelState() == ChannelState::Ready)
+    {
+        sshDataReceived();
+    }
+}
+
+int SshProcess::exitStatus() const
+{
+    return m_exitStatus;
+}
+
+QString SshProcess::exitSignal() const
+{
+    return m_exitSignal;
+}
+
+bool SshProcess::_readThrottled() const
+{
+    if(!m_streaming || m_readBufferSize <= 0)
+        return false;
+    return m_stdout.size() >= m_readBufferSize || m_stderr.size() >= m_readBufferSize;
+}
+
+ssize_t SshProcess::_readStream(int streamId)
+{
+    QByteArray &pending = (streamId == 0) ? m_stdout : m_stderr;
+    if(m_streaming && m_readBufferSize > 0 && pending.size() >= m_readBufferSize)
+    {
+        /* Not read, the channel window closes and the server waits */
+        return 0;
+    }
+
+    char buffer[16*1024];
+    ssize_t retsz = libssh2_channel_read_ex(m_sshChannel, streamId, buffer, sizeof(buffer));
+    if(retsz == LIBSSH2_ERROR_EAGAIN)
+    {
+        return 0;
+    }
+    if(retsz <= 0)
+    {
+        return retsz;
+    }
+
+    if(m_streaming)
+    {
+        pending.append(buffer, static_cast<int>(retsz));
+        if(streamId == 0)
+            emit readyReadStandardOutput();
+        else
+            emit readyReadStandardError();
+    }
+    else if(streamId == 0)
+    {
+        m_result.append(buffer, retsz);
+    }
+    else
+    {
+        if (!m_error)
+        {
+            m_error = true;
+            qCWarning(logsshprocess) << "Run command error";
+            emit failed();
+        }
+        m_errorOutput.append(buffer, retsz);
+    }
+    return retsz;
+}
+
+bool SshProcess::_writeStdin()
+{
+    while(!m_stdin.isEmpty())
+    {
+        ssize_t retsz = libssh2_channel_write_ex(m_sshChannel, 0, m_stdin.constData(), static_cast<size_t>(m_stdin.size()));
+        writeWindowUsed(m_sshChannel);
+        if(retsz == LIBSSH2_ERROR_EAGAIN)
+        {
+            return true;
+        }
+        if(retsz < 0)
+        {
+            if(!m_error)
+            {
+                m_error = true;
+                m_errMsg << QString("Can't write stdin (%1)").arg(sshErrorToString(static_cast<int>(retsz)));
+                emit failed();
+                qCWarning(logsshprocess) << "Can't write stdin (" << sshErrorToString(static_cast<int>(retsz)) << ")";
+            }
+            return false;
+        }
+        m_stdin.remove(0, static_cast<int>(retsz));
+        emit bytesWritten(retsz);
+    }
+
+    if(m_stdinClosed && !m_stdinEofSent)
+    {
+        int ret = libssh2_channel_send_eof(m_sshChannel);
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            return true;
+        }
+        m_stdinEofSent = true;
+    }
+    return true;
+}
+
 void SshProcess::runCommand(const QString &cmd)
 {
     m_cmd = cmd;
@@ -49,12 +261,12 @@ void SshProcess::sshDataReceived()
     {
         case Openning:
         {
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            if ( ! m_sshClient->acquireChannelOpen(this) )
             {
                 return;
             }
-            m_sshChannel = libssh2_channel_open_ex(m_sshClient->session(), "session", sizeof("session") - 1, LIBSSH2_CHANNEL_WINDOW_DEFAULT, LIBSSH2_CHANNEL_PACKET_DEFAULT, nullptr, 0);
-            m_sshClient->releaseChannelCreationMutex(this);
+            m_sshChannel = openChannel("session");
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
             if (m_sshChannel == nullptr)
             {
                 int ret = libssh2_session_last_error(m_sshClient->session(), nullptr, nullptr, 0);
@@ -108,66 +320,45 @@ void SshProcess::sshDataReceived()
 
         FALLTHROUGH; case Ready:
         {
-            ssize_t retsz;
-            char buffer[16*1024];
-
-            retsz = libssh2_channel_read_ex(m_sshChannel, 0, buffer, 16 * 1024);
-            if(retsz == LIBSSH2_ERROR_EAGAIN)
+            if(!_writeStdin())
             {
-                return;
-            }
-
-            if(retsz < 0)
-            {
-                if(!m_error)
-                {
-                    m_error = true;
-                    m_errMsg << QString("Can't read result (%1)").arg(sshErrorToString(static_cast<int>(retsz)));
-                    emit failed();
-                    qCWarning(logsshprocess) << "Can't read result (" << sshErrorToString(static_cast<int>(retsz)) << ")";
-                }
                 setChannelState(ChannelState::Close);
                 sshDataReceived();
                 return;
             }
 
-            m_result.append(buffer, static_cast<int>(retsz));
-
-            retsz = libssh2_channel_read_stderr(m_sshChannel, buffer, 16 * 1024);
-            if(retsz == LIBSSH2_ERROR_EAGAIN)
+            forever
             {
-                return;
-            }
-            if (retsz < 0)
-            {
-                if(!m_error)
+                ssize_t out = _readStream(0);
+                ssize_t err = (out < 0) ? 0 : _readStream(SSH_EXTENDED_DATA_STDERR);
+                if(out < 0 || err < 0)
                 {
-                    m_error = true;
-                    m_errMsg << QString("Can't read stderr msg (%1)").arg(sshErrorToString(static_cast<int>(retsz)));
-                    emit failed();
-                    qCWarning(logsshprocess) << "Can't read stderr msg (" << sshErrorToString(static_cast<int>(retsz)) << ")";
+                    int ret = static_cast<int>((out < 0) ? out : err);
+                    if(!m_error)
+                    {
+                        m_error = true;
+                        m_errMsg << QString("Can't read result (%1)").arg(sshErrorToString(ret));
+                        emit failed();
+                        qCWarning(logsshprocess) << "Can't read result (" << sshErrorToString(ret) << ")";
+                    }
+                    setChannelState(ChannelState::Close);
+                    sshDataReceived();
+                    return;
                 }
-                setChannelState(ChannelState::Close);
-                sshDataReceived();
-                return;
-            }
-            else if (retsz > 0)
-            {
-                if (!m_error)
+                if(out == 0 && err == 0)
                 {
-                    m_error = true;
-                    emit failed();
+                    break;
                 }
-                qCWarning(logsshprocess) << "Run command error";
-                m_errMsg << QString("Run command error: (%1)").arg(buffer);
             }
 
-            if (libssh2_channel_eof(m_sshChannel) == 1)
+            /* Data still waiting in the channel while the reader is late */
+            if(libssh2_channel_eof(m_sshChannel) != 1 || _readThrottled())
             {
-                qCDebug(logsshprocess) << "runCommand(" << m_cmd << ") RESULT: " << m_result;
-                setChannelState(ChannelState::Close);
-                emit finished();
+                return;
             }
+            qCDebug(logsshprocess) << "runCommand(" << m_cmd << ") RESULT: " << m_result.totalSize() << "bytes" << ((m_result.isTruncated()) ? "(truncated)" : "");
+            m_eofReceived = true;
+            setChannelState(ChannelState::Close);
         }
 
         FALLTHROUGH; case Close:
@@ -194,7 +385,7 @@ void SshProcess::sshDataReceived()
         FALLTHROUGH; case WaitClose:
         {
             qCDebug(logsshprocess) << "Wait close channel:" << m_name;
-            int ret = libssh2_channel_wait_closed(m_sshChannel);
+            int ret = skipWaitClosed() ? 0 : libssh2_channel_wait_closed(m_sshChannel);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
                 return;
@@ -209,6 +400,23 @@ void SshProcess::sshDataReceived()
                     qCWarning(logsshprocess) << "Failed to channel_wait_close: " << sshErrorToString(ret);
                 }
             }
+            else
+            {
+                m_exitStatus = libssh2_channel_get_exit_status(m_sshChannel);
+                char *signal = nullptr;
+                size_t signalLen = 0;
+                libssh2_channel_get_exit_signal(m_sshChannel, &signal, &signalLen, nullptr, nullptr, nullptr, nullptr);
+                if(signal)
+                {
+                    m_exitSignal = QString::fromUtf8(signal, static_cast<int>(signalLen));
+                    libssh2_free(m_sshClient->session(), signal);
+                }
+            }
+            if(m_eofReceived)
+            {
+                m_eofReceived = false;
+                emit finished();
+            }
             setChannelState(ChannelState::Freeing);
         }
 
@@ -240,7 +448,6 @@ void SshProcess::sshDataReceived()
                 setChannelState(ChannelState::Free);
             }
             m_sshChannel = nullptr;
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshProcess::sshDataReceived);
             return;
         }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "sshchannel.h"
+#include "sshoutputcapture.h"
 #include <QSemaphore>
 #include <QLoggingCategory>
 
@@ -13,14 +14,54 @@ class SshProcess : public SshChannel
 protected:
     explicit SshProcess(const QString &name, SshClient *client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
 
 public:
     virtual ~SshProcess() override;
     void close() override;
     QByteArray result();
+    QByteArray standardError();
     QStringList errMsg();
     bool isError();
 
+    /*
+     * Capture of result() and standardError() when not streaming, each
+     * one configured on its own before runCommand(): unlimited by default.
+     * isTruncated() once finished tells if something was dropped.
+     */
+    enum Stream {
+        StandardOutput,
+        StandardError
+    };
+    SshOutputCapture &capture(Stream stream);
+    const SshOutputCapture &capture(Stream stream) const;
+    bool isTruncated() const;
+
+    /*
+     * Streaming mode: stdout and stderr are delivered as they arrive with
+     * readyReadStandardOutput()/readyReadStandardError() instead of being
+     * collected in result(). The channel is not read anymore while more
+     * than readBufferSize() bytes are waiting, so the server is throttled
+     * by the SSH window. Set it before runCommand().
+     */
+    void setStreaming(bool streaming);
+    bool isStreaming() const;
+    void setReadBufferSize(qint64 size);
+    qint64 readBufferSize() const;
+    QByteArray readAllStandardOutput();
+    QByteArray readAllStandardError();
+    qint64 bytesAvailableStandardOutput() const;
+    qint64 bytesAvailableStandardError() const;
+
+    /* Standard input of the command */
+    qint64 write(const QByteArray &data);
+    qint64 bytesToWrite() const;
+    void closeWriteChannel();
+
+    /* Valid once finished() is emitted */
+    int exitStatus() const;
+    QString exitSignal() const;
+
 public slots:
     void runCommand(const QString &cmd);
     void sshDataReceived() override;
@@ -28,11 +69,30 @@ public slots:
 private:
     QString m_cmd;
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
-    QByteArray m_result;
+    SshOutputCapture m_result;
+    SshOutputCapture m_errorOutput;
     QStringList m_errMsg;
     bool m_error {false};
+    bool m_eofReceived {false};
+
+    bool m_streaming {false};
+    qint64 m_readBufferSize {1024*1024};
+    QByteArray m_stdout;
+    QByteArray m_stderr;
+    QByteArray m_stdin;
+    bool m_stdinClosed {false};
+    bool m_stdinEofSent {false};
+    int m_exitStatus {-1};
+    QString m_exitSignal;
+
+    ssize_t _readStream(int streamId);
+    bool _readThrottled() const;
+    bool _writeStdin();
 
 signals:
     void finished();
     void failed();
+    void readyReadStandardOutput();
+    void readyReadStandardError();
+    void bytesWritten(qint64 bytes);
 };
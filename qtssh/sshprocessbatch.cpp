@@ -0,0 +1,295 @@
+#include "sshprocessbatch.h"
+#include "sshclient.h"
+#include <QEventLoop>
+#include <QUuid>
+
+#define DEBUGB qCDebug(logsshprocess) << m_name
+
+SshProcessBatch::SshProcessBatch(SshClient *client, int channels, const QString &name, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_name(name)
+    , m_channels(qMax(1, channels))
+    , m_marker("__QTSSH_" + QUuid::createUuid().toByteArray().toHex())
+{
+}
+
+SshProcessBatch::~SshProcessBatch()
+{
+    for(Worker &worker: m_workers)
+    {
+        if(worker.proc)
+        {
+            QObject::disconnect(worker.proc, nullptr, this, nullptr);
+            worker.proc->closeWriteChannel();
+        }
+    }
+}
+
+int SshProcessBatch::channels() const
+{
+    return m_channels;
+}
+
+int SshProcessBatch::pipelineDepth() const
+{
+    return m_pipelineDepth;
+}
+
+void SshProcessBatch::setPipelineDepth(int depth)
+{
+    m_pipelineDepth = qMax(1, depth);
+}
+
+int SshProcessBatch::addCommand(const QString &command)
+{
+    m_results.append(Result {command, QByteArray(), QByteArray(), -1, false});
+    if(m_started)
+    {
+        _dispatch();
+    }
+    return m_results.size() - 1;
+}
+
+void SshProcessBatch::start()
+{
+    if(m_started)
+        return;
+    m_started = true;
+    DEBUGB << "start" << m_results.size() << "commands on" << qMin(m_channels, m_results.size()) << "channels";
+    _dispatch();
+    if(isFinished())
+        emit finished();
+}
+
+bool SshProcessBatch::waitForFinished()
+{
+    start();
+    QEventLoop wait(this);
+    bool disconnected = false;
+    QObject::connect(this, &SshProcessBatch::finished, &wait, &QEventLoop::quit);
+    QObject::connect(m_client, &SshClient::sshDisconnected, &wait, [&wait, &disconnected](){
+        disconnected = true;
+        wait.quit();
+    });
+    while(!isFinished() && !disconnected)
+    {
+        wait.exec();
+    }
+    if(!isFinished())
+        return false;
+    for(const Result &result: m_results)
+    {
+        if(result.exitCode != 0)
+            return false;
+    }
+    return true;
+}
+
+bool SshProcessBatch::isFinished() const
+{
+    return m_finished == m_results.size();
+}
+
+int SshProcessBatch::count() const
+{
+    return m_results.size();
+}
+
+SshProcessBatch::Result SshProcessBatch::result(int index) const
+{
+    return m_results.value(index);
+}
+
+const QList<SshProcessBatch::Result> &SshProcessBatch::results() const
+{
+    return m_results;
+}
+
+void SshProcessBatch::_dispatch()
+{
+    /* Running shells take the commands first */
+    for(int i = 0; i < m_workers.size() && m_next < m_results.size(); ++i)
+    {
+        _feed(i);
+    }
+
+    /* Then new shells, in the slots of the closed ones or up to channels() */
+    for(int i = 0; i < m_workers.size() && m_next < m_results.size(); ++i)
+    {
+        if(!m_workers[i].proc)
+            _startWorker(i);
+    }
+    while(m_workers.size() < m_channels && m_next < m_results.size())
+    {
+        m_workers.append(Worker {nullptr, {}, {}, {}, -1, -1, false});
+        _startWorker(m_workers.size() - 1);
+    }
+}
+
+void SshProcessBatch::_startWorker(int worker)
+{
+    Worker &w = m_workers[worker];
+    w.inflight.clear();
+    w.out.clear();
+    w.err.clear();
+    w.outDone = -1;
+    w.errDone = -1;
+    w.inputClosed = false;
+    if(m_next >= m_results.size())
+        return;
+
+    w.proc = m_client->getChannel<SshProcess>(QString("%1_%2").arg(m_name).arg(m_shellId++));
+    w.proc->setStreaming(true);
+    QObject::connect(w.proc, &SshProcess::readyReadStandardOutput, this, [this, worker](){ _readOutput(worker); });
+    QObject::connect(w.proc, &SshProcess::readyReadStandardError, this, [this, worker](){ _readError(worker); });
+    QObject::connect(w.proc, &SshProcess::finished, this, [this, worker](){ _workerClosed(worker); });
+    QObject::connect(w.proc, &SshProcess::failed, this, [this, worker](){ _workerClosed(worker); });
+    /* Gone with the session, without finished() nor failed() */
+    QObject::connect(w.proc, &QObject::destroyed, this, [this, worker](){ _workerClosed(worker); });
+    QObject::connect(w.proc, &SshChannel::stateChanged, this, [this, worker](SshChannel::ChannelState state){
+        if(state == SshChannel::ChannelState::Error)
+            _workerClosed(worker);
+    });
+    w.proc->runCommand("sh");
+    _feed(worker);
+}
+
+void SshProcessBatch::_feed(int worker)
+{
+    Worker &w = m_workers[worker];
+    if(!w.proc || w.inputClosed || w.proc->channelState() > SshChannel::ChannelState::Ready)
+        return;
+
+    QByteArray script;
+    while(w.inflight.size() < m_pipelineDepth && m_next < m_results.size())
+    {
+        int index = m_next++;
+        w.inflight.append(index);
+        script += "{ " + m_results[index].command.toUtf8() + "\n} </dev/null; "
+                + "printf '\\n%s:%d:%d\\n' " + m_marker + " " + QByteArray::number(index) + " $?; "
+                + "printf '\\n%s:%d\\n' " + m_marker + " " + QByteArray::number(index) + " >&2\n";
+    }
+    if(!script.isEmpty())
+    {
+        w.proc->write(script);
+    }
+    if(w.inflight.isEmpty())
+    {
+        /* Nothing more to run, let the shell exit */
+        w.inputClosed = true;
+        w.proc->closeWriteChannel();
+    }
+}
+
+void SshProcessBatch::_readOutput(int worker)
+{
+    Worker &w = m_workers[worker];
+    w.out += w.proc->readAllStandardOutput();
+
+    /* Output of the running command ends with "\n<marker>:<index>:<code>\n" */
+    QByteArray tag = "\n" + m_marker + ":";
+    forever
+    {
+        if(w.inflight.isEmpty() || w.outDone >= 0)
+            return;
+        int pos = w.out.indexOf(tag);
+        if(pos < 0)
+            return;
+        int end = w.out.indexOf('\n', pos + tag.size());
+        if(end < 0)
+            return;
+        QList<QByteArray> fields = w.out.mid(pos + tag.size(), end - pos - tag.size()).split(':');
+        int index = w.inflight.first();
+        m_results[index].output = w.out.left(pos);
+        m_results[index].exitCode = fields.value(1).toInt();
+        w.out.remove(0, end + 1);
+        w.outDone = index;
+        _complete(worker);
+    }
+}
+
+void SshProcessBatch::_readError(int worker)
+{
+    Worker &w = m_workers[worker];
+    w.err += w.proc->readAllStandardError();
+
+    QByteArray tag = "\n" + m_marker + ":";
+    forever
+    {
+        if(w.inflight.isEmpty() || w.errDone >= 0)
+            return;
+        int pos = w.err.indexOf(tag);
+        if(pos < 0)
+            return;
+        int end = w.err.indexOf('\n', pos + tag.size());
+        if(end < 0)
+            return;
+        int index = w.inflight.first();
+        m_results[index].errorOutput = w.err.left(pos);
+        w.err.remove(0, end + 1);
+        w.errDone = index;
+        _complete(worker);
+    }
+}
+
+void SshProcessBatch::_complete(int worker)
+{
+    Worker &w = m_workers[worker];
+    if(w.inflight.isEmpty() || w.outDone != w.inflight.first() || w.errDone != w.inflight.first())
+        return;
+
+    int index = w.inflight.takeFirst();
+    w.outDone = -1;
+    w.errDone = -1;
+    m_results[index].finished = true;
+    ++m_finished;
+    emit commandFinished(index, m_results[index].exitCode);
+
+    _feed(worker);
+    if(isFinished())
+    {
+        DEBUGB << "all commands done";
+        emit finished();
+        return;
+    }
+
+    /* The next markers may already be buffered */
+    _readOutput(worker);
+    _readError(worker);
+}
+
+void SshProcessBatch::_workerClosed(int worker)
+{
+    Worker &w = m_workers[worker];
+    if(w.proc)
+    {
+        QObject::disconnect(w.proc, nullptr, this, nullptr);
+    }
+    w.proc = nullptr;
+    if(w.inflight.isEmpty())
+    {
+        /* Commands added while this shell was exiting */
+        if(m_next < m_results.size())
+            _dispatch();
+        return;
+    }
+
+    /* The shell died (exit in a command, channel error): fail its commands */
+    for(int index: w.inflight)
+    {
+        DEBUGB << "command failed:" << m_results[index].command;
+        m_results[index].exitCode = -1;
+        m_results[index].finished = true;
+        ++m_finished;
+        emit commandFinished(index, -1);
+    }
+    w.inflight.clear();
+
+    if(isFinished())
+    {
+        emit finished();
+        return;
+    }
+    _startWorker(worker);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QByteArray>
+#include <QStringList>
+#include "sshprocess.h"
+
+class SshClient;
+
+/**
+ * \brief Run many short commands over a few long lived shells
+ * \details Each of the channels() session channels runs one remote shell.
+ * Commands are written to its standard input, several in advance, and the
+ * shell prints a marker with the exit code after each of them, so one
+ * channel setup is shared by the whole batch. Every command runs with its
+ * standard input redirected from /dev/null.
+ */
+class SshProcessBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        QString command;
+        QByteArray output;
+        QByteArray errorOutput;
+        int exitCode;
+        bool finished;
+    };
+
+private:
+    struct Worker {
+        QPointer<SshProcess> proc;
+        QList<int> inflight;
+        QByteArray out;
+        QByteArray err;
+        int outDone;
+        int errDone;
+        bool inputClosed;
+    };
+
+    SshClient *m_client;
+    QString m_name;
+    int m_channels;
+    int m_pipelineDepth {4};
+    QByteArray m_marker;
+    QList<Result> m_results;
+    QList<Worker> m_workers;
+    int m_next {0};
+    int m_finished {0};
+    int m_shellId {0};
+    bool m_started {false};
+
+    void _dispatch();
+    void _startWorker(int worker);
+    void _feed(int worker);
+    void _readOutput(int worker);
+    void _readError(int worker);
+    void _complete(int worker);
+    void _workerClosed(int worker);
+
+public:
+    explicit SshProcessBatch(SshClient *client, int channels = 4, const QString &name = "batch", QObject *parent = nullptr);
+    virtual ~SshProcessBatch() override;
+
+    int channels() const;
+    int pipelineDepth() const;
+    void setPipelineDepth(int depth);
+
+    int addCommand(const QString &command);
+    void start();
+    bool waitForFinished();
+    bool isFinished() const;
+
+    int count() const;
+    Result result(int index) const;
+    const QList<Result> &results() const;
+
+signals:
+    void commandFinished(int index, int exitCode);
+    void finished();
+};
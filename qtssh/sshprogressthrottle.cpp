@@ -0,0 +1,44 @@
+#include "sshprogressthrottle.h"
+
+qint64 SshProgressThrottle::step() const
+{
+    return m_step;
+}
+
+void SshProgressThrottle::setStep(qint64 bytes)
+{
+    m_step = bytes;
+}
+
+int SshProgressThrottle::interval() const
+{
+    return m_interval;
+}
+
+void SshProgressThrottle::setInterval(int msec)
+{
+    m_interval = msec;
+}
+
+void SshProgressThrottle::reset()
+{
+    m_last = -1;
+}
+
+bool SshProgressThrottle::update(qint64 done, qint64 total)
+{
+    bool notify = (m_last < 0 || done == total);
+    if(m_step <= 0 && m_interval <= 0)
+        notify = true;
+    if(m_step > 0 && done - m_last >= m_step)
+        notify = true;
+    if(m_interval > 0 && m_timer.isValid() && m_timer.elapsed() >= m_interval)
+        notify = true;
+
+    if(notify)
+    {
+        m_last = done;
+        m_timer.start();
+    }
+    return notify;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QElapsedTimer>
+
+/**
+ * \brief Coalesce progress notifications of a transfer
+ * \details update() returns true when a progress signal should be sent:
+ * once the transfer advanced by step() bytes or interval() milliseconds
+ * elapsed since the last one, and always for the first and last update.
+ * A step or an interval of 0 disables the criterion.
+ */
+class SshProgressThrottle
+{
+    qint64 m_step {0};
+    int m_interval {100};
+    qint64 m_last {-1};
+    QElapsedTimer m_timer;
+
+public:
+    qint64 step() const;
+    void setStep(qint64 bytes);
+    int interval() const;
+    void setInterval(int msec);
+
+    void reset();
+    bool update(qint64 done, qint64 total);
+};
@@ -0,0 +1,88 @@
+#include "sshratelimiter.h"
+#include <cmath>
+
+void SshRateLimiter::setRate(quint64 bytesPerSecond, quint64 burst)
+{
+    if(!m_clock.isValid())
+    {
+        m_clock.start();
+    }
+    _refill();
+    bool wasLimited = isLimited();
+    m_rate = bytesPerSecond;
+    m_burst = (burst) ? burst : bytesPerSecond;
+    if(!wasLimited)
+    {
+        /* Start with a full bucket */
+        m_tokens = static_cast<double>(m_burst);
+    }
+    m_tokens = qMin(m_tokens, static_cast<double>(m_burst));
+}
+
+quint64 SshRateLimiter::rate() const
+{
+    return m_rate;
+}
+
+quint64 SshRateLimiter::burst() const
+{
+    return m_burst;
+}
+
+bool SshRateLimiter::isLimited() const
+{
+    return m_rate > 0;
+}
+
+void SshRateLimiter::_refill()
+{
+    if(!m_clock.isValid())
+    {
+        return;
+    }
+    qint64 now = m_clock.elapsed();
+    if(isLimited())
+    {
+        m_tokens = qMin(m_tokens + static_cast<double>(m_rate) * static_cast<double>(now - m_last) / 1000.0,
+                        static_cast<double>(m_burst));
+    }
+    m_last = now;
+}
+
+size_t SshRateLimiter::available(size_t wanted)
+{
+    if(!isLimited())
+    {
+        return wanted;
+    }
+    _refill();
+    if(m_tokens < 1.0)
+    {
+        return 0;
+    }
+    return qMin(wanted, static_cast<size_t>(m_tokens));
+}
+
+void SshRateLimiter::consume(size_t bytes)
+{
+    if(isLimited())
+    {
+        m_tokens -= static_cast<double>(bytes);
+    }
+}
+
+int SshRateLimiter::delay()
+{
+    if(!isLimited())
+    {
+        return 0;
+    }
+    _refill();
+    /* Wait for a few packets worth of tokens, not for every byte */
+    double need = qMin(static_cast<double>(m_burst), 4096.0) - m_tokens;
+    if(need <= 0)
+    {
+        return 0;
+    }
+    return static_cast<int>(std::ceil(need * 1000.0 / static_cast<double>(m_rate)));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+/**
+ * \brief Token bucket limiting a write rate
+ * \details Tokens are bytes, refilled at rate() per second up to burst().
+ * consume() may overdraw the bucket (writes larger than granted), the
+ * debt is paid back before the next grant. A rate of 0 means unlimited.
+ */
+class SshRateLimiter
+{
+    quint64 m_rate {0};
+    quint64 m_burst {0};
+    double m_tokens {0};
+    qint64 m_last {0};
+    QElapsedTimer m_clock;
+
+    void _refill();
+
+public:
+    /* burst 0: one second of traffic */
+    void setRate(quint64 bytesPerSecond, quint64 burst = 0);
+    quint64 rate() const;
+    quint64 burst() const;
+    bool isLimited() const;
+
+    /* Bytes that can be written now */
+    size_t available(size_t wanted);
+    void consume(size_t bytes);
+    /* Milliseconds until some bytes can be written */
+    int delay();
+};
@@ -0,0 +1,107 @@
+#include "sshringbuffer.h"
+#include "sshbufferpool.h"
+#include <QtGlobal>
+
+SshRingBuffer::SshRingBuffer(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+SshRingBuffer::~SshRingBuffer()
+{
+    release();
+}
+
+size_t SshRingBuffer::size() const
+{
+    return m_size;
+}
+
+size_t SshRingBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+size_t SshRingBuffer::freeSpace() const
+{
+    return m_capacity - m_size;
+}
+
+bool SshRingBuffer::isEmpty() const
+{
+    return m_size == 0;
+}
+
+bool SshRingBuffer::isFull() const
+{
+    return m_size == m_capacity;
+}
+
+bool SshRingBuffer::setCapacity(size_t capacity)
+{
+    if(m_size != 0)
+        return false;
+    release();
+    m_capacity = capacity;
+    return true;
+}
+
+const char *SshRingBuffer::readPointer() const
+{
+    return m_data + m_head;
+}
+
+size_t SshRingBuffer::readSize() const
+{
+    return qMin(m_size, m_capacity - m_head);
+}
+
+void SshRingBuffer::consume(size_t len)
+{
+    Q_ASSERT(len <= readSize());
+    m_head += len;
+    m_size -= len;
+    if(m_head == m_capacity || m_size == 0)
+    {
+        /* Wrap, or rewind to get the largest contiguous free area */
+        m_head = 0;
+    }
+}
+
+char *SshRingBuffer::writePointer()
+{
+    if(m_data == nullptr)
+    {
+        m_data = SshBufferPool::instance().acquire(m_capacity);
+    }
+    return m_data + ((m_head + m_size) % m_capacity);
+}
+
+size_t SshRingBuffer::writeSize() const
+{
+    if(m_size == m_capacity)
+        return 0;
+    size_t tail = (m_head + m_size) % m_capacity;
+    if(tail >= m_head)
+        return m_capacity - tail;
+    return m_head - tail;
+}
+
+void SshRingBuffer::commit(size_t len)
+{
+    Q_ASSERT(len <= writeSize());
+    m_size += len;
+}
+
+void SshRingBuffer::clear()
+{
+    m_head = 0;
+    m_size = 0;
+}
+
+void SshRingBuffer::release()
+{
+    clear();
+    SshBufferPool::instance().release(m_data, m_capacity);
+    m_data = nullptr;
+}
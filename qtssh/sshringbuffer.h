@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * \brief Circular byte buffer used by tunnels to pipeline transfers
+ * \details Data is written and read from contiguous areas given by
+ * writePointer()/writeSize() and readPointer()/readSize(), so callers
+ * can read a socket or a channel directly inside the buffer.
+ * Storage is borrowed from SshBufferPool on first write and can be
+ * given back with release() when empty.
+ */
+class SshRingBuffer
+{
+    char *m_data {nullptr};
+    size_t m_capacity {0};
+    size_t m_head {0};
+    size_t m_size {0};
+
+public:
+    explicit SshRingBuffer(size_t capacity);
+    ~SshRingBuffer();
+    SshRingBuffer(const SshRingBuffer &) = delete;
+    SshRingBuffer &operator=(const SshRingBuffer &) = delete;
+
+    size_t size() const;
+    size_t capacity() const;
+    size_t freeSpace() const;
+    bool isEmpty() const;
+    bool isFull() const;
+    bool setCapacity(size_t capacity);
+
+    /* Contiguous data available for reading */
+    const char *readPointer() const;
+    size_t readSize() const;
+    void consume(size_t len);
+
+    /* Contiguous free space available for writing */
+    char *writePointer();
+    size_t writeSize() const;
+    void commit(size_t len);
+
+    void clear();
+    void release();
+};
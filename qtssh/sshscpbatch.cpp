@@ -0,0 +1,272 @@
+#include "sshscpbatch.h"
+#include "sshclient.h"
+#include "sshscpget.h"
+#include "sshscpsend.h"
+#include <QEventLoop>
+#include <QFileInfo>
+
+Q_LOGGING_CATEGORY(logscpbatch, "ssh.scpbatch", QtWarningMsg)
+
+SshScpBatch::SshScpBatch(SshClient *client, const QString &name, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_name(name)
+{
+}
+
+SshScpBatch::~SshScpBatch()
+{
+    abort();
+}
+
+void SshScpBatch::setMaxChannels(int max)
+{
+    m_maxChannels = qMax(1, max);
+    if(m_started)
+    {
+        _startNext();
+    }
+}
+
+int SshScpBatch::maxChannels() const
+{
+    return m_maxChannels;
+}
+
+int SshScpBatch::addGet(const QString &source, const QString &dest)
+{
+    return _add(false, source, dest);
+}
+
+int SshScpBatch::addSend(const QString &source, const QString &dest)
+{
+    return _add(true, source, dest);
+}
+
+int SshScpBatch::_add(bool send, const QString &source, const QString &dest)
+{
+    Item item {send, source, dest, -1, 0, Pending, nullptr};
+    if(send)
+    {
+        QFileInfo info(source);
+        if(info.isFile())
+        {
+            item.size = info.size();
+            m_bytesTotal += item.size;
+        }
+    }
+    m_items.append(item);
+    if(m_started && !m_finished)
+    {
+        _startNext();
+    }
+    return m_items.size() - 1;
+}
+
+void SshScpBatch::start()
+{
+    if(m_started)
+        return;
+    m_started = true;
+    qCDebug(logscpbatch) << m_name << "start" << m_items.size() << "files," << m_maxChannels << "channels";
+    _startNext();
+}
+
+void SshScpBatch::abort()
+{
+    for(int i = 0; i < m_items.size(); ++i)
+    {
+        Item &item = m_items[i];
+        if(item.state == Pending || item.state == Running)
+        {
+            if(item.channel)
+            {
+                QObject::disconnect(item.channel, nullptr, this, nullptr);
+                item.channel->close();
+            }
+            if(item.state == Running)
+                m_running--;
+            item.state = Failed;
+            m_failed++;
+        }
+    }
+    m_next = m_items.size();
+    if(m_started && !m_finished)
+    {
+        m_errMsg << "Aborted";
+        _finish();
+    }
+}
+
+bool SshScpBatch::waitForFinished()
+{
+    QEventLoop wait(this);
+    bool disconnected = false;
+    QObject::connect(this, &SshScpBatch::finished, &wait, &QEventLoop::quit);
+    QObject::connect(m_client, &SshClient::sshDisconnected, &wait, [&wait, &disconnected](){
+        disconnected = true;
+        wait.quit();
+    });
+    while(m_started && !m_finished && !disconnected)
+    {
+        wait.exec();
+    }
+    return m_finished && m_failed == 0;
+}
+
+bool SshScpBatch::isRunning() const
+{
+    return m_started && !m_finished;
+}
+
+bool SshScpBatch::isFinished() const
+{
+    return m_finished;
+}
+
+bool SshScpBatch::isError() const
+{
+    return m_failed > 0;
+}
+
+QStringList SshScpBatch::errMsg() const
+{
+    return m_errMsg;
+}
+
+int SshScpBatch::fileCount() const
+{
+    return m_items.size();
+}
+
+int SshScpBatch::completedCount() const
+{
+    return m_completed;
+}
+
+int SshScpBatch::failedCount() const
+{
+    return m_failed;
+}
+
+qint64 SshScpBatch::bytesDone() const
+{
+    return m_bytesDone;
+}
+
+qint64 SshScpBatch::bytesTotal() const
+{
+    return m_bytesTotal;
+}
+
+void SshScpBatch::_startNext()
+{
+    while(m_running < m_maxChannels && m_next < m_items.size())
+    {
+        int index = m_next++;
+        /* Numbered by the client: batches of the same name don't share channels */
+        QString name = QString("%1_%2").arg(m_name).arg(m_client->nextChannelId());
+        const QString source = m_items[index].source;
+        const QString dest = m_items[index].dest;
+        m_items[index].state = Running;
+        m_running++;
+        emit fileStarted(index, source, dest);
+        qCDebug(logscpbatch) << m_name << "start" << source << "->" << dest << "on" << name;
+
+        /* A channel failing at once calls _fileDone() from send() or get() */
+        auto watch = [this, index](SshChannel *channel){
+            /* Gone with the session, without finished() nor failed() */
+            QObject::connect(channel, &QObject::destroyed, this, [this, index](){ _fileDone(index, false); });
+            QObject::connect(channel, &SshChannel::stateChanged, this, [this, index](SshChannel::ChannelState state){
+                if(state == SshChannel::ChannelState::Error)
+                    _fileDone(index, false);
+            });
+        };
+        if(m_items[index].send)
+        {
+            SshScpSend *channel = m_client->getChannel<SshScpSend>(name);
+            m_items[index].channel = channel;
+            QObject::connect(channel, &SshScpSend::progress, this, [this, index](qint64 done, qint64 total){ _fileProgress(index, done, total); });
+            QObject::connect(channel, &SshScpSend::finished, this, [this, index](){ _fileDone(index, true); });
+            QObject::connect(channel, &SshScpSend::failed, this, [this, index](){ _fileDone(index, false); });
+            watch(channel);
+            channel->send(source, dest);
+        }
+        else
+        {
+            SshScpGet *channel = m_client->getChannel<SshScpGet>(name);
+            m_items[index].channel = channel;
+            QObject::connect(channel, &SshScpGet::progress, this, [this, index](qint64 done, qint64 total){ _fileProgress(index, done, total); });
+            QObject::connect(channel, &SshScpGet::finished, this, [this, index](){ _fileDone(index, true); });
+            QObject::connect(channel, &SshScpGet::failed, this, [this, index](){ _fileDone(index, false); });
+            watch(channel);
+            channel->get(source, dest);
+        }
+    }
+    if(m_started && !m_finished && m_running == 0 && m_next >= m_items.size())
+    {
+        _finish();
+    }
+}
+
+void SshScpBatch::_fileProgress(int index, qint64 done, qint64 total)
+{
+    Item &item = m_items[index];
+    if(item.state != Running)
+        return;
+    if(item.size < 0 && total >= 0)
+    {
+        item.size = total;
+        m_bytesTotal += total;
+    }
+    m_bytesDone += done - item.done;
+    item.done = done;
+    emit fileProgress(index, done, total);
+    emit progress(m_bytesDone, m_bytesTotal);
+}
+
+void SshScpBatch::_fileDone(int index, bool ok)
+{
+    Item &item = m_items[index];
+    if(item.state != Running)
+        return;
+
+    /* The channel goes on closing by itself, it is not ours anymore */
+    if(item.channel)
+    {
+        QObject::disconnect(item.channel, nullptr, this, nullptr);
+    }
+    item.channel = nullptr;
+    m_running--;
+    if(ok)
+    {
+        item.state = Done;
+        m_completed++;
+        if(item.size >= 0)
+        {
+            m_bytesDone += item.size - item.done;
+            item.done = item.size;
+        }
+    }
+    else
+    {
+        item.state = Failed;
+        m_failed++;
+        m_errMsg << QString("SCP %1 of %2 failed").arg(item.send ? "send" : "get", item.source);
+    }
+    qCDebug(logscpbatch) << m_name << item.source << (ok ? "done" : "failed") << m_completed + m_failed << "/" << m_items.size();
+    emit fileFinished(index, ok);
+    emit progress(m_bytesDone, m_bytesTotal);
+
+    /* Next file set up outside of the finishing channel state machine */
+    QMetaObject::invokeMethod(this, [this](){ _startNext(); }, Qt::QueuedConnection);
+}
+
+void SshScpBatch::_finish()
+{
+    m_finished = true;
+    qCDebug(logscpbatch) << m_name << "finished," << m_completed << "done" << m_failed << "failed";
+    if(m_failed > 0)
+        emit failed();
+    emit finished();
+}
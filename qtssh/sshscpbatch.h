@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QList>
+#include <QLoggingCategory>
+
+class SshClient;
+class SshChannel;
+
+Q_DECLARE_LOGGING_CATEGORY(logscpbatch)
+
+/**
+ * \brief Several files copied with SCP, a bounded number of channels at once
+ * \details Each file still takes its own SCP channel, as scp does, but up
+ * to maxChannels() run together. The next file starts as soon as one is
+ * transferred, while the finished channel is still closing, so channel
+ * setup and teardown overlap with data. For hosts where SFTP is not
+ * available; the transfer succeeds when every file does.
+ */
+class SshScpBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshScpBatch(SshClient *client, const QString &name = "scpbatch", QObject *parent = nullptr);
+    virtual ~SshScpBatch() override;
+
+    void setMaxChannels(int max);
+    int maxChannels() const;
+
+    /* Queued files, index in the signals; can be added while running */
+    int addGet(const QString &source, const QString &dest);
+    int addSend(const QString &source, const QString &dest);
+
+    void start();
+    void abort();
+    bool waitForFinished();
+
+    bool isRunning() const;
+    bool isFinished() const;
+    bool isError() const;
+    QStringList errMsg() const;
+
+    int fileCount() const;
+    int completedCount() const;
+    int failedCount() const;
+
+    /* Bytes copied, out of the sizes known yet (gets learn it when opened) */
+    qint64 bytesDone() const;
+    qint64 bytesTotal() const;
+
+signals:
+    void fileStarted(int index, const QString &source, const QString &dest);
+    void fileProgress(int index, qint64 done, qint64 total);
+    void fileFinished(int index, bool ok);
+    void progress(qint64 done, qint64 total);
+    void finished();
+    void failed();
+
+private:
+    enum ItemState {
+        Pending,
+        Running,
+        Done,
+        Failed
+    };
+    struct Item {
+        bool send;
+        QString source;
+        QString dest;
+        qint64 size;
+        qint64 done;
+        ItemState state;
+        QPointer<SshChannel> channel;
+    };
+
+    SshClient *m_client;
+    QString m_name;
+    int m_maxChannels {4};
+    QList<Item> m_items;
+    int m_next {0};
+    int m_running {0};
+    int m_completed {0};
+    int m_failed {0};
+    qint64 m_bytesDone {0};
+    qint64 m_bytesTotal {0};
+    bool m_started {false};
+    bool m_finished {false};
+    QStringList m_errMsg;
+
+    int _add(bool send, const QString &source, const QString &dest);
+    void _startNext();
+    void _fileProgress(int index, qint64 done, qint64 total);
+    void _fileDone(int index, bool ok);
+    void _finish();
+};
@@ -1,12 +1,9 @@
 #include "sshscpget.h"
 #include "sshclient.h"
+#include "sshbufferpool.h"
 #include <QFileInfo>
 #include <qdebug.h>
 
-#ifndef PAGE_SIZE
-#define PAGE_SIZE (4*1024)
-#endif
-
 Q_LOGGING_CATEGORY(logscpget, "ssh.scpget", QtWarningMsg)
 
 SshScpGet::SshScpGet(const QString &name, SshClient *client):
@@ -17,6 +14,12 @@ SshScpGet::SshScpGet(const QString &name, SshClient *client):
 SshScpGet::~SshScpGet()
 {
     qCDebug(logscpget) << "free Channel:" << m_name;
+    SshBufferPool::instance().release(m_buffer, SCP_BUFFER_SIZE);
+}
+
+LIBSSH2_CHANNEL *SshScpGet::dispatchChannel() const
+{
+    return m_sshChannel;
 }
 
 void SshScpGet::close()
@@ -25,6 +28,67 @@ void SshScpGet::close()
     sshDataReceived();
 }
 
+void SshScpGet::setKeepPartial(bool keep)
+{
+    m_keepPartial = keep;
+}
+
+void SshScpGet::setMemoryMapped(bool enable)
+{
+    m_mapped = enable;
+}
+
+SshProgressThrottle &SshScpGet::progressThrottle()
+{
+    return m_progress;
+}
+
+bool SshScpGet::_nextWindow()
+{
+    qint64 remaining = m_fileinfo.st_size - m_got;
+    m_windowFill = 0;
+    if(m_mapped)
+    {
+        m_windowSize = qMin(remaining, static_cast<qint64>(SCP_MAP_WINDOW));
+        m_map = m_file.map(m_got, m_windowSize);
+        if(m_map)
+        {
+            m_window = reinterpret_cast<char *>(m_map);
+            return true;
+        }
+        qCDebug(logscpget) << m_name << "Can't map destination file, use buffered writes";
+        m_mapped = false;
+        m_file.resize(m_got);
+        m_file.seek(m_got);
+    }
+
+    if(m_buffer == nullptr)
+    {
+        m_buffer = SshBufferPool::instance().acquire(SCP_BUFFER_SIZE);
+    }
+    m_window = m_buffer;
+    m_windowSize = qMin(remaining, static_cast<qint64>(SCP_BUFFER_SIZE));
+    return true;
+}
+
+bool SshScpGet::_flushWindow()
+{
+    bool ok = true;
+    if(m_map)
+    {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    else if(m_window && m_windowFill > 0)
+    {
+        ok = (m_file.write(m_window, m_windowFill) == m_windowFill);
+    }
+    m_window = nullptr;
+    m_windowSize = 0;
+    m_windowFill = 0;
+    return ok;
+}
+
 
 void SshScpGet::get(const QString &source, const QString &dest)
 {
@@ -42,12 +106,12 @@ void SshScpGet::sshDataReceived()
     {
         case Openning:
         {
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            if ( ! m_sshClient->acquireChannelOpen(this) )
             {
                 return;
             }
             m_sshChannel = libssh2_scp_recv2(m_sshClient->session(), qPrintable(m_source), &m_fileinfo);
-            m_sshClient->releaseChannelCreationMutex(this);
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
             if (m_sshChannel == nullptr)
             {
                 int ret = libssh2_session_last_error(m_sshClient->session(), nullptr, nullptr, 0);
@@ -71,7 +135,13 @@ void SshScpGet::sshDataReceived()
         FALLTHROUGH; case Exec:
         {
             m_file.setFileName(m_dest);
-            if(!m_file.open(QIODevice::WriteOnly))
+            /* Mapping needs read access and the final size of the file */
+            bool opened = m_mapped ? m_file.open(QIODevice::ReadWrite | QIODevice::Truncate) : m_file.open(QIODevice::WriteOnly);
+            if(opened && m_mapped && !m_file.resize(m_fileinfo.st_size))
+            {
+                m_mapped = false;
+            }
+            if(!opened)
             {
                 if(!m_error)
                 {
@@ -84,6 +154,7 @@ void SshScpGet::sshDataReceived()
                 return;
             }
 
+            m_progress.reset();
             setChannelState(ChannelState::Ready);
             /* OK, next step */
         }
@@ -92,15 +163,12 @@ void SshScpGet::sshDataReceived()
         {
             while(m_got < m_fileinfo.st_size)
             {
-                char mem[PAGE_SIZE];
-                int amount=sizeof(mem);
-
-                if((m_fileinfo.st_size - m_got) < amount) {
-                    amount = static_cast<int>(m_fileinfo.st_size - m_got);
+                if(m_window == nullptr)
+                {
+                    _nextWindow();
                 }
 
-
-                ssize_t retsz = libssh2_channel_read_ex(m_sshChannel, 0, mem, static_cast<size_t>(amount));
+                ssize_t retsz = libssh2_channel_read_ex(m_sshChannel, 0, m_window + m_windowFill, static_cast<size_t>(m_windowSize - m_windowFill));
                 if(retsz == LIBSSH2_ERROR_EAGAIN)
                 {
                     return;
@@ -119,20 +187,43 @@ void SshScpGet::sshDataReceived()
                     return;
                 }
 
-                m_file.write(mem, retsz);
+                m_windowFill += retsz;
+                if(m_windowFill == m_windowSize && !_flushWindow())
+                {
+                    if(!m_error)
+                    {
+                        m_error = true;
+                        qCWarning(logscpget) << "Can't write destination file";
+                    }
+                    setChannelState(ChannelState::Close);
+                    sshDataReceived();
+                    return;
+                }
                 m_got += retsz;
-                emit progress(m_got, m_fileinfo.st_size);
+                if(m_progress.update(m_got, m_fileinfo.st_size))
+                {
+                    emit progress(m_got, m_fileinfo.st_size);
+                }
             }
             setChannelState(ChannelState::Close);
         }
 
         FALLTHROUGH; case Close:
         {
+            _flushWindow();
+            if(m_file.isOpen() && m_file.size() > m_got)
+            {
+                /* The mapped file was sized before receiving */
+                m_file.resize(m_got);
+            }
             m_file.close();
             if(m_got != m_fileinfo.st_size)
             {
                 qCDebug(logscpget) << m_name << "Transfer not completed";
-                m_file.remove();
+                if(!m_keepPartial)
+                {
+                    m_file.remove();
+                }
                 emit failed();
             }
             else
@@ -161,7 +252,7 @@ void SshScpGet::sshDataReceived()
         FALLTHROUGH; case WaitClose:
         {
             qCDebug(logscpget) << "Wait close channel:" << m_name;
-            int ret = libssh2_channel_wait_closed(m_sshChannel);
+            int ret = skipWaitClosed() ? 0 : libssh2_channel_wait_closed(m_sshChannel);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
                 return;
@@ -205,7 +296,6 @@ void SshScpGet::sshDataReceived()
                 setChannelState(ChannelState::Free);
             }
             m_sshChannel = nullptr;
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshScpGet::sshDataReceived);
             return;
         }
 
@@ -2,6 +2,8 @@
 
 #include "sshchannel.h"
 #include <QFile>
+#include "sshprogressthrottle.h"
+#include "sshscpsend.h"
 
 Q_DECLARE_LOGGING_CATEGORY(logscpget)
 
@@ -12,11 +14,19 @@ class SshScpGet : public SshChannel
 protected:
     SshScpGet(const QString &name, SshClient *client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
 
 public:
     virtual ~SshScpGet() override;
     void close() override;
 
+    /* Keep an incomplete file, so it can be resumed with SshSFtp::resumeGet() */
+    void setKeepPartial(bool keep);
+
+    /* Read the channel straight into mapped windows of the file */
+    void setMemoryMapped(bool enable);
+    SshProgressThrottle &progressThrottle();
+
 
 
 public slots:
@@ -30,7 +40,18 @@ private:
     libssh2_struct_stat_size m_got = 0;
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
     bool m_error {false};
+    bool m_keepPartial {false};
     QFile m_file;
+    bool m_mapped {true};
+    uchar *m_map {nullptr};
+    char *m_buffer {nullptr};
+    char *m_window {nullptr};
+    qint64 m_windowSize {0};
+    qint64 m_windowFill {0};
+    SshProgressThrottle m_progress;
+
+    bool _nextWindow();
+    bool _flushWindow();
 
 signals:
     void finished();
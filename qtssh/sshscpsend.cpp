@@ -9,6 +9,8 @@ Q_LOGGING_CATEGORY(logscpsend, "ssh.scpsend", QtWarningMsg)
 SshScpSend::SshScpSend(const QString &name, SshClient *client):
     SshChannel(name, client)
 {
+    m_stream.setBlockSize(SCP_BUFFER_SIZE);
+    QObject::connect(&m_stream, &SshFileStream::ready, this, &SshScpSend::sshDataReceived, Qt::QueuedConnection);
 }
 
 SshScpSend::~SshScpSend()
@@ -16,12 +18,75 @@ SshScpSend::~SshScpSend()
     qCDebug(logscpsend) << "free Channel:" << m_name;
 }
 
+LIBSSH2_CHANNEL *SshScpSend::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
 void SshScpSend::close()
 {
     setChannelState(ChannelState::Close);
     sshDataReceived();
 }
 
+void SshScpSend::setMemoryMapped(bool enable)
+{
+    m_mapped = enable;
+}
+
+SshProgressThrottle &SshScpSend::progressThrottle()
+{
+    return m_progress;
+}
+
+bool SshScpSend::_fillWindow()
+{
+    qint64 remaining = static_cast<qint64>(m_fileinfo.st_size) - m_sent;
+    if(m_mapped)
+    {
+        qint64 len = qMin(remaining, static_cast<qint64>(SCP_MAP_WINDOW));
+        m_map = m_file.map(m_sent, len);
+        if(m_map)
+        {
+            m_window = reinterpret_cast<const char *>(m_map);
+            m_dataInBuf = len;
+            return true;
+        }
+        /* Not a mappable file (resource, pipe...) */
+        qCDebug(logscpsend) << m_name << "Can't map source file, use buffered reads";
+        m_mapped = false;
+        m_file.close();
+        m_stream.open(m_source, QIODevice::ReadOnly);
+        m_stream.seek(m_sent);
+    }
+
+    /* Empty until the I/O thread has read ahead, ready() wakes us */
+    m_block = m_stream.readBlock();
+    if(m_block.isEmpty())
+    {
+        return !m_stream.isError() && !m_stream.atEnd();
+    }
+    if(m_block.size() > remaining)
+    {
+        m_block.truncate(static_cast<int>(remaining));
+    }
+    m_window = m_block.constData();
+    m_dataInBuf = m_block.size();
+    return true;
+}
+
+void SshScpSend::_releaseWindow()
+{
+    if(m_map)
+    {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_block.clear();
+    m_window = nullptr;
+    m_dataInBuf = 0;
+    m_offset = 0;
+}
 
 void SshScpSend::send(const QString &source, QString dest)
 {
@@ -39,12 +104,12 @@ void SshScpSend::sshDataReceived()
         case Openning:
         {
             stat(m_source.toStdString().c_str(), &m_fileinfo);
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            if ( ! m_sshClient->acquireChannelOpen(this) )
             {
                 return;
             }
             m_sshChannel = libssh2_scp_send64(m_sshClient->session(), m_dest.toStdString().c_str(), m_fileinfo.st_mode & 0777, m_fileinfo.st_size, 0, 0);
-            m_sshClient->releaseChannelCreationMutex(this);
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
             if (m_sshChannel == nullptr)
             {
                 int ret = libssh2_session_last_error(m_sshClient->session(), nullptr, nullptr, 0);
@@ -68,7 +133,11 @@ void SshScpSend::sshDataReceived()
         FALLTHROUGH; case Exec:
         {
             m_file.setFileName(m_source);
-            if(!m_file.open(QIODevice::ReadOnly))
+            if(!m_mapped)
+            {
+                m_stream.open(m_source, QIODevice::ReadOnly);
+            }
+            else if(!m_file.open(QIODevice::ReadOnly))
             {
                 if(!m_error)
                 {
@@ -81,20 +150,44 @@ void SshScpSend::sshDataReceived()
                 return;
             }
 
+            m_progress.reset();
             setChannelState(ChannelState::Ready);
             /* OK, next step */
         }
 
         FALLTHROUGH; case Ready:
         {
-            while(!m_file.atEnd())
+            const qint64 size = static_cast<qint64>(m_fileinfo.st_size);
+            while(m_sent < size)
             {
                 if(m_dataInBuf == 0)
                 {
-                    m_dataInBuf = m_file.read(m_buffer, PAGE_SIZE);
+                    if(!_fillWindow())
+                    {
+                        if(!m_error)
+                        {
+                            m_error = true;
+                            emit failed();
+                            qCWarning(logscpsend) << "Can't read source file" << m_stream.errorString();
+                        }
+                        setChannelState(ChannelState::Close);
+                        sshDataReceived();
+                        return;
+                    }
+                    if(m_dataInBuf == 0)
+                    {
+                        return;
+                    }
                 }
 
-                ssize_t retsz = libssh2_channel_write_ex(m_sshChannel, 0, m_buffer + m_offset, static_cast<size_t>(m_dataInBuf - m_offset));
+                size_t quota = m_sshClient->writeScheduler().grant(this, static_cast<size_t>(m_dataInBuf - m_offset));
+                if(quota == 0)
+                {
+                    /* Woken up on our next turn */
+                    return;
+                }
+                ssize_t retsz = libssh2_channel_write_ex(m_sshChannel, 0, m_window + m_offset, quota);
+                writeWindowUsed(m_sshChannel);
                 if(retsz == LIBSSH2_ERROR_EAGAIN)
                 {
                     return;
@@ -113,22 +206,27 @@ void SshScpSend::sshDataReceived()
                     return;
                 }
 
+                m_sshClient->writeScheduler().consumed(this, static_cast<size_t>(retsz));
                 m_sent += retsz;
                 m_offset += retsz;
                 if(m_offset == m_dataInBuf)
                 {
-                    m_dataInBuf = 0;
-                    m_offset = 0;
+                    _releaseWindow();
+                }
+                if(m_progress.update(m_sent, size))
+                {
+                    emit progress(m_sent, size);
                 }
-                emit progress(m_sent, m_file.size());
             }
             setChannelState(ChannelState::Close);
         }
 
         FALLTHROUGH; case Close:
         {
+            _releaseWindow();
             m_file.close();
-            if(m_sent != m_file.size())
+            m_stream.close();
+            if(m_sent != static_cast<qint64>(m_fileinfo.st_size))
             {
                 qCDebug(logscpsend) << m_name << "Transfer not completed";
                 emit failed();
@@ -159,7 +257,7 @@ void SshScpSend::sshDataReceived()
         FALLTHROUGH; case WaitClose:
         {
             qCDebug(logscpsend) << "Wait close channel:" << m_name;
-            int ret = libssh2_channel_wait_closed(m_sshChannel);
+            int ret = skipWaitClosed() ? 0 : libssh2_channel_wait_closed(m_sshChannel);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
                 return;
@@ -203,7 +301,6 @@ void SshScpSend::sshDataReceived()
                 setChannelState(ChannelState::Free);
             }
             m_sshChannel = nullptr;
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshScpSend::sshDataReceived);
             return;
         }
 
@@ -2,10 +2,11 @@
 
 #include "sshchannel.h"
 #include <QFile>
+#include "sshprogressthrottle.h"
+#include "sshfilestream.h"
 
-#if !defined(PAGE_SIZE)
-#define PAGE_SIZE (4*1024)
-#endif
+#define SCP_BUFFER_SIZE (256*1024)
+#define SCP_MAP_WINDOW  (16*1024*1024)
 
 Q_DECLARE_LOGGING_CATEGORY(logscpsend)
 
@@ -16,11 +17,19 @@ class SshScpSend : public SshChannel
 protected:
     SshScpSend(const QString &name, SshClient * client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
 
 public:
     virtual ~SshScpSend() override;
     void close() override;
 
+    /*
+     * Write the file from mapped windows instead of blocks read ahead by
+     * the I/O thread; page faults then block the session thread
+     */
+    void setMemoryMapped(bool enable);
+    SshProgressThrottle &progressThrottle();
+
 public slots:
     void send(const QString &source, QString dest);
     void sshDataReceived() override;
@@ -34,9 +43,17 @@ private:
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
     bool m_error {false};
     QFile m_file;
-    char m_buffer[PAGE_SIZE];
+    bool m_mapped {false};
+    uchar *m_map {nullptr};
+    SshFileStream m_stream;
+    QByteArray m_block;
+    const char *m_window {nullptr};
     qint64 m_dataInBuf {0};
     qint64 m_offset {0};
+    SshProgressThrottle m_progress;
+
+    bool _fillWindow();
+    void _releaseWindow();
 
 signals:
     void finished();
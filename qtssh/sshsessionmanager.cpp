@@ -0,0 +1,193 @@
+#include "sshsessionmanager.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+
+Q_LOGGING_CATEGORY(logsshsessionmanager, "ssh.sessionmanager", QtWarningMsg)
+
+SshSessionManager::SshSessionManager(QObject *parent)
+    : QObject(parent)
+{
+    m_reaper.setSingleShot(true);
+    QObject::connect(&m_reaper, &QTimer::timeout, this, &SshSessionManager::_reap);
+}
+
+SshSessionManager::~SshSessionManager()
+{
+    /* SshClient destructor disconnects the session */
+    const QList<SshClient *> clients = m_sessions.keys();
+    m_sessions.clear();
+    m_byKey.clear();
+    qDeleteAll(clients);
+}
+
+/*
+ * A session is only shared with callers giving the same credentials: the
+ * key holds a digest of all of them (password or passphrase, keys and
+ * methods), each field length prefixed so they can't be shifted.
+ */
+QString SshSessionManager::_key(const QString &username, const QString &hostname, quint16 port,
+                                const QString &publicKey, const QString &privateKey,
+                                const QString &passphrase, const QByteArrayList &methodes)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    auto addField = [&hash](const QByteArray &field){
+        QByteArray length = QByteArray::number(field.size()) + ':';
+        hash.addData(length);
+        hash.addData(field);
+    };
+    addField(publicKey.toUtf8());
+    addField(privateKey.toUtf8());
+    addField(passphrase.toUtf8());
+    addField(methodes.join(','));
+    QByteArray credentials = hash.result().toHex();
+    return QString("%1@%2:%3/%4").arg(username, hostname).arg(port).arg(QString::fromLatin1(credentials));
+}
+
+SshClient *SshSessionManager::acquire(const QString &username, const QString &hostname, quint16 port,
+                                      const QString &publicKey, const QString &privateKey,
+                                      const QString &passphrase, QByteArrayList methodes,
+                                      int connTimeoutMsec)
+{
+    QString key = _key(username, hostname, port, publicKey, privateKey, passphrase, methodes);
+    SshClient *client = m_byKey.value(key, nullptr);
+    if(client)
+    {
+        Session &session = m_sessions[client];
+        session.refs++;
+        qCDebug(logsshsessionmanager) << "Reuse session" << client->getName() << "for" << username << hostname << port << "refs" << session.refs;
+        return client;
+    }
+
+    client = new SshClient(QString("session-%1").arg(m_counter++));
+    if(!privateKey.isEmpty())
+    {
+        client->setKeys(publicKey, privateKey);
+    }
+    if(!passphrase.isEmpty())
+    {
+        client->setPassphrase(passphrase);
+    }
+    QObject::connect(client, &SshClient::sshError, this, [this, client](){ _sessionDead(client); });
+    QObject::connect(client, &SshClient::sshDisconnected, this, [this, client](){ _sessionDead(client); });
+
+    m_sessions.insert(client, Session{key, 1, 0, false});
+    m_byKey.insert(key, client);
+    qCDebug(logsshsessionmanager) << "New session" << client->getName() << "for" << username << hostname << port;
+    client->connectToHost(username, hostname, port, methodes, connTimeoutMsec);
+    return client;
+}
+
+void SshSessionManager::release(SshClient *client)
+{
+    auto it = m_sessions.find(client);
+    if(it == m_sessions.end() || it->refs == 0)
+    {
+        return;
+    }
+
+    if(--it->refs > 0)
+    {
+        return;
+    }
+    if(it->dead)
+    {
+        _destroy(client);
+        return;
+    }
+    qCDebug(logsshsessionmanager) << "Session" << client->getName() << "is idle";
+    it->idleSince = QDateTime::currentMSecsSinceEpoch();
+    _armReaper();
+}
+
+void SshSessionManager::_sessionDead(SshClient *client)
+{
+    auto it = m_sessions.find(client);
+    if(it == m_sessions.end() || it->dead)
+    {
+        return;
+    }
+    qCDebug(logsshsessionmanager) << "Session" << client->getName() << "lost";
+    it->dead = true;
+    if(m_byKey.value(it->key, nullptr) == client)
+    {
+        m_byKey.remove(it->key);
+    }
+    if(it->refs == 0)
+    {
+        _destroy(client);
+    }
+}
+
+void SshSessionManager::_destroy(SshClient *client)
+{
+    Session session = m_sessions.take(client);
+    if(m_byKey.value(session.key, nullptr) == client)
+    {
+        m_byKey.remove(session.key);
+    }
+    QObject::disconnect(client, nullptr, this, nullptr);
+    client->disconnectFromHost();
+    client->deleteLater();
+}
+
+void SshSessionManager::_armReaper()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 next = -1;
+    for(const Session &session: m_sessions)
+    {
+        if(session.refs == 0 && !session.dead)
+        {
+            qint64 left = qMax(qint64(0), session.idleSince + m_idleTimeout - now);
+            next = (next < 0) ? left : qMin(next, left);
+        }
+    }
+    if(next < 0)
+    {
+        m_reaper.stop();
+    }
+    else
+    {
+        m_reaper.start(static_cast<int>(next));
+    }
+}
+
+void SshSessionManager::_reap()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<SshClient *> expired;
+    for(auto it = m_sessions.cbegin(); it != m_sessions.cend(); ++it)
+    {
+        if(it->refs == 0 && !it->dead && now - it->idleSince >= m_idleTimeout)
+        {
+            expired.append(it.key());
+        }
+    }
+    for(SshClient *client: expired)
+    {
+        qCDebug(logsshsessionmanager) << "Reap idle session" << client->getName();
+        _destroy(client);
+    }
+    _armReaper();
+}
+
+void SshSessionManager::setIdleTimeout(int msec)
+{
+    m_idleTimeout = qMax(0, msec);
+    _armReaper();
+}
+
+int SshSessionManager::idleTimeout() const
+{
+    return m_idleTimeout;
+}
+
+int SshSessionManager::sessionCount() const
+{
+    return m_sessions.size();
+}
+
+int SshSessionManager::references(SshClient *client) const
+{
+    return m_sessions.value(client, Session{QString(), 0, 0, false}).refs;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QLoggingCategory>
+#include "sshclient.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshsessionmanager)
+
+/**
+ * \brief Share SshClient sessions between the users of a same host
+ * \details Sessions are keyed by user, host, port and a digest of the
+ * credentials (keys, password or passphrase, methods), and are
+ * reference counted: acquire() returns the connected (or connecting)
+ * client of the key when there is one, else it creates and connects a
+ * new one. Once released by all its users, a session stays connected
+ * for the idle timeout, then it is disconnected and deleted. A session
+ * in error or disconnected is never handed out again.
+ */
+class SshSessionManager : public QObject
+{
+    Q_OBJECT
+
+    struct Session {
+        QString key;
+        int refs;
+        qint64 idleSince;
+        bool dead;
+    };
+
+    QHash<SshClient *, Session> m_sessions;
+    QHash<QString, SshClient *> m_byKey;
+    QTimer m_reaper;
+    int m_idleTimeout {60000};
+    int m_counter {0};
+
+    static QString _key(const QString &username, const QString &hostname, quint16 port,
+                        const QString &publicKey, const QString &privateKey,
+                        const QString &passphrase, const QByteArrayList &methodes);
+    void _sessionDead(SshClient *client);
+    void _destroy(SshClient *client);
+    void _armReaper();
+
+private slots:
+    void _reap();
+
+public:
+    explicit SshSessionManager(QObject *parent = nullptr);
+    virtual ~SshSessionManager() override;
+
+    SshClient *acquire(const QString &username, const QString &hostname, quint16 port = 22,
+                       const QString &publicKey = QString(), const QString &privateKey = QString(),
+                       const QString &passphrase = QString(), QByteArrayList methodes = QByteArrayList(),
+                       int connTimeoutMsec = 60000);
+    void release(SshClient *client);
+
+    void setIdleTimeout(int msec);
+    int idleTimeout() const;
+    int sessionCount() const;
+    int references(SshClient *client) const;
+};
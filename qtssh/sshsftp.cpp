@@ -1,15 +1,23 @@
 #include "sshsftp.h"
 #include "sshclient.h"
+#include "sshprocess.h"
 
 #include <QFile>
 #include <QFileInfo>
 #include <QCryptographicHash>
+#include <QPointer>
 #include "sshsftpcommandsend.h"
 #include "sshsftpcommandget.h"
 #include "sshsftpcommandreaddir.h"
 #include "sshsftpcommandmkdir.h"
 #include "sshsftpcommandunlink.h"
+#include "sshsftpcommandrename.h"
+#include "sshsftpcommandsymlink.h"
+#include "sshsftpcommandfsync.h"
+#include "sshsftpcommandstatvfs.h"
+#include "sshsftpfile.h"
 #include "sshsftpcommandfileinfo.h"
+#include "sshsftptransferqueue.h"
 
 Q_LOGGING_CATEGORY(logsshsftp, "ssh.sftp", QtWarningMsg)
 
@@ -19,7 +27,6 @@ SshSFtp::SshSFtp(const QString &name, SshClient *client):
     SshChannel(name, client)
 
 {
-    QObject::connect(client, &SshClient::sshDataReceived, this, &SshSFtp::sshDataReceived, Qt::QueuedConnection);
     QObject::connect(this, &SshSFtp::sendEvent, this, &SshSFtp::_eventLoop, Qt::QueuedConnection);
 }
 
@@ -28,6 +35,21 @@ SshSFtp::~SshSFtp()
     DEBUGCH << "Free SshSFtp (destructor)";
 }
 
+LIBSSH2_CHANNEL *SshSFtp::dispatchChannel() const
+{
+    if(m_sftpSession == nullptr)
+        return nullptr;
+    return libssh2_sftp_get_channel(m_sftpSession);
+}
+
+bool SshSFtp::sshEventPending()
+{
+    /* SFTP responses can be already read by libssh2 sftp layer */
+    if(m_cmd.size() > 0)
+        return true;
+    return SshChannel::sshEventPending();
+}
+
 void SshSFtp::close()
 {
     DEBUGCH << "Close SshSFtp asked";
@@ -42,20 +64,41 @@ void SshSFtp::close()
 QString SshSFtp::send(const QString &source, QString dest)
 {
     DEBUGCH << "send(" << source << ", " << dest << ")";
-    QFileInfo src(source);
+    dest = _remoteDest(source, dest);
+
+    QString s(source);
+    s.replace("qrc:/", ":/");
+
+    SshSftpCommandSend cmd(s,dest,*this);
+    if(processCmd(&cmd))
+    {
+        return dest;
+    }
+    return QString();
+}
+
+QString SshSFtp::_remoteDest(const QString &source, QString dest)
+{
     if(dest.endsWith("/"))
     {
         if(!isDir(dest))
         {
             mkpath(dest);
         }
-        dest += src.fileName();
+        dest += QFileInfo(source).fileName();
     }
+    return dest;
+}
 
+QString SshSFtp::resumeSend(const QString &source, QString dest)
+{
+    DEBUGCH << "resumeSend(" << source << ", " << dest << ")";
+    dest = _remoteDest(source, dest);
     QString s(source);
     s.replace("qrc:/", ":/");
 
-    SshSftpCommandSend cmd(s,dest,*this);
+    SshSftpCommandSend cmd(s, dest, *this);
+    cmd.setMode(SshSftpCommandSend::Resume);
     if(processCmd(&cmd))
     {
         return dest;
@@ -63,6 +106,65 @@ QString SshSFtp::send(const QString &source, QString dest)
     return QString();
 }
 
+QString SshSFtp::deltaSend(const QString &source, QString dest, qint64 blockSize)
+{
+    DEBUGCH << "deltaSend(" << source << ", " << dest << ", " << blockSize << ")";
+    dest = _remoteDest(source, dest);
+    QString s(source);
+    s.replace("qrc:/", ":/");
+
+    QFile local(s);
+    if(!local.open(QIODevice::ReadOnly))
+    {
+        m_errMsg << "Can't open local file " + s;
+        return QString();
+    }
+
+    SshSftpCommandSend cmd(s, dest, *this);
+    QList<QByteArray> remote = remoteBlockChecksums(dest, blockSize);
+    if(!remote.isEmpty())
+    {
+        /* Compare block by block, adjacent changed blocks are sent at once */
+        QList<QPair<qint64, qint64>> ranges;
+        qint64 offset = 0;
+        for(int block = 0; !local.atEnd(); ++block)
+        {
+            QByteArray data = local.read(blockSize);
+            if(data.isEmpty())
+                break;
+            if(block >= remote.size() || QCryptographicHash::hash(data, QCryptographicHash::Md5) != remote[block])
+            {
+                if(!ranges.isEmpty() && ranges.last().first + ranges.last().second == offset)
+                    ranges.last().second += data.size();
+                else
+                    ranges << qMakePair(offset, static_cast<qint64>(data.size()));
+            }
+            offset += data.size();
+        }
+        DEBUGCH << "deltaSend(" << source << ") " << ranges.size() << " changed ranges";
+        cmd.setRanges(ranges);
+    }
+    local.close();
+
+    if(processCmd(&cmd))
+    {
+        return dest;
+    }
+    return QString();
+}
+
+bool SshSFtp::resumeGet(const QString &source, QString dest)
+{
+    DEBUGCH << "resumeGet(" << source << ", " << dest << ")";
+    if(dest.endsWith("/"))
+    {
+        dest += QFileInfo(source).fileName();
+    }
+    SshSftpCommandGet cmd(dest, source, *this);
+    cmd.setResume(true);
+    return processCmd(&cmd);
+}
+
 bool SshSFtp::get(const QString &source, QString dest, bool override)
 {
     DEBUGCH << "get(" << source << ", " << dest << ", " << override << ")";
@@ -75,10 +177,24 @@ bool SshSFtp::get(const QString &source, QString dest, bool override)
 
     QString original(dest);
     QFile fout(dest);
+    bool compare = false;
     if(!override)
     {
         if(fout.exists())
         {
+            /* Different sizes: the files can't be the same */
+            compare = (filesize(source) == static_cast<quint64>(fout.size()));
+            if(compare && m_remoteChecksum)
+            {
+                QByteArray remote = remoteChecksum(source);
+                if(!remote.isEmpty() && remote == fileChecksum(original, QCryptographicHash::Sha256))
+                {
+                    DEBUGCH << "get(" << source << ") skipped, same checksum as " << original;
+                    return true;
+                }
+                compare = remote.isEmpty();
+            }
+
             QString newpath;
             int i = 1;
             do {
@@ -90,35 +206,118 @@ bool SshSFtp::get(const QString &source, QString dest, bool override)
         }
     }
 
-    SshSftpCommandGet cmd(fout, source, *this);
+    SshSftpCommandGet cmd(dest, source, *this);
+    if(compare)
+    {
+        cmd.setHashAlgorithm(QCryptographicHash::Sha256);
+    }
     bool ret = processCmd(&cmd);
 
     if(!ret)
         return false;
 
     /* Remove file if is the same that original */
-    if(dest != original)
+    if(compare && cmd.hash() == fileChecksum(original, QCryptographicHash::Sha256))
     {
-        QCryptographicHash hash1( QCryptographicHash::Md5 );
-        QCryptographicHash hash2( QCryptographicHash::Md5 );
-        QFile f1( original );
-        if ( f1.open( QIODevice::ReadOnly ) ) {
-            hash1.addData( f1.readAll() );
-        }
-        QByteArray sig1 = hash1.result();
-        QFile f2( dest );
-        if ( f2.open( QIODevice::ReadOnly ) ) {
-            hash2.addData( f2.readAll() );
-        }
-        QByteArray sig2 = hash2.result();
-        if(sig1 == sig2)
-        {
-            f2.remove();
-        }
+        QFile::remove(dest);
     }
     return true;
 }
 
+QByteArray SshSFtp::fileChecksum(const QString &path, QCryptographicHash::Algorithm algorithm)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    /* addData(QIODevice*) reads the file by blocks */
+    QCryptographicHash hash(algorithm);
+    if(!hash.addData(&file))
+        return QByteArray();
+    return hash.result();
+}
+
+QByteArray SshSFtp::_runRemoteCommand(const QString &command, bool *ok)
+{
+    /* One channel per command: a name already used may still be closing */
+    QString name = QString("%1-cmd%2").arg(m_name, QString::number(m_remoteCommandCounter++));
+    QPointer<SshProcess> proc = m_sshClient->getChannel<SshProcess>(name);
+
+    /* The process channel is freed and deleted once the command is done */
+    QByteArray output;
+    bool done = false;
+    QEventLoop wait(this);
+    QObject::connect(proc, &SshProcess::finished, &wait, [&](){
+        output = proc->result();
+        done = !proc->isError();
+        wait.quit();
+    });
+    QObject::connect(proc, &SshProcess::failed, &wait, &QEventLoop::quit);
+    QObject::connect(proc, &QObject::destroyed, &wait, &QEventLoop::quit);
+    proc->runCommand(command);
+    while(!done && proc && !proc->isError())
+    {
+        wait.exec();
+    }
+    if(proc && proc->channelState() <= ChannelState::Ready)
+    {
+        proc->close();
+    }
+    *ok = done;
+    return output;
+}
+
+QString SshSFtp::_shellQuote(const QString &path)
+{
+    QString quoted(path);
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+
+QByteArray SshSFtp::remoteChecksum(const QString &path)
+{
+    bool ok;
+    QByteArray output = _runRemoteCommand(QString("sha256sum -- %1").arg(_shellQuote(path)), &ok);
+
+    QByteArray res;
+    if(ok)
+    {
+        /* Output is "<hex digest>  <path>" */
+        res = QByteArray::fromHex(output.split(' ').value(0).trimmed());
+        if(res.size() != 32)
+            res.clear();
+    }
+    DEBUGCH << "remoteChecksum(" << path << ") = " << res.toHex();
+    return res;
+}
+
+QList<QByteArray> SshSFtp::remoteBlockChecksums(const QString &path, qint64 blockSize)
+{
+    /* One md5 per block, computed with dd on the server */
+    QString command = QString(
+                "f=%1; n=$(( ($(stat -c %s -- \"$f\") + %2 - 1) / %2 )); i=0; "
+                "while [ $i -lt $n ]; do dd if=\"$f\" bs=%2 skip=$i count=1 2>/dev/null | md5sum; i=$((i+1)); done"
+                ).arg(_shellQuote(path), QString::number(blockSize));
+    bool ok;
+    QByteArray output = _runRemoteCommand(command, &ok);
+
+    QList<QByteArray> res;
+    if(!ok)
+        return res;
+    for(const QByteArray &line: output.split('\n'))
+    {
+        if(line.trimmed().isEmpty())
+            continue;
+        QByteArray digest = QByteArray::fromHex(line.split(' ').value(0));
+        if(digest.size() != 16)
+            return QList<QByteArray>();
+        res << digest;
+    }
+    DEBUGCH << "remoteBlockChecksums(" << path << ") = " << res.size() << " blocks";
+    return res;
+}
+
+
 int SshSFtp::mkdir(const QString &dest, int mode)
 {
     SshSftpCommandMkdir cmd(dest, mode, *this);
@@ -135,9 +334,34 @@ QStringList SshSFtp::readdir(const QString &d)
     DEBUGCH << "readdir(" << d << ")";
     processCmd(&cmd);
     DEBUGCH << "readdir(" << d << ") = " << cmd.result();
+    _seedFileInfo(d, cmd.entries());
     return cmd.result();
 }
 
+QList<SshSftpDirEntry> SshSFtp::readdirEx(const QString &d)
+{
+    SshSftpCommandReadDir cmd(d, *this);
+    DEBUGCH << "readdirEx(" << d << ")";
+    processCmd(&cmd);
+    DEBUGCH << "readdirEx(" << d << ") = " << cmd.entries().size() << "entries";
+    _seedFileInfo(d, cmd.entries());
+    return cmd.entries();
+}
+
+void SshSFtp::_seedFileInfo(const QString &dir, const QList<SshSftpDirEntry> &entries)
+{
+    QString prefix = dir.endsWith("/") ? dir : dir + "/";
+    for(const SshSftpDirEntry &entry: entries)
+    {
+        /* Readdir attributes don't follow links, stat() does */
+        if(!(entry.attrs.flags & LIBSSH2_SFTP_ATTR_PERMISSIONS) || LIBSSH2_SFTP_S_ISLNK(entry.attrs.permissions))
+            continue;
+        if(entry.name == "." || entry.name == "..")
+            continue;
+        m_attrCache.insert(prefix + entry.name, entry.attrs);
+    }
+}
+
 bool SshSFtp::isDir(const QString &d)
 {
     DEBUGCH << "isDir(" << d << ")";
@@ -178,6 +402,101 @@ bool SshSFtp::unlink(const QString &d)
     return 0;
 }
 
+bool SshSFtp::rename(const QString &source, const QString &dest, bool overwrite)
+{
+    SshSftpCommandRename cmd(source, dest, overwrite, *this);
+    DEBUGCH << "rename(" << source << "," << dest << ")";
+    processCmd(&cmd);
+    DEBUGCH << "rename(" << source << "," << dest << ") = " << ((cmd.error())?("FAIL"):("OK"));
+    return !cmd.error();
+}
+
+bool SshSFtp::copy(const QString &source, const QString &dest)
+{
+    bool ok;
+    _runRemoteCommand(QString("cp -p -- %1 %2").arg(_shellQuote(source), _shellQuote(dest)), &ok);
+    m_attrCache.invalidate(dest);
+    DEBUGCH << "copy(" << source << "," << dest << ") = " << ((ok)?("OK"):("FAIL"));
+    return ok;
+}
+
+bool SshSFtp::fsync(const QString &path)
+{
+    SshSftpCommandFsync cmd(path, *this);
+    DEBUGCH << "fsync(" << path << ")";
+    processCmd(&cmd);
+    DEBUGCH << "fsync(" << path << ") = " << ((cmd.error())?("FAIL"):("OK"));
+    return !cmd.error();
+}
+
+bool SshSFtp::statvfs(const QString &path, LIBSSH2_SFTP_STATVFS &st)
+{
+    SshSftpCommandStatVfs cmd(path, *this);
+    DEBUGCH << "statvfs(" << path << ")";
+    processCmd(&cmd);
+    DEBUGCH << "statvfs(" << path << ") = " << cmd.bytesAvailable() << "/" << cmd.bytesTotal();
+    st = cmd.statvfs();
+    return !cmd.error();
+}
+
+bool SshSFtp::symlink(const QString &path, const QString &target)
+{
+    SshSftpCommandSymlink cmd(path, target, SshSftpCommandSymlink::Symlink, *this);
+    DEBUGCH << "symlink(" << path << "," << target << ")";
+    processCmd(&cmd);
+    DEBUGCH << "symlink(" << path << ") = " << ((cmd.error())?("FAIL"):("OK"));
+    return !cmd.error();
+}
+
+QString SshSFtp::readlink(const QString &path)
+{
+    SshSftpCommandSymlink cmd(path, QString(), SshSftpCommandSymlink::Readlink, *this);
+    processCmd(&cmd);
+    DEBUGCH << "readlink(" << path << ") = " << cmd.target();
+    return cmd.target();
+}
+
+QString SshSFtp::realpath(const QString &path)
+{
+    SshSftpCommandSymlink cmd(path, QString(), SshSftpCommandSymlink::Realpath, *this);
+    processCmd(&cmd);
+    DEBUGCH << "realpath(" << path << ") = " << cmd.target();
+    return cmd.target();
+}
+
+QByteArray SshSFtp::readFile(const QString &path, bool *ok)
+{
+    SshSftpFile file(this, path);
+    QByteArray data;
+    bool res = file.open(QIODevice::ReadOnly);
+    if(res)
+    {
+        /* One request for the whole file */
+        file.setReadAheadSize(file.size());
+        data = file.readAll();
+        res = (data.size() >= file.size());
+        file.close();
+    }
+    DEBUGCH << "readFile(" << path << ") = " << data.size() << "bytes";
+    if(ok)
+        *ok = res;
+    return data;
+}
+
+bool SshSFtp::writeFile(const QString &path, const QByteArray &data)
+{
+    SshSftpFile file(this, path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    file.setWriteBehindSize(data.size());
+    bool res = (file.write(data) == data.size()) && file.flush();
+    file.close();
+    DEBUGCH << "writeFile(" << path << ") = " << ((res)?("OK"):("FAIL"));
+    return res;
+}
+
 quint64 SshSFtp::filesize(const QString &d)
 {
     DEBUGCH << "filesize(" << d << ")";
@@ -196,12 +515,12 @@ void SshSFtp::_eventLoop()
     {
         case Openning:
         {
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            if ( ! m_sshClient->acquireChannelOpen(this) )
             {
                 return;
             }
             m_sftpSession = libssh2_sftp_init(m_sshClient->session());
-            m_sshClient->releaseChannelCreationMutex(this);
+            m_sshClient->releaseChannelOpen(this, m_sftpSession);
             if(m_sftpSession == nullptr)
             {
                 char *emsg;
@@ -233,28 +552,28 @@ void SshSFtp::_eventLoop()
 
         FALLTHROUGH; case Ready:
         {
-            if(m_currentCmd == nullptr && m_cmd.size() > 0)
-            {
-                m_currentCmd = m_cmd.first();
-                DEBUGCH << "Start process next command:" << m_currentCmd->name();
-                m_cmd.pop_front();
-            }
-            if(m_currentCmd)
+            /*
+             * Commands run in parallel, but libssh2 keeps only one request
+             * state per SFTP session, for handle operations too (read,
+             * write, readdir, fstat, close...). A command whose call ended
+             * with EAGAIN owns the session until it completes that call.
+             */
+            const QList<SshSftpCommand *> commands = m_cmd;
+            for(SshSftpCommand *cmd: commands)
             {
-                DEBUGCH << "Continue process current command:" << m_currentCmd->name();
-                m_currentCmd->process();
-                if(m_currentCmd->state() == SshSftpCommand::CommandState::Terminate || m_currentCmd->state() == SshSftpCommand::CommandState::Error)
+                if(!m_cmd.contains(cmd))
+                    continue;
+                if(m_sessionOwner && m_sessionOwner != cmd)
+                    continue;
+
+                DEBUGCH << "Process command:" << cmd->name() << cmd->state();
+                cmd->m_holdSession = false;
+                cmd->process();
+                m_sessionOwner = (cmd->m_holdSession) ? cmd : nullptr;
+
+                if(cmd->state() == SshSftpCommand::CommandState::Terminate || cmd->state() == SshSftpCommand::CommandState::Error)
                 {
-                    DEBUGCH << "Finish process command:" << m_currentCmd->name();
-                    if (m_currentCmd->state() == SshSftpCommand::CommandState::Error)
-                    {
-                        if (m_currentCmd->errMsg().size() > 0)
-                            m_errMsg.append(m_currentCmd->errMsg());
-                        m_error = true;
-                    }
-                    m_currentCmd = nullptr;
-                    emit cmdEvent();
-                    emit sendEvent();
+                    _finishCmd(cmd);
                 }
             }
             break;
@@ -263,6 +582,7 @@ void SshSFtp::_eventLoop()
         case Close:
         {
             DEBUGCH << "closeChannel";
+            _failPendingCmd("SFTP channel closed");
             if(libssh2_sftp_shutdown(m_sftpSession) != 0)
             {
                 return;
@@ -279,7 +599,6 @@ void SshSFtp::_eventLoop()
         {
             DEBUGCH << "free Channel";
             setChannelState(ChannelState::Free);
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshSFtp::sshDataReceived);
             return;
         }
 
@@ -292,25 +611,204 @@ void SshSFtp::_eventLoop()
         case Error:
         {
             DEBUGCH << "Channel is in error state";
+            _failPendingCmd("SFTP channel error");
             setChannelState(Free);
             return;
         }
     }
 }
 
+void SshSFtp::setRemoteChecksum(bool enable)
+{
+    m_remoteChecksum = enable;
+}
+
+bool SshSFtp::remoteChecksumEnabled() const
+{
+    return m_remoteChecksum;
+}
+
+void SshSFtp::setTransferChunkSize(size_t chunkSize)
+{
+    m_transferChunkSize = qBound<size_t>(SFTP_MIN_CHUNK_SIZE, chunkSize, SFTP_MAX_CHUNK_SIZE);
+}
+
+size_t SshSFtp::transferChunkSize() const
+{
+    return m_transferChunkSize;
+}
+
+void SshSFtp::setTransferWindow(int window)
+{
+    m_transferWindow = qMax(1, window);
+}
+
+int SshSFtp::transferWindow() const
+{
+    return m_transferWindow;
+}
+
+size_t SshSFtp::transferBufferSize() const
+{
+    return m_transferChunkSize * static_cast<size_t>(m_transferWindow);
+}
+
 LIBSSH2_SFTP *SshSFtp::getSftpSession() const
 {
     return m_sftpSession;
 }
 
+int SshSFtp::pendingCommands() const
+{
+    return m_cmd.size();
+}
+
+void SshSFtp::enqueueCmd(SshSftpCommand *cmd)
+{
+    m_cmd.push_back(cmd);
+    QObject::connect(cmd, &QObject::destroyed, this, [this, cmd](){
+        m_cmd.removeAll(cmd);
+        if(m_sessionOwner == cmd)
+            m_sessionOwner = nullptr;
+    });
+    emit sendEvent();
+}
+
+void SshSFtp::cancelCmd(SshSftpCommand *cmd)
+{
+    if(!m_cmd.contains(cmd))
+    {
+        cmd->deleteLater();
+        return;
+    }
+    /* Libssh2 handles are given back by the command itself */
+    QObject::connect(cmd, &SshSftpCommand::finished, cmd, &QObject::deleteLater);
+    cmd->cancel();
+    emit sendEvent();
+}
+
+void SshSFtp::_finishCmd(SshSftpCommand *cmd)
+{
+    DEBUGCH << "Finish process command:" << cmd->name();
+    if (cmd->state() == SshSftpCommand::CommandState::Error)
+    {
+        if (cmd->errMsg().size() > 0)
+            m_errMsg.append(cmd->errMsg());
+        m_error = true;
+    }
+    m_cmd.removeAll(cmd);
+    if(m_sessionOwner == cmd)
+        m_sessionOwner = nullptr;
+    emit cmd->finished();
+    emit cmdEvent();
+    emit sendEvent();
+}
+
+void SshSFtp::_failPendingCmd(const QString &msg)
+{
+    const QList<SshSftpCommand *> commands = m_cmd;
+    for(SshSftpCommand *cmd: commands)
+    {
+        if(!m_cmd.contains(cmd))
+            continue;
+        cmd->m_errMsg << msg;
+        cmd->setState(SshSftpCommand::CommandState::Error);
+        _finishCmd(cmd);
+    }
+}
+
+SshSftpCommandSend *SshSFtp::asyncSend(const QString &source, const QString &dest)
+{
+    QString s(source);
+    s.replace("qrc:/", ":/");
+    SshSftpCommandSend *cmd = new SshSftpCommandSend(s, dest, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandGet *SshSFtp::asyncGet(const QString &source, const QString &dest)
+{
+    SshSftpCommandGet *cmd = new SshSftpCommandGet(dest, source, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandMkdir *SshSFtp::asyncMkdir(const QString &dest, int mode)
+{
+    SshSftpCommandMkdir *cmd = new SshSftpCommandMkdir(dest, mode, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandReadDir *SshSFtp::asyncReaddir(const QString &d)
+{
+    SshSftpCommandReadDir *cmd = new SshSftpCommandReadDir(d, *this);
+    QObject::connect(cmd, &SshSftpCommand::finished, this, [this, cmd, d](){ _seedFileInfo(d, cmd->entries()); });
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandUnlink *SshSFtp::asyncUnlink(const QString &d)
+{
+    SshSftpCommandUnlink *cmd = new SshSftpCommandUnlink(d, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandFileInfo *SshSFtp::asyncFileInfo(const QString &path)
+{
+    SshSftpCommandFileInfo *cmd = new SshSftpCommandFileInfo(path, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandRename *SshSFtp::asyncRename(const QString &source, const QString &dest, bool overwrite)
+{
+    SshSftpCommandRename *cmd = new SshSftpCommandRename(source, dest, overwrite, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandFsync *SshSFtp::asyncFsync(const QString &path)
+{
+    SshSftpCommandFsync *cmd = new SshSftpCommandFsync(path, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandStatVfs *SshSFtp::asyncStatVfs(const QString &path)
+{
+    SshSftpCommandStatVfs *cmd = new SshSftpCommandStatVfs(path, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandSymlink *SshSFtp::asyncSymlink(const QString &path, const QString &target)
+{
+    SshSftpCommandSymlink *cmd = new SshSftpCommandSymlink(path, target, SshSftpCommandSymlink::Symlink, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpCommandSymlink *SshSFtp::asyncReadlink(const QString &path)
+{
+    SshSftpCommandSymlink *cmd = new SshSftpCommandSymlink(path, QString(), SshSftpCommandSymlink::Readlink, *this);
+    enqueueCmd(cmd);
+    return cmd;
+}
+
+SshSftpTransferQueue *SshSFtp::createTransferQueue(int concurrency)
+{
+    return new SshSftpTransferQueue(*this, concurrency, this);
+}
+
 bool SshSFtp::processCmd(SshSftpCommand *cmd)
 {
     QEventLoop wait(this);
     QObject::connect(this, &SshSFtp::stateChanged, &wait, &QEventLoop::quit);
-    QObject::connect(this, &SshSFtp::cmdEvent, &wait, &QEventLoop::quit);
+    QObject::connect(cmd, &SshSftpCommand::finished, &wait, &QEventLoop::quit);
 
-    m_cmd.push_back(cmd);
-    emit sendEvent();
+    enqueueCmd(cmd);
     while(channelState() <= ChannelState::Ready && cmd->state() != SshSftpCommand::CommandState::Terminate && cmd->state() != SshSftpCommand::CommandState::Error)
     {
         wait.exec();
@@ -328,16 +826,31 @@ QStringList SshSFtp::errMsg()
     return m_errMsg;
 }
 
+SshSftpAttrCache &SshSFtp::attrCache()
+{
+    return m_attrCache;
+}
+
 LIBSSH2_SFTP_ATTRIBUTES SshSFtp::getFileInfo(const QString &path)
 {
-    if(!m_fileinfo.contains(path))
+    LIBSSH2_SFTP_ATTRIBUTES fileinfo {};
+    bool exists;
+    if(m_attrCache.lookup(path, fileinfo, exists))
+    {
+        return fileinfo;
+    }
+
+    SshSftpCommandFileInfo cmd(path, *this);
+    DEBUGCH << "fileinfo(" << path << ")";
+    processCmd(&cmd);
+    DEBUGCH << "fileinfo(" << path << ") = " << ((cmd.error())?("FAIL"):("OK"));
+    if(cmd.state() == SshSftpCommand::CommandState::Terminate)
     {
-        SshSftpCommandFileInfo cmd(path, *this);
-        DEBUGCH << "fileinfo(" << path << ")";
-        processCmd(&cmd);
-        DEBUGCH << "fileinfo(" << path << ") = " << ((cmd.error())?("FAIL"):("OK"));
-        LIBSSH2_SFTP_ATTRIBUTES fileinfo = cmd.fileinfo();
-        m_fileinfo[path] = fileinfo;
+        /* Terminate with an error: the file doesn't exist */
+        if(cmd.error())
+            m_attrCache.insertNegative(path);
+        else
+            m_attrCache.insert(path, cmd.fileinfo());
     }
-    return m_fileinfo[path];
+    return cmd.error() ? fileinfo : cmd.fileinfo();
 }
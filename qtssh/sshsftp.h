@@ -7,12 +7,37 @@
 #include <QTimer>
 #include <QStringList>
 #include <QHash>
+#include <QCryptographicHash>
 #include <QLoggingCategory>
+#include "sshsftpattrcache.h"
 
 class SshSftpCommand;
+class SshSftpCommandSend;
+class SshSftpCommandGet;
+class SshSftpCommandMkdir;
+class SshSftpCommandReadDir;
+class SshSftpCommandUnlink;
+class SshSftpCommandFileInfo;
+class SshSftpCommandRename;
+class SshSftpCommandSymlink;
+class SshSftpCommandFsync;
+class SshSftpCommandStatVfs;
+class SshSftpTransferQueue;
 
 Q_DECLARE_LOGGING_CATEGORY(logsshsftp)
 
+struct SshSftpDirEntry {
+    QString name;
+    QString longName;
+    LIBSSH2_SFTP_ATTRIBUTES attrs;
+};
+
+#define SFTP_MIN_CHUNK_SIZE     (32*1024)
+#define SFTP_MAX_CHUNK_SIZE     (256*1024)
+#define SFTP_DEFAULT_CHUNK_SIZE (64*1024)
+#define SFTP_DEFAULT_WINDOW     8
+#define SFTP_DELTA_BLOCK_SIZE   (1024*1024)
+
 class SshSFtp : public SshChannel
 {
     Q_OBJECT
@@ -24,14 +49,28 @@ private:
     QStringList m_errMsg;
 
     QList<SshSftpCommand *> m_cmd;
-    SshSftpCommand *m_currentCmd {nullptr};
+    /* Command in the middle of a libssh2 call, the others wait for it */
+    SshSftpCommand *m_sessionOwner {nullptr};
+
+    size_t m_transferChunkSize {SFTP_DEFAULT_CHUNK_SIZE};
+    int m_transferWindow {SFTP_DEFAULT_WINDOW};
+    bool m_remoteChecksum {true};
+    int m_remoteCommandCounter {0};
 
-    QHash<QString,  LIBSSH2_SFTP_ATTRIBUTES> m_fileinfo;
+    SshSftpAttrCache m_attrCache;
     LIBSSH2_SFTP_ATTRIBUTES getFileInfo(const QString &path);
+    void _seedFileInfo(const QString &dir, const QList<SshSftpDirEntry> &entries);
+    QString _remoteDest(const QString &source, QString dest);
+    QByteArray _runRemoteCommand(const QString &command, bool *ok);
+    static QString _shellQuote(const QString &path);
+    void _finishCmd(SshSftpCommand *cmd);
+    void _failPendingCmd(const QString &msg);
 
 protected:
     SshSFtp(const QString &name, SshClient * client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+    bool sshEventPending() override;
 
 public:
     virtual ~SshSFtp() override;
@@ -39,16 +78,87 @@ public:
 
     QString send(const QString &source, QString dest);
     bool get(const QString &source, QString dest, bool override = false);
+
+    /* Continue an interrupted transfer after the data already transferred */
+    QString resumeSend(const QString &source, QString dest);
+    bool resumeGet(const QString &source, QString dest);
+
+    /* Only send the blocks which differ from the remote file */
+    QString deltaSend(const QString &source, QString dest, qint64 blockSize = SFTP_DELTA_BLOCK_SIZE);
+    QList<QByteArray> remoteBlockChecksums(const QString &path, qint64 blockSize);
     int mkdir(const QString &dest, int mode = 0755);
     QStringList readdir(const QString &d);
+    QList<SshSftpDirEntry> readdirEx(const QString &d);
     bool isDir(const QString &d);
     bool isFile(const QString &d);
     int mkpath(const QString &dest);
     bool unlink(const QString &d);
     quint64 filesize(const QString &d);
 
+    /* Server side operations, nothing goes through the client */
+    bool rename(const QString &source, const QString &dest, bool overwrite = true);
+    /* No copy-data in libssh2: cp on the server, over a session channel */
+    bool copy(const QString &source, const QString &dest);
+    bool fsync(const QString &path);
+    bool statvfs(const QString &path, LIBSSH2_SFTP_STATVFS &st);
+    bool symlink(const QString &path, const QString &target);
+    QString readlink(const QString &path);
+    QString realpath(const QString &path);
+
+    /* Whole small files in memory, without local file */
+    QByteArray readFile(const QString &path, bool *ok = nullptr);
+    bool writeFile(const QString &path, const QByteArray &data);
+
+    /*
+     * get() without override compares the remote file with the existing
+     * one: with sha256sum on the server when enabled, before downloading.
+     */
+    void setRemoteChecksum(bool enable);
+    bool remoteChecksumEnabled() const;
+    QByteArray remoteChecksum(const QString &path);
+    static QByteArray fileChecksum(const QString &path, QCryptographicHash::Algorithm algorithm);
+
+    /*
+     * Asynchronous API: commands are processed in parallel, the returned
+     * command emit finished() when done. The caller owns it and have to
+     * delete it (deleteLater) after use.
+     */
+    SshSftpCommandSend *asyncSend(const QString &source, const QString &dest);
+    SshSftpCommandGet *asyncGet(const QString &source, const QString &dest);
+    SshSftpCommandMkdir *asyncMkdir(const QString &dest, int mode = 0755);
+    SshSftpCommandReadDir *asyncReaddir(const QString &d);
+    SshSftpCommandUnlink *asyncUnlink(const QString &d);
+    SshSftpCommandFileInfo *asyncFileInfo(const QString &path);
+    SshSftpCommandRename *asyncRename(const QString &source, const QString &dest, bool overwrite = true);
+    SshSftpCommandFsync *asyncFsync(const QString &path);
+    SshSftpCommandStatVfs *asyncStatVfs(const QString &path);
+    SshSftpCommandSymlink *asyncSymlink(const QString &path, const QString &target);
+    SshSftpCommandSymlink *asyncReadlink(const QString &path);
+
+    /* Batch of transfers running concurrency at a time, owned by the channel */
+    SshSftpTransferQueue *createTransferQueue(int concurrency = 8);
+
+    /*
+     * Pipelined transfers: get and send keep up to window * chunkSize bytes
+     * of read/write requests in flight on the link. The settings apply to
+     * the commands started after the call.
+     */
+    void setTransferChunkSize(size_t chunkSize);
+    size_t transferChunkSize() const;
+    void setTransferWindow(int window);
+    int transferWindow() const;
+    size_t transferBufferSize() const;
+
+    /* Attributes cache used by isDir/isFile/filesize */
+    SshSftpAttrCache &attrCache();
+
     LIBSSH2_SFTP *getSftpSession() const;
+    void enqueueCmd(SshSftpCommand *cmd);
+    /* Commands queued or running, the load seen by SshSftpPool */
+    int pendingCommands() const;
     bool processCmd(SshSftpCommand *cmd);
+    /* Stop a command of which the result is no more wanted, deleted when done */
+    void cancelCmd(SshSftpCommand *cmd);
 
     bool isError();
     QStringList errMsg();
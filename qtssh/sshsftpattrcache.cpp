@@ -0,0 +1,173 @@
+#include "sshsftpattrcache.h"
+
+SshSftpAttrCache::SshSftpAttrCache()
+{
+    m_clock.start();
+}
+
+int SshSftpAttrCache::maxEntries() const
+{
+    return m_maxEntries;
+}
+
+void SshSftpAttrCache::setMaxEntries(int maxEntries)
+{
+    m_maxEntries = qMax(0, maxEntries);
+    while(m_entries.size() > m_maxEntries)
+    {
+        _remove(m_entries.find(m_lru.back()));
+    }
+}
+
+qint64 SshSftpAttrCache::ttl() const
+{
+    return m_ttl;
+}
+
+void SshSftpAttrCache::setTtl(qint64 msec)
+{
+    m_ttl = msec;
+}
+
+qint64 SshSftpAttrCache::negativeTtl() const
+{
+    return m_negativeTtl;
+}
+
+void SshSftpAttrCache::setNegativeTtl(qint64 msec)
+{
+    m_negativeTtl = msec;
+}
+
+bool SshSftpAttrCache::lookup(const QString &path, LIBSSH2_SFTP_ATTRIBUTES &attrs, bool &exists)
+{
+    auto it = m_entries.find(path);
+    if(it == m_entries.end())
+    {
+        ++m_misses;
+        return false;
+    }
+    if(it->expire <= m_clock.elapsed())
+    {
+        _remove(it);
+        ++m_misses;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->lru);
+    attrs = it->attrs;
+    exists = it->exists;
+    ++m_hits;
+    return true;
+}
+
+void SshSftpAttrCache::insert(const QString &path, const LIBSSH2_SFTP_ATTRIBUTES &attrs)
+{
+    _insert(path, attrs, true, m_ttl);
+}
+
+void SshSftpAttrCache::insertNegative(const QString &path)
+{
+    _insert(path, LIBSSH2_SFTP_ATTRIBUTES {}, false, m_negativeTtl);
+}
+
+void SshSftpAttrCache::invalidate(const QString &path)
+{
+    auto it = m_entries.find(path);
+    if(it != m_entries.end())
+        _remove(it);
+
+    it = m_entries.find(parentPath(path));
+    if(it != m_entries.end())
+        _remove(it);
+}
+
+void SshSftpAttrCache::invalidateTree(const QString &path)
+{
+    invalidate(path);
+
+    QString prefix(path);
+    if(!prefix.endsWith("/"))
+        prefix += "/";
+    for(auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if(it.key().startsWith(prefix))
+        {
+            m_lru.erase(it->lru);
+            it = m_entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void SshSftpAttrCache::clear()
+{
+    m_entries.clear();
+    m_lru.clear();
+}
+
+int SshSftpAttrCache::size() const
+{
+    return m_entries.size();
+}
+
+quint64 SshSftpAttrCache::hits() const
+{
+    return m_hits;
+}
+
+quint64 SshSftpAttrCache::misses() const
+{
+    return m_misses;
+}
+
+void SshSftpAttrCache::resetStats()
+{
+    m_hits = 0;
+    m_misses = 0;
+}
+
+QString SshSftpAttrCache::parentPath(const QString &path)
+{
+    QString p(path);
+    while(p.size() > 1 && p.endsWith("/"))
+        p.chop(1);
+    int index = p.lastIndexOf("/");
+    if(index < 0)
+        return QString(".");
+    if(index == 0)
+        return QString("/");
+    return p.left(index);
+}
+
+void SshSftpAttrCache::_insert(const QString &path, const LIBSSH2_SFTP_ATTRIBUTES &attrs, bool exists, qint64 ttl)
+{
+    if(m_maxEntries == 0 || ttl <= 0)
+        return;
+
+    auto it = m_entries.find(path);
+    if(it != m_entries.end())
+    {
+        m_lru.splice(m_lru.begin(), m_lru, it->lru);
+        it->attrs = attrs;
+        it->exists = exists;
+        it->expire = m_clock.elapsed() + ttl;
+        return;
+    }
+
+    while(m_entries.size() >= m_maxEntries)
+    {
+        _remove(m_entries.find(m_lru.back()));
+    }
+    m_lru.push_front(path);
+    m_entries.insert(path, Entry {attrs, exists, m_clock.elapsed() + ttl, m_lru.begin()});
+}
+
+void SshSftpAttrCache::_remove(QHash<QString, Entry>::iterator it)
+{
+    m_lru.erase(it->lru);
+    m_entries.erase(it);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QElapsedTimer>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <list>
+
+/**
+ * \brief Bounded cache of SFTP file attributes
+ * \details Entries are evicted in least recently used order once
+ * maxEntries() is reached and expire after ttl() milliseconds. Paths
+ * which don't exist are kept as negative entries with a shorter TTL.
+ */
+class SshSftpAttrCache
+{
+    struct Entry {
+        LIBSSH2_SFTP_ATTRIBUTES attrs;
+        bool exists;
+        qint64 expire;
+        std::list<QString>::iterator lru;
+    };
+
+    QHash<QString, Entry> m_entries;
+    std::list<QString> m_lru;
+    QElapsedTimer m_clock;
+    int m_maxEntries {4096};
+    qint64 m_ttl {30000};
+    qint64 m_negativeTtl {2000};
+    quint64 m_hits {0};
+    quint64 m_misses {0};
+
+    void _insert(const QString &path, const LIBSSH2_SFTP_ATTRIBUTES &attrs, bool exists, qint64 ttl);
+    void _remove(QHash<QString, Entry>::iterator it);
+
+public:
+    SshSftpAttrCache();
+
+    int maxEntries() const;
+    void setMaxEntries(int maxEntries);
+    qint64 ttl() const;
+    void setTtl(qint64 msec);
+    qint64 negativeTtl() const;
+    void setNegativeTtl(qint64 msec);
+
+    /* Return true on hit, exists is false for a negative entry */
+    bool lookup(const QString &path, LIBSSH2_SFTP_ATTRIBUTES &attrs, bool &exists);
+    void insert(const QString &path, const LIBSSH2_SFTP_ATTRIBUTES &attrs);
+    void insertNegative(const QString &path);
+
+    /* Forget path and its parent directory, which changed too */
+    void invalidate(const QString &path);
+    /* Same, with everything under path: directory renamed or removed */
+    void invalidateTree(const QString &path);
+    void clear();
+
+    int size() const;
+    quint64 hits() const;
+    quint64 misses() const;
+    void resetStats();
+
+    static QString parentPath(const QString &path);
+};
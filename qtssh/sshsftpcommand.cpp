@@ -20,6 +20,21 @@ QStringList SshSftpCommand::errMsg() const
     return m_errMsg;
 }
 
+void SshSftpCommand::cancel()
+{
+    m_cancelled = true;
+}
+
+bool SshSftpCommand::isCancelled() const
+{
+    return m_cancelled;
+}
+
+void SshSftpCommand::holdSession()
+{
+    m_holdSession = true;
+}
+
 SshSftpCommand::SshSftpCommand(SshSFtp &sftp)
     : QObject(qobject_cast<QObject*>(&sftp))
     , m_sftp(sftp)
@@ -13,6 +13,7 @@ class SshSftpCommand : public QObject
 
     SshSFtp &m_sftp;
     QString m_name;
+    friend class SshSFtp;
 
 public:
     enum CommandState {
@@ -39,12 +40,29 @@ public:
 
     QStringList errMsg() const;
 
+    /* Transfers stop and close their file on next pass, others run to their end */
+    void cancel();
+    bool isCancelled() const;
+
 protected:
     CommandState m_state;
     QStringList m_errMsg;
+    bool m_cancelled {false};
+
+    /*
+     * A libssh2 call returned EAGAIN: libssh2 keeps one request state per
+     * SFTP session (open, stat, readdir, read, write, close...), no other
+     * command may call it until this one completes the call.
+     */
+    void holdSession();
+
+private:
+    bool m_holdSession {false};
 
 signals:
     void stateChanged(CommandState state);
+    void progress(qint64 done, qint64 total);
+    void finished();
 };
 
 #endif // SSHSFTPCOMMAND_H
@@ -0,0 +1,244 @@
+#include "sshsftpcommandfile.h"
+#include "sshclient.h"
+
+SshSftpCommandFile::SshSftpCommandFile(const QString &path, unsigned long flags, long mode, SshSFtp &parent)
+    : SshSftpCommand(parent)
+    , m_path(path)
+    , m_flags(flags)
+    , m_mode(mode)
+{
+    setName(QString("file(%1)").arg(path));
+}
+
+bool SshSftpCommandFile::error() const
+{
+    return m_error;
+}
+
+bool SshSftpCommandFile::isOpened() const
+{
+    return m_opened;
+}
+
+qint64 SshSftpCommandFile::fileSize() const
+{
+    return m_size;
+}
+
+void SshSftpCommandFile::read(qint64 offset, qint64 size)
+{
+    m_readOffset = offset;
+    m_readSize = size;
+    m_readSeeked = false;
+    m_readError = false;
+    m_readData.clear();
+    emit sftp().sendEvent();
+}
+
+bool SshSftpCommandFile::isReading() const
+{
+    return m_readSize > 0;
+}
+
+bool SshSftpCommandFile::readError() const
+{
+    return m_readError;
+}
+
+QByteArray SshSftpCommandFile::takeReadData()
+{
+    QByteArray data;
+    data.swap(m_readData);
+    return data;
+}
+
+void SshSftpCommandFile::write(qint64 offset, const QByteArray &data)
+{
+    if(data.isEmpty())
+        return;
+    m_writes.append(Write {offset, data, 0, false});
+    m_pendingWrite += data.size();
+    emit sftp().sendEvent();
+}
+
+qint64 SshSftpCommandFile::pendingWrite() const
+{
+    return m_pendingWrite;
+}
+
+void SshSftpCommandFile::closeFile()
+{
+    m_closeRequested = true;
+    emit sftp().sendEvent();
+}
+
+bool SshSftpCommandFile::_processWrites()
+{
+    while(!m_writes.isEmpty())
+    {
+        Write &w = m_writes.first();
+        if(!w.seeked)
+        {
+            libssh2_sftp_seek64(m_handle, static_cast<libssh2_uint64_t>(w.offset));
+            w.seeked = true;
+        }
+        /* Same pointer and size again after EAGAIN: libssh2 pipelines them */
+        ssize_t res = libssh2_sftp_write(m_handle, w.data.constData() + w.done, static_cast<size_t>(w.data.size() - w.done));
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return false;
+        }
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP write error: %1").arg(res);
+            qCWarning(logsshsftp) << "SFTP write error " << res << "on" << m_path;
+            m_writes.clear();
+            m_pendingWrite = 0;
+            emit written(0);
+            return true;
+        }
+        w.done += res;
+        if(w.done == w.data.size())
+        {
+            qint64 size = w.data.size();
+            m_pendingWrite -= size;
+            m_writes.removeFirst();
+            emit written(size);
+        }
+    }
+    return true;
+}
+
+bool SshSftpCommandFile::_processRead()
+{
+    while(m_readSize > 0)
+    {
+        if(!m_readSeeked)
+        {
+            libssh2_sftp_seek64(m_handle, static_cast<libssh2_uint64_t>(m_readOffset));
+            m_readSeeked = true;
+            m_readBuffer.resize(static_cast<int>(qMin<qint64>(m_readSize, static_cast<qint64>(sftp().transferBufferSize()))));
+        }
+        ssize_t res = libssh2_sftp_read(m_handle, m_readBuffer.data(), static_cast<size_t>(m_readBuffer.size()));
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return false;
+        }
+        if(res < 0)
+        {
+            m_readError = true;
+            m_errMsg << QString("SFTP read error: %1").arg(res);
+            qCWarning(logsshsftp) << "SFTP read error " << res << "on" << m_path;
+            m_readSize = 0;
+        }
+        else if(res == 0)
+        {
+            /* End of file */
+            m_readSize = 0;
+        }
+        else
+        {
+            qint64 len = qMin<qint64>(res, m_readSize);
+            m_readData.append(m_readBuffer.constData(), static_cast<int>(len));
+            m_readSize -= len;
+        }
+        if(m_readSize == 0)
+        {
+            emit readDone();
+        }
+    }
+    return true;
+}
+
+void SshSftpCommandFile::process()
+{
+    int res;
+    switch(m_state)
+    {
+    case Openning:
+    {
+        QByteArray path = m_path.toUtf8();
+        m_handle = libssh2_sftp_open_ex(
+                    sftp().getSftpSession(),
+                    path.constData(),
+                    static_cast<unsigned int>(path.size()),
+                    m_flags,
+                    m_mode,
+                    LIBSSH2_SFTP_OPENFILE
+                    );
+        if(!m_handle)
+        {
+            char *emsg;
+            int size;
+            if(libssh2_session_last_error(sftp().sshClient()->session(), &emsg, &size, 0) == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+            m_error = true;
+            m_errMsg << "Can't open SFTP file " + m_path + ", " + QString(emsg);
+            qCWarning(logsshsftp) << "Can't open SFTP file " << m_path;
+            setState(CommandState::Error);
+            return;
+        }
+        sftp().attrCache().invalidate(m_path);
+        setState(CommandState::Exec);
+        FALLTHROUGH;
+    }
+    case Exec:
+        if(m_statPending)
+        {
+            LIBSSH2_SFTP_ATTRIBUTES attrs {};
+            res = libssh2_sftp_fstat_ex(m_handle, &attrs, 0);
+            if(res == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+            if(res == 0 && (attrs.flags & LIBSSH2_SFTP_ATTR_SIZE))
+            {
+                m_size = static_cast<qint64>(attrs.filesize);
+            }
+            m_statPending = false;
+            m_opened = true;
+            emit opened();
+        }
+        /* Writes first: a read after a write sees its data */
+        if(!_processWrites() || !_processRead())
+        {
+            return;
+        }
+        if(!m_closeRequested || !m_writes.isEmpty())
+        {
+            return;
+        }
+        setState(CommandState::Closing);
+        FALLTHROUGH;
+
+    case Closing:
+        res = libssh2_sftp_close_handle(m_handle);
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        m_handle = nullptr;
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP close error: %1").arg(res);
+        }
+        sftp().attrCache().invalidate(m_path);
+        setState((m_error) ? CommandState::Error : CommandState::Terminate);
+        break;
+
+    case Terminate:
+        break;
+
+    case Error:
+        break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SSHSFTPCOMMANDFILE_H
+#define SSHSFTPCOMMANDFILE_H
+
+#include <QObject>
+#include <QList>
+#include <sshsftpcommand.h>
+
+/*
+ * Remote file handle kept open until closeFile(): reads and writes at any
+ * offset are queued and processed in order by the SFTP channel loop.
+ * Used by SshSftpFile.
+ */
+class SshSftpCommandFile : public SshSftpCommand
+{
+    Q_OBJECT
+
+    struct Write {
+        qint64 offset;
+        QByteArray data;
+        qint64 done;
+        bool seeked;
+    };
+
+    QString m_path;
+    unsigned long m_flags;
+    long m_mode;
+    LIBSSH2_SFTP_HANDLE *m_handle {nullptr};
+    bool m_error {false};
+    bool m_opened {false};
+    bool m_statPending {true};
+    bool m_closeRequested {false};
+    qint64 m_size {0};
+
+    qint64 m_readOffset {0};
+    qint64 m_readSize {0};
+    bool m_readSeeked {false};
+    bool m_readError {false};
+    QByteArray m_readData;
+    QByteArray m_readBuffer;
+
+    QList<Write> m_writes;
+    qint64 m_pendingWrite {0};
+
+    bool _processWrites();
+    bool _processRead();
+
+public:
+    SshSftpCommandFile(const QString &path, unsigned long flags, long mode, SshSFtp &parent);
+    void process() override;
+    bool error() const;
+    bool isOpened() const;
+    /* Size when opened */
+    qint64 fileSize() const;
+
+    /* One read at a time: readDone() when size bytes or the end are read */
+    void read(qint64 offset, qint64 size);
+    bool isReading() const;
+    bool readError() const;
+    QByteArray takeReadData();
+
+    void write(qint64 offset, const QByteArray &data);
+    qint64 pendingWrite() const;
+
+    /* Close once the queued writes are done */
+    void closeFile();
+
+signals:
+    void opened();
+    void readDone();
+    void written(qint64 bytes);
+};
+
+#endif // SSHSFTPCOMMANDFILE_H
@@ -38,6 +38,7 @@ void SshSftpCommandFileInfo::process()
         {
             if(res == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             m_error = true;
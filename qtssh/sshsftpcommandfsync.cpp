@@ -0,0 +1,81 @@
+#include "sshsftpcommandfsync.h"
+#include "sshclient.h"
+
+SshSftpCommandFsync::SshSftpCommandFsync(const QString &path, SshSFtp &parent)
+    : SshSftpCommand(parent)
+    , m_path(path)
+{
+    setName(QString("fsync(%1)").arg(path));
+}
+
+bool SshSftpCommandFsync::error() const
+{
+    return m_error;
+}
+
+void SshSftpCommandFsync::process()
+{
+    int res;
+    switch(m_state)
+    {
+    case Openning:
+    {
+        QByteArray path = m_path.toUtf8();
+        m_handle = libssh2_sftp_open_ex(
+                    sftp().getSftpSession(),
+                    path.constData(),
+                    static_cast<unsigned int>(path.size()),
+                    LIBSSH2_FXF_READ,
+                    0,
+                    LIBSSH2_SFTP_OPENFILE
+                    );
+        if(!m_handle)
+        {
+            if(libssh2_session_last_error(sftp().sshClient()->session(), nullptr, nullptr, 0) == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+            m_error = true;
+            m_errMsg << "Can't open SFTP file " + m_path;
+            qCWarning(logsshsftp) << "Can't open SFTP file " << m_path;
+            setState(CommandState::Error);
+            break;
+        }
+        setState(CommandState::Exec);
+        FALLTHROUGH;
+    }
+    case Exec:
+        res = libssh2_sftp_fsync(m_handle);
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP fsync error: %1").arg(res);
+            qCWarning(logsshsftp) << "SFTP fsync error " << res;
+        }
+        setState(CommandState::Closing);
+        FALLTHROUGH;
+
+    case Closing:
+        res = libssh2_sftp_close_handle(m_handle);
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        m_handle = nullptr;
+        setState((m_error) ? CommandState::Error : CommandState::Terminate);
+        break;
+
+    case Terminate:
+        break;
+
+    case Error:
+        break;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef SSHSFTPCOMMANDFSYNC_H
+#define SSHSFTPCOMMANDFSYNC_H
+
+#include <QObject>
+#include <sshsftpcommand.h>
+
+/* Flush a remote file to disk, needs the fsync@openssh.com extension */
+class SshSftpCommandFsync : public SshSftpCommand
+{
+    Q_OBJECT
+    QString m_path;
+    LIBSSH2_SFTP_HANDLE *m_handle {nullptr};
+    bool m_error {false};
+
+public:
+    SshSftpCommandFsync(const QString &path, SshSFtp &parent);
+    void process() override;
+    bool error() const;
+};
+
+#endif // SSHSFTPCOMMANDFSYNC_H
@@ -1,16 +1,113 @@
 #include "sshsftpcommandget.h"
 #include "sshclient.h"
+#include "sshbufferpool.h"
 
-SshSftpCommandGet::SshSftpCommandGet(QFile &fout, const QString &source, SshSFtp &parent)
+SshSftpCommandGet::SshSftpCommandGet(const QString &dest, const QString &source, SshSFtp &parent)
     : SshSftpCommand(parent)
-    , m_fout(fout)
+    , m_dest(dest)
     , m_src(source)
 {
-    setName(QString("get(%1, %2)").arg(source).arg(fout.fileName()));
+    setName(QString("get(%1, %2)").arg(source).arg(dest));
+    QObject::connect(&m_fout, &SshFileStream::ready, &sftp(), &SshSFtp::sshDataReceived, Qt::QueuedConnection);
+}
+
+SshSftpCommandGet::~SshSftpCommandGet()
+{
+    SshBufferPool::instance().release(m_buffer, m_bufferSize);
+    delete m_hash;
+}
+
+void SshSftpCommandGet::setHashAlgorithm(QCryptographicHash::Algorithm algorithm)
+{
+    delete m_hash;
+    m_hash = new QCryptographicHash(algorithm);
+}
+
+void SshSftpCommandGet::setResume(bool resume)
+{
+    m_resume = resume;
+}
+
+bool SshSftpCommandGet::_prepare()
+{
+    if(!m_statDone)
+    {
+        /* The remote size preallocates the local file */
+        LIBSSH2_SFTP_ATTRIBUTES attrs {};
+        int rc = libssh2_sftp_fstat_ex(m_sftpfile, &attrs, 0);
+        if(rc == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return false;
+        }
+        if(rc == 0 && (attrs.flags & LIBSSH2_SFTP_ATTR_SIZE))
+        {
+            m_remoteSize = static_cast<qint64>(attrs.filesize);
+        }
+        m_statDone = true;
+        m_fout.open(m_dest, m_resume ? QIODevice::ReadWrite : QIODevice::WriteOnly, qMax<qint64>(m_remoteSize, 0));
+    }
+    if(!m_fout.isOpen())
+    {
+        /* Opened by the I/O thread, ready() wakes the session */
+        return m_fout.isError();
+    }
+    return !m_resume || _prepareResume();
+}
+
+bool SshSftpCommandGet::_prepareResume()
+{
+    if(m_resumeOffset < 0)
+    {
+        /* A local file larger than the remote one is not a partial download */
+        if(m_remoteSize < 0 || m_fout.size() > m_remoteSize)
+        {
+            m_fout.resize(0);
+            m_resumeOffset = 0;
+        }
+        else
+        {
+            m_resumeOffset = m_fout.size();
+        }
+        m_fout.seek(0);
+    }
+
+    while(m_hash && m_hashed < m_resumeOffset)
+    {
+        qint64 nread = m_fout.read(m_buffer, qMin(static_cast<qint64>(m_bufferSize), m_resumeOffset - m_hashed));
+        if(nread == 0)
+        {
+            if(m_fout.isError() || m_fout.atEnd())
+            {
+                break;
+            }
+            return false;
+        }
+        m_hash->addData(m_buffer, static_cast<int>(nread));
+        m_hashed += nread;
+    }
+    m_fout.seek(m_resumeOffset);
+    libssh2_sftp_seek64(m_sftpfile, static_cast<libssh2_uint64_t>(m_resumeOffset));
+    m_received = m_resumeOffset;
+    qCDebug(logsshsftp) << "Resume " << m_src << " at " << m_resumeOffset;
+    return true;
+}
+
+QByteArray SshSftpCommandGet::hash() const
+{
+    if(m_hash == nullptr)
+        return QByteArray();
+    return m_hash->result();
 }
 
 void SshSftpCommandGet::process()
 {
+    if(m_cancelled && m_state == CommandState::Exec)
+    {
+        m_error = true;
+        m_errMsg << "Cancelled";
+        setState(CommandState::Closing);
+    }
     switch(m_state)
     {
     case Openning:
@@ -30,6 +127,7 @@ void SshSftpCommandGet::process()
             int ret = libssh2_session_last_error(sftp().sshClient()->session(), &emsg, &size, 0);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             qCDebug(logsshsftp) << "Can't open SFTP file " << m_src << ", " << QString(emsg);
@@ -39,21 +137,45 @@ void SshSftpCommandGet::process()
             return;
         }
 
-        if(!m_fout.open(QIODevice::WriteOnly))
-        {
-            m_error = true;
-            setState(CommandState::Closing);
-        }
+        /*
+         * libssh2_sftp_read() keeps read-ahead requests in flight for the
+         * whole buffer length and returns the data in order, so a buffer
+         * of window times chunk size keeps the link busy.
+         */
+        m_bufferSize = sftp().transferBufferSize();
+        m_buffer = SshBufferPool::instance().acquire(m_bufferSize);
         setState(CommandState::Exec);
         FALLTHROUGH;
     case Exec:
+        if(!m_prepared)
+        {
+            if(!_prepare())
+            {
+                return;
+            }
+            m_prepared = true;
+        }
         while(1)
         {
-            ssize_t rc = libssh2_sftp_read(m_sftpfile, m_buffer, SFTP_BUFFER_SIZE);
+            if(m_fout.isError())
+            {
+                qCWarning(logsshsftp) << "Can't write local file " << m_dest << ", " << m_fout.errorString();
+                m_error = true;
+                m_errMsg << "Can't write local file " + m_dest + ", " + m_fout.errorString();
+                setState(CommandState::Closing);
+                break;
+            }
+            if(!m_fout.canWrite())
+            {
+                /* Disk behind, woken by ready() once a block is written */
+                return;
+            }
+            ssize_t rc = libssh2_sftp_read(m_sftpfile, m_buffer, m_bufferSize);
             if(rc < 0)
             {
                 if(rc == LIBSSH2_ERROR_EAGAIN)
                 {
+                    holdSession();
                     return;
                 }
                 qCWarning(logsshsftp) << "SFTP read error " << rc;
@@ -70,32 +192,47 @@ void SshSftpCommandGet::process()
             }
             else
             {
-                char *begin = m_buffer;
-                while(rc)
+                m_received += rc;
+                if(m_hash)
                 {
-                    ssize_t wrc = m_fout.write(begin, rc);
-                    rc -= wrc;
-                    begin += wrc;
+                    m_hash->addData(m_buffer, static_cast<int>(rc));
                 }
+                m_fout.write(m_buffer, rc);
+                emit progress(m_received, -1);
             }
         }
+        FALLTHROUGH;
 
     case Closing:
     {
-        if(m_fout.isOpen())
+        /* Queued blocks still written, the close completes in the I/O thread */
+        m_fout.close();
+        SshBufferPool::instance().release(m_buffer, m_bufferSize);
+        m_buffer = nullptr;
+        if(m_sftpfile)
         {
-            m_fout.close();
-        }
-        int rc = libssh2_sftp_close_handle(m_sftpfile);
-        if(rc < 0)
-        {
-            if(rc == LIBSSH2_ERROR_EAGAIN)
+            int rc = libssh2_sftp_close_handle(m_sftpfile);
+            if(rc < 0)
             {
-                return;
+                if(rc == LIBSSH2_ERROR_EAGAIN)
+                {
+                    holdSession();
+                    return;
+                }
+                qCWarning(logsshsftp) << "SFTP close error " << rc;
+                m_errMsg << QString("SFTP close error: %1").arg(rc);
+                m_error = true;
             }
-            qCWarning(logsshsftp) << "SFTP close error " << rc;
-            m_errMsg << QString("SFTP close error: %1").arg(rc);
-            setState(CommandState::Error);
+            m_sftpfile = nullptr;
+        }
+        if(!m_fout.isClosed())
+        {
+            return;
+        }
+        if(m_fout.isError() && !m_error)
+        {
+            m_error = true;
+            m_errMsg << "Can't write local file " + m_dest + ", " + m_fout.errorString();
         }
         if(m_error)
         {
@@ -2,22 +2,44 @@
 #define SSHSFTPCOMMANDGET_H
 
 #include <QObject>
-#include <QFile>
+#include <QCryptographicHash>
+#include "sshfilestream.h"
 #include <sshsftpcommand.h>
 
 class SshSftpCommandGet : public SshSftpCommand
 {
     Q_OBJECT
 
-    QFile &m_fout;
-    const QString &m_src;
-    LIBSSH2_SFTP_HANDLE *m_sftpfile;
+    SshFileStream m_fout;
+    QString m_dest;
+    QString m_src;
+    LIBSSH2_SFTP_HANDLE *m_sftpfile {nullptr};
     bool m_error {false};
-    char m_buffer[SFTP_BUFFER_SIZE];
+    char *m_buffer {nullptr};
+    size_t m_bufferSize {0};
+    qint64 m_received {0};
+    QCryptographicHash *m_hash {nullptr};
+    bool m_resume {false};
+    bool m_prepared {false};
+    bool m_statDone {false};
+    qint64 m_remoteSize {-1};
+    qint64 m_resumeOffset {-1};
+    qint64 m_hashed {0};
+
+    bool _prepare();
+    bool _prepareResume();
 
 public:
-    SshSftpCommandGet(QFile &fout, const QString &source, SshSFtp &parent);
+    SshSftpCommandGet(const QString &dest, const QString &source, SshSFtp &parent);
+    virtual ~SshSftpCommandGet() override;
     void process() override;
+
+    /* Hash the received data while it is written */
+    void setHashAlgorithm(QCryptographicHash::Algorithm algorithm);
+    QByteArray hash() const;
+
+    /* Keep the existing local file and download only the missing data */
+    void setResume(bool resume);
 };
 
 #endif // SSHSFTPCOMMANDGET_H
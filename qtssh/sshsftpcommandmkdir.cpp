@@ -28,12 +28,14 @@ void SshSftpCommandMkdir::process()
                     m_mode
                     );
 
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        sftp().attrCache().invalidate(m_dir);
         if(res < 0)
         {
-            if(res == LIBSSH2_ERROR_EAGAIN)
-            {
-                return;
-            }
             m_error = true;
             m_errMsg << "SFTP mkdir error " + res;
             qCWarning(logsshsftp) << "SFTP mkdir error " << res;
@@ -7,7 +7,7 @@
 class SshSftpCommandMkdir : public SshSftpCommand
 {
     Q_OBJECT
-    const QString &m_dir;
+    QString m_dir;
     int m_mode;
     bool m_error {false};
 
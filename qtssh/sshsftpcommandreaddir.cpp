@@ -6,6 +6,11 @@ QStringList SshSftpCommandReadDir::result() const
     return m_result;
 }
 
+QList<SshSftpDirEntry> SshSftpCommandReadDir::entries() const
+{
+    return m_entries;
+}
+
 SshSftpCommandReadDir::SshSftpCommandReadDir(const QString &dir, SshSFtp &parent)
     : SshSftpCommand(parent)
     , m_dir(dir)
@@ -34,6 +39,7 @@ void SshSftpCommandReadDir::process()
             int ret = libssh2_session_last_error(sftp().sshClient()->session(), &emsg, &size, 0);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             qCDebug(logsshsftp) << "Can't open SFTP dir " << m_dir << ", " << QString(emsg);
@@ -50,15 +56,19 @@ void SshSftpCommandReadDir::process()
     case Exec:
         while(1)
         {
-            ssize_t rc = libssh2_sftp_readdir_ex(m_sftpdir, m_buffer, SFTP_BUFFER_SIZE, nullptr, 0, &m_attrs);
+            ssize_t rc = libssh2_sftp_readdir_ex(m_sftpdir, m_buffer, SFTP_BUFFER_SIZE, m_longentry, SFTP_BUFFER_SIZE, &m_attrs);
             if(rc < 0)
             {
                 if(rc == LIBSSH2_ERROR_EAGAIN)
                 {
+                    holdSession();
                     return;
                 }
                 qCWarning(logsshsftp) << "SFTP readdir error " << rc;
+                m_error = true;
                 m_errMsg << QString("SFTP readdir error: %1").arg(rc);
+                setState(Closing);
+                break;
             }
             else if(rc == 0)
             {
@@ -68,9 +78,12 @@ void SshSftpCommandReadDir::process()
             }
             else
             {
-                m_result.append(QString(m_buffer));
+                QString name = QString::fromUtf8(m_buffer, static_cast<int>(rc));
+                m_result.append(name);
+                m_entries.append({name, QString::fromUtf8(m_longentry), m_attrs});
             }
         }
+        FALLTHROUGH;
 
     case Closing:
     {
@@ -79,6 +92,7 @@ void SshSftpCommandReadDir::process()
         {
             if(rc == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             qCWarning(logsshsftp) << "SFTP close error " << rc;
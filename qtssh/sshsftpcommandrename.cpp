@@ -0,0 +1,144 @@
+#include "sshsftpcommandrename.h"
+#include "sshclient.h"
+
+SshSftpCommandRename::SshSftpCommandRename(const QString &source, const QString &dest, bool overwrite, SshSFtp &parent)
+    : SshSftpCommand(parent)
+    , m_source(source)
+    , m_dest(dest)
+    , m_overwrite(overwrite)
+{
+    setName(QString("rename(%1, %2)").arg(source, dest));
+}
+
+bool SshSftpCommandRename::error() const
+{
+    return m_error;
+}
+
+int SshSftpCommandRename::_rename(long flags)
+{
+    QByteArray source = m_source.toUtf8();
+    QByteArray dest = m_dest.toUtf8();
+    return libssh2_sftp_rename_ex(
+                sftp().getSftpSession(),
+                source.constData(),
+                static_cast<unsigned int>(source.size()),
+                dest.constData(),
+                static_cast<unsigned int>(dest.size()),
+                flags
+                );
+}
+
+int SshSftpCommandRename::_posixRename()
+{
+#if LIBSSH2_VERSION_NUM >= 0x010b00
+    QByteArray source = m_source.toUtf8();
+    QByteArray dest = m_dest.toUtf8();
+    return libssh2_sftp_posix_rename_ex(
+                sftp().getSftpSession(),
+                source.constData(),
+                static_cast<unsigned int>(source.size()),
+                dest.constData(),
+                static_cast<unsigned int>(dest.size())
+                );
+#else
+    return LIBSSH2_ERROR_SFTP_PROTOCOL;
+#endif
+}
+
+void SshSftpCommandRename::process()
+{
+    int res;
+    switch(m_state)
+    {
+    case Openning:
+        /* Every step is a non handle request: all stay in Openning */
+        if(m_step == 0)
+        {
+            m_step = 1;
+#if LIBSSH2_VERSION_NUM >= 0x010b00
+            if(m_overwrite)
+            {
+                res = _posixRename();
+                if(res == LIBSSH2_ERROR_EAGAIN)
+                {
+                    holdSession();
+                    m_step = 0;
+                    return;
+                }
+                bool unsupported = (res == LIBSSH2_ERROR_SFTP_PROTOCOL && libssh2_sftp_last_error(sftp().getSftpSession()) == LIBSSH2_FX_OP_UNSUPPORTED);
+                if(!unsupported)
+                {
+                    m_step = 4;
+                }
+                else
+                {
+                    qCDebug(logsshsftp) << "No posix-rename extension, non atomic fallback for" << m_dest;
+                }
+            }
+#endif
+        }
+        if(m_step == 1)
+        {
+            long flags = (m_overwrite) ? (LIBSSH2_SFTP_RENAME_OVERWRITE | LIBSSH2_SFTP_RENAME_ATOMIC | LIBSSH2_SFTP_RENAME_NATIVE) : 0;
+            res = _rename(flags);
+            if(res == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+            if(res == LIBSSH2_ERROR_SFTP_PROTOCOL && m_overwrite)
+            {
+                unsigned long err = libssh2_sftp_last_error(sftp().getSftpSession());
+                if(err == LIBSSH2_FX_FAILURE || err == LIBSSH2_FX_FILE_ALREADY_EXISTS)
+                {
+                    qCDebug(logsshsftp) << "Server refused to overwrite" << m_dest << ", unlink it first (not atomic)";
+                    m_step = 2;
+                }
+            }
+        }
+        if(m_step == 2)
+        {
+            QByteArray dest = m_dest.toUtf8();
+            res = libssh2_sftp_unlink_ex(sftp().getSftpSession(), dest.constData(), static_cast<unsigned int>(dest.size()));
+            if(res == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+            sftp().attrCache().invalidateTree(m_dest);
+            m_step = 3;
+        }
+        if(m_step == 3)
+        {
+            res = _rename(0);
+            if(res == LIBSSH2_ERROR_EAGAIN)
+            {
+                holdSession();
+                return;
+            }
+        }
+
+        sftp().attrCache().invalidateTree(m_source);
+        sftp().attrCache().invalidateTree(m_dest);
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP rename error: %1 (%2)").arg(res).arg(libssh2_sftp_last_error(sftp().getSftpSession()));
+            qCWarning(logsshsftp) << "SFTP rename error " << res;
+            setState(CommandState::Error);
+            break;
+        }
+        setState(CommandState::Terminate);
+        FALLTHROUGH;
+    case Terminate:
+        break;
+
+    case Error:
+        break;
+
+    default:
+        setState(CommandState::Terminate);
+        break;
+    }
+}
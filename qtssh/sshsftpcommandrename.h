@@ -0,0 +1,32 @@
+#ifndef SSHSFTPCOMMANDRENAME_H
+#define SSHSFTPCOMMANDRENAME_H
+
+#include <QObject>
+#include <sshsftpcommand.h>
+
+/*
+ * Rename on the server. With overwrite, the posix-rename@openssh.com
+ * extension replaces the target atomically (libssh2 1.11). Without it
+ * (older libssh2, or server without the extension) the POSIX rename flags
+ * are asked; SFTP v3 servers ignore them and refuse an existing target:
+ * it is then unlinked and the rename retried, which is NOT atomic.
+ */
+class SshSftpCommandRename : public SshSftpCommand
+{
+    Q_OBJECT
+    QString m_source;
+    QString m_dest;
+    bool m_overwrite;
+    int m_step {0};
+    bool m_error {false};
+
+    int _rename(long flags);
+    int _posixRename();
+
+public:
+    SshSftpCommandRename(const QString &source, const QString &dest, bool overwrite, SshSFtp &parent);
+    void process() override;
+    bool error() const;
+};
+
+#endif // SSHSFTPCOMMANDRENAME_H
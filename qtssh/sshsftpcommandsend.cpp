@@ -1,16 +1,110 @@
 #include "sshsftpcommandsend.h"
 #include "sshclient.h"
+#include "sshbufferpool.h"
+#include <cstring>
 
 SshSftpCommandSend::SshSftpCommandSend(const QString &source, QString dest, SshSFtp &parent)
     : SshSftpCommand(parent)
     , m_dest(dest)
-    , m_localfile(source)
+    , m_source(source)
 {
     setName(QString("send(%1, %2)").arg(source, dest));
+    QObject::connect(&m_localfile, &SshFileStream::ready, &sftp(), &SshSFtp::sshDataReceived, Qt::QueuedConnection);
+}
+
+SshSftpCommandSend::~SshSftpCommandSend()
+{
+    SshBufferPool::instance().release(m_buffer, m_bufferSize);
+}
+
+void SshSftpCommandSend::setMode(SendMode mode)
+{
+    m_mode = mode;
+}
+
+void SshSftpCommandSend::setRanges(const QList<QPair<qint64, qint64>> &ranges)
+{
+    m_mode = Ranges;
+    m_ranges = ranges;
+}
+
+qint64 SshSftpCommandSend::bytesSent() const
+{
+    return m_sent;
+}
+
+bool SshSftpCommandSend::_prepare()
+{
+    if(!m_localfile.isOpen())
+    {
+        /* Opened by the I/O thread, ready() wakes the session */
+        return false;
+    }
+    qint64 localSize = m_localfile.size();
+    if(m_mode == Overwrite)
+    {
+        m_ranges = {qMakePair(qint64(0), localSize)};
+        return true;
+    }
+
+    LIBSSH2_SFTP_ATTRIBUTES attrs {};
+    int rc = libssh2_sftp_fstat_ex(m_sftpfile, &attrs, 0);
+    if(rc == LIBSSH2_ERROR_EAGAIN)
+    {
+        holdSession();
+        return false;
+    }
+    qint64 remoteSize = (rc == 0) ? static_cast<qint64>(attrs.filesize) : 0;
+
+    if(m_mode == Resume)
+    {
+        /* Acknowledged writes are on the server, continue after them */
+        qint64 offset = (remoteSize <= localSize) ? remoteSize : 0;
+        m_ranges = {qMakePair(offset, localSize - offset)};
+        qCDebug(logsshsftp) << "Resume " << m_dest << " at " << offset;
+    }
+    m_truncate = (remoteSize > localSize);
+
+    /* Data outside the ranges is already on the server */
+    m_sent = localSize;
+    for(const QPair<qint64, qint64> &range: m_ranges)
+    {
+        m_sent -= range.second;
+    }
+    return true;
+}
+
+bool SshSftpCommandSend::_nextRange()
+{
+    ++m_range;
+    while(m_range < m_ranges.size() && m_ranges[m_range].second <= 0)
+    {
+        ++m_range;
+    }
+    if(m_range >= m_ranges.size())
+    {
+        return false;
+    }
+
+    qint64 offset = m_ranges[m_range].first;
+    m_localfile.seek(offset);
+    libssh2_sftp_seek64(m_sftpfile, static_cast<libssh2_uint64_t>(offset));
+    m_rangeToRead = m_ranges[m_range].second;
+    m_begin = m_buffer;
+    m_nread = 0;
+    m_eof = false;
+    return true;
 }
 
 void SshSftpCommandSend::process()
 {
+    if(m_cancelled && m_state == CommandState::Exec)
+    {
+        m_error = true;
+        m_errMsg << "Cancelled";
+        m_nread = 0;
+        setState(CommandState::Closing);
+    }
     switch(m_state)
     {
     case Openning:
@@ -18,7 +112,7 @@ void SshSftpCommandSend::process()
                     sftp().getSftpSession(),
                     qPrintable(m_dest),
                     static_cast<unsigned int>(m_dest.size()),
-                    LIBSSH2_FXF_WRITE|LIBSSH2_FXF_CREAT|LIBSSH2_FXF_TRUNC,
+                    (m_mode == Overwrite) ? (LIBSSH2_FXF_WRITE|LIBSSH2_FXF_CREAT|LIBSSH2_FXF_TRUNC) : (LIBSSH2_FXF_WRITE|LIBSSH2_FXF_CREAT),
                     LIBSSH2_SFTP_S_IRUSR|LIBSSH2_SFTP_S_IWUSR| LIBSSH2_SFTP_S_IRGRP|LIBSSH2_SFTP_S_IROTH,
                     LIBSSH2_SFTP_OPENFILE
                     );
@@ -30,6 +124,7 @@ void SshSftpCommandSend::process()
             int ret = libssh2_session_last_error(sftp().sshClient()->session(), &emsg, &size, 0);
             if(ret == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             qCDebug(logsshsftp) << "Can't open SFTP file " << m_dest << ", " << QString(emsg);
@@ -39,63 +134,159 @@ void SshSftpCommandSend::process()
             return;
         }
 
-        if(!m_localfile.open(QIODevice::ReadOnly))
+        /* Read ahead by the I/O thread while the transfer is prepared */
+        m_localfile.open(m_source, QIODevice::ReadOnly);
+
+        /*
+         * libssh2_sftp_write() sends the whole buffer as a train of write
+         * requests and returns each time the first ones are acknowledged.
+         * The buffer holds window * chunk bytes and is refilled as soon as
+         * a chunk is acknowledged, so the window stays full on the link.
+         */
+        m_chunkSize = sftp().transferChunkSize();
+        m_bufferSize = sftp().transferBufferSize();
+        m_buffer = SshBufferPool::instance().acquire(m_bufferSize);
+        m_begin = m_buffer;
+        setState(CommandState::Exec);
+        FALLTHROUGH;
+    case Exec:
+        if(m_localfile.isError())
         {
-            qCWarning(logsshsftp) << "Can't open local file " << m_localfile.fileName();
+            qCWarning(logsshsftp) << "Can't read local file " << m_source << ", " << m_localfile.errorString();
             m_error = true;
-            m_errMsg << "Can't open local file " + m_localfile.fileName();
+            m_errMsg << "Can't read local file " + m_source + ", " + m_localfile.errorString();
+            m_nread = 0;
             setState(CommandState::Closing);
-            break;
         }
-        setState(CommandState::Exec);
-        FALLTHROUGH;
-    case Exec:
-        while(1)
+        else if(!m_prepared)
+        {
+            if(!_prepare())
+            {
+                return;
+            }
+            m_prepared = true;
+            if(!_nextRange())
+            {
+                m_eof = true;
+            }
+        }
+
+        while(m_state == CommandState::Exec)
         {
-            if(m_nread == 0 && m_localfile.isOpen())
+            if(!m_eof && m_bufferSize - m_nread >= m_chunkSize)
             {
-                m_nread = m_localfile.read(m_buffer, SFTP_BUFFER_SIZE);
-                if (m_nread <= 0) {
-                    /* end of file */
+                /* Unacknowledged data must stay at the head of the buffer */
+                if(m_begin != m_buffer && m_nread > 0)
+                {
+                    std::memmove(m_buffer, m_begin, m_nread);
+                }
+                m_begin = m_buffer;
+                qint64 len = qMin(static_cast<qint64>(m_bufferSize - m_nread), m_rangeToRead);
+                qint64 nread = m_localfile.read(m_buffer + m_nread, len);
+                if(m_localfile.isError())
+                {
+                    qCWarning(logsshsftp) << "Can't read local file " << m_source << ", " << m_localfile.errorString();
+                    m_error = true;
+                    m_errMsg << "Can't read local file " + m_source + ", " + m_localfile.errorString();
+                    m_nread = 0;
                     setState(CommandState::Closing);
                     break;
                 }
-                m_begin = m_buffer;
+                m_rangeToRead -= nread;
+                if(m_rangeToRead == 0 || (nread == 0 && m_localfile.atEnd()))
+                {
+                    m_eof = true;
+                }
+                m_nread += static_cast<size_t>(nread);
             }
-            while(m_nread != 0)
+            if(m_nread == 0 && !m_eof)
             {
-                ssize_t rc = libssh2_sftp_write(m_sftpfile, m_begin, m_nread);
-                if(rc < 0)
+                /* Block not read yet, woken by ready() */
+                return;
+            }
+            if(m_nread == 0)
+            {
+                /* Range acknowledged, seek to the next one */
+                if(_nextRange())
+                {
+                    continue;
+                }
+                if(m_truncate)
                 {
+                    LIBSSH2_SFTP_ATTRIBUTES attrs {};
+                    attrs.flags = LIBSSH2_SFTP_ATTR_SIZE;
+                    attrs.filesize = static_cast<libssh2_uint64_t>(m_localfile.size());
+                    int rc = libssh2_sftp_fsetstat(m_sftpfile, &attrs);
                     if(rc == LIBSSH2_ERROR_EAGAIN)
                     {
+                        holdSession();
                         return;
                     }
-                    qCWarning(logsshsftp) << "SFTP Write error " << rc;
+                    if(rc < 0)
+                    {
+                        qCWarning(logsshsftp) << "SFTP truncate error " << rc;
+                        m_error = true;
+                        m_errMsg << QString("SFTP truncate error: %1").arg(rc);
+                    }
+                    m_truncate = false;
                 }
-                m_nread -= rc;
-                m_begin += rc;
+                /* end of file, everything acknowledged */
+                setState(CommandState::Closing);
+                break;
+            }
+
+            /*
+             * Writes of the SFTP session share its channel turn. The whole
+             * buffer is still given to keep the request train, the turn
+             * is charged with the acknowledged bytes.
+             */
+            SshWriteScheduler &scheduler = sftp().sshClient()->writeScheduler();
+            if(scheduler.grant(&sftp(), m_nread) == 0)
+            {
+                return;
+            }
+            ssize_t rc = libssh2_sftp_write(m_sftpfile, m_begin, m_nread);
+            if(rc == LIBSSH2_ERROR_EAGAIN || rc == 0)
+            {
+                holdSession();
+                return;
+            }
+            if(rc < 0)
+            {
+                qCWarning(logsshsftp) << "SFTP Write error " << rc;
+                m_error = true;
+                m_errMsg << QString("SFTP write error: %1").arg(rc);
+                m_nread = 0;
+                setState(CommandState::Closing);
+                break;
             }
+            scheduler.consumed(&sftp(), static_cast<size_t>(rc));
+            m_nread -= static_cast<size_t>(rc);
+            m_begin += rc;
+            m_sent += rc;
+            emit progress(m_sent, m_localfile.size());
         }
-        break;
+        FALLTHROUGH;
 
     case Closing:
     {
-        if(m_localfile.isOpen())
-        {
-            m_localfile.close();
-        }
+        m_localfile.close();
+        SshBufferPool::instance().release(m_buffer, m_bufferSize);
+        m_buffer = nullptr;
+        m_begin = nullptr;
         int rc = libssh2_sftp_close_handle(m_sftpfile);
         if(rc < 0)
         {
             if(rc == LIBSSH2_ERROR_EAGAIN)
             {
+                holdSession();
                 return;
             }
             qCWarning(logsshsftp) << "SFTP close error " << rc;
             m_errMsg << QString("SFTP close error: %1").arg(rc);
             setState(CommandState::Error);
         }
+        sftp().attrCache().invalidate(m_dest);
         if(m_error)
         {
             setState(CommandState::Error);
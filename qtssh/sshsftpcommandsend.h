@@ -2,30 +2,60 @@
 #define SSHSFTPCOMMANDSEND_H
 
 #include <QObject>
-#include <QFile>
 #include <QFileInfo>
+#include <QList>
+#include <QPair>
 #include <sshsftpcommand.h>
+#include "sshfilestream.h"
 
 class SshSFtp;
 
-#define SshSftpCommandSend_BUFFER_SIZE 4096
-
 class SshSftpCommandSend: public SshSftpCommand
 {
     Q_OBJECT
 
+public:
+    enum SendMode {
+        Overwrite,      /* Truncate and send the whole file */
+        Resume,         /* Continue after the data already on the server */
+        Ranges          /* Only send the given ranges (delta) */
+    };
+    Q_ENUM(SendMode)
+
+private:
     QString m_dest;
     bool m_error {false};
+    SendMode m_mode {Overwrite};
 
-    QFile m_localfile;
-    char m_buffer[SFTP_BUFFER_SIZE];
+    QString m_source;
+    SshFileStream m_localfile;
+    char *m_buffer {nullptr};
+    size_t m_bufferSize {0};
+    size_t m_chunkSize {0};
     char *m_begin {nullptr};
     size_t m_nread {0};
+    bool m_eof {false};
     LIBSSH2_SFTP_HANDLE *m_sftpfile {nullptr};
+    qint64 m_sent {0};
+
+    /* Ranges (offset, length) of the local file to send */
+    QList<QPair<qint64, qint64>> m_ranges;
+    bool m_prepared {false};
+    bool m_truncate {false};
+    int m_range {-1};
+    qint64 m_rangeToRead {0};
+
+    bool _prepare();
+    bool _nextRange();
 
 public:
     SshSftpCommandSend(const QString &source, QString dest, SshSFtp &parent);
+    virtual ~SshSftpCommandSend() override;
     void process() override;
+
+    void setMode(SendMode mode);
+    void setRanges(const QList<QPair<qint64, qint64>> &ranges);
+    qint64 bytesSent() const;
 };
 
 #endif // SSHSFTPCOMMANDSEND_H
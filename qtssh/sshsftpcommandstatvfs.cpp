@@ -0,0 +1,70 @@
+#include "sshsftpcommandstatvfs.h"
+#include "sshclient.h"
+
+SshSftpCommandStatVfs::SshSftpCommandStatVfs(const QString &path, SshSFtp &parent)
+    : SshSftpCommand(parent)
+    , m_path(path)
+{
+    setName(QString("statvfs(%1)").arg(path));
+}
+
+bool SshSftpCommandStatVfs::error() const
+{
+    return m_error;
+}
+
+LIBSSH2_SFTP_STATVFS SshSftpCommandStatVfs::statvfs() const
+{
+    return m_statvfs;
+}
+
+quint64 SshSftpCommandStatVfs::bytesAvailable() const
+{
+    return static_cast<quint64>(m_statvfs.f_bavail) * m_statvfs.f_frsize;
+}
+
+quint64 SshSftpCommandStatVfs::bytesTotal() const
+{
+    return static_cast<quint64>(m_statvfs.f_blocks) * m_statvfs.f_frsize;
+}
+
+void SshSftpCommandStatVfs::process()
+{
+    int res;
+    QByteArray path = m_path.toUtf8();
+    switch(m_state)
+    {
+    case Openning:
+        res = libssh2_sftp_statvfs(
+                    sftp().getSftpSession(),
+                    path.constData(),
+                    static_cast<size_t>(path.size()),
+                    &m_statvfs
+                    );
+
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP statvfs error: %1").arg(res);
+            qCWarning(logsshsftp) << "SFTP statvfs error " << res;
+            setState(CommandState::Error);
+            break;
+        }
+        setState(CommandState::Terminate);
+        FALLTHROUGH;
+    case Terminate:
+        break;
+
+    case Error:
+        break;
+
+    default:
+        setState(CommandState::Terminate);
+        break;
+    }
+}
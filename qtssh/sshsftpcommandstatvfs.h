@@ -0,0 +1,24 @@
+#ifndef SSHSFTPCOMMANDSTATVFS_H
+#define SSHSFTPCOMMANDSTATVFS_H
+
+#include <QObject>
+#include <sshsftpcommand.h>
+
+/* File system usage, needs the statvfs@openssh.com extension */
+class SshSftpCommandStatVfs : public SshSftpCommand
+{
+    Q_OBJECT
+    QString m_path;
+    bool m_error {false};
+    LIBSSH2_SFTP_STATVFS m_statvfs {};
+
+public:
+    SshSftpCommandStatVfs(const QString &path, SshSFtp &parent);
+    void process() override;
+    bool error() const;
+    LIBSSH2_SFTP_STATVFS statvfs() const;
+    quint64 bytesAvailable() const;
+    quint64 bytesTotal() const;
+};
+
+#endif // SSHSFTPCOMMANDSTATVFS_H
@@ -0,0 +1,102 @@
+#include "sshsftpcommandsymlink.h"
+#include "sshclient.h"
+
+#define SFTP_PATH_MAX 4096
+
+SshSftpCommandSymlink::SshSftpCommandSymlink(const QString &path, const QString &target, Mode mode, SshSFtp &parent)
+    : SshSftpCommand(parent)
+    , m_path(path)
+    , m_target(target)
+    , m_mode(mode)
+{
+    switch(mode)
+    {
+    case Symlink:
+        setName(QString("symlink(%1, %2)").arg(path, target));
+        break;
+    case Readlink:
+        setName(QString("readlink(%1)").arg(path));
+        break;
+    case Realpath:
+        setName(QString("realpath(%1)").arg(path));
+        break;
+    }
+}
+
+bool SshSftpCommandSymlink::error() const
+{
+    return m_error;
+}
+
+QString SshSftpCommandSymlink::target() const
+{
+    return m_target;
+}
+
+void SshSftpCommandSymlink::process()
+{
+    int res;
+    QByteArray path = m_path.toUtf8();
+    switch(m_state)
+    {
+    case Openning:
+        if(m_mode == Symlink)
+        {
+            /* libssh2 order: what the link points to, then the link */
+            QByteArray target = m_target.toUtf8();
+            res = libssh2_sftp_symlink_ex(
+                        sftp().getSftpSession(),
+                        target.constData(),
+                        static_cast<unsigned int>(target.size()),
+                        path.data(),
+                        static_cast<unsigned int>(path.size()),
+                        LIBSSH2_SFTP_SYMLINK
+                        );
+        }
+        else
+        {
+            char buffer[SFTP_PATH_MAX];
+            res = libssh2_sftp_symlink_ex(
+                        sftp().getSftpSession(),
+                        path.constData(),
+                        static_cast<unsigned int>(path.size()),
+                        buffer,
+                        sizeof(buffer),
+                        (m_mode == Readlink) ? LIBSSH2_SFTP_READLINK : LIBSSH2_SFTP_REALPATH
+                        );
+            if(res >= 0)
+            {
+                m_target = QString::fromUtf8(buffer, res);
+            }
+        }
+
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        if(m_mode == Symlink)
+        {
+            sftp().attrCache().invalidate(m_path);
+        }
+        if(res < 0)
+        {
+            m_error = true;
+            m_errMsg << QString("SFTP %1 error: %2").arg(name()).arg(res);
+            qCWarning(logsshsftp) << "SFTP" << name() << "error " << res;
+            setState(CommandState::Error);
+            break;
+        }
+        setState(CommandState::Terminate);
+        FALLTHROUGH;
+    case Terminate:
+        break;
+
+    case Error:
+        break;
+
+    default:
+        setState(CommandState::Terminate);
+        break;
+    }
+}
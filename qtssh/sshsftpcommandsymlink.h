@@ -0,0 +1,33 @@
+#ifndef SSHSFTPCOMMANDSYMLINK_H
+#define SSHSFTPCOMMANDSYMLINK_H
+
+#include <QObject>
+#include <sshsftpcommand.h>
+
+/* Create a symbolic link, or read one (target() is the result) */
+class SshSftpCommandSymlink : public SshSftpCommand
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        Symlink,
+        Readlink,
+        Realpath
+    };
+
+private:
+    QString m_path;
+    QString m_target;
+    Mode m_mode;
+    bool m_error {false};
+
+public:
+    /* Symlink: path -> target. Readlink and Realpath: target ignored */
+    SshSftpCommandSymlink(const QString &path, const QString &target, Mode mode, SshSFtp &parent);
+    void process() override;
+    bool error() const;
+    QString target() const;
+};
+
+#endif // SSHSFTPCOMMANDSYMLINK_H
@@ -25,12 +25,14 @@ void SshSftpCommandUnlink::process()
                     static_cast<unsigned int>(m_path.size())
                     );
 
+        if(res == LIBSSH2_ERROR_EAGAIN)
+        {
+            holdSession();
+            return;
+        }
+        sftp().attrCache().invalidateTree(m_path);
         if(res < 0)
         {
-            if(res == LIBSSH2_ERROR_EAGAIN)
-            {
-                return;
-            }
             m_error = true;
             m_errMsg << QString("SFTP unlink error: %1").arg(res);
             qCWarning(logsshsftp) << "SFTP unlink error " << res;
@@ -7,7 +7,7 @@
 class SshSftpCommandUnlink : public SshSftpCommand
 {
     Q_OBJECT
-    const QString &m_path;
+    QString m_path;
     bool m_error {false};
 
 public:
@@ -0,0 +1,276 @@
+#include "sshsftpfile.h"
+#include "sshsftp.h"
+#include "sshsftpcommandfile.h"
+#include <QEventLoop>
+#include <QTimer>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(logsshsftpfile, "ssh.sftpfile", QtWarningMsg)
+
+SshSftpFile::SshSftpFile(SshSFtp *sftp, const QString &path, QObject *parent)
+    : QIODevice(parent)
+    , m_sftp(sftp)
+    , m_path(path)
+{
+}
+
+SshSftpFile::~SshSftpFile()
+{
+    if(isOpen())
+    {
+        close();
+    }
+}
+
+QString SshSftpFile::fileName() const
+{
+    return m_path;
+}
+
+void SshSftpFile::setReadAheadSize(qint64 size)
+{
+    m_readAhead = qMax<qint64>(size, 4096);
+}
+
+qint64 SshSftpFile::readAheadSize() const
+{
+    return m_readAhead;
+}
+
+void SshSftpFile::setWriteBehindSize(qint64 size)
+{
+    m_writeBehind = qMax<qint64>(size, 4096);
+}
+
+qint64 SshSftpFile::writeBehindSize() const
+{
+    return m_writeBehind;
+}
+
+void SshSftpFile::setTimeout(int msecs)
+{
+    m_timeout = msecs;
+}
+
+bool SshSftpFile::open(OpenMode mode)
+{
+    if(isOpen() || !m_sftp)
+    {
+        return false;
+    }
+
+    unsigned long flags = 0;
+    if(mode & QIODevice::ReadOnly)
+        flags |= LIBSSH2_FXF_READ;
+    if(mode & QIODevice::WriteOnly)
+    {
+        flags |= LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT;
+        /* Same rule as QFile: write only truncates, unless appending */
+        if((mode & QIODevice::Truncate) || (!(mode & QIODevice::ReadOnly) && !(mode & QIODevice::Append)))
+            flags |= LIBSSH2_FXF_TRUNC;
+    }
+    long perms = LIBSSH2_SFTP_S_IRUSR | LIBSSH2_SFTP_S_IWUSR | LIBSSH2_SFTP_S_IRGRP | LIBSSH2_SFTP_S_IROTH;
+
+    m_cmd = new SshSftpCommandFile(m_path, flags, perms, *m_sftp);
+    QObject::connect(m_cmd, &SshSftpCommandFile::written, this, [this](qint64 bytes){
+        if(bytes > 0)
+            emit bytesWritten(bytes);
+    });
+    m_sftp->enqueueCmd(m_cmd);
+    _waitFor(m_timeout, [this](){ return m_cmd->isOpened(); });
+    if(!m_cmd || !m_cmd->isOpened())
+    {
+        setErrorString((m_cmd) ? m_cmd->errMsg().join("; ") : QString("SFTP channel closed"));
+        qCWarning(logsshsftpfile) << "Can't open" << m_path << ":" << errorString();
+        if(m_cmd)
+            m_cmd->deleteLater();
+        return false;
+    }
+
+    m_size = m_cmd->fileSize();
+    m_cache.clear();
+    m_writeBuffer.clear();
+    /* Our own buffers: nothing to gain from the QIODevice one */
+    QIODevice::open(mode | QIODevice::Unbuffered);
+    if(mode & QIODevice::Append)
+    {
+        QIODevice::seek(m_size);
+    }
+    return true;
+}
+
+void SshSftpFile::close()
+{
+    if(!isOpen())
+    {
+        return;
+    }
+    emit aboutToClose();
+    if(m_cmd)
+    {
+        _sendWrites();
+        m_cmd->closeFile();
+        _waitFor(m_timeout, [this](){ return m_cmd->state() == SshSftpCommand::CommandState::Terminate; });
+        if(m_cmd && m_cmd->error())
+        {
+            setErrorString(m_cmd->errMsg().join("; "));
+        }
+        if(m_cmd)
+            m_cmd->deleteLater();
+    }
+    m_cache.clear();
+    QIODevice::close();
+}
+
+bool SshSftpFile::isSequential() const
+{
+    return false;
+}
+
+qint64 SshSftpFile::size() const
+{
+    return m_size;
+}
+
+bool SshSftpFile::seek(qint64 pos)
+{
+    /* The write buffer is sent when the next write isn't contiguous */
+    return QIODevice::seek(pos);
+}
+
+bool SshSftpFile::atEnd() const
+{
+    return pos() >= m_size;
+}
+
+qint64 SshSftpFile::bytesToWrite() const
+{
+    qint64 pending = (m_cmd) ? m_cmd->pendingWrite() : 0;
+    return pending + m_writeBuffer.size();
+}
+
+bool SshSftpFile::waitForBytesWritten(int msecs)
+{
+    _sendWrites();
+    if(!m_cmd || m_cmd->pendingWrite() == 0)
+    {
+        return false;
+    }
+    qint64 pending = m_cmd->pendingWrite();
+    return _waitFor(msecs, [this, pending](){ return m_cmd->pendingWrite() < pending; });
+}
+
+bool SshSftpFile::flush()
+{
+    _sendWrites();
+    if(!m_cmd)
+    {
+        return false;
+    }
+    _waitFor(m_timeout, [this](){ return m_cmd->pendingWrite() == 0 || m_cmd->error(); });
+    return m_cmd && m_cmd->pendingWrite() == 0 && !m_cmd->error();
+}
+
+void SshSftpFile::_sendWrites()
+{
+    if(m_writeBuffer.isEmpty() || !m_cmd)
+    {
+        return;
+    }
+    QByteArray data;
+    data.swap(m_writeBuffer);
+    m_cmd->write(m_writeOffset, data);
+}
+
+qint64 SshSftpFile::readData(char *data, qint64 maxlen)
+{
+    if(!m_cmd)
+    {
+        return -1;
+    }
+    qint64 offset = pos();
+
+    if(offset < m_cacheOffset || offset >= m_cacheOffset + m_cache.size())
+    {
+        /* Miss: pending writes go before the read, then read ahead */
+        _sendWrites();
+        m_cmd->read(offset, qMax(maxlen, m_readAhead));
+        _waitFor(m_timeout, [this](){ return !m_cmd->isReading(); });
+        if(!m_cmd || m_cmd->isReading() || m_cmd->readError())
+        {
+            setErrorString((m_cmd) ? m_cmd->errMsg().join("; ") : QString("SFTP channel closed"));
+            return -1;
+        }
+        m_cache = m_cmd->takeReadData();
+        m_cacheOffset = offset;
+        if(m_cache.isEmpty())
+        {
+            return 0;
+        }
+    }
+
+    qint64 start = offset - m_cacheOffset;
+    qint64 len = qMin(maxlen, static_cast<qint64>(m_cache.size()) - start);
+    memcpy(data, m_cache.constData() + start, static_cast<size_t>(len));
+    return len;
+}
+
+qint64 SshSftpFile::writeData(const char *data, qint64 len)
+{
+    if(!m_cmd || m_cmd->error())
+    {
+        setErrorString("SFTP write error");
+        return -1;
+    }
+    qint64 offset = pos();
+    if(!m_writeBuffer.isEmpty() && offset != m_writeOffset + m_writeBuffer.size())
+    {
+        _sendWrites();
+    }
+    if(m_writeBuffer.isEmpty())
+    {
+        m_writeOffset = offset;
+    }
+    m_writeBuffer.append(data, static_cast<int>(len));
+
+    /* The cached range may hold the old data */
+    if(offset < m_cacheOffset + m_cache.size() && offset + len > m_cacheOffset)
+    {
+        m_cache.clear();
+    }
+    m_size = qMax(m_size, offset + len);
+
+    if(m_writeBuffer.size() >= m_writeBehind)
+    {
+        _sendWrites();
+    }
+    return len;
+}
+
+bool SshSftpFile::_waitFor(int msecs, const std::function<bool()> &done)
+{
+    QEventLoop wait;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &wait, &QEventLoop::quit);
+    QObject::connect(m_cmd, &SshSftpCommandFile::opened, &wait, &QEventLoop::quit);
+    QObject::connect(m_cmd, &SshSftpCommandFile::readDone, &wait, &QEventLoop::quit);
+    QObject::connect(m_cmd, &SshSftpCommandFile::written, &wait, &QEventLoop::quit);
+    QObject::connect(m_cmd, &SshSftpCommand::stateChanged, &wait, &QEventLoop::quit);
+    QObject::connect(m_cmd, &QObject::destroyed, &wait, &QEventLoop::quit);
+    if(msecs >= 0)
+    {
+        timeout.start(msecs);
+    }
+
+    /* A command in error won't make progress anymore */
+    while(m_cmd && !done() && m_cmd->state() != SshSftpCommand::CommandState::Error)
+    {
+        if(msecs >= 0 && !timeout.isActive())
+        {
+            return false;
+        }
+        wait.exec();
+    }
+    return m_cmd && done();
+}
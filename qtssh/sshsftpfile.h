@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QIODevice>
+#include <QPointer>
+#include <QLoggingCategory>
+#include <functional>
+
+class SshSFtp;
+class SshSftpCommandFile;
+
+Q_DECLARE_LOGGING_CATEGORY(logsshsftpfile)
+
+/**
+ * \brief Random access QIODevice on a remote file
+ * \details The remote handle is a command of the SFTP channel, only the
+ * requested ranges are transferred. Reads go through a read-ahead cache
+ * of readAheadSize() bytes. Contiguous writes are gathered in a
+ * write-behind buffer and sent in the background once writeBehindSize()
+ * bytes are waiting, on seek elsewhere, read, flush() or close().
+ * Read, open and flush block in a local event loop, like the SshSFtp
+ * synchronous API.
+ */
+class SshSftpFile : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    SshSftpFile(SshSFtp *sftp, const QString &path, QObject *parent = nullptr);
+    virtual ~SshSftpFile() override;
+
+    QString fileName() const;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+    bool atEnd() const override;
+    qint64 bytesToWrite() const override;
+    bool waitForBytesWritten(int msecs) override;
+    bool flush();
+
+    void setReadAheadSize(qint64 size);
+    qint64 readAheadSize() const;
+    void setWriteBehindSize(qint64 size);
+    qint64 writeBehindSize() const;
+    /* Limit of the blocking operations */
+    void setTimeout(int msecs);
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    QPointer<SshSFtp> m_sftp;
+    QString m_path;
+    QPointer<SshSftpCommandFile> m_cmd;
+    qint64 m_size {0};
+    int m_timeout {30000};
+
+    qint64 m_cacheOffset {0};
+    QByteArray m_cache;
+    qint64 m_readAhead {64 * 1024};
+
+    qint64 m_writeOffset {0};
+    QByteArray m_writeBuffer;
+    qint64 m_writeBehind {256 * 1024};
+
+    void _sendWrites();
+    bool _waitFor(int msecs, const std::function<bool()> &done);
+};
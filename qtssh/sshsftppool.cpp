@@ -0,0 +1,153 @@
+#include "sshsftppool.h"
+#include "sshclient.h"
+#include "sshsftp.h"
+
+Q_LOGGING_CATEGORY(logsshsftppool, "ssh.sftp.pool", QtWarningMsg)
+
+SshSftpPool::SshSftpPool(SshClient *client)
+    : QObject(client)
+    , m_client(client)
+{
+    QObject::connect(&m_idleTimer, &QTimer::timeout, this, &SshSftpPool::_closeIdle);
+}
+
+SshSftpPool::~SshSftpPool()
+{
+    /* The subsystems are channels of the client, it frees them */
+}
+
+void SshSftpPool::setMaxSessions(int max)
+{
+    m_maxSessions = qMax(1, max);
+}
+
+int SshSftpPool::maxSessions() const
+{
+    return m_maxSessions;
+}
+
+void SshSftpPool::setIdleTimeout(int msec)
+{
+    m_idleTimeout = qMax(0, msec);
+    if(m_idleTimeout == 0)
+    {
+        m_idleTimer.stop();
+    }
+    else if(!m_sessions.isEmpty())
+    {
+        m_idleTimer.start(qMax(m_idleTimeout / 2, 100));
+    }
+}
+
+int SshSftpPool::idleTimeout() const
+{
+    return m_idleTimeout;
+}
+
+int SshSftpPool::sessionCount() const
+{
+    int count = 0;
+    for(const Session &session: m_sessions)
+    {
+        if(session.sftp)
+            count++;
+    }
+    return count;
+}
+
+void SshSftpPool::_prune()
+{
+    for(int i = m_sessions.size() - 1; i >= 0; --i)
+    {
+        SshSFtp *sftp = m_sessions.at(i).sftp.data();
+        if(sftp == nullptr || sftp->channelState() >= SshChannel::ChannelState::Close)
+        {
+            m_sessions.removeAt(i);
+        }
+    }
+}
+
+SshSFtp *SshSftpPool::acquire()
+{
+    _prune();
+
+    int best = -1;
+    int bestLoad = 0;
+    for(int i = 0; i < m_sessions.size(); ++i)
+    {
+        int load = m_sessions.at(i).sftp->pendingCommands();
+        if(best < 0 || load < bestLoad)
+        {
+            best = i;
+            bestLoad = load;
+        }
+    }
+
+    if(best < 0 || (bestLoad > 0 && m_sessions.size() < m_maxSessions))
+    {
+        /* Opened lazily: commands wait in its queue until it is Ready */
+        QString name = QString("%1_sftppool_%2").arg(m_client->getName()).arg(m_id++);
+        SshSFtp *sftp = m_client->getChannel<SshSFtp>(name);
+        QObject::connect(sftp, &SshSFtp::cmdEvent, this, [this, sftp](){ _activity(sftp); });
+        Session session;
+        session.sftp = sftp;
+        m_sessions.append(session);
+        best = m_sessions.size() - 1;
+        qCDebug(logsshsftppool) << "Open" << name << "," << m_sessions.size() << "subsystems";
+        if(m_idleTimeout > 0 && !m_idleTimer.isActive())
+        {
+            m_idleTimer.start(qMax(m_idleTimeout / 2, 100));
+        }
+    }
+
+    m_sessions[best].idle.start();
+    return m_sessions.at(best).sftp.data();
+}
+
+void SshSftpPool::_activity(SshSFtp *sftp)
+{
+    for(Session &session: m_sessions)
+    {
+        if(session.sftp == sftp)
+        {
+            session.idle.start();
+            return;
+        }
+    }
+}
+
+void SshSftpPool::_closeIdle()
+{
+    _prune();
+    for(int i = m_sessions.size() - 1; i >= 0; --i)
+    {
+        Session &session = m_sessions[i];
+        if(session.sftp->pendingCommands() == 0 && session.idle.hasExpired(m_idleTimeout))
+        {
+            qCDebug(logsshsftppool) << "Close idle" << session.sftp->name();
+            SshSFtp *sftp = session.sftp.data();
+            m_sessions.removeAt(i);
+            QObject::disconnect(sftp, nullptr, this, nullptr);
+            sftp->close();
+        }
+    }
+    if(m_sessions.isEmpty())
+    {
+        m_idleTimer.stop();
+    }
+}
+
+void SshSftpPool::clear()
+{
+    const QList<Session> sessions = m_sessions;
+    m_sessions.clear();
+    m_idleTimer.stop();
+    for(const Session &session: sessions)
+    {
+        if(session.sftp)
+        {
+            QObject::disconnect(session.sftp, nullptr, this, nullptr);
+            session.sftp->close();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+class SshClient;
+class SshSFtp;
+
+Q_DECLARE_LOGGING_CATEGORY(logsshsftppool)
+
+/**
+ * \brief SFTP subsystems of one SshClient shared by all its users
+ * \details acquire() gives the least busy subsystem (fewest commands
+ * queued), opening a new one only when all are busy and fewer than
+ * maxSessions() are open. Subsystems without command for idleTimeout()
+ * are closed. The subsystem is for the operations started right after
+ * acquire(): keep a QPointer, don't hold it, acquire again next time.
+ */
+class SshSftpPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshSftpPool(SshClient *client);
+    virtual ~SshSftpPool() override;
+
+    void setMaxSessions(int max);
+    int maxSessions() const;
+    /* 0 keeps idle subsystems open */
+    void setIdleTimeout(int msec);
+    int idleTimeout() const;
+
+    SshSFtp *acquire();
+    int sessionCount() const;
+    /* Close every subsystem, in use or not */
+    void clear();
+
+private:
+    struct Session {
+        QPointer<SshSFtp> sftp;
+        QElapsedTimer idle;
+    };
+
+    SshClient *m_client;
+    QList<Session> m_sessions;
+    int m_maxSessions {4};
+    int m_idleTimeout {60000};
+    int m_id {0};
+    QTimer m_idleTimer;
+
+    void _prune();
+    void _activity(SshSFtp *sftp);
+    void _closeIdle();
+};
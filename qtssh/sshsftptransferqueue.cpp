@@ -0,0 +1,205 @@
+#include "sshsftptransferqueue.h"
+#include "sshsftpcommandsend.h"
+#include "sshsftpcommandget.h"
+#include <QFileInfo>
+#include <QEventLoop>
+
+#define DEBUGQ qCDebug(logsshsftp) << m_sftp.name() << "queue"
+
+SshSftpTransferQueue::SshSftpTransferQueue(SshSFtp &sftp, int concurrency, QObject *parent)
+    : QObject(parent)
+    , m_sftp(sftp)
+    , m_concurrency(qMax(1, concurrency))
+{
+    /* Commands are children of the channel, gone with it */
+    QObject::connect(&m_sftp, &QObject::destroyed, this, [this](){ m_running.clear(); });
+}
+
+SshSftpTransferQueue::~SshSftpTransferQueue()
+{
+    /* The channel may still be processing them: it stops and deletes them */
+    const QList<SshSftpCommand *> running = m_running.keys();
+    m_running.clear();
+    for(SshSftpCommand *cmd: running)
+    {
+        QObject::disconnect(cmd, nullptr, this, nullptr);
+        m_sftp.cancelCmd(cmd);
+    }
+}
+
+int SshSftpTransferQueue::concurrency() const
+{
+    return m_concurrency;
+}
+
+void SshSftpTransferQueue::setConcurrency(int concurrency)
+{
+    m_concurrency = qMax(1, concurrency);
+    if(m_started)
+        _startNext();
+}
+
+int SshSftpTransferQueue::enqueueSend(const QString &source, const QString &dest)
+{
+    QString s(source);
+    s.replace("qrc:/", ":/");
+    Transfer t {Send, s, dest, Pending, 0, QFileInfo(s).size(), {}};
+    m_transfers.append(t);
+    _addTotal(t.total);
+    if(m_started)
+        _startNext();
+    return m_transfers.size() - 1;
+}
+
+int SshSftpTransferQueue::enqueueGet(const QString &source, const QString &dest)
+{
+    Transfer t {Get, source, dest, Pending, 0, -1, {}};
+    m_transfers.append(t);
+    _addTotal(t.total);
+    if(m_started)
+        _startNext();
+    return m_transfers.size() - 1;
+}
+
+void SshSftpTransferQueue::start()
+{
+    DEBUGQ << "start" << m_transfers.size() << "transfers," << m_concurrency << "in parallel";
+    m_started = true;
+    _startNext();
+    if(isFinished())
+        emit finished();
+}
+
+bool SshSftpTransferQueue::waitForFinished()
+{
+    if(!m_started)
+        start();
+
+    QEventLoop wait(this);
+    QObject::connect(this, &SshSftpTransferQueue::finished, &wait, &QEventLoop::quit);
+    QObject::connect(&m_sftp, &SshChannel::stateChanged, &wait, &QEventLoop::quit);
+    while(!isFinished() && m_sftp.channelState() <= SshChannel::ChannelState::Ready)
+    {
+        wait.exec();
+    }
+    return isFinished() && m_failed == 0;
+}
+
+bool SshSftpTransferQueue::isRunning() const
+{
+    return m_started && !isFinished();
+}
+
+bool SshSftpTransferQueue::isFinished() const
+{
+    return m_finished == m_transfers.size();
+}
+
+int SshSftpTransferQueue::count() const
+{
+    return m_transfers.size();
+}
+
+int SshSftpTransferQueue::finishedCount() const
+{
+    return m_finished;
+}
+
+int SshSftpTransferQueue::failedCount() const
+{
+    return m_failed;
+}
+
+qint64 SshSftpTransferQueue::bytesDone() const
+{
+    return m_bytesDone;
+}
+
+qint64 SshSftpTransferQueue::bytesTotal() const
+{
+    /* Unknown while the size of a downloaded file is not known */
+    return (m_unknownSizes > 0) ? -1 : m_bytesTotal;
+}
+
+void SshSftpTransferQueue::_addTotal(qint64 total)
+{
+    if(total < 0)
+        ++m_unknownSizes;
+    else
+        m_bytesTotal += total;
+}
+
+const QList<SshSftpTransferQueue::Transfer> &SshSftpTransferQueue::transfers() const
+{
+    return m_transfers;
+}
+
+SshSftpTransferQueue::Transfer SshSftpTransferQueue::transfer(int index) const
+{
+    return m_transfers.value(index);
+}
+
+void SshSftpTransferQueue::_startNext()
+{
+    while(m_running.size() < m_concurrency && m_next < m_transfers.size())
+    {
+        int index = m_next++;
+        Transfer &t = m_transfers[index];
+        SshSftpCommand *cmd;
+        if(t.direction == Send)
+            cmd = m_sftp.asyncSend(t.source, t.dest);
+        else
+            cmd = m_sftp.asyncGet(t.source, t.dest);
+
+        t.state = Running;
+        m_running.insert(cmd, index);
+        QObject::connect(cmd, &SshSftpCommand::progress, this, [this, cmd](qint64 done, qint64){ _cmdProgress(cmd, done); });
+        QObject::connect(cmd, &SshSftpCommand::finished, this, [this, cmd](){ _cmdFinished(cmd); });
+    }
+}
+
+void SshSftpTransferQueue::_cmdProgress(SshSftpCommand *cmd, qint64 done)
+{
+    int index = m_running.value(cmd, -1);
+    if(index < 0)
+        return;
+    Transfer &t = m_transfers[index];
+    m_bytesDone += done - t.done;
+    t.done = done;
+    emit progress(bytesDone(), bytesTotal());
+}
+
+void SshSftpTransferQueue::_cmdFinished(SshSftpCommand *cmd)
+{
+    int index = m_running.value(cmd, -1);
+    if(index < 0)
+        return;
+    m_running.remove(cmd);
+
+    Transfer &t = m_transfers[index];
+    bool success = (cmd->state() == SshSftpCommand::CommandState::Terminate);
+    t.state = success ? Done : Failed;
+    t.errMsg = cmd->errMsg();
+    if(success && t.total < 0)
+    {
+        t.total = t.done;
+        --m_unknownSizes;
+        m_bytesTotal += t.total;
+    }
+    ++m_finished;
+    if(!success)
+    {
+        ++m_failed;
+        DEBUGQ << "transfer failed" << t.source << t.errMsg;
+    }
+    cmd->deleteLater();
+
+    emit transferFinished(index, success);
+    emit progress(bytesDone(), bytesTotal());
+    _startNext();
+    if(isFinished())
+    {
+        DEBUGQ << "finished," << m_failed << "failed";
+        emit finished();
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QStringList>
+#include "sshsftp.h"
+
+class SshSftpCommand;
+
+/**
+ * \brief Transfer a batch of files over one SFTP channel
+ * \details Up to concurrency() transfers run at the same time on the
+ * SshSFtp channel, so the opens, writes and closes of different files
+ * overlap on the wire. Progress is aggregated over the whole batch and
+ * each file keeps its own result and error messages.
+ */
+class SshSftpTransferQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Direction {
+        Send,
+        Get
+    };
+    Q_ENUM(Direction)
+
+    enum TransferState {
+        Pending,
+        Running,
+        Done,
+        Failed
+    };
+    Q_ENUM(TransferState)
+
+    struct Transfer {
+        Direction direction;
+        QString source;
+        QString dest;
+        TransferState state;
+        qint64 done;
+        qint64 total;
+        QStringList errMsg;
+    };
+
+private:
+    SshSFtp &m_sftp;
+    int m_concurrency;
+    QList<Transfer> m_transfers;
+    QHash<SshSftpCommand *, int> m_running;
+    int m_next {0};
+    int m_finished {0};
+    int m_failed {0};
+    bool m_started {false};
+    /* Running totals, bytesTotal() is unknown while m_unknownSizes > 0 */
+    qint64 m_bytesDone {0};
+    qint64 m_bytesTotal {0};
+    int m_unknownSizes {0};
+
+    void _addTotal(qint64 total);
+
+    void _startNext();
+    void _cmdFinished(SshSftpCommand *cmd);
+    void _cmdProgress(SshSftpCommand *cmd, qint64 done);
+
+public:
+    explicit SshSftpTransferQueue(SshSFtp &sftp, int concurrency = 8, QObject *parent = nullptr);
+    virtual ~SshSftpTransferQueue() override;
+
+    int concurrency() const;
+    void setConcurrency(int concurrency);
+
+    int enqueueSend(const QString &source, const QString &dest);
+    int enqueueGet(const QString &source, const QString &dest);
+
+    void start();
+    bool waitForFinished();
+
+    bool isRunning() const;
+    bool isFinished() const;
+    int count() const;
+    int finishedCount() const;
+    int failedCount() const;
+    qint64 bytesDone() const;
+    qint64 bytesTotal() const;
+
+    const QList<Transfer> &transfers() const;
+    Transfer transfer(int index) const;
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void transferFinished(int index, bool success);
+    void finished();
+};
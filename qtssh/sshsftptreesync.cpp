@@ -0,0 +1,393 @@
+#include "sshsftptreesync.h"
+#include "sshclient.h"
+#include "sshsftpcommandmkdir.h"
+#include "sshsftpcommandreaddir.h"
+#include "sshsftpcommandfileinfo.h"
+#include "sshsftptransferqueue.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QEventLoop>
+
+#define DEBUGTS qCDebug(logsshsftp) << m_name
+
+SshSftpTreeSync::SshSftpTreeSync(SshClient *client, int channels, const QString &name, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_name(name)
+    , m_channelCount(qMax(1, channels))
+{
+}
+
+SshSftpTreeSync::~SshSftpTreeSync()
+{
+    for(SshSFtp *sftp: m_sftp)
+    {
+        sftp->close();
+    }
+}
+
+int SshSftpTreeSync::channelCount() const
+{
+    return m_channelCount;
+}
+
+int SshSftpTreeSync::concurrency() const
+{
+    return m_concurrency;
+}
+
+void SshSftpTreeSync::setConcurrency(int transfersPerChannel)
+{
+    m_concurrency = qMax(1, transfersPerChannel);
+}
+
+int SshSftpTreeSync::fileCount() const
+{
+    return m_fileCount;
+}
+
+int SshSftpTreeSync::failedCount() const
+{
+    return m_failedCount;
+}
+
+QStringList SshSftpTreeSync::errMsg() const
+{
+    return m_errMsg;
+}
+
+QString SshSftpTreeSync::_join(const QString &dir, const QString &name)
+{
+    if(name.isEmpty())
+        return dir;
+    if(dir.isEmpty())
+        return name;
+    if(dir.endsWith("/"))
+        return dir + name;
+    return dir + "/" + name;
+}
+
+void SshSftpTreeSync::_openChannels()
+{
+    while(m_sftp.size() < m_channelCount)
+    {
+        SshSFtp *sftp = m_client->getChannel<SshSFtp>(QString("%1-%2").arg(m_name).arg(m_sftp.size()));
+        QObject::connect(sftp, &QObject::destroyed, this, [this, sftp](){ m_sftp.removeAll(sftp); });
+        m_sftp.append(sftp);
+    }
+}
+
+bool SshSftpTreeSync::_waitCommands(const QList<SshSftpCommand *> &commands)
+{
+    QEventLoop wait(this);
+    int remaining = 0;
+    for(SshSftpCommand *cmd: commands)
+    {
+        if(cmd->state() == SshSftpCommand::CommandState::Terminate || cmd->state() == SshSftpCommand::CommandState::Error)
+            continue;
+        ++remaining;
+        QObject::connect(cmd, &SshSftpCommand::finished, &wait, [&wait, &remaining](){
+            if(--remaining == 0)
+                wait.quit();
+        });
+    }
+    for(SshSFtp *sftp: m_sftp)
+    {
+        QObject::connect(sftp, &SshChannel::stateChanged, &wait, &QEventLoop::quit);
+    }
+
+    while(remaining > 0)
+    {
+        bool alive = true;
+        for(SshSFtp *sftp: m_sftp)
+        {
+            if(sftp->channelState() > SshChannel::ChannelState::Ready)
+                alive = false;
+        }
+        if(!alive)
+            break;
+        wait.exec();
+    }
+
+    bool success = (remaining == 0);
+    for(SshSftpCommand *cmd: commands)
+    {
+        if(cmd->state() != SshSftpCommand::CommandState::Terminate)
+            success = false;
+    }
+    return success;
+}
+
+bool SshSftpTreeSync::_runTransfers(const QList<QPair<QString, QString>> &files, bool send)
+{
+    QList<SshSftpTransferQueue *> queues;
+    QList<qint64> load;
+    for(SshSFtp *sftp: m_sftp)
+    {
+        queues.append(new SshSftpTransferQueue(*sftp, m_concurrency, this));
+        load.append(0);
+    }
+
+    /* Give each file to the least loaded channel */
+    for(const QPair<QString, QString> &file: files)
+    {
+        int best = 0;
+        for(int i = 1; i < queues.size(); ++i)
+        {
+            if(load[i] < load[best])
+                best = i;
+        }
+        int index = send ? queues[best]->enqueueSend(file.first, file.second)
+                         : queues[best]->enqueueGet(file.first, file.second);
+        qint64 size = queues[best]->transfer(index).total;
+        load[best] += (size > 0) ? size : 1;
+    }
+
+    auto emitProgress = [this, &queues](){
+        qint64 done = 0;
+        qint64 total = 0;
+        for(SshSftpTransferQueue *queue: queues)
+        {
+            done += queue->bytesDone();
+            qint64 t = queue->bytesTotal();
+            total = (total < 0 || t < 0) ? -1 : total + t;
+        }
+        emit progress(done, total);
+    };
+
+    QEventLoop wait(this);
+    for(SshSftpTransferQueue *queue: queues)
+    {
+        QObject::connect(queue, &SshSftpTransferQueue::progress, this, emitProgress);
+        QObject::connect(queue, &SshSftpTransferQueue::finished, &wait, &QEventLoop::quit);
+    }
+    for(SshSFtp *sftp: m_sftp)
+    {
+        QObject::connect(sftp, &SshChannel::stateChanged, &wait, &QEventLoop::quit);
+    }
+    for(SshSftpTransferQueue *queue: queues)
+    {
+        queue->start();
+    }
+
+    forever
+    {
+        bool finished = true;
+        for(SshSftpTransferQueue *queue: queues)
+        {
+            if(!queue->isFinished())
+                finished = false;
+        }
+        bool alive = true;
+        for(SshSFtp *sftp: m_sftp)
+        {
+            if(sftp->channelState() > SshChannel::ChannelState::Ready)
+                alive = false;
+        }
+        if(finished || !alive)
+            break;
+        wait.exec();
+    }
+
+    bool success = true;
+    for(SshSftpTransferQueue *queue: queues)
+    {
+        for(const SshSftpTransferQueue::Transfer &t: queue->transfers())
+        {
+            ++m_fileCount;
+            if(t.state != SshSftpTransferQueue::Done)
+            {
+                ++m_failedCount;
+                success = false;
+                m_errMsg << QString("%1: %2").arg(t.source, t.errMsg.join(", "));
+            }
+        }
+    }
+    qDeleteAll(queues);
+    return success;
+}
+
+bool SshSftpTreeSync::putTree(const QString &localDir, const QString &remoteDir)
+{
+    DEBUGTS << "putTree(" << localDir << ", " << remoteDir << ")";
+    QDir root(localDir);
+    if(!root.exists())
+    {
+        m_errMsg << "Local directory " + localDir + " doesn't exist";
+        return false;
+    }
+
+    QList<QStringList> levels;
+    QList<QPair<QString, QString>> files;
+    QDirIterator it(localDir, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        QString path = it.next();
+        QFileInfo info = it.fileInfo();
+        QString rel = root.relativeFilePath(path);
+        if(info.isDir())
+        {
+            int depth = rel.count('/');
+            while(levels.size() <= depth)
+                levels.append(QStringList());
+            levels[depth] << rel;
+        }
+        else if(info.isFile())
+        {
+            files.append(qMakePair(path, _join(remoteDir, rel)));
+        }
+    }
+
+    _openChannels();
+    m_sftp.first()->mkpath(remoteDir);
+
+    /* One batch of mkdir per level, the parents exist before children */
+    for(const QStringList &level: levels)
+    {
+        QList<SshSftpCommand *> commands;
+        for(int i = 0; i < level.size(); ++i)
+        {
+            commands << m_sftp[i % m_sftp.size()]->asyncMkdir(_join(remoteDir, level[i]));
+        }
+        /* mkdir fails when the directory already exists */
+        _waitCommands(commands);
+        qDeleteAll(commands);
+    }
+
+    DEBUGTS << "putTree: " << files.size() << " files on " << m_sftp.size() << " channels";
+    return _runTransfers(files, true);
+}
+
+void SshSftpTreeSync::setFollowDirLinks(bool follow)
+{
+    m_followDirLinks = follow;
+}
+
+bool SshSftpTreeSync::followDirLinks() const
+{
+    return m_followDirLinks;
+}
+
+void SshSftpTreeSync::setMaxDepth(int depth)
+{
+    m_maxDepth = qMax(1, depth);
+}
+
+int SshSftpTreeSync::maxDepth() const
+{
+    return m_maxDepth;
+}
+
+bool SshSftpTreeSync::_isUnder(const QString &path, const QString &dir)
+{
+    return path == dir || path.startsWith(dir.endsWith('/') ? dir : dir + '/');
+}
+
+bool SshSftpTreeSync::getTree(const QString &remoteDir, const QString &localDir)
+{
+    DEBUGTS << "getTree(" << remoteDir << ", " << localDir << ")";
+    _openChannels();
+
+    QList<QPair<QString, QString>> files;
+    QStringList level {QString()};
+    bool success = true;
+
+    /* Real paths already walked: the tree itself, then each followed link */
+    QStringList walked;
+    if(m_followDirLinks)
+    {
+        QString root = m_sftp.first()->realpath(remoteDir);
+        if(!root.isEmpty())
+            walked << root;
+    }
+    int depth = 0;
+    while(!level.isEmpty())
+    {
+        if(depth++ >= m_maxDepth)
+        {
+            m_errMsg << QString("Directories deeper than %1 levels not copied").arg(m_maxDepth);
+            success = false;
+            break;
+        }
+
+        for(const QString &dir: level)
+        {
+            if(!QDir().mkpath(_join(localDir, dir)))
+            {
+                m_errMsg << "Can't create local directory " + _join(localDir, dir);
+                success = false;
+            }
+        }
+
+        QList<SshSftpCommandReadDir *> readdirs;
+        for(int i = 0; i < level.size(); ++i)
+        {
+            readdirs << m_sftp[i % m_sftp.size()]->asyncReaddir(_join(remoteDir, level[i]));
+        }
+        _waitCommands(QList<SshSftpCommand *>(readdirs.begin(), readdirs.end()));
+
+        /* Readdir attributes give the type, only links need a stat */
+        QStringList next;
+        QStringList links;
+        for(int i = 0; i < readdirs.size(); ++i)
+        {
+            if(readdirs[i]->state() != SshSftpCommand::CommandState::Terminate)
+            {
+                m_errMsg << readdirs[i]->errMsg();
+                success = false;
+            }
+            for(const SshSftpDirEntry &entry: readdirs[i]->entries())
+            {
+                if(entry.name == "." || entry.name == "..")
+                    continue;
+                QString path = _join(level[i], entry.name);
+                if(!(entry.attrs.flags & LIBSSH2_SFTP_ATTR_PERMISSIONS) || LIBSSH2_SFTP_S_ISLNK(entry.attrs.permissions))
+                    links << path;
+                else if(LIBSSH2_SFTP_S_ISDIR(entry.attrs.permissions))
+                    next << path;
+                else if(LIBSSH2_SFTP_S_ISREG(entry.attrs.permissions))
+                    files.append(qMakePair(_join(remoteDir, path), _join(localDir, path)));
+            }
+        }
+        qDeleteAll(readdirs);
+
+        QList<SshSftpCommandFileInfo *> infos;
+        for(int i = 0; i < links.size(); ++i)
+        {
+            infos << m_sftp[i % m_sftp.size()]->asyncFileInfo(_join(remoteDir, links[i]));
+        }
+        _waitCommands(QList<SshSftpCommand *>(infos.begin(), infos.end()));
+        for(int i = 0; i < infos.size(); ++i)
+        {
+            LIBSSH2_SFTP_ATTRIBUTES attrs = infos[i]->fileinfo();
+            if(LIBSSH2_SFTP_S_ISDIR(attrs.permissions))
+            {
+                if(!m_followDirLinks)
+                {
+                    DEBUGTS << "Skip link to directory " << links[i];
+                    continue;
+                }
+                QString real = m_sftp.first()->realpath(_join(remoteDir, links[i]));
+                bool loop = real.isEmpty();
+                for(const QString &dir: walked)
+                {
+                    loop = loop || _isUnder(real, dir);
+                }
+                if(loop)
+                {
+                    DEBUGTS << "Skip link " << links[i] << " to " << real << ", already walked";
+                    continue;
+                }
+                walked << real;
+                next << links[i];
+            }
+            else if(LIBSSH2_SFTP_S_ISREG(attrs.permissions))
+                files.append(qMakePair(_join(remoteDir, links[i]), _join(localDir, links[i])));
+        }
+        qDeleteAll(infos);
+        level = next;
+    }
+
+    DEBUGTS << "getTree: " << files.size() << " files on " << m_sftp.size() << " channels";
+    return _runTransfers(files, false) && success;
+}
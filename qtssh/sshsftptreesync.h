@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include "sshsftp.h"
+
+class SshClient;
+class SshSftpCommand;
+class SshSftpTransferQueue;
+
+/**
+ * \brief Recursive directory upload and download
+ * \details Directories are walked level by level, and all the requests of
+ * one level (mkdir, readdir, stat) are sent at once. File transfers are
+ * spread over several SshSFtp channels of the same SshClient, each one
+ * running a SshSftpTransferQueue, so a large tree is limited by the
+ * bandwidth rather than by the latency.
+ */
+class SshSftpTreeSync : public QObject
+{
+    Q_OBJECT
+
+    SshClient *m_client;
+    QString m_name;
+    int m_channelCount;
+    int m_concurrency {8};
+    QList<SshSFtp *> m_sftp;
+    bool m_followDirLinks {false};
+    int m_maxDepth {64};
+
+    int m_fileCount {0};
+    int m_failedCount {0};
+    QStringList m_errMsg;
+
+    void _openChannels();
+    bool _waitCommands(const QList<SshSftpCommand *> &commands);
+    bool _runTransfers(const QList<QPair<QString, QString>> &files, bool send);
+    static QString _join(const QString &dir, const QString &name);
+    static bool _isUnder(const QString &path, const QString &dir);
+
+public:
+    explicit SshSftpTreeSync(SshClient *client, int channels = 4, const QString &name = "treesync", QObject *parent = nullptr);
+    virtual ~SshSftpTreeSync() override;
+
+    int channelCount() const;
+    int concurrency() const;
+    void setConcurrency(int transfersPerChannel);
+
+    /*
+     * getTree() skips remote links to directories unless enabled; then a
+     * link is only walked when its real path is outside the tree and the
+     * links already walked (no loop). Directories deeper than maxDepth
+     * are not walked in any case.
+     */
+    void setFollowDirLinks(bool follow);
+    bool followDirLinks() const;
+    void setMaxDepth(int depth);
+    int maxDepth() const;
+
+    bool putTree(const QString &localDir, const QString &remoteDir);
+    bool getTree(const QString &remoteDir, const QString &localDir);
+
+    int fileCount() const;
+    int failedCount() const;
+    QStringList errMsg() const;
+
+signals:
+    void progress(qint64 done, qint64 total);
+};
@@ -0,0 +1,403 @@
+#include "sshshell.h"
+#include "sshclient.h"
+#include "sshwritescheduler.h"
+
+Q_LOGGING_CATEGORY(logsshshell, "ssh.shell", QtWarningMsg)
+
+SshShell::SshShell(const QString &name, SshClient *client)
+    : SshChannel(name, client)
+{
+    setPriority(Priority::Interactive);
+}
+
+SshShell::~SshShell()
+{
+    qCDebug(sshchannel) << "free Channel:" << m_name;
+}
+
+LIBSSH2_CHANNEL *SshShell::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
+void SshShell::close()
+{
+    setChannelState(ChannelState::Close);
+    sshDataReceived();
+}
+
+QStringList SshShell::errMsg()
+{
+    return m_errMsg;
+}
+
+bool SshShell::isError()
+{
+    return m_error;
+}
+
+void SshShell::setTerminal(const QString &type, int columns, int rows)
+{
+    m_terminal = type.toLatin1();
+    m_columns = columns;
+    m_rows = rows;
+}
+
+void SshShell::resizeTerminal(int columns, int rows)
+{
+    if(columns == m_columns && rows == m_rows)
+    {
+        return;
+    }
+    m_columns = columns;
+    m_rows = rows;
+    if(channelState() == ChannelState::Ready)
+    {
+        m_resizePending = true;
+        sshDataReceived();
+    }
+}
+
+int SshShell::columns() const
+{
+    return m_columns;
+}
+
+int SshShell::rows() const
+{
+    return m_rows;
+}
+
+void SshShell::setReadBatchSize(int size)
+{
+    m_readBatchSize = qMax(1024, size);
+}
+
+int SshShell::readBatchSize() const
+{
+    return m_readBatchSize;
+}
+
+qint64 SshShell::write(const QByteArray &data)
+{
+    if(m_stdinClosed)
+    {
+        return -1;
+    }
+    m_stdin.append(data);
+    if(channelState() == ChannelState::Ready && !_writeStdin())
+    {
+        close();
+    }
+    return data.size();
+}
+
+qint64 SshShell::bytesToWrite() const
+{
+    return m_stdin.size();
+}
+
+void SshShell::closeWriteChannel()
+{
+    m_stdinClosed = true;
+    if(channelState() == ChannelState::Ready)
+    {
+        sshDataReceived();
+    }
+}
+
+int SshShell::exitStatus() const
+{
+    return m_exitStatus;
+}
+
+void SshShell::start()
+{
+    m_started = true;
+    sshDataReceived();
+}
+
+void SshShell::_fail(const QString &message)
+{
+    if(!m_error)
+    {
+        m_error = true;
+        m_errMsg << message;
+        qCWarning(logsshshell) << m_name << message;
+        emit failed();
+    }
+}
+
+bool SshShell::_writeStdin()
+{
+    qint64 written = 0;
+    SshWriteScheduler &scheduler = m_sshClient->writeScheduler();
+    while(!m_stdin.isEmpty())
+    {
+        size_t quota = scheduler.grant(this, static_cast<size_t>(m_stdin.size()));
+        if(quota == 0)
+        {
+            break;
+        }
+        ssize_t retsz = libssh2_channel_write_ex(m_sshChannel, 0, m_stdin.constData(), quota);
+        writeWindowUsed(m_sshChannel);
+        if(retsz == LIBSSH2_ERROR_EAGAIN)
+        {
+            /* Sent on the next event, when the socket is writable again */
+            break;
+        }
+        if(retsz < 0)
+        {
+            _fail(QString("Can't write stdin (%1)").arg(sshErrorToString(static_cast<int>(retsz))));
+            return false;
+        }
+        m_stdin.remove(0, static_cast<int>(retsz));
+        scheduler.consumed(this, static_cast<size_t>(retsz));
+        written += retsz;
+    }
+    if(m_stdin.isEmpty())
+    {
+        scheduler.done(this);
+    }
+    if(written > 0)
+    {
+        emit bytesWritten(written);
+    }
+
+    if(m_stdin.isEmpty() && m_stdinClosed && !m_stdinEofSent)
+    {
+        int ret = libssh2_channel_send_eof(m_sshChannel);
+        if(ret == LIBSSH2_ERROR_EAGAIN)
+        {
+            return true;
+        }
+        m_stdinEofSent = true;
+    }
+    return true;
+}
+
+bool SshShell::_resize()
+{
+    if(!m_resizePending)
+    {
+        return true;
+    }
+    int ret = libssh2_channel_request_pty_size_ex(m_sshChannel, m_columns, m_rows, 0, 0);
+    if(ret == LIBSSH2_ERROR_EAGAIN)
+    {
+        return true;
+    }
+    m_resizePending = false;
+    if(ret < 0)
+    {
+        /* The session goes on with the old size */
+        qCWarning(logsshshell) << m_name << "Window change refused:" << sshErrorToString(ret);
+    }
+    return true;
+}
+
+ssize_t SshShell::_read()
+{
+    /* Bulk output is read in one batch, a keystroke echo is a single read */
+    QByteArray batch;
+    ssize_t total = 0;
+    char buffer[16*1024];
+    while(total < m_readBatchSize)
+    {
+        size_t wanted = qMin(sizeof(buffer), static_cast<size_t>(m_readBatchSize - total));
+        ssize_t retsz = libssh2_channel_read_ex(m_sshChannel, 0, buffer, wanted);
+        if(retsz == LIBSSH2_ERROR_EAGAIN || retsz == 0)
+        {
+            break;
+        }
+        if(retsz < 0)
+        {
+            return retsz;
+        }
+        batch.append(buffer, static_cast<int>(retsz));
+        total += retsz;
+    }
+    tuneWindow(m_sshChannel);
+    if(total > 0)
+    {
+        emit dataReceived(batch);
+    }
+    return total;
+}
+
+void SshShell::sshDataReceived()
+{
+    qCDebug(logsshshell) << "Channel "<< m_name << "State:" << channelState();
+    switch(channelState())
+    {
+        case Openning:
+        {
+            if(!m_started)
+            {
+                return;
+            }
+            if ( ! m_sshClient->acquireChannelOpen(this) )
+            {
+                return;
+            }
+            m_sshChannel = openChannel("session");
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
+            if (m_sshChannel == nullptr)
+            {
+                int ret = libssh2_session_last_error(m_sshClient->session(), nullptr, nullptr, 0);
+                if(ret == LIBSSH2_ERROR_EAGAIN)
+                {
+                    return;
+                }
+                _fail(QString("Channel session open failed: %1").arg(ret));
+                setChannelState(ChannelState::Error);
+                return;
+            }
+            /* No stderr stream on a terminal */
+            libssh2_channel_handle_extended_data2(m_sshChannel, LIBSSH2_CHANNEL_EXTENDED_DATA_MERGE);
+            qCDebug(logsshshell) << "Channel session opened";
+            m_step = RequestPty;
+            setChannelState(ChannelState::Exec);
+        }
+
+        FALLTHROUGH; case Exec:
+        {
+            if(m_step == RequestPty)
+            {
+                int ret = libssh2_channel_request_pty_ex(m_sshChannel, m_terminal.constData(), static_cast<unsigned int>(m_terminal.size()),
+                                                         nullptr, 0, m_columns, m_rows, 0, 0);
+                if(ret == LIBSSH2_ERROR_EAGAIN)
+                {
+                    return;
+                }
+                if(ret != 0)
+                {
+                    _fail(QString("Failed to request pty: %1").arg(sshErrorToString(ret)));
+                    setChannelState(ChannelState::Close);
+                    sshDataReceived();
+                    return;
+                }
+                m_step = StartShell;
+            }
+            int ret = libssh2_channel_shell(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret != 0)
+            {
+                _fail(QString("Failed to start shell: %1").arg(sshErrorToString(ret)));
+                setChannelState(ChannelState::Close);
+                sshDataReceived();
+                return;
+            }
+            setChannelState(ChannelState::Ready);
+            emit started();
+        }
+
+        FALLTHROUGH; case Ready:
+        {
+            if(!_resize() || !_writeStdin())
+            {
+                setChannelState(ChannelState::Close);
+                sshDataReceived();
+                return;
+            }
+
+            ssize_t ret = _read();
+            if(ret < 0)
+            {
+                _fail(QString("Can't read shell (%1)").arg(sshErrorToString(static_cast<int>(ret))));
+                setChannelState(ChannelState::Close);
+                sshDataReceived();
+                return;
+            }
+            if(ret >= m_readBatchSize)
+            {
+                /* More to read: let the event loop breathe between batches */
+                QMetaObject::invokeMethod(this, "sshDataReceived", Qt::QueuedConnection);
+                return;
+            }
+            if(libssh2_channel_eof(m_sshChannel) != 1)
+            {
+                return;
+            }
+            m_eofReceived = true;
+            setChannelState(ChannelState::Close);
+        }
+
+        FALLTHROUGH; case Close:
+        {
+            qCDebug(logsshshell) << "closeChannel:" << m_name;
+            if(m_sshChannel == nullptr)
+            {
+                setChannelState(ChannelState::Free);
+                return;
+            }
+            int ret = libssh2_channel_close(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to channel_close: %1").arg(sshErrorToString(ret)));
+            }
+            setChannelState(ChannelState::WaitClose);
+        }
+
+        FALLTHROUGH; case WaitClose:
+        {
+            qCDebug(logsshshell) << "Wait close channel:" << m_name;
+            int ret = skipWaitClosed() ? 0 : libssh2_channel_wait_closed(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to channel_wait_close: %1").arg(sshErrorToString(ret)));
+            }
+            else
+            {
+                m_exitStatus = libssh2_channel_get_exit_status(m_sshChannel);
+            }
+            if(m_eofReceived)
+            {
+                m_eofReceived = false;
+                emit finished();
+            }
+            setChannelState(ChannelState::Freeing);
+        }
+
+        FALLTHROUGH; case Freeing:
+        {
+            qCDebug(logsshshell) << "free Channel:" << m_name;
+            int ret = libssh2_channel_free(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                _fail(QString("Failed to free channel: %1").arg(sshErrorToString(ret)));
+            }
+            m_sshChannel = nullptr;
+            setChannelState(m_error ? ChannelState::Error : ChannelState::Free);
+            return;
+        }
+
+        case Free:
+        {
+            qCDebug(logsshshell) << "Channel" << m_name << "is free";
+            return;
+        }
+
+        case Error:
+        {
+            qCDebug(logsshshell) << "Channel" << m_name << "is in error state";
+            setChannelState(ChannelState::Free);
+            return;
+        }
+    }
+}
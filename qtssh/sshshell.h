@@ -0,0 +1,88 @@
+#pragma once
+
+#include "sshchannel.h"
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(logsshshell)
+
+/*
+ * Interactive shell on a pseudo terminal. Nothing is accumulated: the
+ * output is given by dataReceived() as soon as it is read, one read batch
+ * (up to readBatchSize() bytes, stderr merged) per event, and write() hands
+ * the keystrokes to libssh2 at once, only what would block is kept for the
+ * next event. Use SshSocketOptions::interactive() on the client so the
+ * keystrokes are not delayed by Nagle.
+ */
+class SshShell : public SshChannel
+{
+    Q_OBJECT
+
+protected:
+    explicit SshShell(const QString &name, SshClient *client);
+    friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+
+public:
+    virtual ~SshShell() override;
+    void close() override;
+    QStringList errMsg();
+    bool isError();
+
+    /* Terminal type and size asked for the pty, set them before start() */
+    void setTerminal(const QString &type, int columns = 80, int rows = 24);
+    /* Window change, can be called at any time */
+    void resizeTerminal(int columns, int rows);
+    int columns() const;
+    int rows() const;
+
+    /* Max bytes read from the channel before dataReceived() is emitted */
+    void setReadBatchSize(int size);
+    int readBatchSize() const;
+
+    qint64 write(const QByteArray &data);
+    qint64 bytesToWrite() const;
+    void closeWriteChannel();
+
+    /* Valid once finished() is emitted */
+    int exitStatus() const;
+
+public slots:
+    void start();
+    void sshDataReceived() override;
+
+private:
+    enum ExecStep {
+        RequestPty,
+        StartShell
+    };
+
+    LIBSSH2_CHANNEL *m_sshChannel {nullptr};
+    QStringList m_errMsg;
+    bool m_error {false};
+    bool m_started {false};
+    bool m_eofReceived {false};
+    ExecStep m_step {RequestPty};
+
+    QByteArray m_terminal {"xterm"};
+    int m_columns {80};
+    int m_rows {24};
+    bool m_resizePending {false};
+    int m_readBatchSize {64*1024};
+
+    QByteArray m_stdin;
+    bool m_stdinClosed {false};
+    bool m_stdinEofSent {false};
+    int m_exitStatus {-1};
+
+    void _fail(const QString &message);
+    bool _writeStdin();
+    bool _resize();
+    ssize_t _read();
+
+signals:
+    void started();
+    void finished();
+    void failed();
+    void dataReceived(const QByteArray &data);
+    void bytesWritten(qint64 bytes);
+};
@@ -0,0 +1,79 @@
+#include "sshsocketoptions.h"
+#include <QAbstractSocket>
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+SshSocketOptions SshSocketOptions::interactive()
+{
+    SshSocketOptions options;
+    options.noDelay = true;
+    options.keepAlive = true;
+    return options;
+}
+
+SshSocketOptions SshSocketOptions::bulk(int bufferSize)
+{
+    SshSocketOptions options;
+    options.keepAlive = true;
+    options.sendBufferSize = bufferSize;
+    options.receiveBufferSize = bufferSize;
+    return options;
+}
+
+void SshSocketOptions::apply(QAbstractSocket *socket) const
+{
+    if(socket == nullptr)
+        return;
+
+    if(socket->socketType() == QAbstractSocket::TcpSocket)
+    {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, noDelay ? 1 : 0);
+        socket->setSocketOption(QAbstractSocket::KeepAliveOption, keepAlive ? 1 : 0);
+    }
+    if(sendBufferSize > 0)
+    {
+        socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, sendBufferSize);
+    }
+    if(receiveBufferSize > 0)
+    {
+        socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, receiveBufferSize);
+    }
+    if(readBufferSize > 0)
+    {
+        socket->setReadBufferSize(readBufferSize);
+    }
+}
+
+void SshSocketOptions::apply(qintptr descriptor) const
+{
+    if(descriptor < 0)
+        return;
+
+#ifdef Q_OS_WIN
+    SOCKET fd = static_cast<SOCKET>(descriptor);
+    typedef const char *optval_t;
+#else
+    int fd = static_cast<int>(descriptor);
+    typedef const void *optval_t;
+#endif
+    int value = noDelay ? 1 : 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<optval_t>(&value), sizeof(value));
+    value = keepAlive ? 1 : 0;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<optval_t>(&value), sizeof(value));
+    if(sendBufferSize > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<optval_t>(&sendBufferSize), sizeof(sendBufferSize));
+    }
+    if(receiveBufferSize > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<optval_t>(&receiveBufferSize), sizeof(receiveBufferSize));
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QtGlobal>
+
+class QAbstractSocket;
+
+/**
+ * \brief Socket tuning profile of a session or of tunnel sockets
+ * \details Kernel buffer sizes of 0 keep the system defaults. A
+ * readBufferSize of 0 keeps the Qt default (unlimited), it only applies
+ * to QAbstractSocket.
+ */
+struct SshSocketOptions
+{
+    bool noDelay {false};
+    bool keepAlive {false};
+    int sendBufferSize {0};
+    int receiveBufferSize {0};
+    qint64 readBufferSize {0};
+
+    /* Latency first: no Nagle */
+    static SshSocketOptions interactive();
+    /* Throughput first: large kernel buffers for long fat links */
+    static SshSocketOptions bulk(int bufferSize = 4 * 1024 * 1024);
+
+    /* On a connected socket */
+    void apply(QAbstractSocket *socket) const;
+    void apply(qintptr descriptor) const;
+};
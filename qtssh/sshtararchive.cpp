@@ -0,0 +1,614 @@
+#include "sshtararchive.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QDateTime>
+#include <cstring>
+
+#define TAR_BLOCK 512
+/* Largest size of the 11 octal digits of a ustar field */
+#define TAR_MAX_OCTAL_SIZE 077777777777LL
+#define TAR_MAX_META (1024*1024)
+
+static const struct {
+    QFileDevice::Permission permission;
+    quint32 mode;
+} s_permissions[] = {
+    {QFileDevice::ReadOwner, 0400}, {QFileDevice::WriteOwner, 0200}, {QFileDevice::ExeOwner, 0100},
+    {QFileDevice::ReadGroup, 0040}, {QFileDevice::WriteGroup, 0020}, {QFileDevice::ExeGroup, 0010},
+    {QFileDevice::ReadOther, 0004}, {QFileDevice::WriteOther, 0002}, {QFileDevice::ExeOther, 0001}
+};
+
+static quint32 tarMode(QFileDevice::Permissions permissions)
+{
+    quint32 mode = 0;
+    for(const auto &p: s_permissions)
+    {
+        if(permissions & p.permission)
+            mode |= p.mode;
+    }
+    return mode;
+}
+
+static QFileDevice::Permissions filePermissions(quint32 mode)
+{
+    QFileDevice::Permissions permissions;
+    for(const auto &p: s_permissions)
+    {
+        if(mode & p.mode)
+            permissions |= p.permission;
+    }
+    /* Qt "User" is the current user, the owner of what we extract */
+    if(mode & 0400) permissions |= QFileDevice::ReadUser;
+    if(mode & 0200) permissions |= QFileDevice::WriteUser;
+    if(mode & 0100) permissions |= QFileDevice::ExeUser;
+    return permissions;
+}
+
+static void tarOctal(char *field, int length, qint64 value)
+{
+    QByteArray digits = QByteArray::number(value, 8).rightJustified(length - 1, '0', true);
+    std::memcpy(field, digits.constData(), static_cast<size_t>(length - 1));
+    field[length - 1] = '\0';
+}
+
+static qint64 tarNumber(const char *field, int length)
+{
+    qint64 value = 0;
+    if(static_cast<unsigned char>(field[0]) & 0x80)
+    {
+        /* GNU base-256, big files */
+        value = static_cast<unsigned char>(field[0]) & 0x7F;
+        for(int i = 1; i < length; i++)
+        {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+    for(int i = 0; i < length; i++)
+    {
+        if(field[i] >= '0' && field[i] <= '7')
+            value = value * 8 + (field[i] - '0');
+        else if(field[i] != ' ' || value != 0)
+            break;
+    }
+    return value;
+}
+
+static QByteArray tarField(const char *field, int length)
+{
+    const char *end = static_cast<const char *>(std::memchr(field, '\0', static_cast<size_t>(length)));
+    return QByteArray(field, static_cast<int>((end) ? end - field : length));
+}
+
+static unsigned int tarChecksum(const char *header)
+{
+    unsigned int sum = 0;
+    for(int i = 0; i < TAR_BLOCK; i++)
+    {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum;
+}
+
+static QByteArray ustarHeader(const QByteArray &name, char type, qint64 size, quint32 mode, qint64 mtime)
+{
+    QByteArray header(TAR_BLOCK, '\0');
+    char *h = header.data();
+    std::memcpy(h, name.constData(), static_cast<size_t>(qMin(name.size(), 100)));
+    tarOctal(h + 100, 8, mode & 07777);
+    tarOctal(h + 108, 8, 0);
+    tarOctal(h + 116, 8, 0);
+    tarOctal(h + 124, 12, (size > TAR_MAX_OCTAL_SIZE) ? 0 : size);
+    tarOctal(h + 136, 12, qMax<qint64>(mtime, 0));
+    h[156] = type;
+    std::memcpy(h + 257, "ustar", 6);
+    std::memcpy(h + 263, "00", 2);
+    tarOctal(h + 148, 7, tarChecksum(h));
+    h[155] = ' ';
+    return header;
+}
+
+static QByteArray paxRecord(const QByteArray &key, const QByteArray &value)
+{
+    /* "<length> key=value\n", the length counts its own digits */
+    QByteArray body = " " + key + "=" + value + "\n";
+    int length = body.size();
+    forever
+    {
+        int total = body.size() + QByteArray::number(length).size();
+        if(total == length)
+            break;
+        length = total;
+    }
+    return QByteArray::number(length) + body;
+}
+
+static qint64 tarPadding(qint64 size)
+{
+    return (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+}
+
+SshTarWriter::SshTarWriter()
+{
+}
+
+bool SshTarWriter::addTree(const QString &localDir)
+{
+    QDir root(localDir);
+    if(!root.exists())
+    {
+        m_errors << QString("No such directory %1").arg(localDir);
+        return false;
+    }
+    QDirIterator it(root.absolutePath(), QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        if(!info.isDir() && !info.isFile())
+        {
+            /* Sockets, fifos, dangling links */
+            continue;
+        }
+        SshTarEntry entry;
+        entry.path = root.relativeFilePath(info.filePath());
+        entry.localPath = info.filePath();
+        entry.directory = info.isDir();
+        entry.size = (entry.directory) ? 0 : info.size();
+        entry.mode = tarMode(info.permissions());
+        entry.mtime = info.lastModified().toMSecsSinceEpoch() / 1000;
+        m_entries.append(entry);
+        m_dataSize += entry.size;
+        m_archiveSize += _header(entry).size() + entry.size + tarPadding(entry.size);
+    }
+    return true;
+}
+
+int SshTarWriter::entryCount() const
+{
+    return m_entries.size();
+}
+
+qint64 SshTarWriter::dataSize() const
+{
+    return m_dataSize;
+}
+
+qint64 SshTarWriter::archiveSize() const
+{
+    return m_archiveSize + 2 * TAR_BLOCK;
+}
+
+const SshTarEntry &SshTarWriter::entry(int index) const
+{
+    return m_entries.at(index);
+}
+
+bool SshTarWriter::atEnd() const
+{
+    return m_end && m_pending.isEmpty() && m_remaining == 0;
+}
+
+qint64 SshTarWriter::position() const
+{
+    return m_position;
+}
+
+QList<SshTarEntry> SshTarWriter::takeCompleted()
+{
+    QList<SshTarEntry> res;
+    res.swap(m_completed);
+    return res;
+}
+
+QStringList SshTarWriter::errors() const
+{
+    return m_errors;
+}
+
+QByteArray SshTarWriter::_header(const SshTarEntry &entry) const
+{
+    QByteArray name = entry.path.toUtf8();
+    if(entry.directory)
+        name += '/';
+
+    QByteArray pax;
+    if(name.size() > 100)
+        pax += paxRecord("path", name);
+    if(entry.size > TAR_MAX_OCTAL_SIZE)
+        pax += paxRecord("size", QByteArray::number(entry.size));
+
+    QByteArray header;
+    if(!pax.isEmpty())
+    {
+        header += ustarHeader("PaxHeader/" + name.right(80), 'x', pax.size(), 0644, entry.mtime);
+        header += pax;
+        header += QByteArray(static_cast<int>(tarPadding(pax.size())), '\0');
+    }
+    header += ustarHeader(name, (entry.directory) ? '5' : '0', entry.size, entry.mode, entry.mtime);
+    return header;
+}
+
+bool SshTarWriter::_nextEntry()
+{
+    if(m_end)
+        return false;
+
+    if(++m_index >= m_entries.size())
+    {
+        /* End of archive: two zero blocks */
+        m_pending = QByteArray(2 * TAR_BLOCK, '\0');
+        m_end = true;
+        return true;
+    }
+
+    const SshTarEntry &entry = m_entries.at(m_index);
+    if(entry.directory)
+    {
+        m_pending = _header(entry);
+        m_completed.append(entry);
+        return true;
+    }
+
+    m_file.setFileName(entry.localPath);
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        /* Left out of the archive */
+        m_errors << QString("Can't read %1: %2").arg(entry.localPath, m_file.errorString());
+        return true;
+    }
+    m_pending = _header(entry);
+    m_remaining = entry.size;
+    m_padding = tarPadding(entry.size);
+    if(m_remaining == 0)
+    {
+        m_file.close();
+        m_completed.append(entry);
+    }
+    return true;
+}
+
+QByteArray SshTarWriter::read(qint64 maxSize)
+{
+    QByteArray out;
+    while(out.size() < maxSize && !atEnd())
+    {
+        qint64 room = maxSize - out.size();
+        if(!m_pending.isEmpty())
+        {
+            int len = static_cast<int>(qMin<qint64>(m_pending.size(), room));
+            out.append(m_pending.constData(), len);
+            m_pending.remove(0, len);
+            continue;
+        }
+        if(m_remaining > 0)
+        {
+            int offset = out.size();
+            int len = static_cast<int>(qMin(m_remaining, room));
+            out.resize(offset + len);
+            qint64 got = m_file.read(out.data() + offset, len);
+            if(got <= 0)
+            {
+                /* File shrunk since the scan: zeros keep the archive valid */
+                if(m_errors.isEmpty() || !m_errors.last().startsWith(m_file.fileName()))
+                    m_errors << QString("%1 changed while archived").arg(m_file.fileName());
+                std::memset(out.data() + offset, 0, static_cast<size_t>(len));
+                got = len;
+            }
+            else if(got < len)
+            {
+                out.resize(offset + static_cast<int>(got));
+            }
+            m_remaining -= got;
+            if(m_remaining == 0)
+            {
+                m_file.close();
+                m_pending = QByteArray(static_cast<int>(m_padding), '\0');
+                m_completed.append(m_entries.at(m_index));
+            }
+            continue;
+        }
+        _nextEntry();
+    }
+    m_position += out.size();
+    return out;
+}
+
+SshTarReader::SshTarReader(const QString &localDir)
+    : m_destination(localDir)
+{
+}
+
+void SshTarReader::setDestination(const QString &localDir)
+{
+    m_destination = localDir;
+}
+
+bool SshTarReader::atEnd() const
+{
+    return m_end;
+}
+
+bool SshTarReader::isError() const
+{
+    return m_error;
+}
+
+QStringList SshTarReader::errors() const
+{
+    return m_errors;
+}
+
+int SshTarReader::fileCount() const
+{
+    return m_fileCount;
+}
+
+int SshTarReader::skippedCount() const
+{
+    return m_skipped;
+}
+
+qint64 SshTarReader::dataSize() const
+{
+    return m_dataSize;
+}
+
+QList<SshTarEntry> SshTarReader::takeCompleted()
+{
+    QList<SshTarEntry> res;
+    res.swap(m_completed);
+    return res;
+}
+
+bool SshTarReader::feed(const char *data, qint64 length)
+{
+    while(length > 0 && !m_end)
+    {
+        if(m_remaining > 0)
+        {
+            qint64 len = qMin(length, m_remaining);
+            _memberData(data, len);
+            data += len;
+            length -= len;
+            m_remaining -= len;
+            if(m_remaining == 0 && m_padding == 0)
+                _memberEnd();
+            continue;
+        }
+        if(m_padding > 0)
+        {
+            qint64 len = qMin(length, m_padding);
+            data += len;
+            length -= len;
+            m_padding -= len;
+            if(m_padding == 0)
+                _memberEnd();
+            continue;
+        }
+        int len = static_cast<int>(qMin<qint64>(length, TAR_BLOCK - m_header.size()));
+        m_header.append(data, len);
+        data += len;
+        length -= len;
+        if(m_header.size() == TAR_BLOCK)
+        {
+            _parseHeader();
+            m_header.clear();
+        }
+    }
+    return !m_error;
+}
+
+QString SshTarReader::_destination(const QString &path)
+{
+    /* Archives made on Windows may use '\', both are separators here */
+    QString name = path;
+    name.replace('\\', '/');
+    if(name.startsWith('/') || QDir::isAbsolutePath(name) || (name.size() >= 2 && name.at(1) == ':'))
+        return QString();
+    for(const QString &part: name.split('/'))
+    {
+        if(part == "..")
+            return QString();
+    }
+
+    /* Whatever the name, the result must stay under the destination */
+    QString root = QDir::cleanPath(QDir(m_destination).absolutePath());
+    QString dest = QDir::cleanPath(root + "/" + name);
+    if(dest == root)
+        return root;
+    if(!dest.startsWith(root.endsWith('/') ? root : root + "/"))
+        return QString();
+    return dest;
+}
+
+bool SshTarReader::_parseHeader()
+{
+    const char *h = m_header.constData();
+    bool zero = true;
+    for(int i = 0; i < TAR_BLOCK && zero; i++)
+        zero = (h[i] == '\0');
+    if(zero)
+    {
+        if(++m_zeroBlocks >= 2)
+            m_end = true;
+        return true;
+    }
+    m_zeroBlocks = 0;
+
+    if(static_cast<unsigned int>(tarNumber(h + 148, 8)) != tarChecksum(h))
+    {
+        m_error = true;
+        m_end = true;
+        m_errors << "Corrupted tar header";
+        return false;
+    }
+
+    char type = h[156];
+    qint64 size = tarNumber(h + 124, 12);
+    QByteArray name = tarField(h, 100);
+    if(std::memcmp(h + 257, "ustar\0", 6) == 0)
+    {
+        /* POSIX ustar, GNU tar uses this area for other fields */
+        QByteArray prefix = tarField(h + 345, 155);
+        if(!prefix.isEmpty())
+            name = prefix + "/" + name;
+    }
+
+    m_member = Skipped;
+    if(type == 'x' || type == 'L')
+    {
+        m_member = (type == 'x') ? PaxHeader : LongName;
+        m_meta.clear();
+    }
+    else if(type != 'g')
+    {
+        /* Real member: apply the pending pax or GNU long name */
+        QString path = (m_nextPath.isEmpty()) ? QString::fromUtf8(name) : m_nextPath;
+        if(m_nextSize >= 0)
+            size = m_nextSize;
+        m_nextPath.clear();
+        m_nextSize = -1;
+
+        m_current.path = path;
+        m_current.size = size;
+        m_current.mode = static_cast<quint32>(tarNumber(h + 100, 8));
+        m_current.mtime = tarNumber(h + 136, 12);
+        m_current.directory = (type == '5');
+        m_current.localPath = _destination(path);
+
+        if(type != '0' && type != '\0' && type != '7' && type != '5')
+        {
+            /* Links, devices, fifos */
+            m_skipped++;
+        }
+        else if(m_current.localPath.isEmpty())
+        {
+            m_skipped++;
+            m_errors << QString("Refused member %1 outside of destination").arg(path);
+        }
+        else if(m_current.directory)
+        {
+            QDir().mkpath(m_current.localPath);
+            m_member = Directory;
+        }
+        else
+        {
+            QDir().mkpath(QFileInfo(m_current.localPath).absolutePath());
+            m_file.setFileName(m_current.localPath);
+            if(m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                m_member = File;
+            }
+            else
+            {
+                m_skipped++;
+                m_errors << QString("Can't write %1: %2").arg(m_current.localPath, m_file.errorString());
+            }
+        }
+    }
+
+    m_remaining = size;
+    m_padding = tarPadding(size);
+    if(m_remaining == 0)
+        _memberEnd();
+    return true;
+}
+
+void SshTarReader::_memberData(const char *data, qint64 length)
+{
+    switch(m_member)
+    {
+        case File:
+        {
+            if(m_file.write(data, length) != length)
+            {
+                m_error = true;
+                m_end = true;
+                m_errors << QString("Can't write %1: %2").arg(m_current.localPath, m_file.errorString());
+                m_file.close();
+                m_member = Skipped;
+            }
+            return;
+        }
+        case PaxHeader:
+        case LongName:
+        {
+            if(m_meta.size() + length > TAR_MAX_META)
+            {
+                m_error = true;
+                m_end = true;
+                m_errors << "Tar extended header too large";
+                m_member = Skipped;
+                return;
+            }
+            m_meta.append(data, static_cast<int>(length));
+            return;
+        }
+        case Directory:
+        case Skipped:
+            return;
+    }
+}
+
+void SshTarReader::_memberEnd()
+{
+    switch(m_member)
+    {
+        case File:
+        {
+            m_file.close();
+            m_file.setPermissions(filePermissions(m_current.mode));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+            if(m_file.open(QIODevice::Append))
+            {
+                m_file.setFileTime(QDateTime::fromMSecsSinceEpoch(m_current.mtime * 1000), QFileDevice::FileModificationTime);
+                m_file.close();
+            }
+#endif
+            m_fileCount++;
+            m_dataSize += m_current.size;
+            m_completed.append(m_current);
+            break;
+        }
+        case Directory:
+        {
+            /* Permissions left as created: a read only one would stop the next members */
+            m_completed.append(m_current);
+            break;
+        }
+        case PaxHeader:
+        {
+            int pos = 0;
+            while(pos < m_meta.size())
+            {
+                int space = m_meta.indexOf(' ', pos);
+                if(space < 0)
+                    break;
+                int length = m_meta.mid(pos, space - pos).toInt();
+                if(length <= 0 || pos + length > m_meta.size())
+                    break;
+                QByteArray record = m_meta.mid(space + 1, length - (space - pos) - 2);
+                int equal = record.indexOf('=');
+                if(equal > 0)
+                {
+                    QByteArray key = record.left(equal);
+                    if(key == "path")
+                        m_nextPath = QString::fromUtf8(record.mid(equal + 1));
+                    else if(key == "size")
+                        m_nextSize = record.mid(equal + 1).toLongLong();
+                }
+                pos += length;
+            }
+            break;
+        }
+        case LongName:
+        {
+            m_nextPath = QString::fromUtf8(tarField(m_meta.constData(), m_meta.size()));
+            break;
+        }
+        case Skipped:
+            break;
+    }
+    m_member = Skipped;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/* Member of an archive, path relative to the archive root with '/' */
+struct SshTarEntry {
+    QString path;
+    QString localPath;
+    bool directory;
+    qint64 size;
+    quint32 mode;
+    qint64 mtime;
+};
+
+/**
+ * \brief Tar (POSIX pax) stream of a local directory, generated on demand
+ * \details Files are opened one at a time while read() produces the
+ * archive, so a tree of any size is streamed with a window of memory.
+ * Names longer than the ustar fields and files above 8 GiB get a pax
+ * header. Symbolic links to files are archived as the file content,
+ * linked directories are not descended.
+ */
+class SshTarWriter
+{
+public:
+    SshTarWriter();
+    bool addTree(const QString &localDir);
+
+    int entryCount() const;
+    qint64 dataSize() const;
+    /* Stream size, unless files change while archived */
+    qint64 archiveSize() const;
+    const SshTarEntry &entry(int index) const;
+
+    /* Next piece of the archive, empty once atEnd() */
+    QByteArray read(qint64 maxSize);
+    bool atEnd() const;
+    qint64 position() const;
+
+    /* Entries completely written in the stream since the last call */
+    QList<SshTarEntry> takeCompleted();
+    QStringList errors() const;
+
+private:
+    bool _nextEntry();
+    QByteArray _header(const SshTarEntry &entry) const;
+
+    QList<SshTarEntry> m_entries;
+    QList<SshTarEntry> m_completed;
+    QStringList m_errors;
+    qint64 m_dataSize {0};
+    qint64 m_archiveSize {0};
+    int m_index {-1};
+    QByteArray m_pending;
+    QFile m_file;
+    qint64 m_remaining {0};
+    qint64 m_padding {0};
+    qint64 m_position {0};
+    bool m_end {false};
+};
+
+/**
+ * \brief Extracts a tar stream fed in pieces under a local directory
+ * \details ustar, pax ('x' path and size) and GNU long names are read.
+ * Absolute paths, drives and ".." components (with '/' or '\') are
+ * refused, links, devices and other special members are skipped: the
+ * archive can't write outside of the destination.
+ */
+class SshTarReader
+{
+public:
+    explicit SshTarReader(const QString &localDir = QString());
+    void setDestination(const QString &localDir);
+
+    bool feed(const char *data, qint64 length);
+    bool atEnd() const;
+    bool isError() const;
+    QStringList errors() const;
+
+    int fileCount() const;
+    int skippedCount() const;
+    qint64 dataSize() const;
+
+    /* Entries completely extracted since the last call */
+    QList<SshTarEntry> takeCompleted();
+
+private:
+    enum Member {
+        File,
+        Directory,
+        PaxHeader,
+        LongName,
+        Skipped
+    };
+    bool _parseHeader();
+    void _memberData(const char *data, qint64 length);
+    void _memberEnd();
+    QString _destination(const QString &path);
+
+    QString m_destination;
+    QByteArray m_header;
+    Member m_member {Skipped};
+    SshTarEntry m_current {};
+    QByteArray m_meta;
+    QString m_nextPath;
+    qint64 m_nextSize {-1};
+    QFile m_file;
+    qint64 m_remaining {0};
+    qint64 m_padding {0};
+    int m_zeroBlocks {0};
+    bool m_end {false};
+    bool m_error {false};
+    int m_fileCount {0};
+    int m_skipped {0};
+    qint64 m_dataSize {0};
+    QList<SshTarEntry> m_completed;
+    QStringList m_errors;
+};
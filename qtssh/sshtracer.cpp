@@ -0,0 +1,23 @@
+#include "sshtracer.h"
+#include <QElapsedTimer>
+
+QAtomicPointer<SshTracer> SshTracer::s_tracer {nullptr};
+
+static QElapsedTimer startClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+void SshTracer::install(SshTracer *tracer)
+{
+    now();
+    s_tracer.storeRelease(tracer);
+}
+
+qint64 SshTracer::now()
+{
+    static const QElapsedTimer clock = startClock();
+    return clock.nsecsElapsed();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QAtomicPointer>
+#include "sshclient.h"
+#include "sshchannel.h"
+
+/*
+ * Lifecycle tracing: installed once for the process, given every state
+ * change of the clients and channels, from the thread of the object.
+ * timestamp is now() at the transition, duration the ns spent in the left
+ * state. Without tracer installed, a transition only loads a pointer.
+ * Implementations must be thread safe when clients run in several threads
+ * (SshClientPool), and stay alive until uninstalled with the clients idle.
+ */
+class SshTracer
+{
+public:
+    virtual ~SshTracer() = default;
+
+    virtual void clientStateChanged(const SshClient *client, SshClient::SshState from, SshClient::SshState to, qint64 timestamp, qint64 duration) = 0;
+    virtual void channelStateChanged(const SshChannel *channel, SshChannel::ChannelState from, SshChannel::ChannelState to, qint64 timestamp, qint64 duration) = 0;
+
+    /* Not owned, nullptr to remove */
+    static void install(SshTracer *tracer);
+    static SshTracer *installed() { return s_tracer.loadAcquire(); }
+
+    /* ns on the monotonic clock of all timestamps */
+    static qint64 now();
+
+private:
+    static QAtomicPointer<SshTracer> s_tracer;
+};
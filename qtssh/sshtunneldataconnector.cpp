@@ -1,11 +1,31 @@
 #include "sshtunneldataconnector.h"
 #include <QTcpSocket>
+#include <QLocalSocket>
 #include <QEventLoop>
 #include "sshclient.h"
+#include <algorithm>
+#include <iterator>
 
 Q_LOGGING_CATEGORY(logxfer, "ssh.tunnel.transfer", QtWarningMsg)
 #define DEBUGCH qCDebug(logxfer) << m_name
 
+/* Per packet tracing, compiled only with QTSSH_TRACE_TRANSFER */
+#if defined(QTSSH_TRACE_TRANSFER)
+#define TRACECH qCDebug(logxfer) << m_name
+#else
+#define TRACECH while(false) QMessageLogger().noDebug()
+#endif
+
+static int _writeBucket(size_t len)
+{
+    int bucket = 0;
+    for(size_t limit = 64; len >= limit && bucket < SSH_WRITE_HISTOGRAM_BUCKETS - 1; limit <<= 1)
+    {
+        bucket++;
+    }
+    return bucket;
+}
+
 SshTunnelDataConnector::SshTunnelDataConnector(SshClient *client, const QString &name, QObject *parent)
     : QObject(parent)
     , m_sshClient(client)
@@ -13,6 +33,11 @@ SshTunnelDataConnector::SshTunnelDataConnector(SshClient *client, const QString
 {
     DEBUGCH << "SshTunnelDataConnector constructor";
     m_tx_data_on_sock = true;
+    m_coalesceTimer.setSingleShot(true);
+    QObject::connect(&m_coalesceTimer, &QTimer::timeout, this, [this](){
+        m_coalesceFlush = true;
+        emit sendEvent();
+    });
 }
 
 SshTunnelDataConnector::~SshTunnelDataConnector()
@@ -22,32 +47,183 @@ SshTunnelDataConnector::~SshTunnelDataConnector()
     DEBUGCH << "TOTAL TRANSFERED: Tx:" << m_total_TxToSsh << " | Rx:" << m_total_RxToSock;
 }
 
+SshTunnelDataConnector::Stats SshTunnelDataConnector::stats() const
+{
+    Stats stats;
+    stats.sockToTx = static_cast<quint64>(m_total_sockToTx);
+    stats.txToSsh = static_cast<quint64>(m_total_TxToSsh);
+    stats.sshToRx = static_cast<quint64>(m_total_SshToRx);
+    stats.rxToSock = static_cast<quint64>(m_total_RxToSock);
+    stats.txBuffered = m_tx.size();
+    stats.rxBuffered = m_rx.size();
+    stats.txStalls = m_txStalls;
+    stats.rxStalls = m_rxStalls;
+    stats.processCalls = m_processCalls;
+    std::copy(std::begin(m_writeSizes), std::end(m_writeSizes), std::begin(stats.writeSizes));
+    return stats;
+}
+
 void SshTunnelDataConnector::setChannel(LIBSSH2_CHANNEL *channel)
 {
     m_sshChannel = channel;
 }
 
-void SshTunnelDataConnector::setSock(QTcpSocket *sock)
+void SshTunnelDataConnector::reset(const QString &name)
 {
-    m_sock = sock;
-    QObject::connect(m_sock, &QTcpSocket::disconnected,
-                     this,   &SshTunnelDataConnector::_socketDisconnected);
+    DEBUGCH << "TOTAL TRANSFERED: Tx:" << m_total_TxToSsh << " | Rx:" << m_total_RxToSock;
+    if(m_sock)
+    {
+        QObject::disconnect(m_sock, nullptr, this, nullptr);
+    }
+    m_sock = nullptr;
+    m_sshChannel = nullptr;
+    m_name = name;
+
+    m_tx.clear();
+    m_tx_throttled = false;
+    m_tx_data_on_sock = true;
+    m_total_sockToTx = 0;
+    m_tx_eof = false;
+    m_total_TxToSsh = 0;
+    m_tx_closed = false;
+
+    m_rx.clear();
+    m_rx_throttled = false;
+    m_rx_data_on_ssh = false;
+    m_total_SshToRx = 0;
+    m_rx_eof = false;
+    m_total_RxToSock = 0;
+    m_rx_closed = false;
+
+    m_txStalls = 0;
+    m_rxStalls = 0;
+    m_processCalls = 0;
+    std::fill(std::begin(m_writeSizes), std::end(m_writeSizes), 0);
+
+    m_coalesceHold = false;
+    m_coalesceFlush = false;
+    m_coalesceTimer.stop();
+}
+
+void SshTunnelDataConnector::setIo(SshChannelIo *io)
+{
+    m_io = (io) ? io : &SshChannelIo::direct();
+}
+
+void SshTunnelDataConnector::setCoalescing(size_t size, int delayUsec)
+{
+    m_coalesceSize = qMin(size, static_cast<size_t>(BUFFER_SIZE));
+    m_coalesceDelay = static_cast<qint64>(qMax(0, delayUsec)) * 1000;
+}
+
+bool SshTunnelDataConnector::_holdTx()
+{
+    if(m_coalesceSize == 0 || m_tx_eof)
+    {
+        return false;
+    }
+    if(!m_coalesceHold)
+    {
+        if(m_tx.size() >= m_coalesceSize)
+        {
+            return false;
+        }
+        /* Zero timer: fires once the already queued socket reads are in */
+        m_coalesceHold = true;
+        m_coalesceFlush = false;
+        m_coalesceClock.start();
+        m_coalesceTimer.start(0);
+        return true;
+    }
+    if(m_tx.size() < m_coalesceSize && !m_coalesceFlush && m_coalesceClock.nsecsElapsed() < m_coalesceDelay)
+    {
+        return true;
+    }
+    m_coalesceHold = false;
+    m_coalesceTimer.stop();
+    return false;
+}
+
+void SshTunnelDataConnector::setOwner(SshChannel *owner)
+{
+    m_owner = owner;
+}
 
-    QObject::connect(m_sock, &QTcpSocket::destroyed, [this](){m_sock = nullptr;});
+void SshTunnelDataConnector::setSock(QIODevice *sock)
+{
+    m_sock = sock;
+    QObject::connect(m_sock, &QIODevice::destroyed, this, [this](){m_sock = nullptr;});
 
-    QObject::connect(m_sock, &QTcpSocket::readyRead,
+    QObject::connect(m_sock, &QIODevice::readyRead,
                      this,   &SshTunnelDataConnector::_socketDataRecived);
 
+    QObject::connect(m_sock, &QIODevice::bytesWritten, this, [this](qint64 len){ m_total_RxToSock += len; });
 
+    if(QAbstractSocket *tcp = qobject_cast<QAbstractSocket *>(m_sock))
+    {
+        QObject::connect(tcp, &QAbstractSocket::disconnected,
+                         this, &SshTunnelDataConnector::_socketDisconnected);
+#if QT_VERSION >= QT_VERSION_CHECK(5,15,0)
+        QObject::connect(tcp, &QAbstractSocket::errorOccurred,
+                         this, &SshTunnelDataConnector::_socketError);
+#else
+        QObject::connect(tcp, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error),
+                         this, &SshTunnelDataConnector::_socketError);
+#endif
+    }
+    else if(QLocalSocket *local = qobject_cast<QLocalSocket *>(m_sock))
+    {
+        QObject::connect(local, &QLocalSocket::disconnected,
+                         this,  &SshTunnelDataConnector::_socketDisconnected);
 #if QT_VERSION >= QT_VERSION_CHECK(5,15,0)
-    QObject::connect(m_sock, &QAbstractSocket::errorOccurred,
-                     this,   &SshTunnelDataConnector::_socketError);
+        QObject::connect(local, &QLocalSocket::errorOccurred,
+                         this,  &SshTunnelDataConnector::_socketError);
 #else
-    QObject::connect(m_sock, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error),
-                     this,   &SshTunnelDataConnector::_socketError);
+        QObject::connect(local, QOverload<QLocalSocket::LocalSocketError>::of(&QLocalSocket::error),
+                         this,  &SshTunnelDataConnector::_socketError);
 #endif
+    }
+    else
+    {
+        /* Plain device: end of the read channel or close is the end of the stream */
+        QObject::connect(m_sock, &QIODevice::readChannelFinished,
+                         this,   &SshTunnelDataConnector::_socketDisconnected);
+        QObject::connect(m_sock, &QIODevice::aboutToClose,
+                         this,   &SshTunnelDataConnector::_socketDisconnected);
+    }
+}
+
+bool SshTunnelDataConnector::_sockConnected() const
+{
+    if(m_sock == nullptr)
+    {
+        return false;
+    }
+    if(QAbstractSocket *tcp = qobject_cast<QAbstractSocket *>(m_sock))
+    {
+        return tcp->state() == QAbstractSocket::ConnectedState;
+    }
+    if(QLocalSocket *local = qobject_cast<QLocalSocket *>(m_sock))
+    {
+        return local->state() == QLocalSocket::ConnectedState;
+    }
+    return m_sock->isOpen() && !m_tx_eof;
+}
 
-    QObject::connect(m_sock, &QTcpSocket::bytesWritten, this, [this](qint64 len){ m_total_RxToSock += len; });
+void SshTunnelDataConnector::_sockDisconnect()
+{
+    if(QAbstractSocket *tcp = qobject_cast<QAbstractSocket *>(m_sock))
+    {
+        tcp->disconnectFromHost();
+    }
+    else if(QLocalSocket *local = qobject_cast<QLocalSocket *>(m_sock))
+    {
+        local->disconnectFromServer();
+    }
+    else if(m_sock)
+    {
+        m_sock->close();
+    }
 }
 
 void SshTunnelDataConnector::_socketDisconnected()
@@ -60,7 +236,7 @@ void SshTunnelDataConnector::_socketDisconnected()
 
 void SshTunnelDataConnector::_socketDataRecived()
 {
-    DEBUGCH << "_socketDataRecived: Socket data received";
+    TRACECH << "_socketDataRecived: Socket data received";
     m_tx_data_on_sock = true;
     emit sendEvent();
 }
@@ -69,81 +245,82 @@ void SshTunnelDataConnector::_socketError()
 {
     DEBUGCH << "_socketError";
     emit processed();
-    auto error = m_sock->error();
-    switch(error)
+    QAbstractSocket *tcp = qobject_cast<QAbstractSocket *>(m_sock);
+    QLocalSocket *local = qobject_cast<QLocalSocket *>(m_sock);
+    if((tcp && tcp->error() == QAbstractSocket::RemoteHostClosedError) || (local && local->error() == QLocalSocket::PeerClosedError))
     {
-        case QAbstractSocket::RemoteHostClosedError:
-            DEBUGCH << "socket RemoteHostClosedError, data available:" << m_sock->bytesAvailable();
-            // Socket will be closed just after this, nothing to care about
-            break;
-        default:
-            qCWarning(logxfer) << m_name << "socket error=" << error << m_sock->errorString();
-            // setChannelState(ChannelState::Close);
+        DEBUGCH << "socket RemoteHostClosedError, data available:" << m_sock->bytesAvailable();
+        // Socket will be closed just after this, nothing to care about
+        return;
     }
+    qCWarning(logxfer) << m_name << "socket error=" << m_sock->errorString();
 }
 
-size_t SshTunnelDataConnector::_txBufferLen() const
+void SshTunnelDataConnector::setWatermarks(size_t high, size_t low)
 {
-    if(m_tx_stop_ptr == nullptr || m_tx_start_ptr == nullptr)
-        return 0;
-
-    if(m_tx_stop_ptr < m_tx_start_ptr)
+    if(high == 0 || low > high)
     {
-        qCWarning(logxfer) << m_name << "TX Buffer error";
-        return 0;
+        qCWarning(logxfer) << m_name << "Invalid watermarks" << high << low;
+        return;
+    }
+    m_highWatermark = high;
+    m_lowWatermark = low;
+    if(!m_tx.setCapacity(high) || !m_rx.setCapacity(high))
+    {
+        qCWarning(logxfer) << m_name << "Can't resize buffers while transfer in progress";
     }
-
-    return static_cast<size_t>(m_tx_stop_ptr - m_tx_start_ptr);
 }
 
 ssize_t SshTunnelDataConnector::_transferSockToTx()
 {
-    if(!m_sock) return 0;
-    qint64 len = 0;
-    if(_txBufferLen() != 0)
-    {
-        qCDebug(logxfer) << m_name << "Asking transfer sock to tx when buffer not empty (" << _txBufferLen() << " bytes)";
-        return -1;
-    }
-
     if(m_sock == nullptr)
     {
         qCCritical(logxfer) << m_name << "_transferSockToTx on invalid socket";
         return -1;
     }
 
-    len = m_sock->read(m_tx_buffer, BUFFER_SIZE);
-    m_tx_data_on_sock = (m_sock->bytesAvailable() > 0);
-    if(len > 0)
+    if(m_tx_throttled)
     {
-        m_tx_start_ptr = m_tx_buffer;
-        m_tx_stop_ptr = m_tx_buffer + len;
-        m_total_sockToTx += len;
-
-        DEBUGCH << "_transferSockToTx: " << len << "bytes (available:" << m_sock->bytesAvailable() << ", state:" << m_sock->state() << ")";
-        if(m_tx_data_on_sock)
+        if(m_tx.size() > m_lowWatermark)
         {
-            DEBUGCH << "_transferSockToTx: There is other data in socket, re-arm read";
-            emit sendEvent();
+            TRACECH << "_transferSockToTx: TX buffer above low watermark (" << m_tx.size() << " bytes)";
+            return 0;
         }
+        m_tx_throttled = false;
     }
-    else if(len < 0)
+
+    ssize_t total = 0;
+    while(m_tx.size() < m_highWatermark)
     {
-        qCWarning(logxfer) << m_name << "_transferSockToTx: error: " << len << " Bytes available " << m_sock->bytesAvailable();
-        m_tx_stop_ptr = nullptr;
-        m_tx_start_ptr = nullptr;
+        size_t room = qMin(m_tx.writeSize(), m_highWatermark - m_tx.size());
+        qint64 len = m_sock->read(m_tx.writePointer(), static_cast<qint64>(room));
+        if(len < 0)
+        {
+            qCWarning(logxfer) << m_name << "_transferSockToTx: error: " << len << " Bytes available " << m_sock->bytesAvailable();
+            break;
+        }
+        if(len == 0)
+        {
+            break;
+        }
+        m_tx.commit(static_cast<size_t>(len));
+        m_total_sockToTx += len;
+        total += len;
     }
-    else
+
+    if(m_tx.size() >= m_highWatermark)
     {
-        DEBUGCH << m_name << "_transferSockToTx: 0 lenght";
-        m_tx_stop_ptr = nullptr;
-        m_tx_start_ptr = nullptr;
+        TRACECH << "_transferSockToTx: TX buffer reach high watermark";
+        m_tx_throttled = true;
     }
 
+    m_tx_data_on_sock = (m_sock->bytesAvailable() > 0);
+    TRACECH << "_transferSockToTx: " << total << "bytes (available:" << m_sock->bytesAvailable() << ", buffer:" << m_tx.size() << ")";
+
     emit processed();
-    if(len > 0)
+    if(total > 0)
         emit sendEvent();
-    return len;
+    return total;
 }
 
 ssize_t SshTunnelDataConnector::_transferTxToSsh()
@@ -153,18 +330,32 @@ ssize_t SshTunnelDataConnector::_transferTxToSsh()
     if(m_tx_closed) return 0;
     if(!m_sshChannel) return 0;
 
-    while(_txBufferLen() > 0)
+    /* Without owner (nor client, offline) writes are not scheduled */
+    SshWriteScheduler *scheduler = (m_owner && m_sshClient) ? &m_sshClient->writeScheduler() : nullptr;
+    while(m_tx.size() > 0)
     {
-        ssize_t len = libssh2_channel_write(m_sshChannel, m_tx_start_ptr, _txBufferLen());
+        size_t quota = (scheduler) ? scheduler->grant(m_owner, m_tx.readSize()) : m_tx.readSize();
+        if(quota == 0)
+        {
+            /* Our turn is over, woken up on the next round */
+            return LIBSSH2_ERROR_EAGAIN;
+        }
+        ssize_t len = m_io->write(m_sshChannel, m_tx.readPointer(), quota);
+        if(scheduler)
+        {
+            /* Only with a real session, the offline channel has no window */
+            m_owner->writeWindowUsed(m_sshChannel);
+        }
         if(len == LIBSSH2_ERROR_EAGAIN)
         {
+            m_txStalls++;
             return LIBSSH2_ERROR_EAGAIN;
         }
         if (len < 0)
         {
-            char *emsg;
+            char *emsg = nullptr;
             int size;
-            int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
+            int ret = (m_sshClient) ? libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0) : static_cast<int>(len);
             qCCritical(logxfer) << m_name << "Error" << ret << "libssh2_channel_write" << QString(emsg);
             return ret;
         }
@@ -176,85 +367,90 @@ ssize_t SshTunnelDataConnector::_transferTxToSsh()
         /* xfer OK */
 
         m_total_TxToSsh += len;
-        m_tx_start_ptr += len;
+        m_writeSizes[_writeBucket(static_cast<size_t>(len))]++;
+        m_tx.consume(static_cast<size_t>(len));
+        if(scheduler)
+        {
+            scheduler->consumed(m_owner, static_cast<size_t>(len));
+        }
         transfered += len;
-        DEBUGCH << "_transferTxToSsh: write on SSH return " << len << "bytes" ;
+        TRACECH << "_transferTxToSsh: write on SSH return " << len << "bytes" ;
 
-        if(m_tx_start_ptr == m_tx_stop_ptr)
+        if(m_tx_throttled && m_tx_data_on_sock && m_tx.size() <= m_lowWatermark && m_tx.size() + static_cast<size_t>(len) > m_lowWatermark)
         {
-            DEBUGCH << "_transferTxToSsh: All buffer sent on SSH, buffer empty" ;
-            m_tx_stop_ptr = nullptr;
-            m_tx_start_ptr = nullptr;
+            /* Room again in buffer, continue to read the socket while we write */
+            emit sendEvent();
         }
     }
 
-    emit processed();
-    return transfered;
-}
-
-size_t SshTunnelDataConnector::_rxBufferLen() const
-{
-    if(m_rx_stop_ptr == nullptr || m_rx_start_ptr == nullptr)
-        return 0;
-
-    if(m_rx_stop_ptr < m_rx_start_ptr)
+    TRACECH << "_transferTxToSsh: All buffer sent on SSH, buffer empty" ;
+    if(scheduler)
     {
-        qCWarning(logxfer) << m_name << "RX Buffer error";
-        return 0;
+        scheduler->done(m_owner);
     }
-
-    return static_cast<size_t>(m_rx_stop_ptr - m_rx_start_ptr);
+    m_tx.release();
+    emit processed();
+    return transfered;
 }
 
 ssize_t SshTunnelDataConnector::_transferSshToRx()
 {
     if(!m_sshChannel) return 0;
 
-    if(_rxBufferLen() != 0)
+    if(m_rx_throttled)
     {
-        qCDebug(logxfer) << "Buffer not empty, need to retry later";
-        emit sendEvent();
-        return 0;
+        if(m_rx.size() > m_lowWatermark)
+        {
+            TRACECH << "Buffer above low watermark, need to retry later";
+            emit sendEvent();
+            return 0;
+        }
+        m_rx_throttled = false;
     }
 
-    ssize_t len = libssh2_channel_read(m_sshChannel, m_rx_buffer, BUFFER_SIZE);
-    if(len == LIBSSH2_ERROR_EAGAIN)
-        return 0;
-
-    if (len < 0)
+    ssize_t total = 0;
+    while(m_rx.size() < m_highWatermark)
     {
-        qCWarning(logxfer) << m_name << "_transferSshToRx: error: " << len;
-        m_rx_stop_ptr = nullptr;
-        m_rx_start_ptr = nullptr;
-
-        char *emsg;
-        int size;
-        int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
-        qCCritical(logxfer) << m_name << "Error" << ret << QString("libssh2_channel_read (%1 / %2)").arg(len).arg(BUFFER_SIZE) << QString(emsg);
-        return 0;
-    }
-
-    m_total_SshToRx += len;
+        size_t room = qMin(m_rx.writeSize(), m_highWatermark - m_rx.size());
+        ssize_t len = m_io->read(m_sshChannel, m_rx.writePointer(), room);
+        if(len == LIBSSH2_ERROR_EAGAIN || len == 0)
+        {
+            m_rx_data_on_ssh = false;
+            if (m_io->eof(m_sshChannel))
+            {
+                m_rx_eof = true;
+                DEBUGCH << "_transferSshToRx: Ssh channel closed";
+            }
+            break;
+        }
 
-    if(len < BUFFER_SIZE)
-    {
-        DEBUGCH << "_transferSshToRx: Xfer " << len << "bytes";
-        m_rx_data_on_ssh = false;
-        if (libssh2_channel_eof(m_sshChannel))
+        if (len < 0)
         {
-            m_rx_eof = true;
-            DEBUGCH << "_transferSshToRx: Ssh channel closed";
+            qCWarning(logxfer) << m_name << "_transferSshToRx: error: " << len;
+
+            char *emsg = nullptr;
+            int size;
+            int ret = (m_sshClient) ? libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0) : static_cast<int>(len);
+            qCCritical(logxfer) << m_name << "Error" << ret << QString("libssh2_channel_read (%1 / %2)").arg(len).arg(room) << QString(emsg);
+            break;
         }
+
+        m_rx.commit(static_cast<size_t>(len));
+        m_total_SshToRx += len;
+        total += len;
     }
-    else
+
+    if(m_rx.size() >= m_highWatermark)
     {
-        DEBUGCH << "_transferSshToRx: Xfer " << len << "bytes; There is probably more data to read, re-arm event";
+        TRACECH << "_transferSshToRx: RX buffer reach high watermark; There is probably more data to read, re-arm event";
+        m_rx_throttled = true;
+        m_rxStalls++;
         emit sendEvent();
     }
-    m_rx_stop_ptr = m_rx_buffer + len;
-    m_rx_start_ptr = m_rx_buffer;
+
+    TRACECH << "_transferSshToRx: Xfer " << total << "bytes";
     emit processed();
-    return len;
+    return total;
 }
 
 ssize_t SshTunnelDataConnector::_transferRxToSock()
@@ -263,37 +459,42 @@ ssize_t SshTunnelDataConnector::_transferRxToSock()
     ssize_t total = 0;
 
     /* If socket not ready, wait for socket connected */
-    if(!m_sock || m_sock->state() != QAbstractSocket::ConnectedState)
+    if(!_sockConnected())
     {
-        qCDebug(logxfer) << m_name << "_transferRxToSock: Data on SSH when socket closed";
+        TRACECH << "_transferRxToSock: Data on SSH when socket closed";
         return -1;
     }
 
-    if(m_rx_stop_ptr == nullptr)
+    if(m_rx.isEmpty())
     {
-        qCWarning(logxfer) <<  m_name << "Buffer empty";
+        TRACECH << "Buffer empty";
         return 0;
     }
 
-    DEBUGCH << "_transferRxToSock: Buffer contains " << _rxBufferLen() << "bytes";
+    TRACECH << "_transferRxToSock: Buffer contains " << m_rx.size() << "bytes";
 
-    while (_rxBufferLen() > 0)
+    while (m_rx.size() > 0)
     {
-        ssize_t slen = m_sock->write(m_rx_start_ptr, m_rx_stop_ptr - m_rx_start_ptr);
+        qint64 slen = m_sock->write(m_rx.readPointer(), static_cast<qint64>(m_rx.readSize()));
         if (slen <= 0)
         {
             qCWarning(logxfer) << "ERROR : " << m_name << " local failed to write (" << slen << ")";
             return slen;
         }
 
-        m_rx_start_ptr += slen;
+        m_rx.consume(static_cast<size_t>(slen));
         total += slen;
-        DEBUGCH << "_transferRxToSock: " << slen << "bytes written on socket";
+        TRACECH << "_transferRxToSock: " << slen << "bytes written on socket";
     }
 
     /* Buffer is empty */
-    m_rx_stop_ptr = nullptr;
-    m_rx_start_ptr = nullptr;
+    m_rx.release();
+
+    if(m_rx_throttled)
+    {
+        /* Data was left in SSH channel */
+        emit sendEvent();
+    }
 
     emit processed();
     return total;
@@ -306,12 +507,13 @@ void SshTunnelDataConnector::sshDataReceived()
 
 bool SshTunnelDataConnector::process()
 {
+    m_processCalls++;
     if(!m_rx_closed)
     {
-        if(m_rx_data_on_ssh)
+        if(m_rx_data_on_ssh || m_rx_throttled)
             _transferSshToRx();
 
-        if(_rxBufferLen() || m_rx_eof)
+        if(!m_rx.isEmpty() || m_rx_eof)
             _transferRxToSock();
     }
 
@@ -320,16 +522,16 @@ bool SshTunnelDataConnector::process()
         if(m_tx_data_on_sock)
             _transferSockToTx();
 
-        if(_txBufferLen() || m_tx_eof)
+        if((!m_tx.isEmpty() && !_holdTx()) || m_tx_eof)
             _transferTxToSsh();
     }
 
 
 
-    if(!m_tx_closed && m_tx_eof && (m_sock->bytesAvailable() == 0) && (_txBufferLen() == 0))
+    if(!m_tx_closed && m_tx_eof && (m_sock->bytesAvailable() == 0) && m_tx.isEmpty())
     {
         DEBUGCH << "Send EOF to SSH";
-        int ret = libssh2_channel_send_eof(m_sshChannel);
+        int ret = m_io->sendEof(m_sshChannel);
         if(ret == 0)
         {
             m_tx_closed = true;
@@ -337,12 +539,12 @@ bool SshTunnelDataConnector::process()
         }
     }
 
-    if(!m_rx_closed && m_rx_eof && (_rxBufferLen() == 0) && (m_sock->bytesAvailable() == 0) && (_txBufferLen() == 0))
+    if(!m_rx_closed && m_rx_eof && m_rx.isEmpty() && (m_sock->bytesAvailable() == 0) && m_tx.isEmpty())
     {
-        if(m_sock->state() == QAbstractSocket::ConnectedState)
+        if(_sockConnected())
         {
             DEBUGCH << "_transferRxToSock: RX EOF, need to close ???";
-            m_sock->disconnectFromHost();
+            _sockDisconnect();
         }
         else
         {
@@ -352,17 +554,17 @@ bool SshTunnelDataConnector::process()
         }
     }
 
-    DEBUGCH << "XFer Tx: Sock->" << m_total_sockToTx << "->Tx->" <<  m_total_TxToSsh  << "->SSH" << ((m_tx_eof)?(" (EOF)"):("")) << ((m_tx_closed)?(" (CLOSED)"):(""));
-    DEBUGCH << "XFer Rx: SSH->"  << m_total_SshToRx  << "->Rx->" <<  m_total_RxToSock << "->Sock(" << m_sock->state() << ")" << ((m_rx_eof)?(" (EOF)"):(""))<< ((m_rx_closed)?(" (CLOSED)"):(""));
+    TRACECH << "XFer Tx: Sock->" << m_total_sockToTx << "->Tx->" <<  m_total_TxToSsh  << "->SSH" << ((m_tx_eof)?(" (EOF)"):("")) << ((m_tx_closed)?(" (CLOSED)"):(""));
+    TRACECH << "XFer Rx: SSH->"  << m_total_SshToRx  << "->Rx->" <<  m_total_RxToSock << "->Sock(" << _sockConnected() << ")" << ((m_rx_eof)?(" (EOF)"):(""))<< ((m_rx_closed)?(" (CLOSED)"):(""));
 
     return (!m_rx_closed && !m_tx_closed);
 }
 
 void SshTunnelDataConnector::close()
 {
-    if(m_sock && m_sock->state() == QAbstractSocket::ConnectedState)
+    if(_sockConnected())
     {
-        m_sock->disconnectFromHost();
+        _sockDisconnect();
     }
     else
     {
@@ -372,16 +574,16 @@ void SshTunnelDataConnector::close()
 
 bool SshTunnelDataConnector::isClosed()
 {
-    DEBUGCH << "SshTunnelDataConnector::isClosed(tx:" << m_tx_closed << ", rx:" << m_rx_closed << ")";
-    return m_tx_closed && m_rx_closed && _rxBufferLen() == 0 && _txBufferLen() == 0;
+    TRACECH << "SshTunnelDataConnector::isClosed(tx:" << m_tx_closed << ", rx:" << m_rx_closed << ")";
+    return m_tx_closed && m_rx_closed && m_rx.isEmpty() && m_tx.isEmpty();
 }
 
 void SshTunnelDataConnector::flushTx()
 {
-    DEBUGCH << "flushTx: start " << ": Sock: " << m_sock->bytesAvailable() << " | buffer:" << _txBufferLen();
+    TRACECH << "flushTx: start " << ": Sock: " << m_sock->bytesAvailable() << " | buffer:" << m_tx.size();
     while(1)
     {
-        if(m_sock->bytesAvailable() == 0 && _txBufferLen() == 0)
+        if(m_sock->bytesAvailable() == 0 && m_tx.isEmpty())
             break;
 
         if(m_tx_closed || m_rx_closed)
@@ -392,7 +594,7 @@ void SshTunnelDataConnector::flushTx()
             _transferSockToTx();
         }
 
-        if(_txBufferLen() > 0)
+        if(!m_tx.isEmpty())
         {
             if(_transferTxToSsh() == LIBSSH2_ERROR_EAGAIN)
             {
@@ -403,5 +605,5 @@ void SshTunnelDataConnector::flushTx()
         }
     }
 
-    DEBUGCH << "flushTx: end " << ": Sock: " << m_sock->bytesAvailable() << " | buffer:" << _txBufferLen();
+    TRACECH << "flushTx: end " << ": Sock: " << m_sock->bytesAvailable() << " | buffer:" << m_tx.size();
 }
@@ -3,8 +3,12 @@
 
 #include <QObject>
 #include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QTimer>
 #include "sshchannel.h"
-class QTcpSocket;
+#include "sshringbuffer.h"
+#include "sshchannelio.h"
+class QIODevice;
 
 #define BUFFER_SIZE (128*1024)
 
@@ -15,17 +19,21 @@ class SshTunnelDataConnector : public QObject
     Q_OBJECT
 
     SshClient *m_sshClient  {nullptr};
+    SshChannel *m_owner {nullptr};
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
-    QTcpSocket *m_sock  {nullptr};
+    SshChannelIo *m_io {&SshChannelIo::direct()};
+    QIODevice *m_sock  {nullptr};
     QString m_name;
 
     /* Transfer functions */
 
+    /* Buffers watermarks: stop filling at high, resume at low */
+    size_t m_highWatermark {BUFFER_SIZE};
+    size_t m_lowWatermark {BUFFER_SIZE / 2};
+
     /* TX Channel */
-    char m_tx_buffer[BUFFER_SIZE] {0,};
-    char *m_tx_start_ptr {nullptr};
-    char *m_tx_stop_ptr {nullptr};
-    size_t _txBufferLen() const;
+    SshRingBuffer m_tx {BUFFER_SIZE};
+    bool m_tx_throttled {false};
 
     bool m_tx_data_on_sock {false};
     ssize_t _transferSockToTx();
@@ -38,10 +46,8 @@ class SshTunnelDataConnector : public QObject
 
 
     /* RX Channel */
-    char m_rx_buffer[BUFFER_SIZE] {0,};
-    char *m_rx_start_ptr {nullptr};
-    char *m_rx_stop_ptr {nullptr};
-    size_t _rxBufferLen() const;
+    SshRingBuffer m_rx {BUFFER_SIZE};
+    bool m_rx_throttled {false};
 
     bool m_rx_data_on_ssh {false};
     ssize_t _transferSshToRx();
@@ -49,9 +55,28 @@ class SshTunnelDataConnector : public QObject
     bool m_rx_eof {false};
 
     ssize_t _transferRxToSock();
+
+    /* Socket type independent helpers */
+    bool _sockConnected() const;
+    void _sockDisconnect();
     ssize_t m_total_RxToSock {0};
     bool m_rx_closed {false};
 
+    /* Counters always kept, tracing is compiled out of release builds */
+    quint64 m_txStalls {0};
+    quint64 m_rxStalls {0};
+    quint64 m_processCalls {0};
+    quint64 m_writeSizes[SSH_WRITE_HISTOGRAM_BUCKETS] {};
+
+    /* Write coalescing: small socket reads wait to fill a larger packet */
+    size_t m_coalesceSize {0};
+    qint64 m_coalesceDelay {0};
+    bool m_coalesceHold {false};
+    bool m_coalesceFlush {false};
+    QElapsedTimer m_coalesceClock;
+    QTimer m_coalesceTimer;
+    bool _holdTx();
+
 
 public slots:
     void sshDataReceived();
@@ -64,7 +89,41 @@ public:
     explicit SshTunnelDataConnector(SshClient *client, const QString &name, QObject *parent = nullptr);
     virtual ~SshTunnelDataConnector();
     void setChannel(LIBSSH2_CHANNEL *channel);
-    void setSock(QTcpSocket *sock);
+    /* Backend of the channel calls, libssh2 unless a fake one is given */
+    void setIo(SshChannelIo *io);
+    /* Channel on which behalf writes are scheduled with the other channels */
+    void setOwner(SshChannel *owner);
+    /* QTcpSocket, QLocalSocket or any sequential QIODevice (in-process endpoint) */
+    void setSock(QIODevice *sock);
+    void setWatermarks(size_t high, size_t low);
+
+    /*
+     * Back to a new connector for the next connection of a recycled
+     * channel: socket and channel dropped, counters cleared. The buffers
+     * keep their memory, watermarks and coalescing are kept.
+     */
+    void reset(const QString &name);
+
+    /*
+     * Opt-in: less than size bytes read from the socket are held until
+     * the pending events are processed or delayUsec elapsed, then written
+     * with what came meanwhile. 0 disables.
+     */
+    void setCoalescing(size_t size, int delayUsec = 200);
+
+    struct Stats {
+        quint64 sockToTx;
+        quint64 txToSsh;
+        quint64 sshToRx;
+        quint64 rxToSock;
+        size_t txBuffered;
+        size_t rxBuffered;
+        quint64 txStalls;       /* channel write returned EAGAIN */
+        quint64 rxStalls;       /* receive buffer full, channel left unread */
+        quint64 processCalls;
+        quint64 writeSizes[SSH_WRITE_HISTOGRAM_BUCKETS];
+    };
+    Stats stats() const;
 
 signals:
     void sendEvent();
@@ -0,0 +1,156 @@
+#include "sshtunneldynamic.h"
+#include "sshclient.h"
+
+Q_LOGGING_CATEGORY(logsshtunneldynamic, "ssh.tunneldynamic", QtWarningMsg)
+
+
+SshTunnelDynamic::SshTunnelDynamic(const QString &name, SshClient *client)
+    : SshChannel(name, client)
+{
+    QObject::connect(&m_tcpserver, &QTcpServer::newConnection, this, &SshTunnelDynamic::_createConnection);
+    sshDataReceived();
+}
+
+SshTunnelDynamic::~SshTunnelDynamic()
+{
+    qCDebug(logsshtunneldynamic) << "delete SshTunnelDynamic:" << m_name;
+}
+
+bool SshTunnelDynamic::sshEventPending()
+{
+    /* Connections are dispatched by themselves, the server only care about closing */
+    return channelState() != ChannelState::Ready;
+}
+
+void SshTunnelDynamic::close()
+{
+    qCDebug(logsshtunneldynamic) << m_name << "Ask to close";
+    setChannelState(ChannelState::Close);
+    sshDataReceived();
+}
+
+bool SshTunnelDynamic::listen(QString hostListen, quint16 port)
+{
+    if(!m_tcpserver.listen(QHostAddress(hostListen), port))
+    {
+        qCWarning(logsshtunneldynamic) << m_name << "Can't listen on" << hostListen << port << m_tcpserver.errorString();
+        setChannelState(ChannelState::Error);
+        return false;
+    }
+    qCDebug(logsshtunneldynamic) << m_name << "SOCKS server on" << hostListen << m_tcpserver.serverPort();
+    setChannelState(ChannelState::Ready);
+    return true;
+}
+
+void SshTunnelDynamic::sshDataReceived()
+{
+    switch(channelState())
+    {
+        case Openning:
+        case Exec:
+        case Ready:
+        {
+            // Nothing to do...
+            return;
+        }
+
+        case Close:
+        {
+            qCDebug(logsshtunneldynamic) << m_name << "Close server";
+            m_tcpserver.close();
+            closeAllConnections();
+            setChannelState(ChannelState::WaitClose);
+        }
+
+        FALLTHROUGH; case WaitClose:
+        {
+            qCDebug(logsshtunneldynamic) << "Wait close channel:" << m_name << " (connections:"<< m_connection.count() << ")";
+            if(m_connection.count() == 0)
+            {
+                setChannelState(ChannelState::Freeing);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        FALLTHROUGH; case Freeing:
+        {
+            qCDebug(logsshtunneldynamic) << "free Channel:" << m_name;
+            setChannelState(ChannelState::Free);
+            return;
+        }
+
+        case Free:
+        {
+            qCDebug(logsshtunneldynamic) << "Channel" << m_name << "is free";
+            return;
+        }
+
+        case Error:
+        {
+            qCDebug(logsshtunneldynamic) << "Channel" << m_name << "is in error state";
+            return;
+        }
+    }
+}
+
+int SshTunnelDynamic::connections()
+{
+    return m_connection.count();
+}
+
+void SshTunnelDynamic::closeAllConnections()
+{
+    for(SshTunnelDynamicConnection *connection : m_connection)
+    {
+        connection->close();
+    }
+}
+
+void SshTunnelDynamic::connectionStateChanged()
+{
+    QObject *obj = QObject::sender();
+    SshTunnelDynamicConnection *connection = qobject_cast<SshTunnelDynamicConnection*>(obj);
+    if(connection)
+    {
+        if(connection->channelState() == SshChannel::ChannelState::Free)
+        {
+            m_connection.removeAll(connection);
+            emit connectionChanged(m_connection.count());
+
+            if(m_connection.count() == 0 && channelState() == SshChannel::ChannelState::WaitClose)
+            {
+                setChannelState(SshChannel::ChannelState::Freeing);
+                sshDataReceived();
+            }
+        }
+    }
+}
+
+void SshTunnelDynamic::setBufferWatermarks(size_t high, size_t low)
+{
+    m_highWatermark = high;
+    m_lowWatermark = low;
+}
+
+void SshTunnelDynamic::_createConnection()
+{
+    while(m_tcpserver.hasPendingConnections())
+    {
+        QTcpSocket *sock = m_tcpserver.nextPendingConnection();
+        qCDebug(logsshtunneldynamic) << "SshTunnelDynamic new SOCKS client";
+        SshTunnelDynamicConnection *connection = m_sshClient->getChannel<SshTunnelDynamicConnection>(m_name + QString("_%1").arg(m_connectionCounter++));
+        connection->setBufferWatermarks(m_highWatermark, m_lowWatermark);
+        QObject::connect(connection, &SshTunnelDynamicConnection::stateChanged, this, &SshTunnelDynamic::connectionStateChanged);
+        connection->configure(sock);
+        m_connection.append(connection);
+        emit connectionChanged(m_connection.count());
+    }
+}
+
+quint16 SshTunnelDynamic::localPort()
+{
+    return m_tcpserver.serverPort();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QObject>
+#include <QTcpServer>
+#include "sshchannel.h"
+#include "sshtunneldynamicconnection.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshtunneldynamic)
+
+/*
+ * Dynamic forwarding (ssh -D): a local SOCKS5 server, each client gets a
+ * direct-tcpip channel to the destination it asks for.
+ */
+class SshTunnelDynamic : public SshChannel
+{
+    Q_OBJECT
+
+protected:
+    explicit SshTunnelDynamic(const QString &name, SshClient * client);
+    friend class SshClient;
+    bool sshEventPending() override;
+
+public:
+    virtual ~SshTunnelDynamic() override;
+    void close() override;
+    quint16 localPort();
+    void setBufferWatermarks(size_t high, size_t low);
+
+public slots:
+    bool listen(QString hostListen = "127.0.0.1", quint16 port = 0);
+    void sshDataReceived() override;
+    int connections();
+    void closeAllConnections();
+    void connectionStateChanged();
+
+private:
+    QTcpServer              m_tcpserver;
+    int                     m_connectionCounter {0};
+    size_t                  m_highWatermark {BUFFER_SIZE};
+    size_t                  m_lowWatermark {BUFFER_SIZE / 2};
+    QList<SshTunnelDynamicConnection*> m_connection;
+
+private slots:
+    void _createConnection();
+
+signals:
+    void connectionChanged(int);
+};
@@ -0,0 +1,352 @@
+#include "sshtunneldynamicconnection.h"
+#include "sshclient.h"
+#include <QHostAddress>
+#include <QtEndian>
+#include <algorithm>
+#include <iterator>
+
+Q_LOGGING_CATEGORY(logsshtunneldynamicconnection, "ssh.tunneldynamic.connection", QtWarningMsg)
+
+#define DEBUGCH qCDebug(logsshtunneldynamicconnection) << m_name
+
+/* RFC 1928 */
+#define SOCKS_VERSION       (0x05)
+#define SOCKS_NO_AUTH       (0x00)
+#define SOCKS_NO_METHOD     (0xFF)
+#define SOCKS_CMD_CONNECT   (0x01)
+#define SOCKS_ATYP_IPV4     (0x01)
+#define SOCKS_ATYP_DOMAIN   (0x03)
+#define SOCKS_ATYP_IPV6     (0x04)
+#define SOCKS_SUCCEEDED     (0x00)
+#define SOCKS_FAILURE       (0x01)
+#define SOCKS_REFUSED       (0x05)
+#define SOCKS_BAD_COMMAND   (0x07)
+#define SOCKS_BAD_ADDRESS   (0x08)
+
+SshTunnelDynamicConnection::SshTunnelDynamicConnection(const QString &name, SshClient *client)
+    : SshChannel(name, client)
+    , m_connector(client, name)
+{
+    m_connector.setOwner(this);
+    QObject::connect(this, &SshTunnelDynamicConnection::sendEvent, this, &SshTunnelDynamicConnection::_eventLoop, Qt::QueuedConnection);
+    QObject::connect(&m_connector, &SshTunnelDataConnector::sendEvent, this, &SshTunnelDynamicConnection::sendEvent);
+    DEBUGCH << "Create SshTunnelDynamicConnection (constructor)";
+}
+
+SshTunnelDynamicConnection::~SshTunnelDynamicConnection()
+{
+    DEBUGCH << "Free SshTunnelDynamicConnection (destructor)";
+    delete m_sock;
+}
+
+void SshTunnelDynamicConnection::configure(QTcpSocket *sock)
+{
+    m_sock = sock;
+    m_name = QString(m_name + ":%1").arg(m_sock->peerPort());
+    QObject::connect(m_sock, &QTcpSocket::readyRead, this, &SshTunnelDynamicConnection::sendEvent);
+    QObject::connect(m_sock, &QTcpSocket::disconnected, this, [this](){
+        if(channelState() == ChannelState::Openning)
+        {
+            DEBUGCH << "Client left during negotiation";
+            setChannelState(ChannelState::Close);
+            emit sendEvent();
+        }
+    });
+    emit sendEvent();
+}
+
+void SshTunnelDynamicConnection::setBufferWatermarks(size_t high, size_t low)
+{
+    m_connector.setWatermarks(high, low);
+}
+
+LIBSSH2_CHANNEL *SshTunnelDynamicConnection::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
+void SshTunnelDynamicConnection::transferStats(Stats &stats) const
+{
+    SshTunnelDataConnector::Stats xfer = m_connector.stats();
+    stats.bytesIn = xfer.sshToRx;
+    stats.bytesOut = xfer.txToSsh;
+    stats.stalls = xfer.txStalls + xfer.rxStalls;
+    stats.buffered = xfer.txBuffered + xfer.rxBuffered;
+    std::copy(std::begin(xfer.writeSizes), std::end(xfer.writeSizes), std::begin(stats.writeSizes));
+}
+
+QString SshTunnelDynamicConnection::targetHost() const
+{
+    return m_target;
+}
+
+quint16 SshTunnelDynamicConnection::targetPort() const
+{
+    return m_port;
+}
+
+void SshTunnelDynamicConnection::close()
+{
+    DEBUGCH << "Close SshTunnelDynamicConnection asked";
+    if(channelState() != ChannelState::Error)
+    {
+        setChannelState(ChannelState::Close);
+    }
+    emit sendEvent();
+}
+
+void SshTunnelDynamicConnection::sshDataReceived()
+{
+    m_connector.sshDataReceived();
+    emit sendEvent();
+}
+
+void SshTunnelDynamicConnection::flushTx()
+{
+    if(channelState() == ChannelState::Ready)
+    {
+        m_connector.flushTx();
+    }
+}
+
+bool SshTunnelDynamicConnection::_readGreeting()
+{
+    /* VER NMETHODS METHODS... */
+    QByteArray head = m_sock->peek(2);
+    if(head.size() < 2)
+    {
+        return false;
+    }
+    int len = 2 + static_cast<unsigned char>(head[1]);
+    if(m_sock->bytesAvailable() < len)
+    {
+        return false;
+    }
+    QByteArray greeting = m_sock->read(len);
+    if(greeting[0] != SOCKS_VERSION || !greeting.mid(2).contains(static_cast<char>(SOCKS_NO_AUTH)))
+    {
+        qCWarning(logsshtunneldynamicconnection) << m_name << "No supported SOCKS version or method";
+        const char reply[] = {SOCKS_VERSION, static_cast<char>(SOCKS_NO_METHOD)};
+        m_sock->write(reply, sizeof(reply));
+        m_error = true;
+        setChannelState(ChannelState::Close);
+        return false;
+    }
+    const char reply[] = {SOCKS_VERSION, SOCKS_NO_AUTH};
+    m_sock->write(reply, sizeof(reply));
+    return true;
+}
+
+bool SshTunnelDynamicConnection::_readRequest()
+{
+    /* VER CMD RSV ATYP DST.ADDR DST.PORT */
+    QByteArray head = m_sock->peek(5);
+    if(head.size() < 5)
+    {
+        return false;
+    }
+    int addrlen = 0;
+    switch(head[3])
+    {
+        case SOCKS_ATYP_IPV4:   addrlen = 4; break;
+        case SOCKS_ATYP_IPV6:   addrlen = 16; break;
+        case SOCKS_ATYP_DOMAIN: addrlen = 1 + static_cast<unsigned char>(head[4]); break;
+        default:
+            _refuse(SOCKS_BAD_ADDRESS);
+            return false;
+    }
+    int len = 4 + addrlen + 2;
+    if(m_sock->bytesAvailable() < len)
+    {
+        return false;
+    }
+
+    QByteArray request = m_sock->read(len);
+    if(request[0] != SOCKS_VERSION || request[1] != SOCKS_CMD_CONNECT)
+    {
+        _refuse(SOCKS_BAD_COMMAND);
+        return false;
+    }
+
+    const uchar *addr = reinterpret_cast<const uchar *>(request.constData()) + 4;
+    switch(request[3])
+    {
+        case SOCKS_ATYP_IPV4:
+            m_target = QHostAddress(qFromBigEndian<quint32>(addr)).toString();
+            break;
+        case SOCKS_ATYP_IPV6:
+            m_target = QHostAddress(addr).toString();
+            break;
+        default:
+            m_target = QString::fromLatin1(request.mid(5, addrlen - 1));
+            break;
+    }
+    m_port = qFromBigEndian<quint16>(addr + addrlen);
+    DEBUGCH << "SOCKS connect to" << m_target << m_port;
+    return true;
+}
+
+void SshTunnelDynamicConnection::_reply(char status)
+{
+    /* Bound address is not known at channel level, answer 0.0.0.0:0 */
+    const char reply[] = {SOCKS_VERSION, status, 0x00, SOCKS_ATYP_IPV4, 0, 0, 0, 0, 0, 0};
+    m_sock->write(reply, sizeof(reply));
+}
+
+void SshTunnelDynamicConnection::_refuse(char status)
+{
+    qCDebug(logsshtunneldynamicconnection) << m_name << "Refuse SOCKS request, status" << int(status);
+    _reply(status);
+    m_error = true;
+    setChannelState(ChannelState::Close);
+}
+
+void SshTunnelDynamicConnection::_eventLoop()
+{
+    switch(channelState())
+    {
+        case Openning:
+        {
+            if(m_sock == nullptr)
+            {
+                return;
+            }
+            if(m_step == Greeting)
+            {
+                if(!_readGreeting())
+                {
+                    /* Wait for more data, or refused */
+                    if(channelState() != ChannelState::Openning)
+                    {
+                        emit sendEvent();
+                    }
+                    return;
+                }
+                m_step = Request;
+            }
+            if(m_step == Request)
+            {
+                if(!_readRequest())
+                {
+                    if(channelState() != ChannelState::Openning)
+                    {
+                        emit sendEvent();
+                    }
+                    return;
+                }
+                m_step = Connect;
+            }
+
+            if ( ! m_sshClient->acquireChannelOpen(this) )
+            {
+                return;
+            }
+            m_sshChannel = openDirectTcpip(m_target, m_port);
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
+            if (m_sshChannel == nullptr)
+            {
+                char *emsg;
+                int size;
+                int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
+                if(ret == LIBSSH2_ERROR_EAGAIN)
+                {
+                    return;
+                }
+                qCDebug(logsshtunneldynamicconnection) << m_name << "Channel to" << m_target << m_port << "failed:" << QString(emsg);
+                _refuse((ret == LIBSSH2_ERROR_CHANNEL_FAILURE) ? SOCKS_REFUSED : SOCKS_FAILURE);
+                emit sendEvent();
+                return;
+            }
+
+            DEBUGCH << "Channel session opened";
+            _reply(SOCKS_SUCCEEDED);
+            QObject::disconnect(m_sock, &QTcpSocket::readyRead, this, &SshTunnelDynamicConnection::sendEvent);
+            m_connector.setChannel(m_sshChannel);
+            m_connector.setSock(m_sock);
+            setChannelState(ChannelState::Exec);
+        }
+
+        FALLTHROUGH; case Exec:
+        {
+            setChannelState(ChannelState::Ready);
+        }
+
+        FALLTHROUGH; case Ready:
+        {
+            if(!m_connector.process())
+            {
+                setChannelState(ChannelState::Close);
+                return;
+            }
+            tuneWindow(m_sshChannel);
+            return;
+        }
+
+        case Close:
+        {
+            DEBUGCH << "closeChannel";
+            if(m_sshChannel == nullptr)
+            {
+                /* Closed during negotiation, nothing opened on the server */
+                if(m_sock)
+                {
+                    m_sock->disconnectFromHost();
+                }
+                setChannelState(ChannelState::Free);
+                return;
+            }
+            m_connector.close();
+            setChannelState(ChannelState::WaitClose);
+        }
+
+        FALLTHROUGH; case WaitClose:
+        {
+            DEBUGCH << "Wait close channel";
+            /* Fast close: the connector was told to close, don't wait for it */
+            if(skipWaitClosed() || m_connector.isClosed())
+            {
+                setChannelState(ChannelState::Freeing);
+            }
+            else
+            {
+                m_connector.process();
+                return;
+            }
+        }
+
+        FALLTHROUGH; case Freeing:
+        {
+            DEBUGCH << "free Channel";
+
+            int ret = libssh2_channel_free(m_sshChannel);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+            if(ret < 0)
+            {
+                if(!m_error)
+                {
+                    m_error = true;
+                    qCWarning(logsshtunneldynamicconnection) << "Failed to free channel: " << sshErrorToString(ret);
+                }
+            }
+            m_sshChannel = nullptr;
+            setChannelState(ChannelState::Free);
+            return;
+        }
+
+        case Free:
+        {
+            qCDebug(logsshtunneldynamicconnection) << "Channel" << m_name << "is free";
+            return;
+        }
+
+        case Error:
+        {
+            qCDebug(logsshtunneldynamicconnection) << "Channel" << m_name << "is in error state";
+            setChannelState(Free);
+            return;
+        }
+    }
+}
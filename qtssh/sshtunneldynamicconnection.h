@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QLoggingCategory>
+#include "sshchannel.h"
+#include "sshtunneldataconnector.h"
+
+Q_DECLARE_LOGGING_CATEGORY(logsshtunneldynamicconnection)
+
+class SshTunnelDynamicConnection : public SshChannel
+{
+    Q_OBJECT
+protected:
+    explicit SshTunnelDynamicConnection(const QString &name, SshClient *client);
+    friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+    void transferStats(Stats &stats) const override;
+
+public:
+    virtual ~SshTunnelDynamicConnection() override;
+    void configure(QTcpSocket *sock);
+    void setBufferWatermarks(size_t high, size_t low);
+    void close() override;
+
+    /* Destination asked by the SOCKS client */
+    QString targetHost() const;
+    quint16 targetPort() const;
+
+private:
+    enum SocksStep {
+        Greeting,
+        Request,
+        Connect
+    };
+
+    SshTunnelDataConnector m_connector;
+    LIBSSH2_CHANNEL *m_sshChannel {nullptr};
+    QTcpSocket *m_sock {nullptr};
+    SocksStep m_step {Greeting};
+    QString m_target;
+    quint16 m_port {0};
+    bool m_error {false};
+
+    bool _readGreeting();
+    bool _readRequest();
+    void _reply(char status);
+    void _refuse(char status);
+
+private slots:
+    void _eventLoop();
+
+public slots:
+    void sshDataReceived() override;
+    void flushTx();
+
+signals:
+    void sendEvent();
+};
@@ -26,25 +26,163 @@ SshTunnelIn::~SshTunnelIn()
 void SshTunnelIn::listen(QString host, quint16 localPort, quint16 remotePort, QString listenHost, int queueSize)
 {
     qCDebug(logsshtunnelin) << m_name << "listen(" << remotePort << " -> " << host << ":" << localPort << ")";
-    m_localTcpPort = localPort;
-    m_remoteTcpPort = remotePort;
+    int existing = -1;
+    for(int i = 0; i < m_forwards.count() && existing < 0; ++i)
+    {
+        if(m_forwards[i].remotePort == remotePort)
+            existing = i;
+    }
+    if(existing >= 0)
+    {
+        /* Called again: the forward of this remote port is updated, not doubled */
+        m_forwards[existing].targetHost = host;
+        m_forwards[existing].localPort = localPort;
+        m_forwards.move(existing, 0);
+    }
+    else
+    {
+        m_forwards.prepend(Forward {host, localPort, remotePort, listenHost, 0, 10, nullptr});
+    }
     m_queueSize = queueSize;
-    m_targethost = host;
-    m_listenhost = listenHost;
-    m_retryListen = 10;
     setChannelState(ChannelState::Exec);
     sshDataReceived();
 }
 
+void SshTunnelIn::addForward(QString host, quint16 localPort, quint16 remotePort, QString listenHost)
+{
+    qCDebug(logsshtunnelin) << m_name << "addForward(" << remotePort << " -> " << host << ":" << localPort << ")";
+    m_forwards.append(Forward {host, localPort, remotePort, listenHost, 0, 10, nullptr});
+    if(channelState() == ChannelState::Ready)
+    {
+        sshDataReceived();
+    }
+}
+
+void SshTunnelIn::listenRange(QString host, quint16 localPort, quint16 remotePort, int count, QString listenHost, int queueSize)
+{
+    for(int i = 1; i < count; ++i)
+    {
+        addForward(host, static_cast<quint16>(localPort + i), static_cast<quint16>(remotePort + i), listenHost);
+    }
+    listen(host, localPort, remotePort, listenHost, queueSize);
+}
+
 quint16 SshTunnelIn::localPort()
 {
-    return static_cast<unsigned short>(m_localTcpPort);
+    if(m_forwards.isEmpty()) return 0;
+    return m_forwards.first().localPort;
 }
 
 quint16 SshTunnelIn::remotePort()
 {
-    if(m_remoteTcpPort == 0) return static_cast<unsigned short>(m_boundPort);
-    return static_cast<unsigned short>(m_remoteTcpPort);
+    return remotePort(0);
+}
+
+int SshTunnelIn::forwardCount() const
+{
+    return m_forwards.count();
+}
+
+quint16 SshTunnelIn::remotePort(int index) const
+{
+    if(index < 0 || index >= m_forwards.count()) return 0;
+    const Forward &forward = m_forwards.at(index);
+    if(forward.remotePort == 0) return static_cast<unsigned short>(forward.boundPort);
+    return forward.remotePort;
+}
+
+void SshTunnelIn::setBufferWatermarks(size_t high, size_t low)
+{
+    m_highWatermark = high;
+    m_lowWatermark = low;
+}
+
+void SshTunnelIn::setSocketOptions(const SshSocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
+SshSocketOptions SshTunnelIn::socketOptions() const
+{
+    return m_socketOptions;
+}
+
+void SshTunnelIn::setCoalescing(size_t size, int delayUsec)
+{
+    m_coalesceSize = size;
+    m_coalesceDelay = delayUsec;
+}
+
+QVector<quint64> SshTunnelIn::writeHistogram() const
+{
+    QVector<quint64> histogram(SSH_WRITE_HISTOGRAM_BUCKETS);
+    SshChannel::Stats stats;
+    for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+    {
+        histogram[i] = m_writeSizes[i];
+    }
+    for(auto *connection: m_connection)
+    {
+        stats = connection->stats();
+        for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+        {
+            histogram[i] += stats.writeSizes[i];
+        }
+    }
+    return histogram;
+}
+
+bool SshTunnelIn::sessionLost()
+{
+    if(channelState() != ChannelState::Exec && channelState() != ChannelState::Ready)
+    {
+        return false;
+    }
+    /* The listeners are freed with the session, ask the same ports again */
+    for(Forward &forward: m_forwards)
+    {
+        if(forward.remotePort == 0)
+            forward.remotePort = static_cast<quint16>(forward.boundPort);
+        forward.listener = nullptr;
+        forward.retryListen = 10;
+    }
+    qCDebug(logsshtunnelin) << m_name << "Wait for the session to listen again on" << remotePort();
+    setChannelState(ChannelState::Openning);
+    return true;
+}
+
+void SshTunnelIn::sessionRestored()
+{
+    if(channelState() == ChannelState::Openning && !m_forwards.isEmpty())
+    {
+        setChannelState(ChannelState::Exec);
+        sshDataReceived();
+    }
+}
+
+void SshTunnelIn::setLocalSocketTarget(const QString &socketPath)
+{
+    m_localSocket = socketPath;
+}
+
+void SshTunnelIn::setQueueSize(int queueSize)
+{
+    m_queueSize = qMax(1, queueSize);
+}
+
+int SshTunnelIn::queueSize() const
+{
+    return m_queueSize;
+}
+
+quint64 SshTunnelIn::acceptedCount() const
+{
+    return m_accepted;
+}
+
+quint64 SshTunnelIn::refusedCount() const
+{
+    return m_refused;
 }
 
 void SshTunnelIn::sshDataReceived()
@@ -59,95 +197,37 @@ void SshTunnelIn::sshDataReceived()
 
         case Exec:
         {
-            do
+            if(!_openListeners(true))
             {
-                if ( ! m_sshClient->takeChannelCreationMutex(this) )
-                {
-                    qCWarning(logsshtunnelin) << m_name << "mutex busy";
-                    return;
-                }
-
-                m_sshListener = libssh2_channel_forward_listen_ex(m_sshClient->session(), qPrintable(m_listenhost), m_remoteTcpPort, &m_boundPort, m_queueSize);
-                m_sshClient->releaseChannelCreationMutex(this);
-
-                if(m_sshListener == nullptr)
-                {
-                    char *emsg;
-                    int size;
-                    int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
-                    if(ret == LIBSSH2_ERROR_EAGAIN)
-                    {
-                        return;
-                    }
-                    if ( ret==LIBSSH2_ERROR_REQUEST_DENIED && m_retryListen > 0 )
-                    {
-                        m_retryListen--;
-                        return;
-                    }
-                    else
-                    {
-                        if(m_remoteTcpPort == 0)
-                        {
-                            m_remoteTcpPort = m_localTcpPort;
-                            m_retryListen = 5;
-                            qCWarning(logsshtunnelin) << "The server refuse dynamic port, try with the same port as local";
-                            return;
-                        }
-                    }
-
-                    setChannelState(ChannelState::Error);
-                    qCWarning(logsshtunnelin) << "Channel session open failed: " << emsg;
-                    return;
-                }
-                qCDebug(logsshtunnelin) << m_name << "Create Reverse tunnel for " << m_listenhost << m_remoteTcpPort << m_boundPort << m_queueSize;
-            } while (m_sshListener == nullptr);
+                return;
+            }
             /* OK, next step */
             setChannelState(ChannelState::Ready);
         }
 
         FALLTHROUGH; case Ready:
         {
-            LIBSSH2_CHANNEL *newChannel;
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            /* Forwards added since listen(), the others are served meanwhile */
+            _openListeners(false);
+            for(int i = 0; i < m_forwards.count(); ++i)
             {
-                return;
+                _accept(m_forwards[i]);
             }
-            newChannel = libssh2_channel_forward_accept(m_sshListener);
-            m_sshClient->releaseChannelCreationMutex(this);
-
-            if(newChannel == nullptr)
-            {
-                char *emsg;
-                int size;
-                int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
-                if(ret == LIBSSH2_ERROR_EAGAIN)
-                {
-                    return;
-                }
-
-                qCWarning(logsshtunnelin) << "Channel session open failed: " << emsg;
-                return;
-            }
-
-            /* We have a new connection on the remote port, need to create a connection tunnel */
-            qCDebug(logsshtunnelin) << "SshTunnelIn new connection";
-            SshTunnelInConnection *connection = m_sshClient->getChannel<SshTunnelInConnection>(m_name + QString("_%1").arg(m_connectionCounter++));
-            connection->configure(newChannel, m_localTcpPort, m_targethost);
-            m_connection.append(connection);
-            QObject::connect(connection, &SshTunnelInConnection::stateChanged, this, &SshTunnelIn::connectionStateChanged);
-            emit connectionChanged(m_connection.size());
-            break;
+            return;
         }
 
         case Close:
         {
-            if(m_sshListener)
+            for(Forward &forward: m_forwards)
             {
-                if(libssh2_channel_forward_cancel(m_sshListener) == LIBSSH2_ERROR_EAGAIN)
+                if(forward.listener)
                 {
-                    return;
+                    if(libssh2_channel_forward_cancel(forward.listener) == LIBSSH2_ERROR_EAGAIN)
+                    {
+                        return;
+                    }
+                    forward.listener = nullptr;
                 }
-                m_sshListener = nullptr;
             }
             setChannelState(ChannelState::WaitClose);
             FALLTHROUGH;
@@ -184,6 +264,109 @@ void SshTunnelIn::sshDataReceived()
     }
 }
 
+bool SshTunnelIn::_openListeners(bool failOnError)
+{
+    for(int i = 0; i < m_forwards.count(); ++i)
+    {
+        Forward &forward = m_forwards[i];
+        if(forward.listener)
+        {
+            continue;
+        }
+        if ( ! m_sshClient->acquireChannelOpen(this) )
+        {
+            return false;
+        }
+
+        forward.listener = libssh2_channel_forward_listen_ex(m_sshClient->session(), qPrintable(forward.listenHost), forward.remotePort, &forward.boundPort, m_queueSize);
+        m_sshClient->releaseChannelOpen(this, forward.listener);
+
+        if(forward.listener == nullptr)
+        {
+            char *emsg;
+            int size;
+            int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return false;
+            }
+            if ( ret==LIBSSH2_ERROR_REQUEST_DENIED && forward.retryListen > 0 )
+            {
+                forward.retryListen--;
+                return false;
+            }
+            else
+            {
+                if(forward.remotePort == 0)
+                {
+                    forward.remotePort = forward.localPort;
+                    forward.retryListen = 5;
+                    qCWarning(logsshtunnelin) << "The server refuse dynamic port, try with the same port as local";
+                    return false;
+                }
+            }
+
+            qCWarning(logsshtunnelin) << "Channel session open failed on" << forward.remotePort << ": " << emsg;
+            if(failOnError)
+            {
+                setChannelState(ChannelState::Error);
+                return false;
+            }
+            m_forwards.removeAt(i);
+            --i;
+            continue;
+        }
+        qCDebug(logsshtunnelin) << m_name << "Create Reverse tunnel for " << forward.listenHost << forward.remotePort << forward.boundPort << m_queueSize;
+    }
+    return true;
+}
+
+void SshTunnelIn::_accept(Forward &forward)
+{
+    if(!forward.listener)
+    {
+        return;
+    }
+    /* Accept only takes a queued incoming channel, no open state involved: empty the backlog */
+    forever
+    {
+        LIBSSH2_CHANNEL *newChannel = libssh2_channel_forward_accept(forward.listener);
+        if(newChannel == nullptr)
+        {
+            char *emsg;
+            int size;
+            int ret = libssh2_session_last_error(m_sshClient->session(), &emsg, &size, 0);
+            if(ret == LIBSSH2_ERROR_EAGAIN)
+            {
+                return;
+            }
+
+            m_refused++;
+            qCWarning(logsshtunnelin) << "Channel session open failed: " << emsg;
+            return;
+        }
+
+        /* We have a new connection on the remote port, need to create a connection tunnel */
+        qCDebug(logsshtunnelin) << "SshTunnelIn new connection on" << forward.remotePort;
+        m_accepted++;
+        SshTunnelInConnection *connection = m_sshClient->getChannel<SshTunnelInConnection>(m_name + QString("_%1").arg(m_connectionCounter++));
+        connection->setBufferWatermarks(m_highWatermark, m_lowWatermark);
+        connection->setSocketOptions(m_socketOptions);
+        connection->setCoalescing(m_coalesceSize, m_coalesceDelay);
+        if(m_localSocket.isEmpty())
+        {
+            connection->configure(newChannel, forward.localPort, forward.targetHost);
+        }
+        else
+        {
+            connection->configureLocal(newChannel, m_localSocket);
+        }
+        m_connection.append(connection);
+        QObject::connect(connection, &SshTunnelInConnection::stateChanged, this, &SshTunnelIn::connectionStateChanged);
+        emit connectionChanged(m_connection.size());
+    }
+}
+
 void SshTunnelIn::connectionStateChanged()
 {
     QObject *obj = QObject::sender();
@@ -192,6 +375,14 @@ void SshTunnelIn::connectionStateChanged()
     {
         if(connection->channelState() == SshChannel::ChannelState::Free)
         {
+            if(m_connection.contains(connection))
+            {
+                SshChannel::Stats stats = connection->stats();
+                for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+                {
+                    m_writeSizes[i] += stats.writeSizes[i];
+                }
+            }
             m_connection.removeAll(connection);
             emit connectionChanged(m_connection.count());
 
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "sshchannel.h"
+#include "sshtunneldataconnector.h"
+#include "sshsocketoptions.h"
 #include <QAbstractSocket>
 #include <QLoggingCategory>
+#include <QVector>
 
 class SshTunnelInConnection;
 
@@ -13,27 +16,82 @@ class SshTunnelIn : public SshChannel
     Q_OBJECT
 
 private:
-    quint16 m_localTcpPort {0};
-    quint16 m_remoteTcpPort {0};
-    int m_boundPort {0};
+    /* One remote listener and its local target */
+    struct Forward {
+        QString targetHost;
+        quint16 localPort;
+        quint16 remotePort;
+        QString listenHost;
+        int boundPort;
+        int retryListen;
+        LIBSSH2_LISTENER *listener;
+    };
+    QList<Forward> m_forwards;
     int m_queueSize {16};
-    int m_retryListen {10};
-    QString m_targethost;
-    QString m_listenhost;
-    LIBSSH2_LISTENER *m_sshListener {nullptr};
+    QString m_localSocket;
     int  m_connectionCounter {0};
+    quint64 m_accepted {0};
+    quint64 m_refused {0};
+    size_t m_highWatermark {BUFFER_SIZE};
+    size_t m_lowWatermark {BUFFER_SIZE / 2};
+    SshSocketOptions m_socketOptions;
+    size_t m_coalesceSize {0};
+    int m_coalesceDelay {200};
+    quint64 m_writeSizes[SSH_WRITE_HISTOGRAM_BUCKETS] {};
     QList<SshTunnelInConnection*> m_connection;
 
+    /* false while a listener opening waits, or on failure with failOnError */
+    bool _openListeners(bool failOnError);
+    void _accept(Forward &forward);
+
 protected:
     explicit SshTunnelIn(const QString &name, SshClient *client);
     friend class SshClient;
+    bool sessionLost() override;
+    void sessionRestored() override;
 
 public:
     virtual ~SshTunnelIn() override;
     void listen(QString host, quint16 localPort, quint16 remotePort, QString listenHost = "127.0.0.1", int queueSize = 16);
+    /*
+     * More listeners on the same channel: remote connections on remotePort
+     * go to host:localPort. Before listen() they are opened with it and a
+     * failure puts the tunnel in error, afterwards they are opened at once
+     * and a refused one is only dropped.
+     */
+    void addForward(QString host, quint16 localPort, quint16 remotePort, QString listenHost = "127.0.0.1");
+    /* remotePort + i forwarded to host:localPort + i, for i < count */
+    void listenRange(QString host, quint16 localPort, quint16 remotePort, int count, QString listenHost = "127.0.0.1", int queueSize = 16);
     void close() override;
+    /* Ports of the first forward */
     quint16 localPort();
     quint16 remotePort();
+    int forwardCount() const;
+    /* Port bound by the server for forward index, 0 until listening */
+    quint16 remotePort(int index) const;
+    void setBufferWatermarks(size_t high, size_t low);
+    /* Options of the local sockets of the tunnel connections */
+    void setSocketOptions(const SshSocketOptions &options);
+    SshSocketOptions socketOptions() const;
+
+    /*
+     * Write coalescing of the connections (see SshTunnelDataConnector),
+     * for chatty protocols. writeHistogram() gives the channel writes by
+     * size (SSH_WRITE_HISTOGRAM_BUCKETS) of all the connections so far.
+     */
+    void setCoalescing(size_t size, int delayUsec = 200);
+    QVector<quint64> writeHistogram() const;
+
+    /* Deliver remote connections to a local Unix socket instead of host:localPort */
+    void setLocalSocketTarget(const QString &socketPath);
+
+    /* Server side backlog of the listener, used by the next listen */
+    void setQueueSize(int queueSize);
+    int queueSize() const;
+
+    /* Remote connections accepted, and accepts which failed */
+    quint64 acceptedCount() const;
+    quint64 refusedCount() const;
 
 public slots:
     void sshDataReceived() override;
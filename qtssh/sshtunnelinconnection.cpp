@@ -5,6 +5,8 @@
 #include <QEventLoop>
 #include <cerrno>
 #include <QTime>
+#include <algorithm>
+#include <iterator>
 
 Q_LOGGING_CATEGORY(logsshtunnelinconnection, "ssh.tunnelin.connection", QtWarningMsg)
 
@@ -18,7 +20,9 @@ SshTunnelInConnection::SshTunnelInConnection(const QString &name, SshClient *cli
     : SshChannel(name, client)
     , m_connector(client, name)
 {
+    m_connector.setOwner(this);
     QObject::connect(&m_sock, &QTcpSocket::connected, this, &SshTunnelInConnection::_socketConnected);
+    QObject::connect(&m_localSock, &QLocalSocket::connected, this, &SshTunnelInConnection::_socketConnected);
     QObject::connect(this, &SshTunnelInConnection::sendEvent, this, &SshTunnelInConnection::_eventLoop, Qt::QueuedConnection);
     QObject::connect(&m_connector, &SshTunnelDataConnector::sendEvent, this, &SshTunnelInConnection::sendEvent);
 }
@@ -32,11 +36,70 @@ void SshTunnelInConnection::configure(LIBSSH2_CHANNEL *channel, quint16 port, QS
     _eventLoop();
 }
 
+void SshTunnelInConnection::configureLocal(LIBSSH2_CHANNEL *channel, const QString &socketPath)
+{
+    DEBUGCH << "configure: " << socketPath;
+    m_sshChannel = channel;
+    m_socketPath = socketPath;
+    _eventLoop();
+}
+
+void SshTunnelInConnection::setBufferWatermarks(size_t high, size_t low)
+{
+    m_connector.setWatermarks(high, low);
+}
+
+void SshTunnelInConnection::setCoalescing(size_t size, int delayUsec)
+{
+    m_connector.setCoalescing(size, delayUsec);
+}
+
+void SshTunnelInConnection::setSocketOptions(const SshSocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
 SshTunnelInConnection::~SshTunnelInConnection()
 {
     DEBUGCH << "SshTunnelInConnection Destroyed";
 }
 
+bool SshTunnelInConnection::recycle()
+{
+    /* Detached first, the sockets aborted below are not its business */
+    m_connector.reset(m_name);
+    m_sock.abort();
+    m_localSock.abort();
+    m_sshChannel = nullptr;
+    m_socketPath.clear();
+    m_socketOptions = SshSocketOptions();
+    m_port = 0;
+    m_hostname.clear();
+    m_error = false;
+    return true;
+}
+
+void SshTunnelInConnection::reuse()
+{
+    /* New name in the transfer logs */
+    m_connector.reset(m_name);
+}
+
+LIBSSH2_CHANNEL *SshTunnelInConnection::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
+void SshTunnelInConnection::transferStats(Stats &stats) const
+{
+    SshTunnelDataConnector::Stats xfer = m_connector.stats();
+    stats.bytesIn = xfer.sshToRx;
+    stats.bytesOut = xfer.txToSsh;
+    stats.stalls = xfer.txStalls + xfer.rxStalls;
+    stats.buffered = xfer.txBuffered + xfer.rxBuffered;
+    std::copy(std::begin(xfer.writeSizes), std::end(xfer.writeSizes), std::begin(stats.writeSizes));
+}
+
 void SshTunnelInConnection::close()
 {
 }
@@ -47,6 +110,13 @@ void SshTunnelInConnection::_eventLoop()
     {
         case Openning:
         {
+            if(!m_socketPath.isEmpty())
+            {
+                DEBUGCH << "Channel session opened:" << m_socketPath;
+                m_localSock.connectToServer(m_socketPath);
+                setChannelState(SshChannel::Exec);
+                return;
+            }
             DEBUGCH << "Channel session opened:" << m_hostname << ":" << m_port;
             m_sock.connectToHost(m_hostname, m_port);
             setChannelState(SshChannel::Exec);
@@ -63,7 +133,9 @@ void SshTunnelInConnection::_eventLoop()
             if(!m_connector.process())
             {
                 setChannelState(ChannelState::Close);
+                return;
             }
+            tuneWindow(m_sshChannel);
             return;
         }
 
@@ -76,7 +148,8 @@ void SshTunnelInConnection::_eventLoop()
         FALLTHROUGH; case WaitClose:
         {
             DEBUGCH << "Wait close channel";
-            if(m_connector.isClosed())
+            /* Fast close: the connector was told to close, don't wait for it */
+            if(skipWaitClosed() || m_connector.isClosed())
             {
                 setChannelState(ChannelState::Freeing);
             }
@@ -108,7 +181,6 @@ void SshTunnelInConnection::_eventLoop()
                 setChannelState(ChannelState::Free);
             }
             m_sshChannel = nullptr;
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshTunnelInConnection::sshDataReceived);
             return;
         }
 
@@ -142,7 +214,15 @@ void SshTunnelInConnection::_socketConnected()
 {
     DEBUGCH << "Socket connection established";
     m_connector.setChannel(m_sshChannel);
-    m_connector.setSock(&m_sock);
+    if(m_socketPath.isEmpty())
+    {
+        m_socketOptions.apply(&m_sock);
+        m_connector.setSock(&m_sock);
+    }
+    else
+    {
+        m_connector.setSock(&m_localSock);
+    }
     setChannelState(ChannelState::Ready);
     emit sendEvent();
 }
@@ -2,8 +2,10 @@
 
 #include "sshchannel.h"
 #include <QTcpSocket>
+#include <QLocalSocket>
 #include <QLoggingCategory>
 #include "sshtunneldataconnector.h"
+#include "sshsocketoptions.h"
 
 class QTcpSocket;
 
@@ -16,9 +18,19 @@ class SshTunnelInConnection : public SshChannel
 protected:
     explicit SshTunnelInConnection(const QString &name, SshClient *client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+    void transferStats(Stats &stats) const override;
+    bool recycle() override;
+    void reuse() override;
 
 public:
     void configure(LIBSSH2_CHANNEL* channel, quint16 port, QString hostname);
+    /* Deliver the connection to a local Unix socket instead of hostname:port */
+    void configureLocal(LIBSSH2_CHANNEL* channel, const QString &socketPath);
+    void setBufferWatermarks(size_t high, size_t low);
+    void setCoalescing(size_t size, int delayUsec);
+    /* Applied to the local TCP socket once connected */
+    void setSocketOptions(const SshSocketOptions &options);
     virtual ~SshTunnelInConnection() override;
     void close() override;
 
@@ -26,6 +38,9 @@ private:
     SshTunnelDataConnector m_connector;
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
     QTcpSocket m_sock;
+    QLocalSocket m_localSock;
+    QString m_socketPath;
+    SshSocketOptions m_socketOptions;
     quint16 m_port;
     QString m_hostname;
     bool m_error {false};
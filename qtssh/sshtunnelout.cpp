@@ -1,6 +1,7 @@
 #include "sshtunnelout.h"
 #include "sshclient.h"
 #include <QDateTime>
+#include <QLocalSocket>
 
 Q_LOGGING_CATEGORY(logsshtunnelout, "ssh.tunnelout", QtWarningMsg)
 
@@ -9,6 +10,9 @@ SshTunnelOut::SshTunnelOut(const QString &name, SshClient *client)
     : SshChannel(name, client)
 {
     QObject::connect(&m_tcpserver, &QTcpServer::newConnection, this, &SshTunnelOut::_createConnection);
+    QObject::connect(&m_localserver, &QLocalServer::newConnection, this, &SshTunnelOut::_createConnection);
+    m_holdTimer.setSingleShot(true);
+    QObject::connect(&m_holdTimer, &QTimer::timeout, this, &SshTunnelOut::_dropHeldAccepts);
     sshDataReceived();
 }
 
@@ -17,19 +21,193 @@ SshTunnelOut::~SshTunnelOut()
     qCDebug(logsshtunnelout) << "delete SshTunnelOut:" << m_name;
 }
 
+bool SshTunnelOut::sshEventPending()
+{
+    /* Connections are dispatched by themselves, the server only care about closing */
+    return channelState() != ChannelState::Ready;
+}
+
+bool SshTunnelOut::sessionLost()
+{
+    if(channelState() != ChannelState::Ready)
+    {
+        return false;
+    }
+    /* Connections die with the session, the server keeps listening */
+    qCDebug(logsshtunnelout) << m_name << "Suspended until the session is back";
+    m_suspended = true;
+    return true;
+}
+
+void SshTunnelOut::sessionRestored()
+{
+    if(!m_suspended)
+    {
+        return;
+    }
+    qCDebug(logsshtunnelout) << m_name << "Resumed," << m_heldAccepts << "held connections";
+    m_suspended = false;
+    m_holdTimer.stop();
+    _fillPool();
+    int held = m_heldAccepts;
+    m_heldAccepts = 0;
+    for(int i = 0; i < held; ++i)
+    {
+        _createConnection();
+    }
+    for(int r = 0; r < m_rules.count(); ++r)
+    {
+        QTcpServer *server = m_rules[r].server;
+        held = m_rules[r].heldAccepts;
+        m_rules[r].heldAccepts = 0;
+        for(int i = 0; i < held; ++i)
+        {
+            _createRuleConnection(server);
+        }
+    }
+}
+
+void SshTunnelOut::setHoldTimeout(int msec)
+{
+    m_holdTimeout = msec;
+}
+
+void SshTunnelOut::_dropHeldAccepts()
+{
+    qCWarning(logsshtunnelout) << m_name << "Session not back, refuse" << m_heldAccepts << "held connections";
+    while(m_tcpserver.hasPendingConnections())
+    {
+        QTcpSocket *sock = m_tcpserver.nextPendingConnection();
+        sock->close();
+        sock->deleteLater();
+    }
+    while(m_localserver.hasPendingConnections())
+    {
+        QLocalSocket *sock = m_localserver.nextPendingConnection();
+        sock->close();
+        sock->deleteLater();
+    }
+    for(Rule &rule: m_rules)
+    {
+        while(rule.server->hasPendingConnections())
+        {
+            QTcpSocket *sock = rule.server->nextPendingConnection();
+            sock->close();
+            sock->deleteLater();
+        }
+        rule.heldAccepts = 0;
+    }
+    m_heldAccepts = 0;
+}
+
 void SshTunnelOut::close()
 {
     qCDebug(logsshtunnelout) << m_name << "Ask to close";
+    m_suspended = false;
+    m_holdTimer.stop();
     setChannelState(ChannelState::Close);
     sshDataReceived();
 }
 
 void SshTunnelOut::listen(quint16 port, QString hostTarget, QString hostListen)
 {
+    if(channelState() > ChannelState::Ready)
+    {
+        qCWarning(logsshtunnelout) << m_name << "Can't listen, tunnel closed";
+        return;
+    }
     m_port = port;
     m_hostTarget = hostTarget;
     m_tcpserver.listen(QHostAddress(hostListen), 0);
-    setChannelState(ChannelState::Ready);
+    _fillPool();
+}
+
+bool SshTunnelOut::listenLocal(const QString &socketPath, quint16 port, QString hostTarget)
+{
+    if(channelState() > ChannelState::Ready)
+    {
+        return false;
+    }
+    m_port = port;
+    m_hostTarget = hostTarget;
+    /* A socket file left by a previous process would make listen fail */
+    QLocalServer::removeServer(socketPath);
+    if(!m_localserver.listen(socketPath))
+    {
+        qCWarning(logsshtunnelout) << m_name << "Can't listen on" << socketPath << m_localserver.errorString();
+        return false;
+    }
+    _fillPool();
+    return true;
+}
+
+bool SshTunnelOut::addRule(quint16 localPort, quint16 port, QString hostTarget, QString hostListen)
+{
+    if(channelState() > ChannelState::Ready)
+    {
+        return false;
+    }
+    QTcpServer *server = new QTcpServer(this);
+    if(!server->listen(QHostAddress(hostListen), localPort))
+    {
+        qCWarning(logsshtunnelout) << m_name << "Can't listen on" << hostListen << localPort << server->errorString();
+        delete server;
+        return false;
+    }
+    QObject::connect(server, &QTcpServer::newConnection, this, [this, server](){ _createRuleConnection(server); });
+    m_rules.append(Rule {server, port, hostTarget, 0});
+    return true;
+}
+
+int SshTunnelOut::listenRange(quint16 localPort, quint16 port, int count, QString hostTarget, QString hostListen)
+{
+    int added = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        quint16 local = (localPort == 0) ? 0 : static_cast<quint16>(localPort + i);
+        if(addRule(local, static_cast<quint16>(port + i), hostTarget, hostListen))
+        {
+            ++added;
+        }
+    }
+    return added;
+}
+
+int SshTunnelOut::ruleCount() const
+{
+    return m_rules.count();
+}
+
+quint16 SshTunnelOut::ruleLocalPort(int index) const
+{
+    if(index < 0 || index >= m_rules.count())
+    {
+        return 0;
+    }
+    return m_rules.at(index).server->serverPort();
+}
+
+void SshTunnelOut::setRemoteSocket(const QString &path)
+{
+    m_remoteSocket = path;
+}
+
+QString SshTunnelOut::localSocket() const
+{
+    return m_localserver.fullServerName();
+}
+
+SshTunnelOutConnection *SshTunnelOut::connectDevice(QIODevice *device)
+{
+    if(channelState() != ChannelState::Ready)
+    {
+        return nullptr;
+    }
+    SshTunnelOutConnection *connection = _newConnection();
+    connection->configure(device, m_port, m_hostTarget);
+    m_connection.append(connection);
+    emit connectionChanged(m_connection.count());
+    return connection;
 }
 
 void SshTunnelOut::sshDataReceived()
@@ -59,13 +237,22 @@ void SshTunnelOut::sshDataReceived()
         {
             qCDebug(logsshtunnelout) << m_name << "Close server";
             m_tcpserver.close();
+            m_localserver.close();
+            for(const Rule &rule : m_rules)
+            {
+                rule.server->close();
+            }
+            for(SshTunnelOutConnection *connection : m_pool)
+            {
+                connection->close();
+            }
             setChannelState(ChannelState::WaitClose);
         }
 
         FALLTHROUGH; case WaitClose:
         {
-            qCDebug(logsshtunnelout) << "Wait close channel:" << m_name << " (connections:"<< m_connection.count() << ")";
-            if(m_connection.count() == 0)
+            qCDebug(logsshtunnelout) << "Wait close channel:" << m_name << " (connections:"<< m_connection.count() << ", pool:" << m_pool.count() << ")";
+            if(m_connection.count() == 0 && m_pool.count() == 0)
             {
                 setChannelState(ChannelState::Freeing);
             }
@@ -79,8 +266,6 @@ void SshTunnelOut::sshDataReceived()
         {
             qCDebug(logsshtunnelout) << "free Channel:" << m_name;
             setChannelState(ChannelState::Free);
-
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshTunnelOut::sshDataReceived);
             return;
         }
 
@@ -117,12 +302,31 @@ void SshTunnelOut::connectionStateChanged()
     SshTunnelOutConnection *connection = qobject_cast<SshTunnelOutConnection*>(obj);
     if(connection)
     {
+        if(m_pool.contains(connection) && connection->channelState() >= SshChannel::ChannelState::Close)
+        {
+            /* Dead before use, it is replaced on the next attach, not now */
+            qCDebug(logsshtunnelout) << m_name << "Pooled connection lost:" << connection->name();
+            m_pool.removeAll(connection);
+            if(m_connection.count() == 0 && m_pool.count() == 0 && channelState() == SshChannel::ChannelState::WaitClose)
+            {
+                setChannelState(SshChannel::ChannelState::Freeing);
+            }
+            return;
+        }
         if(connection->channelState() == SshChannel::ChannelState::Free)
         {
+            if(m_connection.contains(connection))
+            {
+                SshChannel::Stats stats = connection->stats();
+                for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+                {
+                    m_writeSizes[i] += stats.writeSizes[i];
+                }
+            }
             m_connection.removeAll(connection);
             emit connectionChanged(m_connection.count());
 
-            if(m_connection.count() == 0 && channelState() == SshChannel::ChannelState::WaitClose)
+            if(m_connection.count() == 0 && m_pool.count() == 0 && channelState() == SshChannel::ChannelState::WaitClose)
             {
                 setChannelState(SshChannel::ChannelState::Freeing);
             }
@@ -138,19 +342,166 @@ void SshTunnelOut::flushTx() const
     }
 }
 
+void SshTunnelOut::setBufferWatermarks(size_t high, size_t low)
+{
+    m_highWatermark = high;
+    m_lowWatermark = low;
+}
+
+void SshTunnelOut::setSocketOptions(const SshSocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
+SshSocketOptions SshTunnelOut::socketOptions() const
+{
+    return m_socketOptions;
+}
+
+void SshTunnelOut::setCoalescing(size_t size, int delayUsec)
+{
+    m_coalesceSize = size;
+    m_coalesceDelay = delayUsec;
+}
+
+QVector<quint64> SshTunnelOut::writeHistogram() const
+{
+    QVector<quint64> histogram(SSH_WRITE_HISTOGRAM_BUCKETS);
+    SshChannel::Stats stats;
+    for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+    {
+        histogram[i] = m_writeSizes[i];
+    }
+    for(auto *connection: m_connection)
+    {
+        stats = connection->stats();
+        for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; i++)
+        {
+            histogram[i] += stats.writeSizes[i];
+        }
+    }
+    return histogram;
+}
+
 quint16 SshTunnelOut::port() const
 {
     return m_port;
 }
 
+void SshTunnelOut::setChannelPool(int size)
+{
+    m_poolSize = qMax(0, size);
+    _fillPool();
+}
+
+int SshTunnelOut::channelPool() const
+{
+    return m_poolSize;
+}
+
+int SshTunnelOut::pooledConnections() const
+{
+    return m_pool.count();
+}
+
+SshTunnelOutConnection *SshTunnelOut::_newConnection(const Rule *rule)
+{
+    SshTunnelOutConnection *connection = m_sshClient->getChannel<SshTunnelOutConnection>(m_name + QString("_%1").arg(m_connectionCounter++));
+    if(rule)
+    {
+        connection->configure(rule->server, rule->port, rule->hostTarget);
+    }
+    else if(m_localserver.isListening())
+    {
+        connection->configure(&m_localserver, m_port, m_hostTarget);
+    }
+    else
+    {
+        connection->configure(&m_tcpserver, m_port, m_hostTarget);
+    }
+    connection->setRemoteSocket(m_remoteSocket);
+    connection->setBufferWatermarks(m_highWatermark, m_lowWatermark);
+    connection->setSocketOptions(m_socketOptions);
+    connection->setCoalescing(m_coalesceSize, m_coalesceDelay);
+    QObject::connect(connection, &SshTunnelOutConnection::stateChanged, this, &SshTunnelOut::connectionStateChanged);
+    return connection;
+}
+
+void SshTunnelOut::_fillPool()
+{
+    if(channelState() != ChannelState::Ready || m_suspended)
+    {
+        return;
+    }
+    while(m_pool.count() < m_poolSize)
+    {
+        SshTunnelOutConnection *connection = _newConnection();
+        connection->setPooled(true);
+        m_pool.append(connection);
+    }
+}
+
 void SshTunnelOut::_createConnection()
 {
     qCDebug(logsshtunnelout) << "SshTunnelOut new connection";
-    SshTunnelOutConnection *connection = m_sshClient->getChannel<SshTunnelOutConnection>(m_name + QString("_%1").arg(m_connectionCounter++));
-    connection->configure(&m_tcpserver, m_port, m_hostTarget);
+    if(m_suspended)
+    {
+        /* Left in the server queue until the session is back */
+        m_heldAccepts++;
+        if(!m_holdTimer.isActive())
+        {
+            m_holdTimer.start(m_holdTimeout);
+        }
+        return;
+    }
+    SshTunnelOutConnection *connection = nullptr;
+    if(!m_pool.isEmpty())
+    {
+        /* Prefer a channel already opened, else the oldest one of the pool */
+        connection = m_pool.first();
+        for(SshTunnelOutConnection *pooled : m_pool)
+        {
+            if(pooled->isOpened())
+            {
+                connection = pooled;
+                break;
+            }
+        }
+        m_pool.removeAll(connection);
+        connection->attach();
+    }
+    else
+    {
+        connection = _newConnection();
+    }
     m_connection.append(connection);
-    QObject::connect(connection, &SshTunnelOutConnection::stateChanged, this, &SshTunnelOut::connectionStateChanged);
     emit connectionChanged(m_connection.count());
+    _fillPool();
+}
+
+void SshTunnelOut::_createRuleConnection(QTcpServer *server)
+{
+    for(Rule &rule: m_rules)
+    {
+        if(rule.server != server)
+        {
+            continue;
+        }
+        qCDebug(logsshtunnelout) << "SshTunnelOut new connection to" << rule.hostTarget << rule.port;
+        if(m_suspended)
+        {
+            rule.heldAccepts++;
+            if(!m_holdTimer.isActive())
+            {
+                m_holdTimer.start(m_holdTimeout);
+            }
+            return;
+        }
+        SshTunnelOutConnection *connection = _newConnection(&rule);
+        m_connection.append(connection);
+        emit connectionChanged(m_connection.count());
+        return;
+    }
 }
 
 quint16 SshTunnelOut::localPort()
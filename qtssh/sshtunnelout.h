@@ -4,6 +4,10 @@
 #include "sshchannel.h"
 #include "sshtunneloutconnection.h"
 #include <QTcpServer>
+#include <QLocalServer>
+#include "sshsocketoptions.h"
+#include <QTimer>
+#include <QVector>
 
 Q_DECLARE_LOGGING_CATEGORY(logsshtunnelout)
 
@@ -14,15 +18,67 @@ class SshTunnelOut : public SshChannel
 protected:
     explicit SshTunnelOut(const QString &name, SshClient * client);
     friend class SshClient;
+    bool sshEventPending() override;
+    bool sessionLost() override;
+    void sessionRestored() override;
 
 public:
     virtual ~SshTunnelOut() override;
     void close() override;
     quint16 localPort();
     quint16 port() const;
+    void setBufferWatermarks(size_t high, size_t low);
+    /* Options of the local sockets of the tunnel connections */
+    void setSocketOptions(const SshSocketOptions &options);
+    SshSocketOptions socketOptions() const;
+
+    /*
+     * Write coalescing of the connections (see SshTunnelDataConnector),
+     * for chatty protocols. writeHistogram() gives the channel writes by
+     * size (SSH_WRITE_HISTOGRAM_BUCKETS) of all the connections so far.
+     */
+    void setCoalescing(size_t size, int delayUsec = 200);
+    QVector<quint64> writeHistogram() const;
+
+    /*
+     * Keep size direct-tcpip channels opened in advance to the target, new
+     * client sockets are attached to one of them instead of waiting for a
+     * channel open round trip. 0 (default) disables the pool.
+     */
+    void setChannelPool(int size);
+
+    /* Forward to a Unix socket of the server instead of hostTarget:port */
+    void setRemoteSocket(const QString &path);
+
+    /* Full path of the local Unix socket server, see listenLocal() */
+    QString localSocket() const;
+
+    /*
+     * In-process endpoint: the tunnel is read and written through device,
+     * no local socket involved. The device is not owned by the tunnel.
+     */
+    SshTunnelOutConnection *connectDevice(QIODevice *device);
+    int channelPool() const;
+    int pooledConnections() const;
+
+    /* Client sockets accepted while the session reconnects wait so long */
+    void setHoldTimeout(int msec);
+
+    /*
+     * More targets on the same tunnel: connections to hostListen:localPort
+     * (0 for any free port) go to hostTarget:port. A rule costs a listening
+     * socket and a table entry, its connections share the accept path and
+     * the settings of the tunnel but not the channel pool.
+     */
+    bool addRule(quint16 localPort, quint16 port, QString hostTarget = "127.0.0.1", QString hostListen = "127.0.0.1");
+    /* localPort + i forwarded to hostTarget:port + i, for i < count: rules added */
+    int listenRange(quint16 localPort, quint16 port, int count, QString hostTarget = "127.0.0.1", QString hostListen = "127.0.0.1");
+    int ruleCount() const;
+    quint16 ruleLocalPort(int index) const;
 
 public slots:
     void listen(quint16 port, QString hostTarget = "127.0.0.1", QString hostListen = "127.0.0.1");
+    bool listenLocal(const QString &socketPath, quint16 port, QString hostTarget = "127.0.0.1");
     void sshDataReceived() override;
     int connections();
     void closeAllConnections();
@@ -31,14 +87,40 @@ public slots:
 
 private:
     QTcpServer              m_tcpserver;
+    QLocalServer            m_localserver;
+    QString                 m_remoteSocket;
     quint16                 m_port {0};
     int                     m_connectionCounter {0};
     QString                 m_hostTarget;
+    size_t                  m_highWatermark {BUFFER_SIZE};
+    size_t                  m_lowWatermark {BUFFER_SIZE / 2};
+    SshSocketOptions        m_socketOptions;
+    size_t                  m_coalesceSize {0};
+    int                     m_coalesceDelay {200};
+    quint64                 m_writeSizes[SSH_WRITE_HISTOGRAM_BUCKETS] {};
     QList<SshTunnelOutConnection*> m_connection;
+    int                     m_poolSize {0};
+    QList<SshTunnelOutConnection*> m_pool;
+    bool                    m_suspended {false};
+    int                     m_heldAccepts {0};
+    int                     m_holdTimeout {10000};
+    QTimer                  m_holdTimer;
+
+    struct Rule {
+        QTcpServer *server;
+        quint16 port;
+        QString hostTarget;
+        int heldAccepts;
+    };
+    QList<Rule>             m_rules;
 
+    SshTunnelOutConnection *_newConnection(const Rule *rule = nullptr);
+    void _fillPool();
+    void _createRuleConnection(QTcpServer *server);
 
 private slots:
     void _createConnection();
+    void _dropHeldAccepts();
 
 signals:
     void connectionChanged(int);
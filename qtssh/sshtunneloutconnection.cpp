@@ -1,6 +1,9 @@
 #include "sshtunneloutconnection.h"
 #include "sshtunnelout.h"
 #include "sshclient.h"
+#include <QLocalSocket>
+#include <algorithm>
+#include <iterator>
 
 Q_LOGGING_CATEGORY(logsshtunneloutconnection, "ssh.tunnelout.connection")
 Q_LOGGING_CATEGORY(logsshtunneloutconnectiontransfer, "ssh.tunnelout.connection.transfer")
@@ -14,6 +17,7 @@ SshTunnelOutConnection::SshTunnelOutConnection(const QString &name, SshClient *c
     : SshChannel(name, client)
     , m_connector(client, name)
 {
+    m_connector.setOwner(this);
     QObject::connect(this, &SshTunnelOutConnection::sendEvent, this, &SshTunnelOutConnection::_eventLoop, Qt::QueuedConnection);
     QObject::connect(&m_connector, &SshTunnelDataConnector::sendEvent, this, &SshTunnelOutConnection::sendEvent);
     DEBUGCH << "Create SshTunnelOutConnection (constructor)";
@@ -27,10 +31,158 @@ void SshTunnelOutConnection::configure(QTcpServer *server, quint16 remotePort, Q
     m_target = target;
 }
 
+void SshTunnelOutConnection::configure(QLocalServer *server, quint16 remotePort, QString target)
+{
+    m_localServer = server;
+    m_port = remotePort;
+    m_target = target;
+}
+
+void SshTunnelOutConnection::configure(QIODevice *device, quint16 remotePort, QString target)
+{
+    m_device = device;
+    m_port = remotePort;
+    m_target = target;
+}
+
+void SshTunnelOutConnection::setRemoteSocket(const QString &path)
+{
+    m_remoteSocket = path;
+}
+
+LIBSSH2_CHANNEL *SshTunnelOutConnection::_openChannel()
+{
+    if(m_remoteSocket.isEmpty())
+    {
+        return openDirectTcpip(m_target, m_port);
+    }
+#if LIBSSH2_VERSION_NUM >= 0x010a00
+    return libssh2_channel_direct_streamlocal_ex(m_sshClient->session(), qPrintable(m_remoteSocket), "127.0.0.1", 0);
+#else
+    qCWarning(logsshtunneloutconnection) << m_name << "direct-streamlocal needs libssh2 1.10";
+    return nullptr;
+#endif
+}
+
+QIODevice *SshTunnelOutConnection::_nextPendingConnection()
+{
+    if(m_device)
+    {
+        return m_device;
+    }
+    if(m_localServer)
+    {
+        return m_localServer->nextPendingConnection();
+    }
+    return m_server->nextPendingConnection();
+}
+
+void SshTunnelOutConnection::_closeServer()
+{
+    if(m_localServer)
+    {
+        m_localServer->close();
+    }
+    else if(m_server)
+    {
+        m_server->close();
+    }
+}
+
+void SshTunnelOutConnection::setBufferWatermarks(size_t high, size_t low)
+{
+    m_connector.setWatermarks(high, low);
+}
+
+void SshTunnelOutConnection::setCoalescing(size_t size, int delayUsec)
+{
+    m_connector.setCoalescing(size, delayUsec);
+}
+
+void SshTunnelOutConnection::setSocketOptions(const SshSocketOptions &options)
+{
+    m_socketOptions = options;
+}
+
+void SshTunnelOutConnection::setPooled(bool pooled)
+{
+    m_pooled = pooled;
+}
+
+bool SshTunnelOutConnection::isPooled() const
+{
+    return m_pooled;
+}
+
+bool SshTunnelOutConnection::isAttached() const
+{
+    return m_attached;
+}
+
+bool SshTunnelOutConnection::isOpened() const
+{
+    return m_sshChannel != nullptr && channelState() == ChannelState::Exec;
+}
+
+void SshTunnelOutConnection::attach()
+{
+    DEBUGCH << "Attach pooled connection";
+    m_attached = true;
+    emit sendEvent();
+}
+
 SshTunnelOutConnection::~SshTunnelOutConnection()
 {
     DEBUGCH << "Free SshTunnelOutConnection (destructor)";
-    delete m_sock;
+    if(m_sock != m_device)
+    {
+        delete m_sock;
+    }
+}
+
+LIBSSH2_CHANNEL *SshTunnelOutConnection::dispatchChannel() const
+{
+    return m_sshChannel;
+}
+
+void SshTunnelOutConnection::transferStats(Stats &stats) const
+{
+    SshTunnelDataConnector::Stats xfer = m_connector.stats();
+    stats.bytesIn = xfer.sshToRx;
+    stats.bytesOut = xfer.txToSsh;
+    stats.stalls = xfer.txStalls + xfer.rxStalls;
+    stats.buffered = xfer.txBuffered + xfer.rxBuffered;
+    std::copy(std::begin(xfer.writeSizes), std::end(xfer.writeSizes), std::begin(stats.writeSizes));
+}
+
+bool SshTunnelOutConnection::recycle()
+{
+    m_connector.reset(m_name);
+    if(m_sock != m_device)
+    {
+        delete m_sock;
+    }
+    m_sock = nullptr;
+    m_sshChannel = nullptr;
+    m_server = nullptr;
+    m_localServer = nullptr;
+    m_device = nullptr;
+    m_remoteSocket.clear();
+    m_socketOptions = SshSocketOptions();
+    m_port = 0;
+    m_target.clear();
+    m_error = false;
+    m_pooled = false;
+    m_attached = false;
+    return true;
+}
+
+void SshTunnelOutConnection::reuse()
+{
+    /* New name in the transfer logs */
+    m_connector.reset(m_name);
+    DEBUGCH << "Reuse SshTunnelOutConnection";
+    emit sendEvent();
 }
 
 void SshTunnelOutConnection::close()
@@ -61,12 +213,12 @@ void SshTunnelOutConnection::_eventLoop()
     {
         case Openning:
         {
-            if ( ! m_sshClient->takeChannelCreationMutex(this) )
+            if ( ! m_sshClient->acquireChannelOpen(this) )
             {
                 return;
             }
-            m_sshChannel = libssh2_channel_direct_tcpip(m_sshClient->session(), qPrintable(m_target), m_port);
-            m_sshClient->releaseChannelCreationMutex(this);
+            m_sshChannel = _openChannel();
+            m_sshClient->releaseChannelOpen(this, m_sshChannel);
             if (m_sshChannel == nullptr)
             {
                 char *emsg;
@@ -76,16 +228,22 @@ void SshTunnelOutConnection::_eventLoop()
                 {
                     return;
                 }
+                if(!m_error && m_pooled && !m_attached)
+                {
+                    /* No client waits on this one, leave the server alone */
+                    qCDebug(logsshtunneloutconnection) << "Pooled channel open failed " << QString(emsg);
+                    m_error = true;
+                }
                 if(!m_error)
                 {
-                    qCDebug(logsshtunneloutconnection) << "Refuse client socket connection on " << m_server->serverPort() << QString(emsg);
+                    qCDebug(logsshtunneloutconnection) << "Refuse client socket connection on " << m_target << m_port << QString(emsg);
                     m_error = true;
-                    m_sock = m_server->nextPendingConnection();
+                    m_sock = _nextPendingConnection();
                     if(m_sock)
                     {
                         m_sock->close();
                     }
-                    m_server->close();
+                    _closeServer();
                 }
                 setChannelState(ChannelState::Error);
                 qCWarning(logsshtunneloutconnection) << "Channel session open failed";
@@ -97,10 +255,21 @@ void SshTunnelOutConnection::_eventLoop()
 
         FALLTHROUGH; case Exec:
         {
-            m_sock = m_server->nextPendingConnection();
+            if(m_pooled && !m_attached)
+            {
+                /* Remote end closed the idle channel, it can't be used */
+                if(libssh2_channel_eof(m_sshChannel) == 1)
+                {
+                    DEBUGCH << "Pooled channel closed by remote";
+                    setChannelState(ChannelState::Close);
+                    emit sendEvent();
+                }
+                return;
+            }
+            m_sock = _nextPendingConnection();
             if(!m_sock)
             {
-                m_server->close();
+                _closeServer();
                 setChannelState(ChannelState::Error);
                 qCWarning(logsshtunneloutconnection) << "Fail to get client socket";
                 setChannelState(ChannelState::Close);
@@ -108,8 +277,12 @@ void SshTunnelOutConnection::_eventLoop()
             }
 
             QObject::connect(m_sock, &QObject::destroyed, [this](){ DEBUGCH << "Client Socket destroyed";});
-            m_name = QString(m_name + ":%1").arg(m_sock->localPort());
-            DEBUGCH << "createConnection: " << m_sock << m_sock->localPort();
+            if(QTcpSocket *tcp = qobject_cast<QTcpSocket *>(m_sock))
+            {
+                m_name = QString(m_name + ":%1").arg(tcp->localPort());
+                m_socketOptions.apply(tcp);
+            }
+            DEBUGCH << "createConnection: " << m_sock;
             m_connector.setChannel(m_sshChannel);
             m_connector.setSock(m_sock);
             setChannelState(ChannelState::Ready);
@@ -121,13 +294,27 @@ void SshTunnelOutConnection::_eventLoop()
             if(!m_connector.process())
             {
                 setChannelState(ChannelState::Close);
+                return;
             }
+            tuneWindow(m_sshChannel);
             return;
         }
 
         case Close:
         {
             DEBUGCH << "closeChannel";
+            if(m_sock == nullptr)
+            {
+                /* Never attached to a client socket (pooled channel) */
+                if(m_sshChannel == nullptr)
+                {
+                    setChannelState(ChannelState::Free);
+                    return;
+                }
+                setChannelState(ChannelState::Freeing);
+                emit sendEvent();
+                return;
+            }
             m_connector.close();
             setChannelState(ChannelState::WaitClose);
         }
@@ -135,7 +322,8 @@ void SshTunnelOutConnection::_eventLoop()
         FALLTHROUGH; case WaitClose:
         {
             DEBUGCH << "Wait close channel";
-            if(m_connector.isClosed())
+            /* Fast close: the connector was told to close, don't wait for it */
+            if(skipWaitClosed() || m_connector.isClosed())
             {
                 setChannelState(ChannelState::Freeing);
             }
@@ -173,7 +361,6 @@ void SshTunnelOutConnection::_eventLoop()
                 setChannelState(ChannelState::Free);
             }
             m_sshChannel = nullptr;
-            QObject::disconnect(m_sshClient, &SshClient::sshDataReceived, this, &SshTunnelOutConnection::sshDataReceived);
             return;
         }
 
@@ -2,9 +2,11 @@
 
 #include <QObject>
 #include <QTcpServer>
+#include <QLocalServer>
 #include <QLoggingCategory>
 #include "sshchannel.h"
 #include "sshtunneldataconnector.h"
+#include "sshsocketoptions.h"
 
 Q_DECLARE_LOGGING_CATEGORY(logsshtunneloutconnection)
 Q_DECLARE_LOGGING_CATEGORY(logsshtunneloutconnectiontransfer)
@@ -15,20 +17,56 @@ class SshTunnelOutConnection : public SshChannel
 protected:
     explicit SshTunnelOutConnection(const QString &name, SshClient *client);
     friend class SshClient;
+    LIBSSH2_CHANNEL *dispatchChannel() const override;
+    void transferStats(Stats &stats) const override;
+    bool recycle() override;
+    void reuse() override;
 
 public:
     void configure(QTcpServer *server, quint16 remotePort, QString target = "127.0.0.1");
+    void configure(QLocalServer *server, quint16 remotePort, QString target = "127.0.0.1");
+
+    /* In-process endpoint: pump the channel to device, which is not owned */
+    void configure(QIODevice *device, quint16 remotePort, QString target = "127.0.0.1");
+
+    /* Open the channel to a Unix socket of the server (direct-streamlocal) */
+    void setRemoteSocket(const QString &path);
+    void setBufferWatermarks(size_t high, size_t low);
+    void setCoalescing(size_t size, int delayUsec);
+    /* Applied to the accepted client socket */
+    void setSocketOptions(const SshSocketOptions &options);
+
+    /*
+     * Pooled connection: the channel is opened in advance and waits in
+     * Exec state, without socket, until attach() gives it the next pending
+     * client socket of the server.
+     */
+    void setPooled(bool pooled);
+    bool isPooled() const;
+    bool isAttached() const;
+    bool isOpened() const;
+    void attach();
     virtual ~SshTunnelOutConnection() override;
     void close() override;
 
 private:
     SshTunnelDataConnector m_connector;
     LIBSSH2_CHANNEL *m_sshChannel {nullptr};
-    QTcpSocket *m_sock;
-    QTcpServer *m_server;
-    quint16 m_port;
+    QIODevice *m_sock {nullptr};
+    QTcpServer *m_server {nullptr};
+    QLocalServer *m_localServer {nullptr};
+    QIODevice *m_device {nullptr};
+    QString m_remoteSocket;
+    SshSocketOptions m_socketOptions;
+    quint16 m_port {0};
     QString m_target;
     bool m_error {false};
+    bool m_pooled {false};
+    bool m_attached {false};
+
+    LIBSSH2_CHANNEL *_openChannel();
+    QIODevice *_nextPendingConnection();
+    void _closeServer();
 
 private slots:
     void _eventLoop();
@@ -0,0 +1,189 @@
+#include "sshwritescheduler.h"
+#include <algorithm>
+
+SshWriteScheduler::SshWriteScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_throttleTimer.setSingleShot(true);
+    QObject::connect(&m_throttleTimer, &QTimer::timeout, this, &SshWriteScheduler::_unthrottle);
+}
+
+void SshWriteScheduler::setEnabled(bool enable)
+{
+    m_enabled = enable;
+    if(!m_enabled)
+    {
+        /* Nobody waits on a disabled scheduler */
+        _round();
+        m_entries.clear();
+    }
+}
+
+bool SshWriteScheduler::isEnabled() const
+{
+    return m_enabled;
+}
+
+void SshWriteScheduler::setQuantum(size_t bytes)
+{
+    m_quantum = qMax<size_t>(bytes, 1024);
+}
+
+size_t SshWriteScheduler::quantum() const
+{
+    return m_quantum;
+}
+
+void SshWriteScheduler::setWeight(SshChannel::Priority priority, int weight)
+{
+    m_weights[priority] = qMax(1, weight);
+}
+
+int SshWriteScheduler::weight(SshChannel::Priority priority) const
+{
+    return m_weights[priority];
+}
+
+qint64 SshWriteScheduler::_quantum(const SshChannel *channel) const
+{
+    return static_cast<qint64>(m_quantum) * m_weights[channel->priority()];
+}
+
+void SshWriteScheduler::setSessionRateLimit(quint64 bytesPerSecond, quint64 burst)
+{
+    m_sessionLimiter.setRate(bytesPerSecond, burst);
+    /* New rate: throttled channels compute their delay again */
+    _unthrottle();
+}
+
+quint64 SshWriteScheduler::sessionRateLimit() const
+{
+    return m_sessionLimiter.rate();
+}
+
+size_t SshWriteScheduler::_limit(SshChannel *channel, size_t allowed)
+{
+    SshRateLimiter &limiter = channel->m_rateLimiter;
+    if(!limiter.isLimited() && !m_sessionLimiter.isLimited())
+    {
+        return allowed;
+    }
+
+    allowed = m_sessionLimiter.available(limiter.available(allowed));
+    if(allowed > 0)
+    {
+        return allowed;
+    }
+
+    /* Out of tokens: wake up by timer, not by spinning on events */
+    int delay = qMax(1, qMax(limiter.delay(), m_sessionLimiter.delay()));
+    if(!m_throttled.contains(channel))
+    {
+        m_throttled.insert(channel, channel);
+        QObject::connect(channel, &QObject::destroyed, this, &SshWriteScheduler::_remove, Qt::UniqueConnection);
+    }
+    if(!m_throttleTimer.isActive() || m_throttleTimer.remainingTime() > delay)
+    {
+        m_throttleTimer.start(delay);
+    }
+    return 0;
+}
+
+void SshWriteScheduler::_unthrottle()
+{
+    const QList<SshChannel *> channels = m_throttled.values();
+    m_throttled.clear();
+    for(SshChannel *channel: channels)
+    {
+        channel->_queueSshEvent();
+    }
+}
+
+size_t SshWriteScheduler::grant(SshChannel *channel, size_t wanted)
+{
+    if(!m_enabled)
+    {
+        return _limit(channel, wanted);
+    }
+
+    auto it = m_entries.find(channel);
+    if(it == m_entries.end())
+    {
+        /* Channel joins the round with a full quantum */
+        it = m_entries.insert(channel, Entry {channel, _quantum(channel), false});
+        QObject::connect(channel, &QObject::destroyed, this, &SshWriteScheduler::_remove, Qt::UniqueConnection);
+    }
+
+    if(it->waiting)
+    {
+        return 0;
+    }
+    if(it->deficit > 0)
+    {
+        return _limit(channel, qMin(wanted, static_cast<size_t>(it->deficit)));
+    }
+
+    /* Quantum used: let the other channels run before the next one */
+    it->waiting = true;
+    m_waiting.append(channel);
+    if(!m_roundQueued)
+    {
+        m_roundQueued = true;
+        QMetaObject::invokeMethod(this, "_round", Qt::QueuedConnection);
+    }
+    return 0;
+}
+
+void SshWriteScheduler::consumed(SshChannel *channel, size_t bytes)
+{
+    channel->m_rateLimiter.consume(bytes);
+    m_sessionLimiter.consume(bytes);
+    auto it = m_entries.find(channel);
+    if(it != m_entries.end())
+    {
+        it->deficit -= static_cast<qint64>(bytes);
+    }
+}
+
+void SshWriteScheduler::done(SshChannel *channel)
+{
+    auto it = m_entries.find(channel);
+    if(it != m_entries.end() && !it->waiting)
+    {
+        m_entries.erase(it);
+    }
+}
+
+void SshWriteScheduler::forget(SshChannel *channel)
+{
+    _remove(channel);
+}
+
+void SshWriteScheduler::_remove(QObject *channel)
+{
+    m_entries.remove(channel);
+    m_waiting.removeAll(channel);
+    m_throttled.remove(channel);
+}
+
+void SshWriteScheduler::_round()
+{
+    m_roundQueued = false;
+    QList<QObject *> waiting = m_waiting;
+    m_waiting.clear();
+
+    /* Highest priority first, arrival order inside a class */
+    std::stable_sort(waiting.begin(), waiting.end(), [this](QObject *a, QObject *b) {
+        return m_entries.value(a).channel->priority() < m_entries.value(b).channel->priority();
+    });
+
+    for(QObject *key: waiting)
+    {
+        auto it = m_entries.find(key);
+        if(it == m_entries.end())
+            continue;
+        it->deficit += _quantum(it->channel);
+        it->waiting = false;
+        it->channel->_queueSshEvent();
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include "sshchannel.h"
+#include "sshratelimiter.h"
+
+/*
+ * Deficit round robin between the channels writing on one session.
+ * A writer asks grant() before each write and reports consumed() bytes:
+ * once its quantum (weighted by the channel priority) is used, it gets 0,
+ * stops and is woken up on the next round, after the events queued by the
+ * other channels. Interactive channels get the first turn of each round.
+ * Grants are also bounded by the channel and session rate limits: a
+ * channel out of tokens is woken up by a timer when they are back.
+ */
+class SshWriteScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SshWriteScheduler(QObject *parent = nullptr);
+
+    void setEnabled(bool enable);
+    bool isEnabled() const;
+    void setQuantum(size_t bytes);
+    size_t quantum() const;
+    void setWeight(SshChannel::Priority priority, int weight);
+    int weight(SshChannel::Priority priority) const;
+
+    /* Session wide token bucket, 0 for unlimited */
+    void setSessionRateLimit(quint64 bytesPerSecond, quint64 burst = 0);
+    quint64 sessionRateLimit() const;
+
+    /* Bytes channel may write now (up to wanted), 0 to wait its turn */
+    size_t grant(SshChannel *channel, size_t wanted);
+    void consumed(SshChannel *channel, size_t bytes);
+    /* Nothing more to write: the channel leaves the round */
+    void done(SshChannel *channel);
+    /* Channel kept for reuse: its entry goes, as if it was destroyed */
+    void forget(SshChannel *channel);
+
+private:
+    struct Entry {
+        SshChannel *channel;
+        qint64 deficit;
+        bool waiting;
+    };
+    bool m_enabled {true};
+    size_t m_quantum {16 * 1024};
+    int m_weights[SshChannel::Bulk + 1] {8, 4, 1};
+    /* Keyed by QObject: entries are removed from destroyed() */
+    QHash<QObject *, Entry> m_entries;
+    QList<QObject *> m_waiting;
+    bool m_roundQueued {false};
+    SshRateLimiter m_sessionLimiter;
+    QHash<QObject *, SshChannel *> m_throttled;
+    QTimer m_throttleTimer;
+
+    size_t _limit(SshChannel *channel, size_t allowed);
+
+    qint64 _quantum(const SshChannel *channel) const;
+    void _remove(QObject *channel);
+
+private slots:
+    void _round();
+    void _unthrottle();
+};
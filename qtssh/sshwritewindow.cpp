@@ -0,0 +1,18 @@
+#include "sshwritewindow.h"
+
+void SshWriteWindow::reset()
+{
+    m_last = 0;
+}
+
+void SshWriteWindow::written(unsigned long window)
+{
+    m_last = window;
+}
+
+bool SshWriteWindow::adjusted(unsigned long window)
+{
+    bool grown = (window > m_last);
+    m_last = window;
+    return grown;
+}
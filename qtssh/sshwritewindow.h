@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * \brief Write window of a channel, as last seen
+ * \details The dispatcher polls the window to wake up a blocked writer
+ * when the peer adjusted it. The writes record the window they leave,
+ * so a writer blocked on a window it used up is woken by any adjust,
+ * even one smaller than a window polled before.
+ */
+class SshWriteWindow
+{
+    unsigned long m_last {0};
+
+public:
+    void reset();
+    /* After a write, whatever its result */
+    void written(unsigned long window);
+    /* Dispatcher poll: true when the window grew since last seen */
+    bool adjusted(unsigned long window);
+};
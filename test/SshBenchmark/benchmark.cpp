@@ -0,0 +1,432 @@
+#include "benchmark.h"
+#include <sshtunnelout.h>
+#include <sshsftp.h>
+#include <sshscpsend.h>
+#include <sshscpget.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QProcess>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QPointer>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+Q_LOGGING_CATEGORY(sshbenchmark, "benchmark.ssh", QtInfoMsg)
+
+#define LATENCY_MESSAGE_SIZE 64
+#define FILE_CHUNK_SIZE (1024*1024)
+
+Benchmark::Benchmark(const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_ssh("SshBenchmark")
+{
+    connect(&m_echo, &QTcpServer::newConnection, this, &Benchmark::_echoConnection);
+}
+
+Benchmark::~Benchmark()
+{
+    _setRtt(0);
+}
+
+void Benchmark::_echoConnection()
+{
+    while(m_echo.hasPendingConnections())
+    {
+        QTcpSocket *sock = m_echo.nextPendingConnection();
+        sock->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(sock, &QTcpSocket::readyRead, sock, [sock](){ sock->write(sock->readAll()); });
+        connect(sock, &QTcpSocket::disconnected, sock, &QObject::deleteLater);
+    }
+}
+
+bool Benchmark::_wait(const std::function<bool()> &done, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while(!done())
+    {
+        if(timer.elapsed() > timeout)
+        {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 10);
+    }
+    return true;
+}
+
+bool Benchmark::_connect()
+{
+    if(!m_echo.isListening() && !m_echo.listen(QHostAddress::LocalHost))
+    {
+        qCCritical(sshbenchmark) << "Can't listen echo server port";
+        return false;
+    }
+    SshSocketOptions interactive = SshSocketOptions::interactive();
+    m_ssh.setSocketOptions(interactive);
+    m_ssh.setPassphrase(m_options.password);
+    m_ssh.connectToHost(m_options.login, m_options.hostname, 22);
+    if(!_wait([this](){ return m_ssh.sshState() == SshClient::Ready || m_ssh.sshState() == SshClient::Error; }, m_options.timeout)
+            || m_ssh.sshState() != SshClient::Ready)
+    {
+        qCCritical(sshbenchmark) << "Can't connect to" << m_options.hostname;
+        return false;
+    }
+    return true;
+}
+
+bool Benchmark::_setRtt(int msec)
+{
+    if(msec == m_rtt)
+    {
+        return true;
+    }
+    if(msec == 0)
+    {
+        QProcess::execute("tc", {"qdisc", "del", "dev", m_options.netemDevice, "root"});
+        m_rtt = 0;
+        return true;
+    }
+    /* Both ways go through the device: half the round trip each */
+    QStringList args {"qdisc", "replace", "dev", m_options.netemDevice, "root", "netem", "delay", QString("%1ms").arg(msec / 2.0)};
+    if(QProcess::execute("tc", args) != 0)
+    {
+        qCWarning(sshbenchmark) << "netem failed (tc" << args.join(' ') << ")";
+        return false;
+    }
+    m_rtt = msec;
+    return true;
+}
+
+Benchmark::Usage Benchmark::_usage()
+{
+    Usage usage {0, 0};
+#ifdef Q_OS_UNIX
+    struct rusage ru;
+    if(getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        usage.cpuUsec = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+        usage.rssKb = ru.ru_maxrss;
+    }
+#endif
+    QFile status("/proc/self/status");
+    if(status.open(QIODevice::ReadOnly))
+    {
+        for(const QByteArray &line: status.readAll().split('\n'))
+        {
+            if(line.startsWith("VmRSS:"))
+            {
+                usage.rssKb = line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+    return usage;
+}
+
+double Benchmark::_percentile(const QVector<double> &sorted, double p)
+{
+    if(sorted.isEmpty())
+    {
+        return 0.0;
+    }
+    int index = static_cast<int>(std::ceil(p * sorted.size())) - 1;
+    return sorted.at(qBound(0, index, sorted.size() - 1));
+}
+
+void Benchmark::_record(const QString &name, QJsonObject params, bool ok, qint64 bytes, qint64 elapsedUsec, const Usage &before, QVector<double> latencies)
+{
+    Usage after = _usage();
+    std::sort(latencies.begin(), latencies.end());
+    double seconds = static_cast<double>(elapsedUsec) / 1e6;
+    double gb = static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0);
+
+    params.insert("name", name);
+    params.insert("rtt_ms", m_rtt);
+    params.insert("ok", ok);
+    params.insert("bytes", static_cast<double>(bytes));
+    params.insert("seconds", seconds);
+    params.insert("mb_per_s", seconds > 0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0);
+    params.insert("p50_ms", _percentile(latencies, 0.50));
+    params.insert("p99_ms", _percentile(latencies, 0.99));
+    params.insert("cpu_s_per_gb", gb > 0 ? static_cast<double>(after.cpuUsec - before.cpuUsec) / 1e6 / gb : 0.0);
+    params.insert("rss_kb", static_cast<double>(after.rssKb));
+    m_results.append(params);
+
+    qCInfo(sshbenchmark).noquote() << QJsonDocument(params).toJson(QJsonDocument::Compact);
+}
+
+void Benchmark::_tunnelThroughput(qint64 payload, int connections)
+{
+    QByteArray data(static_cast<int>(payload), Qt::Uninitialized);
+    for(int i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(i * 31 + (i >> 8));
+    }
+
+    SshTunnelOut *tunnel = m_ssh.getChannel<SshTunnelOut>(QString("bench_out_%1").arg(m_counter++));
+    tunnel->listen(m_echo.serverPort());
+
+    QList<QTcpSocket *> sockets;
+    QVector<qint64> received(connections, 0);
+    QVector<double> latencies;
+    int done = 0;
+    QElapsedTimer timer;
+    Usage before = _usage();
+    timer.start();
+    for(int i = 0; i < connections; ++i)
+    {
+        QTcpSocket *sock = new QTcpSocket(this);
+        sock->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(sock, &QTcpSocket::connected, sock, [sock, data](){ sock->write(data); });
+        connect(sock, &QTcpSocket::readyRead, sock, [&, sock, i](){
+            if(received[i] >= payload)
+            {
+                return;
+            }
+            received[i] += sock->readAll().size();
+            if(received[i] >= payload)
+            {
+                latencies.append(static_cast<double>(timer.nsecsElapsed()) / 1e6);
+                done++;
+            }
+        });
+        sock->connectToHost(QHostAddress::LocalHost, tunnel->localPort());
+        sockets.append(sock);
+    }
+    bool ok = _wait([&](){ return done == connections; }, m_options.timeout);
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+    qint64 bytes = 0;
+    for(qint64 r: received)
+    {
+        bytes += r;
+    }
+    /* Sent and echoed */
+    _record("tunnel_throughput", QJsonObject {{"payload", static_cast<double>(payload)}, {"connections", connections}},
+            ok, 2 * bytes, elapsed, before, latencies);
+
+    for(QTcpSocket *sock: sockets)
+    {
+        sock->disconnect();
+        sock->abort();
+        sock->deleteLater();
+    }
+    QPointer<SshTunnelOut> closing(tunnel);
+    tunnel->close();
+    _wait([closing](){ return !closing || closing->connections() == 0; }, m_options.timeout);
+}
+
+void Benchmark::_tunnelLatency(int connections)
+{
+    SshTunnelOut *tunnel = m_ssh.getChannel<SshTunnelOut>(QString("bench_lat_%1").arg(m_counter++));
+    tunnel->listen(m_echo.serverPort());
+
+    const QByteArray message(LATENCY_MESSAGE_SIZE, 'x');
+    int rounds = qMax(1, m_options.latencySamples / connections);
+    QList<QTcpSocket *> sockets;
+    QVector<double> latencies;
+    int finished = 0;
+    qint64 bytes = 0;
+    Usage before = _usage();
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < connections; ++i)
+    {
+        QTcpSocket *sock = new QTcpSocket(this);
+        sock->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        auto sent = std::make_shared<qint64>(0);
+        auto pending = std::make_shared<int>(0);
+        auto left = std::make_shared<int>(rounds);
+        connect(sock, &QTcpSocket::connected, sock, [sock, message, sent, &timer](){
+            *sent = timer.nsecsElapsed();
+            sock->write(message);
+        });
+        connect(sock, &QTcpSocket::readyRead, sock, [&, sock, message, sent, pending, left](){
+            *pending += sock->readAll().size();
+            if(*pending < LATENCY_MESSAGE_SIZE)
+            {
+                return;
+            }
+            *pending -= LATENCY_MESSAGE_SIZE;
+            bytes += 2 * LATENCY_MESSAGE_SIZE;
+            latencies.append(static_cast<double>(timer.nsecsElapsed() - *sent) / 1e6);
+            if(--(*left) == 0)
+            {
+                finished++;
+                return;
+            }
+            *sent = timer.nsecsElapsed();
+            sock->write(message);
+        });
+        sock->connectToHost(QHostAddress::LocalHost, tunnel->localPort());
+        sockets.append(sock);
+    }
+    bool ok = _wait([&](){ return finished == connections; }, m_options.timeout);
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+    _record("tunnel_latency", QJsonObject {{"payload", LATENCY_MESSAGE_SIZE}, {"connections", connections}, {"rounds", rounds}},
+            ok, bytes, elapsed, before, latencies);
+
+    for(QTcpSocket *sock: sockets)
+    {
+        sock->disconnect();
+        sock->abort();
+        sock->deleteLater();
+    }
+    QPointer<SshTunnelOut> closing(tunnel);
+    tunnel->close();
+    _wait([closing](){ return !closing || closing->connections() == 0; }, m_options.timeout);
+}
+
+bool Benchmark::_makeFile(const QString &path, qint64 size)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    QByteArray chunk(FILE_CHUNK_SIZE, Qt::Uninitialized);
+    quint32 seed = static_cast<quint32>(size);
+    for(int i = 0; i < chunk.size(); ++i)
+    {
+        /* Not compressible, not worth a real random generator */
+        seed = seed * 1103515245u + 12345u;
+        chunk[i] = static_cast<char>(seed >> 24);
+    }
+    for(qint64 written = 0; written < size; written += chunk.size())
+    {
+        if(file.write(chunk.constData(), qMin<qint64>(chunk.size(), size - written)) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Benchmark::_sftp(qint64 size)
+{
+    QTemporaryDir dir;
+    QString local = dir.filePath("put.bin");
+    QString back = dir.filePath("get.bin");
+    QString remote = QString("%1/qtssh_bench_%2.bin").arg(m_options.remoteDir).arg(size);
+    if(!_makeFile(local, size))
+    {
+        qCWarning(sshbenchmark) << "Can't create" << local;
+        return;
+    }
+    QJsonObject params {{"size", static_cast<double>(size)}};
+
+    SshSFtp *sftp = m_ssh.getChannel<SshSFtp>("bench_sftp");
+    Usage before = _usage();
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = !sftp->send(local, remote).isEmpty();
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+    _record("sftp_put", params, ok, ok ? size : 0, elapsed, before, {static_cast<double>(elapsed) / 1000.0});
+
+    before = _usage();
+    timer.restart();
+    ok = sftp->get(remote, back, true);
+    elapsed = timer.nsecsElapsed() / 1000;
+    _record("sftp_get", params, ok, ok ? size : 0, elapsed, before, {static_cast<double>(elapsed) / 1000.0});
+
+    sftp->unlink(remote);
+}
+
+void Benchmark::_scp(qint64 size)
+{
+    QTemporaryDir dir;
+    QString local = dir.filePath("put.bin");
+    QString back = dir.filePath("get.bin");
+    QString remote = QString("%1/qtssh_bench_scp_%2.bin").arg(m_options.remoteDir).arg(size);
+    if(!_makeFile(local, size))
+    {
+        qCWarning(sshbenchmark) << "Can't create" << local;
+        return;
+    }
+    QJsonObject params {{"size", static_cast<double>(size)}};
+
+    bool finished = false;
+    bool failed = false;
+    SshScpSend *send = m_ssh.getChannel<SshScpSend>(QString("bench_scp_%1").arg(m_counter++));
+    connect(send, &SshScpSend::finished, this, [&](){ finished = true; });
+    connect(send, &SshScpSend::failed, this, [&](){ failed = true; });
+    Usage before = _usage();
+    QElapsedTimer timer;
+    timer.start();
+    send->send(local, remote);
+    bool ok = _wait([&](){ return finished || failed; }, m_options.timeout) && !failed;
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+    send->disconnect(this);
+    _record("scp_put", params, ok, ok ? size : 0, elapsed, before, {static_cast<double>(elapsed) / 1000.0});
+
+    finished = false;
+    failed = false;
+    SshScpGet *get = m_ssh.getChannel<SshScpGet>(QString("bench_scp_%1").arg(m_counter++));
+    connect(get, &SshScpGet::finished, this, [&](){ finished = true; });
+    connect(get, &SshScpGet::failed, this, [&](){ failed = true; });
+    before = _usage();
+    timer.restart();
+    get->get(remote, back);
+    ok = _wait([&](){ return finished || failed; }, m_options.timeout) && !failed;
+    elapsed = timer.nsecsElapsed() / 1000;
+    get->disconnect(this);
+    _record("scp_get", params, ok, ok ? size : 0, elapsed, before, {static_cast<double>(elapsed) / 1000.0});
+
+    m_ssh.getChannel<SshSFtp>("bench_sftp")->unlink(remote);
+}
+
+bool Benchmark::run()
+{
+    if(!_connect())
+    {
+        return false;
+    }
+    for(int rtt: m_options.rtts)
+    {
+        if(!_setRtt(rtt))
+        {
+            continue;
+        }
+        qCInfo(sshbenchmark) << "RTT" << rtt << "ms";
+        for(int connections: m_options.connections)
+        {
+            for(qint64 payload: m_options.payloads)
+            {
+                _tunnelThroughput(payload, connections);
+            }
+            _tunnelLatency(connections);
+        }
+        for(qint64 size: m_options.fileSizes)
+        {
+            _sftp(size);
+            _scp(size);
+        }
+    }
+    _setRtt(0);
+    m_ssh.disconnectFromHost();
+    m_ssh.waitForState(SshClient::Unconnected);
+    return true;
+}
+
+QJsonDocument Benchmark::report() const
+{
+    QJsonObject root {
+        {"date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {"qt", QString(qVersion())},
+        {"libssh2", QString(LIBSSH2_VERSION)},
+        {"host", m_options.hostname},
+        {"results", m_results}
+    };
+    return QJsonDocument(root);
+}
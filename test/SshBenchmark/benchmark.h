@@ -0,0 +1,82 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QVector>
+#include <functional>
+#include <sshclient.h>
+
+Q_DECLARE_LOGGING_CATEGORY(sshbenchmark)
+
+/*
+ * Benchmark matrices against a live sshd: tunnel throughput by payload
+ * size and number of connections, tunnel round trip latency, SFTP and SCP
+ * transfers by file size, each one for every RTT. A netem delay is set on
+ * netemDevice for the RTTs other than 0 (needs CAP_NET_ADMIN): on the
+ * loopback every hop is delayed, client to sshd and sshd to target.
+ *
+ * Each case gives a JSON object: MB/s, p50/p99 latency in ms, CPU seconds
+ * per GB moved and the RSS of the process.
+ */
+class Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString hostname {"127.0.0.1"};
+        QString login {"lpctest"};
+        QString password {"lpctest"};
+        QList<qint64> payloads {4*1024, 64*1024, 1024*1024, 16*1024*1024};
+        QList<int> connections {1, 10, 100, 1000};
+        QList<qint64> fileSizes {1024*1024, 16*1024*1024, 128*1024*1024};
+        QList<int> rtts {0};
+        QString netemDevice {"lo"};
+        QString remoteDir {"/tmp"};
+        int latencySamples {1000};
+        int timeout {120000};
+    };
+
+    explicit Benchmark(const Options &options, QObject *parent = nullptr);
+    virtual ~Benchmark() override;
+
+    /* Run every matrix, false if the session can't be opened */
+    bool run();
+    QJsonDocument report() const;
+
+private:
+    struct Usage {
+        qint64 cpuUsec;
+        qint64 rssKb;
+    };
+
+    Options m_options;
+    SshClient m_ssh;
+    QTcpServer m_echo;
+    QJsonArray m_results;
+    int m_counter {0};
+    int m_rtt {0};
+
+    bool _connect();
+    bool _setRtt(int msec);
+    void _tunnelThroughput(qint64 payload, int connections);
+    void _tunnelLatency(int connections);
+    void _sftp(qint64 size);
+    void _scp(qint64 size);
+    bool _wait(const std::function<bool()> &done, int timeout);
+    bool _makeFile(const QString &path, qint64 size);
+    void _record(const QString &name, QJsonObject params, bool ok, qint64 bytes, qint64 elapsedUsec, const Usage &before, QVector<double> latencies);
+
+    static Usage _usage();
+    static double _percentile(const QVector<double> &sorted, double p);
+
+private slots:
+    void _echoConnection();
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,99 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+
+#include "benchmark.h"
+
+template<typename T>
+static QList<T> parseList(const QString &value, T (*convert)(const QString &))
+{
+    QList<T> list;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    for(const QString &item: value.split(',', Qt::SkipEmptyParts))
+#else
+    for(const QString &item: value.split(',', QString::SkipEmptyParts))
+#endif
+    {
+        list.append(convert(item.trimmed()));
+    }
+    return list;
+}
+
+static qint64 toSize(const QString &value)
+{
+    /* 4096, 64K, 16M, 1G */
+    qint64 factor = 1;
+    QString number = value;
+    if(value.endsWith('K', Qt::CaseInsensitive)) factor = 1024;
+    else if(value.endsWith('M', Qt::CaseInsensitive)) factor = 1024 * 1024;
+    else if(value.endsWith('G', Qt::CaseInsensitive)) factor = 1024 * 1024 * 1024;
+    if(factor != 1)
+        number.chop(1);
+    return number.toLongLong() * factor;
+}
+
+static int toInt(const QString &value)
+{
+    return value.toInt();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sshbenchmark");
+
+    Benchmark::Options options;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("QtSsh tunnel, SFTP and SCP benchmarks, JSON report");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"host", "sshd host", "host", options.hostname},
+        {"user", "Login", "user", options.login},
+        {"password", "Password", "password", options.password},
+        {"payloads", "Tunnel payload sizes", "list", "4K,64K,1M,16M"},
+        {"connections", "Concurrent tunnel connections", "list", "1,10,100,1000"},
+        {"files", "SFTP and SCP file sizes", "list", "1M,16M,128M"},
+        {"rtt", "Round trip times in ms set with netem, 0 for none", "list", "0"},
+        {"netem-dev", "Device of the netem delay", "device", options.netemDevice},
+        {"remote-dir", "Remote directory of the transfers", "dir", options.remoteDir},
+        {"samples", "Latency samples per case", "count", QString::number(options.latencySamples)},
+        {"timeout", "Timeout of a case in ms", "msec", QString::number(options.timeout)},
+        {"output", "JSON report file, stdout if not set", "file"}
+    });
+    parser.process(app);
+
+    options.hostname = parser.value("host");
+    options.login = parser.value("user");
+    options.password = parser.value("password");
+    options.payloads = parseList<qint64>(parser.value("payloads"), toSize);
+    options.connections = parseList<int>(parser.value("connections"), toInt);
+    options.fileSizes = parseList<qint64>(parser.value("files"), toSize);
+    options.rtts = parseList<int>(parser.value("rtt"), toInt);
+    options.netemDevice = parser.value("netem-dev");
+    options.remoteDir = parser.value("remote-dir");
+    options.latencySamples = parser.value("samples").toInt();
+    options.timeout = parser.value("timeout").toInt();
+
+    Benchmark benchmark(options);
+    if(!benchmark.run())
+    {
+        return 1;
+    }
+
+    QByteArray json = benchmark.report().toJson();
+    if(parser.isSet("output"))
+    {
+        QFile file(parser.value("output"));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            qCCritical(sshbenchmark) << "Can't write" << parser.value("output");
+            return 1;
+        }
+    }
+    else
+    {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT -= gui
+
+CONFIG += c++1z console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += main.cpp benchmark.cpp
+HEADERS += benchmark.h
+
+include(../../QtSsh.pri)
+
+LIBS += -lssh2
@@ -0,0 +1,181 @@
+#include "connectorbench.h"
+#include "fakechannel.h"
+#include "sshtunneldataconnector.h"
+
+#include <QtTest>
+
+/* Volume moved in each direction by one benchmark iteration */
+static const qint64 VOLUME = 16 * 1024 * 1024;
+
+struct Run
+{
+    qint64 sockToSsh {0};
+    qint64 sshToSock {0};
+    qint64 feedChunk {16384};
+    size_t high {BUFFER_SIZE};
+    size_t coalesce {0};
+    qint64 sockWriteLimit {0};
+    FakeChannelIo::Pattern pattern;
+};
+
+static SshTunnelDataConnector::Stats pump(const Run &run)
+{
+    FakeChannelIo io(run.pattern);
+    io.setReadBudget(run.sshToSock);
+    FakeSocket sock(run.sockWriteLimit);
+
+    SshTunnelDataConnector connector(nullptr, "bench");
+    connector.setIo(&io);
+    connector.setChannel(io.handle());
+    connector.setSock(&sock);
+    connector.setWatermarks(run.high, run.high / 2);
+    if(run.coalesce > 0)
+    {
+        connector.setCoalescing(run.coalesce);
+    }
+
+    qint64 fed = 0;
+    while(io.written() < run.sockToSsh || sock.received() < run.sshToSock)
+    {
+        if(fed < run.sockToSsh)
+        {
+            qint64 chunk = qMin(run.feedChunk, run.sockToSsh - fed);
+            sock.feed(chunk);
+            fed += chunk;
+        }
+        if(io.readServed() < run.sshToSock)
+        {
+            connector.sshDataReceived();
+        }
+        connector.process();
+        if(run.coalesce > 0)
+        {
+            /* Zero timer of the coalescing hold */
+            QCoreApplication::processEvents();
+        }
+    }
+    return connector.stats();
+}
+
+static void printStats(const SshTunnelDataConnector::Stats &stats)
+{
+    QString sizes;
+    for(int i = 0; i < SSH_WRITE_HISTOGRAM_BUCKETS; ++i)
+    {
+        sizes += QString(" %1").arg(stats.writeSizes[i]);
+    }
+    qInfo().noquote() << QString("process: %1, tx stalls: %2, rx stalls: %3, write sizes:%4")
+                         .arg(stats.processCalls).arg(stats.txStalls).arg(stats.rxStalls).arg(sizes);
+}
+
+static void addColumns()
+{
+    QTest::addColumn<qint64>("high");
+    QTest::addColumn<qint64>("feedChunk");
+    QTest::addColumn<qint64>("coalesce");
+    QTest::addColumn<qint64>("window");
+    QTest::addColumn<int>("writeEagain");
+    QTest::addColumn<qint64>("readChunk");
+    QTest::addColumn<int>("readEagain");
+    QTest::addColumn<qint64>("sockWriteLimit");
+}
+
+static Run fetchRun()
+{
+    QFETCH(qint64, high);
+    QFETCH(qint64, feedChunk);
+    QFETCH(qint64, coalesce);
+    QFETCH(qint64, window);
+    QFETCH(int, writeEagain);
+    QFETCH(qint64, readChunk);
+    QFETCH(int, readEagain);
+    QFETCH(qint64, sockWriteLimit);
+
+    Run run;
+    run.high = static_cast<size_t>(high);
+    run.feedChunk = feedChunk;
+    run.coalesce = static_cast<size_t>(coalesce);
+    run.sockWriteLimit = sockWriteLimit;
+    run.pattern.writeWindow = static_cast<size_t>(window);
+    run.pattern.writeEagainEvery = writeEagain;
+    run.pattern.readChunk = static_cast<size_t>(readChunk);
+    run.pattern.readEagainEvery = readEagain;
+    return run;
+}
+
+void ConnectorBench::sockToSsh_data()
+{
+    addColumns();
+    QTest::newRow("buffer 32K")   << qint64(32768)  << qint64(16384) << qint64(0)     << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("buffer 128K")  << qint64(131072) << qint64(16384) << qint64(0)     << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("buffer 1M")    << qint64(1 << 20) << qint64(65536) << qint64(0)    << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("window 2K")    << qint64(131072) << qint64(16384) << qint64(0)     << qint64(2048)  << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("eagain 1/4")   << qint64(131072) << qint64(16384) << qint64(0)     << qint64(32768) << 4 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("eagain 1/2")   << qint64(131072) << qint64(16384) << qint64(0)     << qint64(32768) << 2 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("small 256")    << qint64(131072) << qint64(256)   << qint64(0)     << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("small 256 coalesce 8K") << qint64(131072) << qint64(256) << qint64(8192) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+}
+
+void ConnectorBench::sockToSsh()
+{
+    Run run = fetchRun();
+    run.sockToSsh = VOLUME / ((run.feedChunk < 4096) ? 16 : 1);
+
+    SshTunnelDataConnector::Stats stats {};
+    QBENCHMARK
+    {
+        stats = pump(run);
+    }
+    QCOMPARE(stats.txToSsh, static_cast<quint64>(run.sockToSsh));
+    printStats(stats);
+}
+
+void ConnectorBench::sshToSock_data()
+{
+    addColumns();
+    QTest::newRow("buffer 32K")   << qint64(32768)  << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("buffer 128K")  << qint64(131072) << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("buffer 1M")    << qint64(1 << 20) << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("packet 2K")    << qint64(131072) << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(2048)  << 0 << qint64(0);
+    QTest::newRow("eagain 1/4")   << qint64(131072) << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 4 << qint64(0);
+    QTest::newRow("sock writes 4K") << qint64(131072) << qint64(0) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(4096);
+}
+
+void ConnectorBench::sshToSock()
+{
+    Run run = fetchRun();
+    run.sshToSock = VOLUME;
+
+    SshTunnelDataConnector::Stats stats {};
+    QBENCHMARK
+    {
+        stats = pump(run);
+    }
+    QCOMPARE(stats.rxToSock, static_cast<quint64>(run.sshToSock));
+    printStats(stats);
+}
+
+void ConnectorBench::bidirectional_data()
+{
+    addColumns();
+    QTest::newRow("buffer 128K")  << qint64(131072) << qint64(16384) << qint64(0) << qint64(32768) << 0 << qint64(32768) << 0 << qint64(0);
+    QTest::newRow("eagain both")  << qint64(131072) << qint64(16384) << qint64(0) << qint64(32768) << 3 << qint64(32768) << 3 << qint64(0);
+}
+
+void ConnectorBench::bidirectional()
+{
+    Run run = fetchRun();
+    run.sockToSsh = VOLUME;
+    run.sshToSock = VOLUME;
+
+    SshTunnelDataConnector::Stats stats {};
+    QBENCHMARK
+    {
+        stats = pump(run);
+    }
+    QCOMPARE(stats.txToSsh, static_cast<quint64>(run.sockToSsh));
+    QCOMPARE(stats.rxToSock, static_cast<quint64>(run.sshToSock));
+    printStats(stats);
+}
+
+QTEST_GUILESS_MAIN(ConnectorBench)
@@ -0,0 +1,25 @@
+#ifndef CONNECTORBENCH_H
+#define CONNECTORBENCH_H
+
+#include <QObject>
+
+/*
+ * Offline micro-benchmarks of SshTunnelDataConnector: the channel is a
+ * FakeChannelIo and the socket a FakeSocket, no sshd nor event loop needed
+ * (except to release coalesced writes). Each iteration moves a fixed volume
+ * through process() and the connector counters are printed once per row.
+ */
+class ConnectorBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sockToSsh_data();
+    void sockToSsh();
+    void sshToSock_data();
+    void sshToSock();
+    void bidirectional_data();
+    void bidirectional();
+};
+
+#endif // CONNECTORBENCH_H
@@ -0,0 +1,101 @@
+#include "fakechannel.h"
+
+#include <cstring>
+
+static QByteArray payload()
+{
+    QByteArray data(256 * 1024, Qt::Uninitialized);
+    for(int i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(i * 31 + 7);
+    }
+    return data;
+}
+
+FakeChannelIo::FakeChannelIo(const Pattern &pattern)
+    : m_pattern(pattern)
+    , m_payload(payload())
+{
+}
+
+void FakeChannelIo::setReadBudget(qint64 bytes)
+{
+    m_readBudget = bytes;
+    m_readServed = 0;
+}
+
+ssize_t FakeChannelIo::write(LIBSSH2_CHANNEL *, const char *, size_t length)
+{
+    ++m_writeCalls;
+    if(m_pattern.writeEagainEvery > 0 && m_writeCalls % static_cast<quint64>(m_pattern.writeEagainEvery) == 0)
+    {
+        return LIBSSH2_ERROR_EAGAIN;
+    }
+    size_t len = qMin(length, m_pattern.writeWindow);
+    m_written += static_cast<qint64>(len);
+    return static_cast<ssize_t>(len);
+}
+
+ssize_t FakeChannelIo::read(LIBSSH2_CHANNEL *, char *buffer, size_t length)
+{
+    ++m_readCalls;
+    if(m_readServed >= m_readBudget)
+    {
+        return LIBSSH2_ERROR_EAGAIN;
+    }
+    if(m_pattern.readEagainEvery > 0 && m_readCalls % static_cast<quint64>(m_pattern.readEagainEvery) == 0)
+    {
+        return LIBSSH2_ERROR_EAGAIN;
+    }
+    size_t len = qMin(qMin(length, m_pattern.readChunk), static_cast<size_t>(m_readBudget - m_readServed));
+    len = qMin(len, static_cast<size_t>(m_payload.size()));
+    std::memcpy(buffer, m_payload.constData(), len);
+    m_readServed += static_cast<qint64>(len);
+    return static_cast<ssize_t>(len);
+}
+
+int FakeChannelIo::eof(LIBSSH2_CHANNEL *)
+{
+    /* The peer keeps the channel open, the benchmark stops on byte counts */
+    return 0;
+}
+
+int FakeChannelIo::sendEof(LIBSSH2_CHANNEL *)
+{
+    return 0;
+}
+
+FakeSocket::FakeSocket(qint64 writeLimit, QObject *parent)
+    : QIODevice(parent)
+    , m_payload(payload())
+    , m_writeLimit(writeLimit)
+{
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+void FakeSocket::feed(qint64 bytes)
+{
+    m_available += bytes;
+    emit readyRead();
+}
+
+qint64 FakeSocket::bytesAvailable() const
+{
+    return m_available + QIODevice::bytesAvailable();
+}
+
+qint64 FakeSocket::readData(char *data, qint64 maxlen)
+{
+    qint64 len = qMin(qMin(maxlen, m_available), static_cast<qint64>(m_payload.size()));
+    std::memcpy(data, m_payload.constData(), static_cast<size_t>(len));
+    m_available -= len;
+    return len;
+}
+
+qint64 FakeSocket::writeData(const char *, qint64 len)
+{
+    qint64 accepted = (m_writeLimit > 0) ? qMin(len, m_writeLimit) : len;
+    m_received += accepted;
+    emit bytesWritten(accepted);
+    return accepted;
+}
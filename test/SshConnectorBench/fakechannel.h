@@ -0,0 +1,76 @@
+#ifndef FAKECHANNEL_H
+#define FAKECHANNEL_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include "sshchannelio.h"
+
+/*
+ * Channel backend replaying the behaviour of a remote peer without session:
+ * each call moves at most window bytes, one call out of eagainEvery returns
+ * LIBSSH2_ERROR_EAGAIN (0 never) and reads stop once the budget is served.
+ */
+class FakeChannelIo : public SshChannelIo
+{
+public:
+    struct Pattern
+    {
+        size_t writeWindow {32768};
+        int writeEagainEvery {0};
+        size_t readChunk {32768};
+        int readEagainEvery {0};
+    };
+
+    explicit FakeChannelIo(const Pattern &pattern);
+
+    void setReadBudget(qint64 bytes);
+    qint64 written() const { return m_written; }
+    qint64 readServed() const { return m_readServed; }
+
+    ssize_t write(LIBSSH2_CHANNEL *channel, const char *buffer, size_t length) override;
+    ssize_t read(LIBSSH2_CHANNEL *channel, char *buffer, size_t length) override;
+    int eof(LIBSSH2_CHANNEL *channel) override;
+    int sendEof(LIBSSH2_CHANNEL *channel) override;
+
+    /* Opaque handle, never dereferenced by the connector */
+    LIBSSH2_CHANNEL *handle() { return reinterpret_cast<LIBSSH2_CHANNEL *>(this); }
+
+private:
+    Pattern m_pattern;
+    QByteArray m_payload;
+    qint64 m_readBudget {0};
+    qint64 m_readServed {0};
+    qint64 m_written {0};
+    quint64 m_writeCalls {0};
+    quint64 m_readCalls {0};
+};
+
+/*
+ * Sequential in-process endpoint: feed() makes bytes readable and emits
+ * readyRead like a socket would, writes are accepted up to writeLimit.
+ */
+class FakeSocket : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit FakeSocket(qint64 writeLimit = 0, QObject *parent = nullptr);
+
+    void feed(qint64 bytes);
+    qint64 received() const { return m_received; }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    QByteArray m_payload;
+    qint64 m_available {0};
+    qint64 m_received {0};
+    qint64 m_writeLimit {0};
+};
+
+#endif // FAKECHANNEL_H
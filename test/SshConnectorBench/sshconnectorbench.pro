@@ -0,0 +1,15 @@
+QT -= gui
+
+QT += testlib
+
+CONFIG += c++1z console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += connectorbench.cpp fakechannel.cpp
+HEADERS += connectorbench.h fakechannel.h
+
+include(../../QtSsh.pri)
+
+LIBS += -lssh2
@@ -30,5 +30,7 @@ int main(int argc, char *argv[])
     */
 
     Tester test("127.0.0.1", "lpctest", "lpctest");
+    /* TESTSSH_STREAMING=1: multi-GB generated streams instead of in-memory datasets */
+    test.setStreaming(qEnvironmentVariableIntValue("TESTSSH_STREAMING") != 0);
     return QTest::qExec(&test, argc, argv);
 }
@@ -18,6 +18,9 @@ Q_LOGGING_CATEGORY(testssh, "test.ssh", QtInfoMsg)
 #define DUMP_IF_ERROR 0
 #define BENCHMARK_REPEAT 100
 
+#define STREAM_SEED_CLI2SRV 0x436C69324E727653ULL
+#define STREAM_SEED_SRV2CLI 0x5372763243436C69ULL
+
 static inline QString prettySize(long size)
 {
     if (static_cast<double>(size)/1024/1024 >= 1.0 )
@@ -46,13 +49,17 @@ Tester::Tester(QString hostname, QString login, QString password, QObject *paren
     m_timeout.setSingleShot(true);
 }
 
+void Tester::setStreaming(bool streaming)
+{
+    m_streaming = streaming;
+}
+
 void Tester::init()
 {
     qCDebug(testssh) << "Initializing test" << m_testName;
-    m_readcli.clear();
-    m_readsrv.clear();
-    m_readcli.reserve(m_currentDataToUse.size());
-    m_readsrv.reserve(m_currentDataToUse.size());
+    m_sourceCli.stop();
+    m_sourceSrv.stop();
+    resetReceived();
     m_timeout.start(TestTimeOut);
 }
 
@@ -62,7 +69,7 @@ void Tester::cleanup()
 #if DUMP_IF_ERROR
     QString testName = QTest::currentTestFunction();
     QString testFilename = testName.left(testName.indexOf("_"));
-    if ( QTest::currentTestFailed() )
+    if ( QTest::currentTestFailed() && !m_streaming )
     {
         if( m_mode & TEST_CLI2SRV)
         {
@@ -78,6 +85,39 @@ void Tester::cleanup()
 }
 
 void Tester::initTestCase()
+{
+    if(m_streaming)
+    {
+        qCInfo(testssh) << "Streaming test data, nothing to generate";
+    }
+    else
+    {
+        generateDataSets();
+    }
+
+    if (!m_srv.listen())
+    {
+        qCCritical(testssh) << "Can't listen server port";
+        emit endtest(false);
+        return;
+    }
+
+    m_ssh.setPassphrase(m_password);
+    QEventLoop waitssh;
+    QObject::connect(&m_ssh, &SshClient::sshReady, &waitssh, &QEventLoop::quit);
+    QObject::connect(&m_ssh, &SshClient::sshError, &waitssh, &QEventLoop::quit);
+    m_ssh.connectToHost(m_login, m_hostname, 22);
+    waitssh.exec();
+    if(m_ssh.sshState() != SshClient::SshState::Ready)
+    {
+        qCCritical(testssh) << "Can't connect to connexion server";
+        emit endtest(false);
+        return;
+    }
+    qCInfo(testssh) << "SSH connected";
+}
+
+void Tester::generateDataSets()
 {
     qCInfo(testssh) << "Generating test dataset";
 #define RANDOM_DATA 1
@@ -115,26 +155,6 @@ void Tester::initTestCase()
     }
 
 #endif
-    if (!m_srv.listen())
-    {
-        qCCritical(testssh) << "Can't listen server port";
-        emit endtest(false);
-        return;
-    }
-
-    m_ssh.setPassphrase(m_password);
-    QEventLoop waitssh;
-    QObject::connect(&m_ssh, &SshClient::sshReady, &waitssh, &QEventLoop::quit);
-    QObject::connect(&m_ssh, &SshClient::sshError, &waitssh, &QEventLoop::quit);
-    m_ssh.connectToHost(m_login, m_hostname, 22);
-    waitssh.exec();
-    if(m_ssh.sshState() != SshClient::SshState::Ready)
-    {
-        qCCritical(testssh) << "Can't connect to connexion server";
-        emit endtest(false);
-        return;
-    }
-    qCInfo(testssh) << "SSH connected";
 }
 
 void Tester::test1_RemoteProcess()
@@ -166,8 +186,7 @@ void Tester::test2_directTunnelComClientToServer()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int channelid=1;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("T2_OUT_%1").arg(channelid++));
     out1->listen(m_srv.serverPort());
     m_cli.connectToHost("127.0.0.1", out1->localPort());
@@ -197,8 +216,7 @@ void Tester::test3_directTunnelComServerToClient()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int channelid=1;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("T3_OUT_%1").arg(channelid++));
     out1->listen(m_srv.serverPort());
     m_cli.connectToHost("127.0.0.1", out1->localPort());
@@ -226,8 +244,7 @@ void Tester::test4_directTunnelComBothWays()
 #if ((TEST_ENABLE & 0x8) == 0)
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     static int c = 0;
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("T4_OUT_%1").arg(c++));
     out1->listen(m_srv.serverPort());
@@ -253,8 +270,7 @@ void Tester::test5_doubleDirectTunnelComBothWays()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("T5_OUT1_%1").arg(c++));
     out1->listen(m_srv.serverPort());
     SshTunnelOut *out2 = m_ssh.getChannel<SshTunnelOut>(QString("T5_OUT2_%1").arg(c++));
@@ -288,8 +304,7 @@ void Tester::test6_reverseTunnelComClientToServer()
 #else
     // Remote tunnel tcp server is local and client is remote
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T6_IN_%1").arg(c++));
     in1->listen("127.0.0.1", m_srv.serverPort(), 0);
     in1->waitForState(SshChannel::Ready);
@@ -316,8 +331,7 @@ void Tester::test7_reverseTunnelComServerToClient()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T7_IN_%1").arg(c++));
     in1->listen("127.0.0.1", m_srv.serverPort(), 0);
     in1->waitForState(SshChannel::Ready);
@@ -344,8 +358,7 @@ void Tester::test8_reverseTunnelBothWays()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T8_IN_%1").arg(c++));
     in1->listen("127.0.0.1", m_srv.serverPort(), 0);
     in1->waitForState(SshChannel::Ready);
@@ -373,8 +386,7 @@ void Tester::test9_doubleReverseTunnelBothWays()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse=dataForTest;
+    fetchTestData();
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T9_IN1_%1").arg(c++));
     in1->listen("127.0.0.1", m_srv.serverPort(), 0);
     in1->waitForState(SshChannel::Ready);
@@ -406,8 +418,7 @@ void Tester::test10_DirectAndReverseTunnelBothWays()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    QFETCH(QByteArray, dataForTest);
-    m_currentDataToUse = dataForTest;
+    fetchTestData();
 
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T10_IN_%1").arg(c++));
     in1->listen("127.0.0.1", m_srv.serverPort(), 0);
@@ -437,7 +448,7 @@ void Tester::benchmark1_directTunnelComClientToServer()
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
     static int c = 0;
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
     m_mode = TEST_CLI2SRV;
     m_testName = "SshTunnel Out Benchmark CLI ->O-> SRV";
 
@@ -452,21 +463,18 @@ void Tester::benchmark1_directTunnelComClientToServer()
     while (count)
     {
         if ( count != BENCHMARK_REPEAT )
-            m_cli.write(m_currentDataToUse);
+            sendFromClient();
         if ( m_waitTestEnd.exec() )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.stop();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
     // Cleanup test
     m_cli.disconnectFromHost();
     out1->close();
@@ -483,7 +491,7 @@ void Tester::benchmark2_directTunnelComServerToClient()
     static int channelid = 0;
     m_mode = TEST_SRV2CLI;
     m_testName = "SshTunnel Out Benchmark CLI <-O<- SRV";
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("S2_OUT_%1").arg(channelid++));
     out1->listen(m_srv.serverPort());
     int count = BENCHMARK_REPEAT;
@@ -493,21 +501,18 @@ void Tester::benchmark2_directTunnelComServerToClient()
     while (count)
     {
         if ( count != BENCHMARK_REPEAT )
-            m_srvSocket->write(m_currentDataToUse);
+            sendFromServer();
         int result = m_waitTestEnd.exec();
         if ( result )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
     // Cleanup test
     m_cli.disconnectFromHost();
     out1->close();
@@ -524,7 +529,7 @@ void Tester::benchmark3_directTunnelBothWays()
     static int channelid = 0;
     m_mode = TEST_BIDIR;
     m_testName = "SshTunnel Out Benchmark CLI <-O<- SRV";
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
     SshTunnelOut *out1 = m_ssh.getChannel<SshTunnelOut>(QString("T2_OUT_%1").arg(channelid++));
     out1->listen(m_srv.serverPort());
 
@@ -536,23 +541,20 @@ void Tester::benchmark3_directTunnelBothWays()
     {
         if ( count != BENCHMARK_REPEAT )
         {
-            m_srvSocket->write(m_currentDataToUse);
-            m_cli.write(m_currentDataToUse);
+            sendFromServer();
+            sendFromClient();
         }
         int result = m_waitTestEnd.exec();
         if ( result )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
     // Cleanup test
     m_cli.disconnectFromHost();
     out1->close();
@@ -567,7 +569,7 @@ void Tester::benchmark4_reverseTunnelComClientToServer()
 #if ((TEST_ENABLE & 0x2000) == 0)
     QSKIP("Test disabled by TEST_ENABLE variable");
 #else
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
     m_mode = TEST_CLI2SRV;
     m_testName = "SshTunnel IN Benchmark CLI ->I-> SRV";
 
@@ -583,21 +585,18 @@ void Tester::benchmark4_reverseTunnelComClientToServer()
     while (count)
     {
         if ( count != BENCHMARK_REPEAT )
-            m_cli.write(m_currentDataToUse);
+            sendFromClient();
         if ( m_waitTestEnd.exec() )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.stop();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
 
     // Cleanup test
     m_cli.disconnectFromHost();
@@ -614,7 +613,7 @@ void Tester::benchmark5_reverseTunnelComServerToClient()
 #else
     m_mode = TEST_SRV2CLI;
     m_testName = "SshTunnel Out Benchmark CLI <-O<- SRV";
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
 
     static int c = 0;
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T7_IN_%1").arg(c++));
@@ -628,21 +627,18 @@ void Tester::benchmark5_reverseTunnelComServerToClient()
     while (count)
     {
         if ( count != BENCHMARK_REPEAT )
-            m_srvSocket->write(m_currentDataToUse);
+            sendFromServer();
         int result = m_waitTestEnd.exec();
         if ( result )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
     // Cleanup test
     m_cli.disconnectFromHost();
     in1->close();
@@ -659,7 +655,7 @@ void Tester::benchmark6_reverseTunnelBothWays()
 #else
     m_mode = TEST_BIDIR;
     m_testName = "SshTunnel Out Benchmark CLI <-O<- SRV";
-    m_currentDataToUse=m_dataSetBySize[1024*1024*4];
+    useBenchmarkData(1024*1024*4);
 
     static int c = 0;
     SshTunnelIn *in1 = m_ssh.getChannel<SshTunnelIn>(QString("T7_IN_%1").arg(c++));
@@ -674,23 +670,20 @@ void Tester::benchmark6_reverseTunnelBothWays()
     {
         if ( count != BENCHMARK_REPEAT )
         {
-            m_srvSocket->write(m_currentDataToUse);
-            m_cli.write(m_currentDataToUse);
+            sendFromServer();
+            sendFromClient();
         }
         int result = m_waitTestEnd.exec();
         if ( result )
         {
             qCCritical(testssh) << "Test failed during benchmark";
         }
-        m_readcli.clear();
-        m_readsrv.clear();
-        m_readcli.reserve(m_currentDataToUse.size());
-        m_readsrv.reserve(m_currentDataToUse.size());
+        resetReceived();
         m_timeout.start(TestTimeOut);
         count--;
     }
     long elapsed = timer.elapsed();
-    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_currentDataToUse.count()) / (elapsed ), QTest::BytesPerSecond);
+    QTest::setBenchmarkResult(1000.0 * BENCHMARK_REPEAT * static_cast<qreal>(m_expectedSize) / (elapsed ), QTest::BytesPerSecond);
     // Cleanup test
     m_cli.disconnectFromHost();
     in1->close();
@@ -729,9 +722,23 @@ void Tester::findFirstDifference(const QByteArray &buffer)
 
 inline void Tester::compareResults()
 {
-    qCDebug(testssh) << "Compare results :" << "Srv data=" << m_readsrv.count()
-                     << ",Cli data=" << m_readcli.count()
-                     << ", expected="<< m_currentDataToUse.count();
+    qCDebug(testssh) << "Compare results :" << "Srv data=" << m_receivedSrv
+                     << ",Cli data=" << m_receivedCli
+                     << ", expected="<< m_expectedSize;
+    if(m_streaming)
+    {
+        if( m_mode & TEST_CLI2SRV)
+        {
+            QVERIFY2(m_receivedSrv == m_expectedSize, "Data received by server have not the expected size");
+            QVERIFY2(m_sinkSrv.ok(), qPrintable(QString("Data received by server have been corrupted at %1").arg(m_sinkSrv.firstError(), 0, 16)));
+        }
+        if ( m_mode & TEST_SRV2CLI )
+        {
+            QVERIFY2(m_receivedCli == m_expectedSize, "Data received by client have not the expected size");
+            QVERIFY2(m_sinkCli.ok(), qPrintable(QString("Data received by client have been corrupted at %1").arg(m_sinkCli.firstError(), 0, 16)));
+        }
+        return;
+    }
     if( m_mode & TEST_CLI2SRV)
     {
         QVERIFY2(m_readsrv == m_currentDataToUse, "Data received by server have been corrupted");
@@ -745,19 +752,78 @@ inline void Tester::compareResults()
 inline void Tester::populateTestData()
 {
     QTest::addColumn<QByteArray>("dataForTest");
+    QTest::addColumn<qint64>("dataSize");
 
+    if(m_streaming)
+    {
+        foreach(qint64 size, m_sizeForStreamDataSet)
+        {
+            QTest::newRow(QString("Stream of size %1").arg(prettySize(static_cast<long>(size))).toLocal8Bit().constData()) << QByteArray() << size;
+        }
+        return;
+    }
     foreach(long size, m_sizeForDataSet)
     {
-        QTest::newRow(QString("Buffer of size %1").arg(prettySize(size)).toLocal8Bit().constData()) << m_dataSetBySize[size];
+        QTest::newRow(QString("Buffer of size %1").arg(prettySize(size)).toLocal8Bit().constData()) << m_dataSetBySize[size] << static_cast<qint64>(size);
+    }
+}
+
+void Tester::fetchTestData()
+{
+    QFETCH(QByteArray, dataForTest);
+    QFETCH(qint64, dataSize);
+    m_currentDataToUse = dataForTest;
+    m_expectedSize = dataSize;
+    resetReceived();
+}
+
+void Tester::useBenchmarkData(long size)
+{
+    m_currentDataToUse = (m_streaming) ? QByteArray() : m_dataSetBySize[size];
+    m_expectedSize = size;
+    resetReceived();
+}
+
+void Tester::resetReceived()
+{
+    m_receivedSrv = 0;
+    m_receivedCli = 0;
+    m_readcli.clear();
+    m_readsrv.clear();
+    if(m_streaming)
+    {
+        m_sinkSrv.reset(STREAM_SEED_CLI2SRV);
+        m_sinkCli.reset(STREAM_SEED_SRV2CLI);
+    }
+    else
+    {
+        m_readcli.reserve(m_currentDataToUse.size());
+        m_readsrv.reserve(m_currentDataToUse.size());
     }
 }
 
+void Tester::sendFromClient()
+{
+    if(m_streaming)
+        m_sourceCli.start(&m_cli, STREAM_SEED_CLI2SRV, m_expectedSize);
+    else
+        m_cli.write(m_currentDataToUse);
+}
+
+void Tester::sendFromServer()
+{
+    if(m_streaming)
+        m_sourceSrv.start(m_srvSocket, STREAM_SEED_SRV2CLI, m_expectedSize);
+    else
+        m_srvSocket->write(m_currentDataToUse);
+}
+
 void Tester::checkTest()
 {
     bool res = true;
-    if( (m_mode & TEST_CLI2SRV) && (m_readsrv.size() < m_currentDataToUse.size()) )
+    if( (m_mode & TEST_CLI2SRV) && (m_receivedSrv < m_expectedSize) )
         res = false;
-    if ( (m_mode & TEST_SRV2CLI) && (m_readcli.size() < m_currentDataToUse.size()) )
+    if ( (m_mode & TEST_SRV2CLI) && (m_receivedCli < m_expectedSize) )
         res = false;
 
     if( res )
@@ -768,9 +834,9 @@ void Tester::checkTest()
     else if ( m_timeout.remainingTime() <= 0  )     // All the datas are not received and timeout occurs
     {
         /* Test failed Dump test */
-        qCInfo(testssh) << "checkTest() Timeout  SRV(" << m_readsrv.size()
-                            << ") CLI(" << m_readcli.size()
-                            << ") NEED(" << m_currentDataToUse.size() << ")";
+        qCInfo(testssh) << "checkTest() Timeout  SRV(" << m_receivedSrv
+                            << ") CLI(" << m_receivedCli
+                            << ") NEED(" << m_expectedSize << ")";
         emit endSubTest(-1);
     }
 }
@@ -786,25 +852,34 @@ void Tester::newServerConnection()
     if(m_mode & TEST_SRV2CLI)
     {
         qCDebug(testssh) << "Write data in server socket";
-        clientConnection->write(m_currentDataToUse);
         m_srvSocket = clientConnection;
+        sendFromServer();
     }
 }
 
 void Tester::serverDataReady()
 {
-    static long receivedData = 0;
     QTcpSocket *clientConnection = qobject_cast<QTcpSocket*>(sender());
     if(clientConnection)
     {
-        while (clientConnection->bytesAvailable() > 0 )
+        if(m_streaming)
+        {
+            m_sinkSrv.consume(clientConnection);
+            m_receivedSrv = m_sinkSrv.received();
+            /* Multi-GB streams: the timeout is on inactivity */
+            m_timeout.start(TestTimeOut);
+        }
+        else
         {
-            QByteArray res = clientConnection->readAll();
-            receivedData += res.size();
-            m_readsrv.append(res);
+            while (clientConnection->bytesAvailable() > 0 )
+            {
+                QByteArray res = clientConnection->readAll();
+                m_readsrv.append(res);
+            }
+            m_receivedSrv = m_readsrv.size();
         }
     }
-    if(m_readsrv.size() >= m_currentDataToUse.size())
+    if(m_receivedSrv >= m_expectedSize)
     {
         emit serverBufferChange();
     }
@@ -812,9 +887,19 @@ void Tester::serverDataReady()
 
 void Tester::clientDataReady()
 {
-    QByteArray res = m_cli.readAll();
-    m_readcli.append(res);
-    if(m_readcli.size() >= m_currentDataToUse.size())
+    if(m_streaming)
+    {
+        m_sinkCli.consume(&m_cli);
+        m_receivedCli = m_sinkCli.received();
+        m_timeout.start(TestTimeOut);
+    }
+    else
+    {
+        QByteArray res = m_cli.readAll();
+        m_readcli.append(res);
+        m_receivedCli = m_readcli.size();
+    }
+    if(m_receivedCli >= m_expectedSize)
         emit clientBufferChange();
 }
 
@@ -823,7 +908,7 @@ void Tester::clientConnected()
     qCDebug(testssh) << "Client socket connected";
     if(m_mode & TEST_CLI2SRV)
     {
-        qCDebug(testssh) << "Write data in client socket" << m_currentDataToUse.size();
-        m_cli.write(m_currentDataToUse);
+        qCDebug(testssh) << "Write data in client socket" << m_expectedSize;
+        sendFromClient();
     }
 }
@@ -6,6 +6,7 @@
 #include <QTcpServer>
 #include <QLoggingCategory>
 #include <QEventLoop>
+#include "teststream.h"
 
 Q_DECLARE_LOGGING_CATEGORY(testssh)
 
@@ -40,8 +41,20 @@ class Tester : public QObject
     QEventLoop m_waitTestEnd;
     QEventLoop m_waitGeneralPurpose;
 
+    /* Streaming mode: data generated on the fly and verified on receipt */
+    bool m_streaming {false};
+    QList<qint64> m_sizeForStreamDataSet = {16ll*1024*1024, 256ll*1024*1024, 1024ll*1024*1024, 4096ll*1024*1024};
+    qint64 m_expectedSize {0};
+    qint64 m_receivedSrv {0};
+    qint64 m_receivedCli {0};
+    TestStreamSource m_sourceCli;
+    TestStreamSource m_sourceSrv;
+    TestStreamSink m_sinkSrv;
+    TestStreamSink m_sinkCli;
+
 public:
     explicit Tester(QString hostname, QString login, QString password, QObject *parent = nullptr);
+    void setStreaming(bool streaming);
 
 public slots:
     void checkTest();
@@ -62,6 +75,12 @@ private:
     void findFirstDifference(const QByteArray &buffer);
     void compareResults();
     void populateTestData();
+    void generateDataSets();
+    void fetchTestData();
+    void useBenchmarkData(long size);
+    void resetReceived();
+    void sendFromClient();
+    void sendFromServer();
     void dumpData(const QString &testFilename, const QByteArray &data);
 private slots:
 
@@ -0,0 +1,142 @@
+#include "teststream.h"
+#include <QtEndian>
+#include <cstring>
+
+#define STREAM_CHUNK (256*1024)
+#define STREAM_WINDOW (1024*1024)
+
+TestStreamGenerator::TestStreamGenerator(quint64 seed)
+{
+    reset(seed);
+}
+
+void TestStreamGenerator::reset(quint64 seed)
+{
+    m_state = seed;
+    m_word = 0;
+    m_left = 0;
+}
+
+quint64 TestStreamGenerator::next()
+{
+    quint64 z = (m_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void TestStreamGenerator::fill(char *data, size_t length)
+{
+    /* Bytes of a word are produced low first, whatever the chunking */
+    while(length > 0 && m_left > 0)
+    {
+        *data++ = static_cast<char>(m_word & 0xFF);
+        m_word >>= 8;
+        m_left--;
+        length--;
+    }
+    while(length >= sizeof(quint64))
+    {
+        quint64 word = qToLittleEndian(next());
+        std::memcpy(data, &word, sizeof(word));
+        data += sizeof(word);
+        length -= sizeof(word);
+    }
+    if(length > 0)
+    {
+        m_word = next();
+        m_left = sizeof(quint64);
+        fill(data, length);
+    }
+}
+
+TestStreamSource::TestStreamSource(QObject *parent)
+    : QObject(parent)
+    , m_chunk(STREAM_CHUNK, Qt::Uninitialized)
+{
+}
+
+void TestStreamSource::start(QIODevice *device, quint64 seed, qint64 size)
+{
+    stop();
+    m_device = device;
+    m_generator.reset(seed);
+    m_size = size;
+    m_sent = 0;
+    m_connection = QObject::connect(device, &QIODevice::bytesWritten, this, &TestStreamSource::_fill);
+    _fill();
+}
+
+void TestStreamSource::stop()
+{
+    QObject::disconnect(m_connection);
+    m_device = nullptr;
+}
+
+void TestStreamSource::_fill()
+{
+    while(m_device && m_sent < m_size && m_device->bytesToWrite() < STREAM_WINDOW)
+    {
+        qint64 len = qMin(static_cast<qint64>(m_chunk.size()), m_size - m_sent);
+        m_generator.fill(m_chunk.data(), static_cast<size_t>(len));
+        qint64 written = m_device->write(m_chunk.constData(), len);
+        if(written != len)
+        {
+            /* Buffered sockets take everything, anything else is an error */
+            stop();
+            return;
+        }
+        m_sent += written;
+    }
+    if(m_sent >= m_size)
+    {
+        stop();
+    }
+}
+
+TestStreamSink::TestStreamSink()
+    : m_buffer(STREAM_CHUNK, Qt::Uninitialized)
+    , m_expected(STREAM_CHUNK, Qt::Uninitialized)
+{
+}
+
+void TestStreamSink::reset(quint64 seed)
+{
+    m_generator.reset(seed);
+    m_received = 0;
+    m_firstError = -1;
+}
+
+void TestStreamSink::consume(QIODevice *device)
+{
+    while(device->bytesAvailable() > 0)
+    {
+        qint64 len = device->read(m_buffer.data(), m_buffer.size());
+        if(len <= 0)
+        {
+            break;
+        }
+        consume(m_buffer.constData(), static_cast<size_t>(len));
+    }
+}
+
+void TestStreamSink::consume(const char *data, size_t length)
+{
+    while(length > 0)
+    {
+        size_t len = qMin(length, static_cast<size_t>(m_expected.size()));
+        m_generator.fill(m_expected.data(), len);
+        if(m_firstError < 0 && std::memcmp(data, m_expected.constData(), len) != 0)
+        {
+            size_t ii = 0;
+            while(data[ii] == m_expected.at(static_cast<int>(ii)))
+            {
+                ii++;
+            }
+            m_firstError = m_received + static_cast<qint64>(ii);
+        }
+        m_received += static_cast<qint64>(len);
+        data += len;
+        length -= len;
+    }
+}
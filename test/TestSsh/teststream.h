@@ -0,0 +1,78 @@
+#ifndef TESTSTREAM_H
+#define TESTSTREAM_H
+
+#include <QObject>
+#include <QPointer>
+#include <QIODevice>
+
+/*
+ * Seeded pseudo random byte stream (splitmix64). The bytes only depend on
+ * the seed and the offset, not on how the stream is cut in chunks, so the
+ * receiver regenerates what it should get without keeping the data.
+ */
+class TestStreamGenerator
+{
+public:
+    explicit TestStreamGenerator(quint64 seed = 0);
+    void reset(quint64 seed);
+    void fill(char *data, size_t length);
+
+private:
+    quint64 next();
+
+    quint64 m_state {0};
+    quint64 m_word {0};
+    int m_left {0};
+};
+
+/*
+ * Writes size bytes of the stream in a device, refilled on bytesWritten
+ * so that no more than a window of data is queued at once.
+ */
+class TestStreamSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TestStreamSource(QObject *parent = nullptr);
+    void start(QIODevice *device, quint64 seed, qint64 size);
+    void stop();
+    qint64 sent() const { return m_sent; }
+
+private slots:
+    void _fill();
+
+private:
+    QPointer<QIODevice> m_device;
+    QMetaObject::Connection m_connection;
+    TestStreamGenerator m_generator;
+    QByteArray m_chunk;
+    qint64 m_size {0};
+    qint64 m_sent {0};
+};
+
+/*
+ * Checks received data against the regenerated stream as it arrives and
+ * keeps the offset of the first corrupted byte.
+ */
+class TestStreamSink
+{
+public:
+    TestStreamSink();
+    void reset(quint64 seed);
+    void consume(QIODevice *device);
+    void consume(const char *data, size_t length);
+
+    qint64 received() const { return m_received; }
+    bool ok() const { return m_firstError < 0; }
+    qint64 firstError() const { return m_firstError; }
+
+private:
+    TestStreamGenerator m_generator;
+    QByteArray m_buffer;
+    QByteArray m_expected;
+    qint64 m_received {0};
+    qint64 m_firstError {-1};
+};
+
+#endif // TESTSTREAM_H
@@ -0,0 +1,143 @@
+#include "testtar.h"
+#include "sshtararchive.h"
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <cstring>
+
+#define TAR_BLOCK 512
+
+/* One ustar member, the reader only checks the checksum */
+static QByteArray member(const QByteArray &name, const QByteArray &data)
+{
+    QByteArray header(TAR_BLOCK, '\0');
+    char *h = header.data();
+    std::memcpy(h, name.constData(), static_cast<size_t>(qMin(name.size(), 100)));
+    std::memcpy(h + 100, "0000644", 8);
+    std::memcpy(h + 108, "0000000", 8);
+    std::memcpy(h + 116, "0000000", 8);
+    std::memcpy(h + 124, QByteArray::number(data.size(), 8).rightJustified(11, '0').constData(), 12);
+    std::memcpy(h + 136, "00000000000", 12);
+    h[156] = '0';
+    std::memcpy(h + 257, "ustar", 6);
+    std::memcpy(h + 263, "00", 2);
+    unsigned int sum = 0;
+    for(int i = 0; i < TAR_BLOCK; i++)
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(h[i]);
+    std::memcpy(h + 148, QByteArray::number(sum, 8).rightJustified(6, '0').constData(), 7);
+    h[155] = ' ';
+
+    QByteArray padding((TAR_BLOCK - data.size() % TAR_BLOCK) % TAR_BLOCK, '\0');
+    return header + data + padding;
+}
+
+static QByteArray archiveEnd()
+{
+    return QByteArray(2 * TAR_BLOCK, '\0');
+}
+
+static QByteArray writeArchive(const QString &dir)
+{
+    SshTarWriter writer;
+    if(!writer.addTree(dir))
+        return QByteArray();
+    QByteArray archive;
+    while(!writer.atEnd())
+        archive += writer.read(64 * 1024);
+    return archive;
+}
+
+void TestTar::refused_data()
+{
+    QTest::addColumn<QByteArray>("name");
+
+    QTest::newRow("absolute") << QByteArray("/tmp/qtssh-escape");
+    QTest::newRow("drive") << QByteArray("C:\\qtssh-escape");
+    QTest::newRow("dotdot") << QByteArray("../qtssh-escape");
+    QTest::newRow("inner-dotdot") << QByteArray("a/../../qtssh-escape");
+    QTest::newRow("backslash-dotdot") << QByteArray("..\\..\\qtssh-escape");
+}
+
+void TestTar::refused()
+{
+    QFETCH(QByteArray, name);
+    QVERIFY(m_tmp.isValid());
+    QString dest = m_tmp.filePath(QString("refused-%1").arg(QTest::currentDataTag()));
+    QVERIFY(QDir().mkpath(dest));
+
+    QByteArray archive = member(name, "outside") + member("inside.txt", "inside") + archiveEnd();
+    SshTarReader reader(dest);
+    QVERIFY(reader.feed(archive.constData(), archive.size()));
+    QVERIFY(reader.atEnd());
+    QCOMPARE(reader.skippedCount(), 1);
+    QCOMPARE(reader.fileCount(), 1);
+    QVERIFY(QFile::exists(dest + "/inside.txt"));
+
+    /* Nothing written next to the destination */
+    QCOMPARE(QDir(m_tmp.path()).entryList(QStringList() << "*qtssh-escape*", QDir::AllEntries | QDir::Hidden).size(), 0);
+    QVERIFY(!QFile::exists("/tmp/qtssh-escape"));
+}
+
+void TestTar::paxLongName()
+{
+    QVERIFY(m_tmp.isValid());
+    QString source = m_tmp.filePath("pax-source");
+    /* Above the 100 + 155 bytes of ustar name and prefix */
+    QString deep = QString(60, 'd') + "/" + QString(60, 'e') + "/" + QString(60, 'f') + "/" + QString(60, 'g');
+    QString name = deep + "/" + QString(120, 'n') + ".txt";
+    QVERIFY(QDir().mkpath(source + "/" + deep));
+    QFile file(source + "/" + name);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QByteArray content(100000, 'x');
+    file.write(content);
+    file.close();
+
+    QByteArray archive = writeArchive(source);
+    QVERIFY(!archive.isEmpty());
+
+    QString dest = m_tmp.filePath("pax-dest");
+    QVERIFY(QDir().mkpath(dest));
+    SshTarReader reader(dest);
+    /* Pieces smaller than a block, as received from a channel */
+    for(int i = 0; i < archive.size(); i += 300)
+        QVERIFY(reader.feed(archive.constData() + i, qMin(300, archive.size() - i)));
+    QVERIFY(reader.atEnd());
+    QVERIFY(!reader.isError());
+    QCOMPARE(reader.fileCount(), 1);
+
+    QFile extracted(dest + "/" + name);
+    QVERIFY(extracted.open(QIODevice::ReadOnly));
+    QCOMPARE(extracted.readAll(), content);
+}
+
+void TestTar::truncated()
+{
+    QVERIFY(m_tmp.isValid());
+    QString source = m_tmp.filePath("truncated-source");
+    QVERIFY(QDir().mkpath(source));
+    for(int i = 0; i < 3; i++)
+    {
+        QFile file(QString("%1/file%2").arg(source).arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(10000, static_cast<char>('a' + i)));
+    }
+    QByteArray archive = writeArchive(source);
+    QVERIFY(!archive.isEmpty());
+
+    /* Cut in the data of a member: the stream is not complete */
+    QString dest = m_tmp.filePath("truncated-dest");
+    QVERIFY(QDir().mkpath(dest));
+    SshTarReader reader(dest);
+    int cut = archive.size() / 2 + 7;
+    reader.feed(archive.constData(), cut);
+    QVERIFY(!reader.atEnd());
+    QVERIFY(reader.fileCount() < 3);
+
+    /* Cut in a header */
+    SshTarReader header(m_tmp.filePath("truncated-header"));
+    QVERIFY(header.feed(archive.constData(), TAR_BLOCK / 2));
+    QVERIFY(!header.atEnd());
+    QCOMPARE(header.fileCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestTar)
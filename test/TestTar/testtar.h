@@ -0,0 +1,24 @@
+#ifndef TESTTAR_H
+#define TESTTAR_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+/*
+ * Offline tests of SshTarReader: archives are made by SshTarWriter or
+ * built member by member, and extracted in a temporary directory.
+ */
+class TestTar : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_tmp;
+
+private slots:
+    void refused_data();
+    void refused();
+    void paxLongName();
+    void truncated();
+};
+
+#endif // TESTTAR_H
@@ -0,0 +1,15 @@
+QT -= gui
+
+QT += testlib
+
+CONFIG += c++1z console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += testtar.cpp
+HEADERS += testtar.h
+
+include(../../QtSsh.pri)
+
+LIBS += -lssh2
@@ -0,0 +1,40 @@
+#include "testwritewindow.h"
+#include "sshwritewindow.h"
+#include <QTest>
+
+#define KB 1024UL
+#define MB (1024UL * KB)
+
+void TestWriteWindow::adjustAfterPoll()
+{
+    SshWriteWindow window;
+    QVERIFY(window.adjusted(2 * MB));
+    QVERIFY(!window.adjusted(2 * MB));
+    QVERIFY(window.adjusted(3 * MB));
+}
+
+void TestWriteWindow::adjustSmallerThanPolled()
+{
+    /* Polled at 2 MB, then the writer uses it all and blocks */
+    SshWriteWindow window;
+    QVERIFY(window.adjusted(2 * MB));
+    window.written(MB);
+    window.written(0);
+
+    /* The peer gives back less than the window polled before */
+    QVERIFY(window.adjusted(256 * KB));
+    QVERIFY(!window.adjusted(256 * KB));
+}
+
+void TestWriteWindow::noAdjust()
+{
+    /* Writes shrinking the window are not an adjust */
+    SshWriteWindow window;
+    QVERIFY(window.adjusted(MB));
+    window.written(512 * KB);
+    QVERIFY(!window.adjusted(512 * KB));
+    window.written(0);
+    QVERIFY(!window.adjusted(0));
+}
+
+QTEST_GUILESS_MAIN(TestWriteWindow)
@@ -0,0 +1,20 @@
+#ifndef TESTWRITEWINDOW_H
+#define TESTWRITEWINDOW_H
+
+#include <QObject>
+
+/*
+ * Offline tests of SshWriteWindow, the wake up of writers blocked on the
+ * channel window: the windows are the values libssh2 would report.
+ */
+class TestWriteWindow : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void adjustAfterPoll();
+    void adjustSmallerThanPolled();
+    void noAdjust();
+};
+
+#endif // TESTWRITEWINDOW_H